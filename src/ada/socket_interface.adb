@@ -115,6 +115,13 @@ is
             Sock.rcvNxt                := 0;
             Sock.rcvUser               := 0;
             Sock.rcvWnd                := 0;
+            Sock.wndScaleOptionReceived := False;
+            Sock.sndWndShift           := 0;
+            Sock.rcvWndShift           := 0;
+            Sock.tsOptionReceived      := False;
+            Sock.tsRecent              := 0;
+            Sock.tsRecentAge           := 0;
+            Sock.lastAckSent           := 0;
             Sock.rttBusy               := False;
             Sock.rttSeqNum             := 0;
             Sock.rettStartTime         := 0;
@@ -127,6 +134,7 @@ is
             Sock.dupAckCount           := 0;
             Sock.n                     := 0;
             Sock.recover               := 0;
+            Sock.congestAlgo           := TCP_CONGEST_ALGO_RENO;
             Sock.txBuffer.chunkCount   := 0;
             Sock.txBufferSize          := 2_860;
             Sock.rxBuffer.chunkCount   := 0;
@@ -139,11 +147,17 @@ is
             Sock.synQueueSize          := 0;
             Sock.wndProbeCount         := 0;
             Sock.wndProbeInterval      := 0;
+            Sock.delayedAckEnabled     := True;
+            Sock.delayedAckBytes       := 0;
             Sock.sackPermitted         := False;
             Sock.sackBlockCount        := 0;
+            Sock.rxDataCopied          := False;
             Sock.receiveQueue          := null;
             pragma Annotate (GNATprove, False_Positive,
                            "memory leak might occur", "Memory should already be free");
+
+            -- Index the socket by local port
+            Socket_Update_Hash (Sock);
          end if;
       end if;
 
@@ -215,6 +229,7 @@ is
       elsif Sock.S_Type = SOCKET_TYPE_DGRAM then
          Sock.S_Remote_Ip_Addr := Remote_Ip_Addr;
          Sock.S_Remote_Port  := Remote_Port;
+         Socket_Update_Hash (Sock);
          Error               := NO_ERROR;
 
          -- Raw Socket?
@@ -415,6 +430,8 @@ is
 
             -- Mark the socket as closed
             Sock.S_Type := SOCKET_TYPE_UNUSED;
+            -- Remove the socket from the hash tables
+            Socket_Update_Hash (Sock);
 
             -- Fake free the socket
             Free_Socket (Sock);
@@ -460,6 +477,7 @@ is
    begin
       Sock.S_localIpAddr := Local_Ip_Addr;
       Sock.S_Local_Port  := Local_Port;
+      Socket_Update_Hash (Sock);
    end Socket_Bind;
 
    -------------------
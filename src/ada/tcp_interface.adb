@@ -65,6 +65,8 @@ is
          -- Save port number and IP address of the remote host
          Sock.S_Remote_Ip_Addr := Remote_Ip_Addr;
          Sock.S_Remote_Port  := Remote_Port;
+         -- Index the socket by its remote endpoint
+         Socket_Update_Hash (Sock);
 
          -- Select the source address and the relevant network interface
          -- to use when establishing the connection
@@ -121,7 +123,16 @@ is
          Sock.rcvUser := 0;
 
          -- Initialize TCP control block
-         Sock.rcvWnd := unsigned_short(Sock.rxBufferSize);
+         Sock.rcvWnd := unsigned(Sock.rxBufferSize);
+
+         -- Scale factor to offer in the SYN segment
+         Sock.wndScaleOptionReceived := False;
+         Sock.sndWndShift := 0;
+         Sock.rcvWndShift := Tcp_Compute_Window_Shift (size_t(Sock.rxBufferSize));
+
+         -- Timestamps are offered in the SYN segment
+         Sock.tsOptionReceived := False;
+         Sock.tsRecent := 0;
 
          -- Default retransmission timeout
          Sock.rto := TCP_INITIAL_RTO;
@@ -130,11 +141,11 @@ is
          Sock.congestState := TCP_CONGEST_STATE_IDLE;
 
          -- Initial congestion window
-         Sock.cwnd := unsigned_short(
+         Sock.cwnd := unsigned(
                         unsigned_long'Min(unsigned_long(TCP_INITIAL_WINDOW) * unsigned_long(Sock.smss),
                                           unsigned_long(Sock.txBufferSize)));
          -- Slow start threshold should be set arbitrarily high
-         Sock.ssthresh := unsigned_short'Last;
+         Sock.ssthresh := unsigned'Last;
          -- Recover is set to the initial send sequence number
          Sock.recover := Sock.iss;
 
@@ -194,6 +205,8 @@ is
 
       -- Place the socket in the listening state
       Tcp_Change_State (Sock, TCP_STATE_LISTEN);
+      -- Listening sockets are indexed by local port only
+      Socket_Update_Hash (Sock);
 
       -- Sucessful processing
       -- Error := NO_ERROR;
@@ -287,6 +300,7 @@ is
             -- Inherit settings from the listening socket
             Client_Socket.txBufferSize := Sock.txBufferSize;
             Client_Socket.rxBufferSize := Sock.rxBufferSize;
+            Client_Socket.delayedAckEnabled := Sock.delayedAckEnabled;
 
             -- Number of chunks that comprise the TX and the RX buffers
             Client_Socket.txBuffer.maxChunkCound :=
@@ -320,6 +334,8 @@ is
                -- Save the port number and the IP address of the remote host
                Client_Socket.S_Remote_Ip_Addr := Queue_Item.Src_Addr;
                Client_Socket.S_Remote_Port := Queue_Item.Src_Port;
+               -- Index the socket by its remote endpoint
+               Socket_Update_Hash (Client_Socket);
 
                -- The SMSS is the size of the largest segment that the sender
                -- can transmit
@@ -338,7 +354,34 @@ is
                Client_Socket.sndNxt  := Client_Socket.iss + 1;
                Client_Socket.rcvNxt  := Client_Socket.irs + 1;
                Client_Socket.rcvUser := 0;
-               Client_Socket.rcvWnd  := unsigned_short(Client_Socket.rxBufferSize);
+               Client_Socket.rcvWnd  := unsigned(Client_Socket.rxBufferSize);
+
+               -- Window scaling is used only if the SYN segment of the peer
+               -- carried a Window Scale option
+               if Queue_Item.Wnd_Scale_Option_Received then
+                  Client_Socket.wndScaleOptionReceived := True;
+                  Client_Socket.sndWndShift := Queue_Item.Wnd_Shift;
+                  Client_Socket.rcvWndShift :=
+                     Tcp_Compute_Window_Shift (size_t(Client_Socket.rxBufferSize));
+               end if;
+
+               -- Timestamps are used only if the SYN segment of the peer
+               -- carried a Timestamps option
+               if Queue_Item.Ts_Option_Received then
+                  Client_Socket.tsOptionReceived := True;
+                  Client_Socket.tsRecent := Queue_Item.Ts_Val;
+                  Client_Socket.tsRecentAge := Os_Get_System_Time;
+
+                  -- Leave room for the option in every segment
+                  if Client_Socket.smss >=
+                     TCP_MIN_MSS + TCP_TIMESTAMPS_OPTION_LENGTH
+                  then
+                     Client_Socket.smss :=
+                        Client_Socket.smss - TCP_TIMESTAMPS_OPTION_LENGTH;
+                  else
+                     Client_Socket.smss := TCP_MIN_MSS;
+                  end if;
+               end if;
 
                -- Default retransmission timeout
                Client_Socket.rto := TCP_INITIAL_RTO;
@@ -346,13 +389,15 @@ is
                -- Default congestion state
                Sock.congestState := TCP_CONGEST_STATE_IDLE;
                -- Initial congestion window
-               Client_Socket.cwnd := unsigned_short(unsigned_long'Min
+               Client_Socket.cwnd := unsigned(unsigned_long'Min
                         (unsigned_long(TCP_INITIAL_WINDOW * Client_Socket.smss),
                          unsigned_long(Client_Socket.txBufferSize)));
                -- Slow start threshold should be set arbitrarily high
-               Client_Socket.ssthresh := unsigned_short'Last;
+               Client_Socket.ssthresh := unsigned'Last;
                -- Recover is set to the initial send sequence number
                Client_Socket.recover := Client_Socket.iss;
+               -- The connection inherits the algorithm of the listening socket
+               Client_Socket.congestAlgo := Sock.congestAlgo;
 
                -- Send a SYN ACK control segment
                Tcp_Send_Segment
@@ -429,6 +474,8 @@ is
             Tcp_Delete_Control_Block (Sock);
             -- Mark the socket as closed
             Sock.S_Type := SOCKET_TYPE_UNUSED;
+            -- Remove the socket from the hash tables
+            Socket_Update_Hash (Sock);
 
          -- TIME-WAIT state?
          when TCP_STATE_TIME_WAIT =>
@@ -450,6 +497,8 @@ is
             Tcp_Delete_Control_Block (Sock);
             -- Mark the socket as closed
             Sock.S_Type := SOCKET_TYPE_UNUSED;
+            -- Remove the socket from the hash tables
+            Socket_Update_Hash (Sock);
             -- No error to report
             Error := NO_ERROR;
       end case;
@@ -586,7 +635,7 @@ is
                 Length  => unsigned(N));
 
             -- Update the number of data buffered but not yet sent
-            Sock.sndUser := Sock.sndUser + unsigned_short(N);
+            Sock.sndUser := Sock.sndUser + unsigned(N);
 
             -- Update TX events
             Tcp_Update_Events (Sock);
@@ -832,7 +881,7 @@ is
          pragma Assert (Received in 1 .. Data'Length);
 
          -- Remaining data still available in the receive buffer
-         Sock.rcvUser := Sock.rcvUser - unsigned_short(N);
+         Sock.rcvUser := Sock.rcvUser - unsigned(N);
 
          -- Update the receive window
          Tcp_Update_Receive_Window(Sock);
@@ -907,6 +956,8 @@ is
          Tcp_Delete_Control_Block (Sock);
          -- Mark the socket as closed
          Sock.S_Type := SOCKET_TYPE_UNUSED;
+         -- Remove the socket from the hash tables
+         Socket_Update_Hash (Sock);
       end if;
    end Tcp_Kill_Oldest_Connection;
 
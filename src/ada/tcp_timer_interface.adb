@@ -8,19 +8,18 @@ package body Tcp_Timer_Interface is
    procedure Tcp_Timer_Start
       (Timer       : in out Tcp_Timer;
        Timer_Delay : in     Systime)
+   with SPARK_Mode => Off
    is
-      function Os_Get_System_Time return Systime
+      procedure tcpTimerStart
+         (Timer       : in out Tcp_Timer;
+          Timer_Delay : Systime)
       with
          Import => True,
          Convention => C,
-         External_Name => "osGetSystemTime";
+         External_Name => "tcpTimerStart";
    begin
-      -- Start Timer
-      Timer.startTime := Os_Get_System_Time;
-      Timer.interval := Timer_Delay;
-
-      -- The timer is now running
-      Timer.running := True;
+      -- Start Timer and register its deadline with the timer wheel
+      tcpTimerStart (Timer, Timer_Delay);
    end Tcp_Timer_Start;
 
 end Tcp_Timer_Interface;
\ No newline at end of file
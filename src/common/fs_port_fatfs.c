@@ -535,6 +535,67 @@ error_t fsReadFile(FsFile *file, void *data, size_t size, size_t *length)
 }
 
 
+/**
+ * @brief Read data from the specified file at a given position
+ * @param[in] file Handle that identifies the file to be read
+ * @param[in] offset Position in the file, in bytes
+ * @param[in] data Pointer to the buffer where to copy the data
+ * @param[in] size Size of the buffer, in bytes
+ * @param[out] length Number of data bytes that have been read
+ * @return Error code
+ **/
+
+error_t fsReadFileAt(FsFile *file, uint32_t offset, void *data, size_t size,
+   size_t *length)
+{
+   UINT n;
+   FRESULT res;
+
+   //Check parameters
+   if(file == NULL || length == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //No data has been read yet
+   *length = 0;
+
+#if ((FATFS_REVISON <= FATFS_R(0, 12, c) && _FS_REENTRANT == 0) || \
+   (FATFS_REVISON >= FATFS_R(0, 13, 0) && FF_FS_REENTRANT == 0))
+   //Enter critical section
+   osAcquireMutex(&fsMutex);
+#endif
+
+   //Move the read pointer and read data while holding the mutex, so that
+   //the operation cannot be interleaved with another access to the file
+   res = f_lseek((FIL *) file, offset);
+
+   //Check status code
+   if(res == FR_OK)
+   {
+      //Read data
+      res = f_read((FIL *) file, data, size, &n);
+   }
+
+#if ((FATFS_REVISON <= FATFS_R(0, 12, c) && _FS_REENTRANT == 0) || \
+   (FATFS_REVISON >= FATFS_R(0, 13, 0) && FF_FS_REENTRANT == 0))
+   //Leave critical section
+   osReleaseMutex(&fsMutex);
+#endif
+
+   //Any error to report?
+   if(res != FR_OK)
+      return ERROR_FAILURE;
+
+   //End of file?
+   if(!n)
+      return ERROR_END_OF_FILE;
+
+   //Total number of data that have been read
+   *length = n;
+   //Successful processing
+   return NO_ERROR;
+}
+
+
 /**
  * @brief Close a file
  * @param[in] file Handle that identifies the file to be closed
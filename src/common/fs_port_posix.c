@@ -384,6 +384,39 @@ error_t fsReadFile(FsFile *file, void *data, size_t size, size_t *length)
 }
 
 
+/**
+ * @brief Read data from the specified file at a given position
+ * @param[in] file Handle that identifies the file to be read
+ * @param[in] offset Position in the file, in bytes
+ * @param[in] data Pointer to the buffer where to copy the data
+ * @param[in] size Size of the buffer, in bytes
+ * @param[out] length Number of data bytes that have been read
+ * @return Error code
+ **/
+
+error_t fsReadFileAt(FsFile *file, uint32_t offset, void *data, size_t size,
+   size_t *length)
+{
+   int_t ret;
+
+   //Check parameters
+   if(file == NULL || length == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //No data has been read yet
+   *length = 0;
+
+   //Move the file pointer to the specified position
+   ret = fseek(file, offset, SEEK_SET);
+   //Any error to report?
+   if(ret != 0)
+      return ERROR_FAILURE;
+
+   //Read data
+   return fsReadFile(file, data, size, length);
+}
+
+
 /**
  * @brief Close a file
  * @param[in] file Handle that identifies the file to be closed
@@ -78,6 +78,8 @@ FsFile *fsOpenFile(const char_t *path, uint_t mode);
 error_t fsSeekFile(FsFile *file, int_t offset, uint_t origin);
 error_t fsWriteFile(FsFile *file, void *data, size_t length);
 error_t fsReadFile(FsFile *file, void *data, size_t size, size_t *length);
+error_t fsReadFileAt(FsFile *file, uint32_t offset, void *data, size_t size,
+   size_t *length);
 void fsCloseFile(FsFile *file);
 
 bool_t fsDirExists(const char_t *path);
@@ -36,11 +36,18 @@
 #include "core/net.h"
 #include "core/bsd_socket.h"
 #include "core/socket.h"
+#include "core/tcp_congest.h"
+#include "core/socket_event_set.h"
 #include "debug.h"
 
 //Check TCP/IP stack configuration
 #if (BSD_SOCKET_SUPPORT == ENABLED)
 
+#if (SOCKET_EVENT_SET_SUPPORT == ENABLED)
+//User data attached to the sockets monitored through epoll
+static epoll_data_t epollData[SOCKET_MAX_COUNT];
+#endif
+
 //Common IPv6 addresses
 const in6_addr in6addr_any =
    {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}};
@@ -803,7 +810,7 @@ int_t getsockname(int_t s, sockaddr *addr, socklen_t *addrlen)
    sock = &socketTable[s];
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(sock, FALSE);
 
    //Check whether the socket has been bound to an address
    if(sock->localIpAddr.length != 0)
@@ -864,7 +871,7 @@ int_t getsockname(int_t s, sockaddr *addr, socklen_t *addrlen)
    }
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(sock);
 
    //return status code
    return ret;
@@ -895,7 +902,7 @@ int_t getpeername(int_t s, sockaddr *addr, socklen_t *addrlen)
    sock = &socketTable[s];
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(sock, FALSE);
 
    //Check whether the socket is connected to a peer
    if(sock->remoteIpAddr.length != 0)
@@ -956,7 +963,7 @@ int_t getpeername(int_t s, sockaddr *addr, socklen_t *addrlen)
    }
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(sock);
 
    //return status code
    return ret;
@@ -981,6 +988,12 @@ int_t setsockopt(int_t s, int_t level, int_t optname,
    int_t *val;
    timeval *t;
    Socket *sock;
+#if (TCP_SUPPORT == ENABLED && TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+   TcpCongestAlgo algo;
+#endif
+#if (TCP_SUPPORT == ENABLED && TCP_PACING_SUPPORT == ENABLED)
+   uint32_t *rate;
+#endif
 
    //Make sure the socket descriptor is valid
    if(s < 0 || s >= SOCKET_MAX_COUNT)
@@ -1058,6 +1071,40 @@ int_t setsockopt(int_t s, int_t level, int_t optname,
             //We are done
             break;
 
+#if (TCP_SUPPORT == ENABLED && TCP_PACING_SUPPORT == ENABLED)
+         //Set pacing rate
+         case SO_MAX_PACING_RATE:
+            //Check the length of the option
+            if(optlen >= (socklen_t) sizeof(uint32_t))
+            {
+               //Cast the option value to the relevant type
+               rate = (uint32_t *) optval;
+
+               //Save the pacing rate (0xFFFFFFFF derives the rate from the
+               //congestion window and the RTT)
+               if(!socketSetPacingRate(sock, *rate))
+               {
+                  //Successful processing
+                  ret = SOCKET_SUCCESS;
+               }
+               else
+               {
+                  //The socket is not a stream socket
+                  sock->errnoCode = ENOPROTOOPT;
+                  ret = SOCKET_ERROR;
+               }
+            }
+            else
+            {
+               //The option length is not valid
+               sock->errnoCode = EFAULT;
+               ret = SOCKET_ERROR;
+            }
+
+            //We are done
+            break;
+#endif
+
          //Set send timeout or receive timeout
          case SO_SNDTIMEO:
          case SO_RCVTIMEO:
@@ -1151,6 +1198,59 @@ int_t setsockopt(int_t s, int_t level, int_t optname,
             break;
          }
       }
+      else if(level == IPPROTO_TCP)
+      {
+         //Check option type
+         switch(optname)
+         {
+#if (TCP_SUPPORT == ENABLED && TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+         //Congestion control algorithm
+         case TCP_CONGESTION:
+            //The option value is the name of the algorithm
+            if(optlen > 0)
+            {
+               //Look up the specified algorithm
+               if(!tcpGetCongestAlgoByName(optval, optlen, &algo))
+               {
+                  //Select the congestion control algorithm
+                  if(!socketSetCongestControl(sock, algo))
+                  {
+                     //Successful processing
+                     ret = SOCKET_SUCCESS;
+                  }
+                  else
+                  {
+                     //The socket is not a stream socket
+                     sock->errnoCode = ENOPROTOOPT;
+                     ret = SOCKET_ERROR;
+                  }
+               }
+               else
+               {
+                  //The algorithm is not supported
+                  sock->errnoCode = EINVAL;
+                  ret = SOCKET_ERROR;
+               }
+            }
+            else
+            {
+               //The option length is not valid
+               sock->errnoCode = EFAULT;
+               ret = SOCKET_ERROR;
+            }
+
+            //We are done
+            break;
+#endif
+
+         //Unknown option
+         default:
+            //Report an error
+            sock->errnoCode = ENOPROTOOPT;
+            ret = SOCKET_ERROR;
+            break;
+         }
+      }
       else
       {
          //The specified level is not valid
@@ -1188,6 +1288,9 @@ int_t getsockopt(int_t s, int_t level, int_t optname,
    int_t *val;
    timeval *t;
    Socket *sock;
+#if (TCP_SUPPORT == ENABLED && TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+   const TcpCongestControl *congestControl;
+#endif
 
    //Make sure the socket descriptor is valid
    if(s < 0 || s >= SOCKET_MAX_COUNT)
@@ -1199,7 +1302,7 @@ int_t getsockopt(int_t s, int_t level, int_t optname,
    sock = &socketTable[s];
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(sock, FALSE);
 
    //Make sure the option is valid
    if(optval != NULL)
@@ -1259,6 +1362,29 @@ int_t getsockopt(int_t s, int_t level, int_t optname,
             //We are done
             break;
 #endif
+#if (TCP_SUPPORT == ENABLED && TCP_PACING_SUPPORT == ENABLED)
+         //Get pacing rate
+         case SO_MAX_PACING_RATE:
+            //Check the length of the option
+            if(*optlen >= (socklen_t) sizeof(uint32_t))
+            {
+               //Return the pacing rate
+               *((uint32_t *) optval) = sock->pacingRate;
+               //Return the actual length of the option
+               *optlen = sizeof(uint32_t);
+               //Successful processing
+               ret = SOCKET_SUCCESS;
+            }
+            else
+            {
+               //The option length is not valid
+               sock->errnoCode = EFAULT;
+               ret = SOCKET_ERROR;
+            }
+
+            //We are done
+            break;
+#endif
          //Get send timeout or receive timeout
          case SO_SNDTIMEO:
          case SO_RCVTIMEO:
@@ -1394,6 +1520,48 @@ int_t getsockopt(int_t s, int_t level, int_t optname,
             break;
          }
       }
+      else if(level == IPPROTO_TCP)
+      {
+         //Check option type
+         switch(optname)
+         {
+#if (TCP_SUPPORT == ENABLED && TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+         //Congestion control algorithm
+         case TCP_CONGESTION:
+            //Point to the algorithm used by the socket
+            congestControl = tcpGetCongestControl(sock->congestAlgo);
+
+            //Check the length of the option
+            if(congestControl != NULL &&
+               *optlen > (socklen_t) osStrlen(congestControl->name))
+            {
+               //Return the name of the algorithm
+               osStrcpy(optval, congestControl->name);
+               //Return the actual length of the option
+               *optlen = osStrlen(congestControl->name) + 1;
+
+               //Successful processing
+               ret = SOCKET_SUCCESS;
+            }
+            else
+            {
+               //The option length is not valid
+               sock->errnoCode = EFAULT;
+               ret = SOCKET_ERROR;
+            }
+
+            //We are done
+            break;
+#endif
+
+         //Unknown option
+         default:
+            //Report an error
+            sock->errnoCode = ENOPROTOOPT;
+            ret = SOCKET_ERROR;
+            break;
+         }
+      }
       else
       {
          //The specified level is not valid
@@ -1409,7 +1577,7 @@ int_t getsockopt(int_t s, int_t level, int_t optname,
    }
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(sock);
 
    //return status code
    return ret;
@@ -1441,7 +1609,7 @@ int_t ioctlsocket(int_t s, uint32_t cmd, void *arg)
    sock = &socketTable[s];
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(sock, FALSE);
 
    //Make sure the parameter is valid
    if(arg != NULL)
@@ -1486,7 +1654,7 @@ int_t ioctlsocket(int_t s, uint32_t cmd, void *arg)
    }
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(sock);
 
    //return status code
    return ret;
@@ -1518,7 +1686,7 @@ int_t fcntl(int_t s, int_t cmd, void *arg)
    sock = &socketTable[s];
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(sock, FALSE);
 
    //Make sure the parameter is valid
    if(arg != NULL)
@@ -1562,7 +1730,7 @@ int_t fcntl(int_t s, int_t cmd, void *arg)
    }
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(sock);
 
    //return status code
    return ret;
@@ -1617,6 +1785,17 @@ int_t closesocket(int_t s)
 {
    Socket *sock;
 
+#if (SOCKET_EVENT_SET_SUPPORT == ENABLED)
+   //Descriptor that identifies an epoll instance?
+   if(s >= SOCKET_MAX_COUNT && s < (SOCKET_MAX_COUNT + SOCKET_EVENT_SET_MAX_COUNT))
+   {
+      //Delete the underlying event set
+      socketEventSetDelete(&socketEventSetTable[s - SOCKET_MAX_COUNT]);
+      //Successful processing
+      return SOCKET_SUCCESS;
+   }
+#endif
+
    //Make sure the socket descriptor is valid
    if(s < 0 || s >= SOCKET_MAX_COUNT)
    {
@@ -1912,6 +2091,210 @@ int_t selectFdIsSet(fd_set *fds, int_t s)
 }
 
 
+#if (SOCKET_EVENT_SET_SUPPORT == ENABLED)
+
+/**
+ * @brief Create an epoll instance
+ *
+ * The descriptor of an epoll instance does not overlap socket descriptors
+ * and must be released with closesocket
+ *
+ * @param[in] size Unused parameter included only for compatibility
+ * @return Descriptor referencing the new epoll instance, or SOCKET_ERROR
+ *   if an error occurred
+ **/
+
+int_t epoll_create(int_t size)
+{
+   SocketEventSet *set;
+
+   //The size argument is ignored, but must be greater than zero
+   if(size <= 0)
+      return SOCKET_ERROR;
+
+   //Create a new event set
+   set = socketEventSetCreate();
+   //Failed to create event set?
+   if(set == NULL)
+      return SOCKET_ERROR;
+
+   //Return the descriptor of the epoll instance
+   return SOCKET_MAX_COUNT + (int_t) (set - socketEventSetTable);
+}
+
+
+/**
+ * @brief Add, modify or remove a socket monitored by an epoll instance
+ * @param[in] epfd Descriptor that identifies an epoll instance
+ * @param[in] op Operation to be performed (EPOLL_CTL_ADD, EPOLL_CTL_MOD or
+ *   EPOLL_CTL_DEL)
+ * @param[in] s Descriptor that identifies the target socket
+ * @param[in] event Requested events and user data (ignored by EPOLL_CTL_DEL)
+ * @return If no error occurs, epoll_ctl returns SOCKET_SUCCESS.
+ *   Otherwise, it returns SOCKET_ERROR
+ **/
+
+int_t epoll_ctl(int_t epfd, int_t op, int_t s, epoll_event *event)
+{
+   error_t error;
+   uint_t eventMask;
+   epoll_data_t data;
+   Socket *sock;
+   SocketEventSet *set;
+
+   //Make sure the epoll descriptor is valid
+   if(epfd < SOCKET_MAX_COUNT || epfd >= (SOCKET_MAX_COUNT + SOCKET_EVENT_SET_MAX_COUNT))
+      return SOCKET_ERROR;
+
+   //Make sure the socket descriptor is valid
+   if(s < 0 || s >= SOCKET_MAX_COUNT)
+      return SOCKET_ERROR;
+
+   //Point to the event set and to the socket structure
+   set = &socketEventSetTable[epfd - SOCKET_MAX_COUNT];
+   sock = &socketTable[s];
+
+   //The event structure is mandatory for EPOLL_CTL_ADD and EPOLL_CTL_MOD
+   if(op != EPOLL_CTL_DEL && event == NULL)
+   {
+      sock->errnoCode = EFAULT;
+      return SOCKET_ERROR;
+   }
+
+   //Errors and hang-ups are always reported
+   eventMask = SOCKET_EVENT_CLOSED;
+
+   //Translate the requested events
+   if(event != NULL && (event->events & EPOLLIN) != 0)
+      eventMask |= SOCKET_EVENT_RX_READY;
+   if(event != NULL && (event->events & EPOLLOUT) != 0)
+      eventMask |= SOCKET_EVENT_TX_READY;
+
+   //Check operation
+   if(op == EPOLL_CTL_ADD)
+   {
+      //Save user data, which must be available as soon as the socket is
+      //reported
+      data = epollData[s];
+      epollData[s] = event->data;
+
+      //Start monitoring the socket
+      error = socketEventSetAdd(set, sock, eventMask);
+
+      //The socket may already be monitored by another epoll instance
+      if(error)
+         epollData[s] = data;
+   }
+   else if(op == EPOLL_CTL_MOD)
+   {
+      //Save user data, which must be available as soon as the socket is
+      //reported
+      data = epollData[s];
+      epollData[s] = event->data;
+
+      //Change the monitored events
+      error = socketEventSetModify(set, sock, eventMask);
+
+      //The socket may be monitored by another epoll instance
+      if(error)
+         epollData[s] = data;
+   }
+   else if(op == EPOLL_CTL_DEL)
+   {
+      //Stop monitoring the socket
+      error = socketEventSetRemove(set, sock);
+   }
+   else
+   {
+      //Unknown operation
+      error = ERROR_INVALID_PARAMETER;
+   }
+
+   //Any error to report?
+   if(error)
+   {
+      sock->errnoCode = EINVAL;
+      return SOCKET_ERROR;
+   }
+
+   //Successful processing
+   return SOCKET_SUCCESS;
+}
+
+
+/**
+ * @brief Wait for events on an epoll instance
+ * @param[in] epfd Descriptor that identifies an epoll instance
+ * @param[out] events Array receiving the events of the ready sockets
+ * @param[in] maxevents Number of entries in the array
+ * @param[in] timeout Maximum time to wait, in milliseconds. A value of -1
+ *   causes epoll_wait to block indefinitely
+ * @return The number of ready sockets, zero if the time limit expired, or
+ *   SOCKET_ERROR if an error occurred
+ **/
+
+int_t epoll_wait(int_t epfd, epoll_event *events, int_t maxevents,
+   int_t timeout)
+{
+   error_t error;
+   uint_t i;
+   uint_t n;
+   uint_t eventFlags;
+   systime_t time;
+   SocketEventDesc eventDesc[SOCKET_MAX_COUNT];
+
+   //Make sure the epoll descriptor is valid
+   if(epfd < SOCKET_MAX_COUNT || epfd >= (SOCKET_MAX_COUNT + SOCKET_EVENT_SET_MAX_COUNT))
+      return SOCKET_ERROR;
+
+   //Check parameters
+   if(events == NULL || maxevents <= 0)
+      return SOCKET_ERROR;
+
+   //Retrieve timeout value
+   if(timeout >= 0)
+      time = timeout;
+   else
+      time = INFINITE_DELAY;
+
+   //Wait for sockets to become ready
+   error = socketEventSetWait(&socketEventSetTable[epfd - SOCKET_MAX_COUNT],
+      eventDesc, MIN(maxevents, SOCKET_MAX_COUNT), &n, time);
+
+   //Timeout error?
+   if(error == ERROR_TIMEOUT)
+      return 0;
+   //Any other error to report?
+   else if(error)
+      return SOCKET_ERROR;
+
+   //Translate the events of the ready sockets
+   for(i = 0; i < n; i++)
+   {
+      //Get the events in the signaled state
+      eventFlags = eventDesc[i].eventFlags;
+
+      //Clear event flags
+      events[i].events = 0;
+
+      if((eventFlags & SOCKET_EVENT_RX_READY) != 0)
+         events[i].events |= EPOLLIN;
+      if((eventFlags & SOCKET_EVENT_TX_READY) != 0)
+         events[i].events |= EPOLLOUT;
+      if((eventFlags & SOCKET_EVENT_CLOSED) != 0)
+         events[i].events |= EPOLLHUP;
+
+      //Return the user data attached to the socket
+      events[i].data = epollData[eventDesc[i].socket->descriptor];
+   }
+
+   //Return the number of ready sockets
+   return n;
+}
+
+#endif
+
+
 /**
  * @brief Host name resolution
  * @param[in] name Name of the host to resolve
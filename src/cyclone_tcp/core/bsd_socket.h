@@ -125,6 +125,7 @@
 #define SO_ERROR         0x1007
 #define SO_TYPE          0x1008
 #define SO_MAX_MSG_SIZE  0x2003
+#define SO_MAX_PACING_RATE 47
 #define SO_BINDTODEVICE  0x3000
 
 //IP level options
@@ -133,6 +134,7 @@
 
 //TCP level options
 #define TCP_NODELAY      0x0001
+#define TCP_CONGESTION   13
 
 //IOCTL commands
 #define FIONREAD         0x400466FF
@@ -179,6 +181,17 @@
 #define FD_CLR(s, fds) selectFdClr(fds, s)
 #define FD_ISSET(s, fds) selectFdIsSet(fds, s)
 
+//Events reported by epoll_wait
+#define EPOLLIN  0x0001
+#define EPOLLOUT 0x0004
+#define EPOLLERR 0x0008
+#define EPOLLHUP 0x0010
+
+//Operations performed by epoll_ctl
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_DEL 2
+#define EPOLL_CTL_MOD 3
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -277,6 +290,30 @@ typedef struct timeval
 } timeval;
 
 
+/**
+ * @brief User data attached to a monitored socket
+ **/
+
+typedef union epoll_data
+{
+   void *ptr;
+   int_t fd;
+   uint32_t u32;
+   uint64_t u64;
+} epoll_data_t;
+
+
+/**
+ * @brief Event monitored on a socket
+ **/
+
+typedef struct epoll_event
+{
+   uint32_t events;
+   epoll_data_t data;
+} epoll_event;
+
+
 /**
  * @brief Information about a given host
  **/
@@ -332,6 +369,11 @@ void selectFdSet(fd_set *fds, int_t s);
 void selectFdClr(fd_set *fds, int_t s);
 int_t selectFdIsSet(fd_set *fds, int_t s);
 
+int_t epoll_create(int_t size);
+int_t epoll_ctl(int_t epfd, int_t op, int_t s, epoll_event *event);
+int_t epoll_wait(int_t epfd, epoll_event *events, int_t maxevents,
+   int_t timeout);
+
 hostent *gethostbyname(const char_t *name);
 
 hostent *gethostbyname_r(const char_t *name, hostent *result, char_t *buf,
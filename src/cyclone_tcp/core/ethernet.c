@@ -42,6 +42,7 @@
 #include "core/socket.h"
 #include "core/raw_socket.h"
 #include "core/tcp_timer.h"
+#include "core/tcp_gso.h"
 #include "ipv4/arp.h"
 #include "ipv4/ipv4.h"
 #include "ipv6/ipv6.h"
@@ -381,6 +382,24 @@ error_t ethSendFrame(NetInterface *interface, const MacAddr *destAddr,
    uint16_t vmanId = nicGetVmanId(interface);
 #endif
 
+#if (TCP_SUPPORT == ENABLED && TCP_GSO_SUPPORT == ENABLED)
+   //TCP super-segment?
+   if(ancillary->gsoSize != 0)
+   {
+      //Point to the physical interface
+      physicalInterface = nicGetPhysicalInterface(interface);
+
+      //Segmentation not supported by hardware?
+      if(physicalInterface->nicDriver == NULL ||
+         physicalInterface->nicDriver->sendTso == NULL)
+      {
+         //Split the super-segment into MSS-sized frames
+         return tcpGsoSplitFrame(interface, destAddr, type, buffer, offset,
+            ancillary);
+      }
+   }
+#endif
+
 #if (ETH_VLAN_SUPPORT == ENABLED)
    //Valid VLAN identifier?
    if(vlanId != 0)
@@ -522,8 +541,20 @@ error_t ethSendFrame(NetInterface *interface, const MacAddr *destAddr,
    }
 #endif
 
-   //Forward the frame to the physical interface
-   error = nicSendPacket(physicalInterface, buffer, offset);
+#if (TCP_SUPPORT == ENABLED && TCP_GSO_SUPPORT == ENABLED)
+   //TCP super-segment?
+   if(ancillary->gsoSize != 0)
+   {
+      //The hardware splits the frame and computes the checksums
+      error = nicSendTso(physicalInterface, buffer, offset, ancillary->gsoSize);
+   }
+   else
+#endif
+   {
+      //Forward the frame to the physical interface
+      error = nicSendPacket(physicalInterface, buffer, offset);
+   }
+
    //Return status code
    return error;
 }
@@ -41,6 +41,17 @@
 #include "ipv6/ipv6_misc.h"
 #include "debug.h"
 
+//SIMD instruction sets
+#if (IP_CHECKSUM_SIMD_SUPPORT == ENABLED)
+   #if defined(__AVX2__)
+      #include <immintrin.h>
+   #elif defined(__SSE2__)
+      #include <emmintrin.h>
+   #elif defined(__ARM_NEON)
+      #include <arm_neon.h>
+   #endif
+#endif
+
 //Special IP addresses
 const IpAddr IP_ADDR_ANY = {0};
 const IpAddr IP_ADDR_UNSPECIFIED = {0};
@@ -392,27 +403,61 @@ error_t ipLeaveMulticastGroup(NetInterface *interface, const IpAddr *groupAddr)
 
 uint16_t ipCalcChecksum(const void *data, size_t length)
 {
-   uint32_t temp;
+   //Return 1's complement value
+   return ipFoldChecksum(ipCalcChecksumPartial(data, length)) ^ 0xFFFF;
+}
+
+
+/**
+ * @brief Calculate IP checksum over a multi-part buffer
+ * @param[in] buffer Pointer to the multi-part buffer
+ * @param[in] offset Offset from the beginning of the buffer
+ * @param[in] length Number of bytes to process
+ * @return Checksum value
+ **/
+
+uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length)
+{
+   //Return 1's complement value
+   return ipFoldChecksum(ipCalcChecksumPartialEx(buffer, offset, length)) ^ 0xFFFF;
+}
+
+
+/**
+ * @brief Compute the 1's complement sum of a block of data
+ *
+ * The sum is returned unfolded, as a 32-bit value whose 1's complement
+ * fold yields the 16-bit sum. A 32-bit sum can be rotated by 8 bits to
+ * account for data starting at an odd position of the checksummed stream
+ *
+ * @param[in] data Pointer to the data to be summed
+ * @param[in] length Number of bytes to process
+ * @return 32-bit partial sum
+ **/
+
+uint32_t ipCalcChecksumPartial(const void *data, size_t length)
+{
+   uint64_t sum;
    uint32_t checksum;
    const uint8_t *p;
 
    //Checksum preset value
-   checksum = 0x0000;
+   sum = 0;
 
    //Point to the data over which to calculate the IP checksum
    p = (const uint8_t *) data;
 
    //Pointer not aligned on a 16-bit boundary?
-   if(((uint_t) p & 1) != 0)
+   if(((uintptr_t) p & 1) != 0)
    {
       if(length >= 1)
       {
 #ifdef _CPU_BIG_ENDIAN
          //Update checksum value
-         checksum += (uint32_t) *p;
+         sum += (uint32_t) *p;
 #else
          //Update checksum value
-         checksum += (uint32_t) *p << 8;
+         sum += (uint32_t) *p << 8;
 #endif
          //Restore the alignment on 16-bit boundaries
          p++;
@@ -422,12 +467,12 @@ uint16_t ipCalcChecksum(const void *data, size_t length)
    }
 
    //Pointer not aligned on a 32-bit boundary?
-   if(((uint_t) p & 2) != 0)
+   if(((uintptr_t) p & 2) != 0)
    {
       if(length >= 2)
       {
          //Update checksum value
-         checksum += (uint32_t) *((uint16_t *) p);
+         sum += (uint32_t) *((uint16_t *) p);
 
          //Restore the alignment on 32-bit boundaries
          p += 2;
@@ -436,21 +481,115 @@ uint16_t ipCalcChecksum(const void *data, size_t length)
       }
    }
 
-   //Process the data 4 bytes at a time
-   while(length >= 4)
+#if (IP_CHECKSUM_SIMD_SUPPORT == ENABLED && defined(__AVX2__))
+   //Process the data 32 bytes at a time
+   if(length >= 32)
    {
-      //Update checksum value
-      temp = checksum + *((uint32_t *) p);
+      __m256i v;
+      __m256i acc;
+      __m256i zero;
+      uint64_t lanes[4];
 
-      //Add carry bit, if any
-      if(temp < checksum)
+      //Clear accumulators
+      acc = _mm256_setzero_si256();
+      zero = _mm256_setzero_si256();
+
+      do
       {
-         checksum = temp + 1;
-      }
-      else
+         //Load 8 words and zero-extend them to 64 bits before accumulating
+         v = _mm256_loadu_si256((const __m256i *) p);
+         acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(v, zero));
+         acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(v, zero));
+
+         //Point to the next block
+         p += 32;
+         //Number of bytes left to process
+         length -= 32;
+      } while(length >= 32);
+
+      //Add the 64-bit lanes to the sum
+      _mm256_storeu_si256((__m256i *) lanes, acc);
+      sum += (lanes[0] & 0xFFFFFFFF) + (lanes[0] >> 32);
+      sum += (lanes[1] & 0xFFFFFFFF) + (lanes[1] >> 32);
+      sum += (lanes[2] & 0xFFFFFFFF) + (lanes[2] >> 32);
+      sum += (lanes[3] & 0xFFFFFFFF) + (lanes[3] >> 32);
+   }
+#elif (IP_CHECKSUM_SIMD_SUPPORT == ENABLED && defined(__SSE2__))
+   //Process the data 16 bytes at a time
+   if(length >= 16)
+   {
+      __m128i v;
+      __m128i acc;
+      __m128i zero;
+      uint64_t lanes[2];
+
+      //Clear accumulators
+      acc = _mm_setzero_si128();
+      zero = _mm_setzero_si128();
+
+      do
       {
-         checksum = temp;
-      }
+         //Load 4 words and zero-extend them to 64 bits before accumulating
+         v = _mm_loadu_si128((const __m128i *) p);
+         acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, zero));
+         acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, zero));
+
+         //Point to the next block
+         p += 16;
+         //Number of bytes left to process
+         length -= 16;
+      } while(length >= 16);
+
+      //Add the 64-bit lanes to the sum
+      _mm_storeu_si128((__m128i *) lanes, acc);
+      sum += (lanes[0] & 0xFFFFFFFF) + (lanes[0] >> 32);
+      sum += (lanes[1] & 0xFFFFFFFF) + (lanes[1] >> 32);
+   }
+#elif (IP_CHECKSUM_SIMD_SUPPORT == ENABLED && defined(__ARM_NEON))
+   //Process the data 16 bytes at a time
+   if(length >= 16)
+   {
+      uint64x2_t acc;
+
+      //Clear accumulators
+      acc = vdupq_n_u64(0);
+
+      do
+      {
+         //Pairwise add 4 words and accumulate them into 64-bit lanes
+         acc = vpadalq_u32(acc, vld1q_u32((const uint32_t *) p));
+
+         //Point to the next block
+         p += 16;
+         //Number of bytes left to process
+         length -= 16;
+      } while(length >= 16);
+
+      //Add the 64-bit lanes to the sum
+      sum += (vgetq_lane_u64(acc, 0) & 0xFFFFFFFF) + (vgetq_lane_u64(acc, 0) >> 32);
+      sum += (vgetq_lane_u64(acc, 1) & 0xFFFFFFFF) + (vgetq_lane_u64(acc, 1) >> 32);
+   }
+#endif
+
+   //Process the data 16 bytes at a time. The 64-bit accumulator absorbs
+   //the carries, so that they only need to be added once at the end
+   while(length >= 16)
+   {
+      //Update checksum value
+      sum += (uint64_t) ((uint32_t *) p)[0] + ((uint32_t *) p)[1] +
+         ((uint32_t *) p)[2] + ((uint32_t *) p)[3];
+
+      //Point to the next block
+      p += 16;
+      //Number of bytes left to process
+      length -= 16;
+   }
+
+   //Process the remaining data 4 bytes at a time
+   while(length >= 4)
+   {
+      //Update checksum value
+      sum += *((uint32_t *) p);
 
       //Point to the next 32-bit word
       p += 4;
@@ -458,14 +597,11 @@ uint16_t ipCalcChecksum(const void *data, size_t length)
       length -= 4;
    }
 
-   //Fold 32-bit sum to 16 bits
-   checksum = (checksum & 0xFFFF) + (checksum >> 16);
-
    //Add left-over 16-bit word, if any
    if(length >= 2)
    {
       //Update checksum value
-      checksum += (uint32_t) *((uint16_t *) p);
+      sum += (uint32_t) *((uint16_t *) p);
 
       //Point to the next byte
       p += 2;
@@ -478,48 +614,50 @@ uint16_t ipCalcChecksum(const void *data, size_t length)
    {
 #ifdef _CPU_BIG_ENDIAN
       //Update checksum value
-      checksum += (uint32_t) *p << 8;
+      sum += (uint32_t) *p << 8;
 #else
       //Update checksum value
-      checksum += (uint32_t) *p;
+      sum += (uint32_t) *p;
 #endif
    }
 
-   //Fold 32-bit sum to 16 bits (first pass)
-   checksum = (checksum & 0xFFFF) + (checksum >> 16);
-   //Fold 32-bit sum to 16 bits (second pass)
-   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+   //Fold 64-bit sum to 32 bits (first pass)
+   sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+   //Fold 64-bit sum to 32 bits (second pass)
+   checksum = (uint32_t) ((sum & 0xFFFFFFFF) + (sum >> 32));
 
    //Restore checksum endianness
-   if(((uint_t) data & 1) != 0)
+   if(((uintptr_t) data & 1) != 0)
    {
       //Swap checksum value
-      checksum = ((checksum >> 8) | (checksum << 8)) & 0xFFFF;
+      checksum = IP_CHECKSUM_SWAP(checksum);
    }
 
-   //Return 1's complement value
-   return checksum ^ 0xFFFF;
+   //Return partial sum
+   return checksum;
 }
 
 
 /**
- * @brief Calculate IP checksum over a multi-part buffer
+ * @brief Compute the 1's complement sum of a multi-part buffer
  * @param[in] buffer Pointer to the multi-part buffer
  * @param[in] offset Offset from the beginning of the buffer
  * @param[in] length Number of bytes to process
- * @return Checksum value
+ * @return 64-bit partial sum
  **/
 
-uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length)
+uint64_t ipCalcChecksumPartialEx(const NetBuffer *buffer, size_t offset,
+   size_t length)
 {
    uint_t i;
    uint_t n;
    uint_t pos;
    uint8_t *data;
-   uint32_t checksum;
+   uint32_t partial;
+   uint64_t sum;
 
    //Checksum preset value
-   checksum = 0x0000;
+   sum = 0;
 
    //Current position in the multi-part buffer
    pos = 0;
@@ -538,25 +676,19 @@ uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length)
          //Limit the number of byte to process
          n = MIN(n, length - pos);
 
-         //Take care of alignment issues
-         if((pos & 1) != 0)
-         {
-            //Swap checksum value
-            checksum = ((checksum >> 8) | (checksum << 8)) & 0xFFFF;
-         }
-
          //Process data chunk
-         checksum += ipCalcChecksum(data, n) ^ 0xFFFF;
-         //Fold 32-bit sum to 16 bits
-         checksum = (checksum & 0xFFFF) + (checksum >> 16);
+         partial = ipCalcChecksumPartial(data, n);
 
-         //Restore checksum endianness
+         //Take care of alignment issues
          if((pos & 1) != 0)
          {
             //Swap checksum value
-            checksum = ((checksum >> 8) | (checksum << 8)) & 0xFFFF;
+            partial = IP_CHECKSUM_SWAP(partial);
          }
 
+         //Partial sums are accumulated without intermediate folding
+         sum += partial;
+
          //Advance current position
          pos += n;
          //Process the next block from the start
@@ -569,8 +701,80 @@ uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length)
       }
    }
 
-   //Return 1's complement value
-   return checksum ^ 0xFFFF;
+   //Return partial sum
+   return sum;
+}
+
+
+/**
+ * @brief Copy data and compute its 1's complement sum in a single pass
+ *
+ * The data is processed in small blocks so that the bytes are still in the
+ * cache when they are summed, right after being copied
+ *
+ * @param[out] dest Pointer to the destination buffer
+ * @param[in] src Pointer to the data to be copied
+ * @param[in] length Number of bytes to copy
+ * @return 32-bit partial sum of the copied data
+ **/
+
+uint32_t ipCalcChecksumCopy(void *dest, const void *src, size_t length)
+{
+   size_t n;
+   uint64_t sum;
+   uint8_t *p;
+   const uint8_t *q;
+
+   //Checksum preset value
+   sum = 0;
+
+   //Point to the source and destination buffers
+   p = (uint8_t *) dest;
+   q = (const uint8_t *) src;
+
+   //Process the data block by block
+   while(length > 0)
+   {
+      //Limit the number of bytes to process at a time
+      n = MIN(length, IP_CHECKSUM_COPY_BLOCK_SIZE);
+
+      //Copy the current block
+      osMemcpy(p, q, n);
+      //Sum the copied bytes while they are still in the cache
+      sum += ipCalcChecksumPartial(p, n);
+
+      //The block size is even, so that no byte swapping is required
+      p += n;
+      q += n;
+      length -= n;
+   }
+
+   //Fold 64-bit sum to 32 bits
+   sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+   sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+
+   //Return partial sum
+   return (uint32_t) sum;
+}
+
+
+/**
+ * @brief Fold a partial sum to a 16-bit 1's complement sum
+ * @param[in] sum 64-bit partial sum
+ * @return 16-bit 1's complement sum
+ **/
+
+uint16_t ipFoldChecksum(uint64_t sum)
+{
+   //Fold 64-bit sum to 32 bits
+   sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+   sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+   //Fold 32-bit sum to 16 bits
+   sum = (sum & 0xFFFF) + (sum >> 16);
+   sum = (sum & 0xFFFF) + (sum >> 16);
+
+   //Return 16-bit sum
+   return (uint16_t) sum;
 }
 
 
@@ -586,17 +790,15 @@ uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length)
 uint16_t ipCalcUpperLayerChecksum(const void *pseudoHeader,
    size_t pseudoHeaderLen, const void *data, size_t dataLen)
 {
-   uint32_t checksum;
+   uint64_t sum;
 
    //Process pseudo header
-   checksum = ipCalcChecksum(pseudoHeader, pseudoHeaderLen) ^ 0xFFFF;
+   sum = ipCalcChecksumPartial(pseudoHeader, pseudoHeaderLen);
    //Process upper-layer data
-   checksum += ipCalcChecksum(data, dataLen) ^ 0xFFFF;
-   //Fold 32-bit sum to 16 bits
-   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+   sum += ipCalcChecksumPartial(data, dataLen);
 
    //Return 1's complement value
-   return checksum ^ 0xFFFF;
+   return ipFoldChecksum(sum) ^ 0xFFFF;
 }
 
 
@@ -613,17 +815,15 @@ uint16_t ipCalcUpperLayerChecksum(const void *pseudoHeader,
 uint16_t ipCalcUpperLayerChecksumEx(const void *pseudoHeader,
    size_t pseudoHeaderLen, const NetBuffer *buffer, size_t offset, size_t length)
 {
-   uint32_t checksum;
+   uint64_t sum;
 
    //Process pseudo header
-   checksum = ipCalcChecksum(pseudoHeader, pseudoHeaderLen) ^ 0xFFFF;
+   sum = ipCalcChecksumPartial(pseudoHeader, pseudoHeaderLen);
    //Process upper-layer data
-   checksum += ipCalcChecksumEx(buffer, offset, length) ^ 0xFFFF;
-   //Fold 32-bit sum to 16 bits
-   checksum = (checksum & 0xFFFF) + (checksum >> 16);
+   sum += ipCalcChecksumPartialEx(buffer, offset, length);
 
    //Return 1's complement value
-   return checksum ^ 0xFFFF;
+   return ipFoldChecksum(sum) ^ 0xFFFF;
 }
 
 
@@ -35,6 +35,23 @@
 #include "ipv4/ipv4.h"
 #include "ipv6/ipv6.h"
 
+//Use SIMD instructions for checksum computation, when available
+#ifndef IP_CHECKSUM_SIMD_SUPPORT
+   #define IP_CHECKSUM_SIMD_SUPPORT ENABLED
+#elif (IP_CHECKSUM_SIMD_SUPPORT != ENABLED && IP_CHECKSUM_SIMD_SUPPORT != DISABLED)
+   #error IP_CHECKSUM_SIMD_SUPPORT parameter is not valid
+#endif
+
+//Block size used when copying data and computing its checksum in one pass
+#ifndef IP_CHECKSUM_COPY_BLOCK_SIZE
+   #define IP_CHECKSUM_COPY_BLOCK_SIZE 256
+#elif (IP_CHECKSUM_COPY_BLOCK_SIZE < 16 || (IP_CHECKSUM_COPY_BLOCK_SIZE % 16) != 0)
+   #error IP_CHECKSUM_COPY_BLOCK_SIZE parameter is not valid
+#endif
+
+//Swap the bytes of a 32-bit partial sum (modulo 0xFFFF)
+#define IP_CHECKSUM_SWAP(sum) (((sum) << 8) | ((sum) >> 24))
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -124,6 +141,15 @@ error_t ipLeaveMulticastGroup(NetInterface *interface, const IpAddr *groupAddr);
 uint16_t ipCalcChecksum(const void *data, size_t length);
 uint16_t ipCalcChecksumEx(const NetBuffer *buffer, size_t offset, size_t length);
 
+uint32_t ipCalcChecksumPartial(const void *data, size_t length);
+
+uint64_t ipCalcChecksumPartialEx(const NetBuffer *buffer, size_t offset,
+   size_t length);
+
+uint32_t ipCalcChecksumCopy(void *dest, const void *src, size_t length);
+
+uint16_t ipFoldChecksum(uint64_t sum);
+
 uint16_t ipCalcUpperLayerChecksum(const void *pseudoHeader,
    size_t pseudoHeaderLen, const void *data, size_t dataLen);
 
@@ -0,0 +1,526 @@
+/**
+ * @file ip_trie.c
+ * @brief Longest prefix match trie
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * The routing tables are indexed by a path-compressed binary trie. Each
+ * prefix is stored in a node whose depth is bounded by the prefix length,
+ * so that a lookup visits at most one node per bit of the destination
+ * address, whatever the number of routes. Nodes are taken from a static
+ * pool provided by the caller: a trie holding N prefixes never uses more
+ * than 2N - 1 nodes
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL IP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/ip_trie.h"
+#include "ipv4/ipv4_routing.h"
+#include "ipv6/ipv6_routing.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if ((IPV4_SUPPORT == ENABLED && IPV4_ROUTING_SUPPORT == ENABLED) || \
+   (IPV6_SUPPORT == ENABLED && IPV6_ROUTING_SUPPORT == ENABLED))
+
+//Retrieve the value of the bit at the specified position
+#define IP_TRIE_GET_BIT(key, n) (((key)[(n) / 8] >> (7 - ((n) % 8))) & 1)
+
+//Forward declaration of functions
+static uint_t ipTrieMatchLength(const uint8_t *key1, const uint8_t *key2,
+   uint_t start, uint_t end);
+
+static IpTrieNode *ipTrieAllocNode(IpTrie *trie, const uint8_t *key,
+   uint_t prefixLen, void *data);
+
+static void ipTrieFreeNode(IpTrie *trie, IpTrieNode *node);
+static IpTrieNode *ipTrieFindNode(IpTrie *trie, const uint8_t *key,
+   uint_t prefixLen);
+
+
+/**
+ * @brief Initialize a trie
+ * @param[in] trie Pointer to the trie
+ * @param[in] nodes Pool of nodes available to the trie
+ * @param[in] numNodes Number of nodes in the pool
+ **/
+
+void ipTrieInit(IpTrie *trie, IpTrieNode *nodes, uint_t numNodes)
+{
+   uint_t i;
+
+   //The trie is initially empty
+   trie->root = NULL;
+   trie->freeList = NULL;
+
+   //Build the list of unused nodes
+   for(i = 0; i < numNodes; i++)
+   {
+      ipTrieFreeNode(trie, &nodes[i]);
+   }
+}
+
+
+/**
+ * @brief Add a prefix to the trie
+ *
+ * The data attached to the prefix is replaced if the prefix is already
+ * present in the trie
+ *
+ * @param[in] trie Pointer to the trie
+ * @param[in] key Prefix (in network byte order)
+ * @param[in] prefixLen Length of the prefix, in bits
+ * @param[in] data Data attached to the prefix
+ * @return Error code
+ **/
+
+error_t ipTrieAdd(IpTrie *trie, const uint8_t *key, uint_t prefixLen,
+   void *data)
+{
+   uint_t n;
+   uint_t start;
+   IpTrieNode *node;
+   IpTrieNode *parent;
+   IpTrieNode *newNode;
+   IpTrieNode *branchNode;
+   IpTrieNode **link;
+
+   //Check parameters
+   if(key == NULL || data == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Make sure the prefix length is acceptable
+   if(prefixLen > (IP_TRIE_MAX_KEY_SIZE * 8))
+      return ERROR_INVALID_PARAMETER;
+
+   //Start from the root node
+   parent = NULL;
+   link = &trie->root;
+   node = trie->root;
+
+   //Number of leading bits known to match
+   start = 0;
+   n = 0;
+
+   //Walk down the trie
+   while(node != NULL)
+   {
+      //Compare the prefix of the current node with the new prefix
+      n = ipTrieMatchLength(node->key, key, start,
+         MIN(node->prefixLen, prefixLen));
+
+      //The new prefix diverges from the current node?
+      if(n < node->prefixLen)
+         break;
+
+      //The prefix is already present in the trie?
+      if(node->prefixLen == prefixLen)
+      {
+         //Update the data attached to the prefix
+         node->data = data;
+         //Successful processing
+         return NO_ERROR;
+      }
+
+      //Follow the branch selected by the next bit of the new prefix
+      parent = node;
+      link = &node->child[IP_TRIE_GET_BIT(key, node->prefixLen)];
+      node = *link;
+      start = parent->prefixLen;
+   }
+
+   //Create a new node for the prefix
+   newNode = ipTrieAllocNode(trie, key, prefixLen, data);
+   //Failed to allocate a new node?
+   if(newNode == NULL)
+      return ERROR_OUT_OF_RESOURCES;
+
+   //Check where the new node must be inserted
+   if(node == NULL)
+   {
+      //The new node is a leaf
+      newNode->parent = parent;
+      *link = newNode;
+   }
+   else if(n == prefixLen)
+   {
+      //The new prefix covers the current node
+      newNode->child[IP_TRIE_GET_BIT(node->key, prefixLen)] = node;
+      newNode->parent = parent;
+      node->parent = newNode;
+      *link = newNode;
+   }
+   else
+   {
+      //The new prefix and the current node share their first n bits only,
+      //so that a branching node is needed
+      branchNode = ipTrieAllocNode(trie, key, n, NULL);
+
+      //Failed to allocate a new node?
+      if(branchNode == NULL)
+      {
+         //Clean up side effects
+         ipTrieFreeNode(trie, newNode);
+         //Report an error
+         return ERROR_OUT_OF_RESOURCES;
+      }
+
+      //Attach the current node and the new node to the branching node
+      branchNode->child[IP_TRIE_GET_BIT(node->key, n)] = node;
+      branchNode->child[IP_TRIE_GET_BIT(key, n)] = newNode;
+      branchNode->parent = parent;
+      node->parent = branchNode;
+      newNode->parent = branchNode;
+      *link = branchNode;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Remove a prefix from the trie
+ * @param[in] trie Pointer to the trie
+ * @param[in] key Prefix (in network byte order)
+ * @param[in] prefixLen Length of the prefix, in bits
+ * @return Data that was attached to the prefix (NULL if the prefix is not
+ *   present in the trie)
+ **/
+
+void *ipTrieDelete(IpTrie *trie, const uint8_t *key, uint_t prefixLen)
+{
+   void *data;
+   IpTrieNode *node;
+   IpTrieNode *child;
+   IpTrieNode *parent;
+
+   //Make sure the prefix length is acceptable
+   if(prefixLen > (IP_TRIE_MAX_KEY_SIZE * 8))
+      return NULL;
+
+   //Search the trie for the specified prefix
+   node = ipTrieFindNode(trie, key, prefixLen);
+   //Prefix not found?
+   if(node == NULL)
+      return NULL;
+
+   //Detach the data from the node
+   data = node->data;
+   node->data = NULL;
+
+   //Remove the nodes that no longer hold a prefix nor branch
+   while(node != NULL && node->data == NULL)
+   {
+      //Branching nodes must be preserved
+      if(node->child[0] != NULL && node->child[1] != NULL)
+         break;
+
+      //Retrieve the only child of the node, if any
+      child = (node->child[0] != NULL) ? node->child[0] : node->child[1];
+      parent = node->parent;
+
+      //The child takes the place of the node
+      if(parent == NULL)
+         trie->root = child;
+      else if(parent->child[0] == node)
+         parent->child[0] = child;
+      else
+         parent->child[1] = child;
+
+      //Update the parent of the child
+      if(child != NULL)
+         child->parent = parent;
+
+      //Release the node
+      ipTrieFreeNode(trie, node);
+
+      //The parent node has lost a child only when the node was a leaf
+      if(child != NULL)
+         break;
+
+      //Check the parent node
+      node = parent;
+   }
+
+   //Return the data that was attached to the prefix
+   return data;
+}
+
+
+/**
+ * @brief Search the trie for a given prefix
+ * @param[in] trie Pointer to the trie
+ * @param[in] key Prefix (in network byte order)
+ * @param[in] prefixLen Length of the prefix, in bits
+ * @return Data attached to the prefix (NULL if the prefix is not present in
+ *   the trie)
+ **/
+
+void *ipTrieFind(IpTrie *trie, const uint8_t *key, uint_t prefixLen)
+{
+   IpTrieNode *node;
+
+   //Make sure the prefix length is acceptable
+   if(prefixLen > (IP_TRIE_MAX_KEY_SIZE * 8))
+      return NULL;
+
+   //Search the trie for the specified prefix
+   node = ipTrieFindNode(trie, key, prefixLen);
+
+   //Return the data attached to the prefix
+   return (node != NULL) ? node->data : NULL;
+}
+
+
+/**
+ * @brief Find the longest prefix that matches a given address
+ * @param[in] trie Pointer to the trie
+ * @param[in] addr Address (in network byte order)
+ * @param[in] addrLen Length of the address, in bits
+ * @return Node that holds the longest matching prefix (NULL if no prefix
+ *   matches the address)
+ **/
+
+IpTrieNode *ipTrieLookup(IpTrie *trie, const uint8_t *addr, uint_t addrLen)
+{
+   uint_t start;
+   IpTrieNode *node;
+   IpTrieNode *bestNode;
+
+   //Start from the root node
+   node = trie->root;
+   bestNode = NULL;
+   start = 0;
+
+   //Walk down the trie
+   while(node != NULL && node->prefixLen <= addrLen)
+   {
+      //Only the bits that follow the prefix of the parent node need to be
+      //compared
+      if(ipTrieMatchLength(node->key, addr, start,
+         node->prefixLen) < node->prefixLen)
+      {
+         break;
+      }
+
+      //Keep track of the longest matching prefix
+      if(node->data != NULL)
+         bestNode = node;
+
+      //The whole address has been consumed?
+      if(node->prefixLen == addrLen)
+         break;
+
+      //Follow the branch selected by the next bit of the address
+      start = node->prefixLen;
+      node = node->child[IP_TRIE_GET_BIT(addr, node->prefixLen)];
+   }
+
+   //Return the longest matching prefix
+   return bestNode;
+}
+
+
+/**
+ * @brief Find the next shorter prefix that matches the same address
+ *
+ * The prefixes that match an address all lie on the path from the root to
+ * the longest matching prefix. This function is used to fall back to a less
+ * specific prefix when the data attached to a prefix cannot be used
+ *
+ * @param[in] node Node returned by ipTrieLookup or ipTrieLookupNext
+ * @return Node that holds the next matching prefix (NULL if there is no
+ *   shorter matching prefix)
+ **/
+
+IpTrieNode *ipTrieLookupNext(IpTrieNode *node)
+{
+   //Walk up the trie
+   for(node = node->parent; node != NULL; node = node->parent)
+   {
+      //Branching nodes do not hold any prefix
+      if(node->data != NULL)
+         break;
+   }
+
+   //Return the next matching prefix
+   return node;
+}
+
+
+/**
+ * @brief Count the number of leading bits that two keys have in common
+ * @param[in] key1 First key
+ * @param[in] key2 Second key
+ * @param[in] start Index of the first bit to compare (the preceding bits
+ *   are known to match)
+ * @param[in] end Index of the bit where to stop the comparison
+ * @return Index of the first bit that differs, or end if the keys match
+ **/
+
+static uint_t ipTrieMatchLength(const uint8_t *key1, const uint8_t *key2,
+   uint_t start, uint_t end)
+{
+   uint_t n;
+   uint8_t x;
+
+   //Compare the keys byte by byte
+   for(n = start; n < end; n = (n | 7) + 1)
+   {
+      //Ignore the bits that precede the current position
+      x = (key1[n / 8] ^ key2[n / 8]) & (0xFF >> (n % 8));
+
+      //Any difference?
+      if(x != 0)
+      {
+         //Locate the first bit that differs
+         for(n &= ~7U; !(x & 0x80); n++)
+         {
+            x <<= 1;
+         }
+
+         //Do not go past the end of the comparison
+         return MIN(n, end);
+      }
+   }
+
+   //The keys match
+   return end;
+}
+
+
+/**
+ * @brief Allocate a new node
+ * @param[in] trie Pointer to the trie
+ * @param[in] key Prefix (in network byte order)
+ * @param[in] prefixLen Length of the prefix, in bits
+ * @param[in] data Data attached to the prefix
+ * @return Pointer to the new node (NULL if the pool is exhausted)
+ **/
+
+static IpTrieNode *ipTrieAllocNode(IpTrie *trie, const uint8_t *key,
+   uint_t prefixLen, void *data)
+{
+   uint_t n;
+   IpTrieNode *node;
+
+   //Take a node from the list of unused nodes
+   node = trie->freeList;
+
+   //Any node available?
+   if(node != NULL)
+   {
+      //Remove the node from the list
+      trie->freeList = node->child[0];
+
+      //Clear the node
+      osMemset(node, 0, sizeof(IpTrieNode));
+
+      //Number of whole bytes in the prefix
+      n = prefixLen / 8;
+      //Copy the prefix
+      osMemcpy(node->key, key, n);
+
+      //The bits that follow the prefix are cleared
+      if((prefixLen % 8) != 0)
+         node->key[n] = key[n] & (0xFF << (8 - (prefixLen % 8)));
+
+      //Save the length of the prefix and the attached data
+      node->prefixLen = prefixLen;
+      node->data = data;
+   }
+
+   //Return a pointer to the new node
+   return node;
+}
+
+
+/**
+ * @brief Release a node
+ * @param[in] trie Pointer to the trie
+ * @param[in] node Node to be released
+ **/
+
+static void ipTrieFreeNode(IpTrie *trie, IpTrieNode *node)
+{
+   //Put the node back in the list of unused nodes
+   node->parent = NULL;
+   node->child[0] = trie->freeList;
+   node->child[1] = NULL;
+   node->data = NULL;
+   trie->freeList = node;
+}
+
+
+/**
+ * @brief Search the trie for the node that holds a given prefix
+ * @param[in] trie Pointer to the trie
+ * @param[in] key Prefix (in network byte order)
+ * @param[in] prefixLen Length of the prefix, in bits
+ * @return Pointer to the matching node (NULL if the prefix is not present in
+ *   the trie)
+ **/
+
+static IpTrieNode *ipTrieFindNode(IpTrie *trie, const uint8_t *key,
+   uint_t prefixLen)
+{
+   uint_t start;
+   IpTrieNode *node;
+
+   //Start from the root node
+   node = trie->root;
+   start = 0;
+
+   //Walk down the trie
+   while(node != NULL && node->prefixLen <= prefixLen)
+   {
+      //The prefix of the current node must match the specified prefix
+      if(ipTrieMatchLength(node->key, key, start,
+         node->prefixLen) < node->prefixLen)
+      {
+         break;
+      }
+
+      //Matching prefix?
+      if(node->prefixLen == prefixLen)
+         return (node->data != NULL) ? node : NULL;
+
+      //Follow the branch selected by the next bit of the prefix
+      start = node->prefixLen;
+      node = node->child[IP_TRIE_GET_BIT(key, node->prefixLen)];
+   }
+
+   //The prefix is not present in the trie
+   return NULL;
+}
+
+#endif
@@ -0,0 +1,95 @@
+/**
+ * @file ip_trie.h
+ * @brief Longest prefix match trie
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+#ifndef _IP_TRIE_H
+#define _IP_TRIE_H
+
+//Dependencies
+#include "core/net.h"
+
+//Maximum length of the keys, in bytes
+#if (IPV6_SUPPORT == ENABLED)
+   #define IP_TRIE_MAX_KEY_SIZE 16
+#else
+   #define IP_TRIE_MAX_KEY_SIZE 4
+#endif
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Trie node
+ *
+ * Chains of nodes with a single child are compressed, so that each node
+ * either holds a prefix or is a branching point with two children
+ **/
+
+typedef struct _IpTrieNode
+{
+   struct _IpTrieNode *parent;       ///<Parent node
+   struct _IpTrieNode *child[2];     ///<Child nodes (next bit is 0 or 1)
+   uint8_t key[IP_TRIE_MAX_KEY_SIZE]; ///<Prefix (in network byte order)
+   uint_t prefixLen;                 ///<Length of the prefix, in bits
+   void *data;                       ///<Data attached to the prefix (NULL for branching nodes)
+} IpTrieNode;
+
+
+/**
+ * @brief Longest prefix match trie
+ **/
+
+typedef struct
+{
+   IpTrieNode *root;     ///<Root node
+   IpTrieNode *freeList; ///<List of unused nodes
+} IpTrie;
+
+
+//Trie related functions
+void ipTrieInit(IpTrie *trie, IpTrieNode *nodes, uint_t numNodes);
+
+error_t ipTrieAdd(IpTrie *trie, const uint8_t *key, uint_t prefixLen,
+   void *data);
+
+void *ipTrieDelete(IpTrie *trie, const uint8_t *key, uint_t prefixLen);
+void *ipTrieFind(IpTrie *trie, const uint8_t *key, uint_t prefixLen);
+
+IpTrieNode *ipTrieLookup(IpTrie *trie, const uint8_t *addr, uint_t addrLen);
+IpTrieNode *ipTrieLookupNext(IpTrieNode *node);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
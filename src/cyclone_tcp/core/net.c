@@ -34,6 +34,7 @@
 //Dependencies
 #include <stdlib.h>
 #include "core/net.h"
+#include "core/net_timer.h"
 #include "core/socket.h"
 #include "core/raw_socket.h"
 #include "core/tcp_timer.h"
@@ -80,8 +81,10 @@ NetInterface netInterface[NET_INTERFACE_COUNT];
 
 //TCP/IP process state
 static bool_t netTaskRunning;
-//Timestamp
+//Time at which periodic operations were last handled
 static systime_t netTimestamp;
+//Timer used to schedule periodic operations
+static NetTimer netTickTimer;
 //Pseudo-random number generator state
 static uint32_t prngState = 0;
 
@@ -116,6 +119,12 @@ error_t netInit(void)
    //Get current time
    netTimestamp = osGetSystemTime();
 
+   //Timer wheel initialization
+   error = netTimerInit();
+   //Any error to report?
+   if(error)
+      return error;
+
    //Create a mutex to prevent simultaneous access to the TCP/IP stack
    if(!osCreateMutex(&netMutex))
    {
@@ -224,9 +233,6 @@ error_t netInit(void)
 #if (PPP_SUPPORT == ENABLED)
    pppTickCounter = 0;
 #endif
-#if (IPV4_SUPPORT == ENABLED && ETH_SUPPORT == ENABLED)
-   arpTickCounter = 0;
-#endif
 #if (IPV4_SUPPORT == ENABLED && IPV4_FRAG_SUPPORT == ENABLED)
    ipv4FragTickCounter = 0;
 #endif
@@ -257,9 +263,6 @@ error_t netInit(void)
 #if (IPV6_SUPPORT == ENABLED && DHCPV6_CLIENT_SUPPORT == ENABLED)
    dhcpv6ClientTickCounter = 0;
 #endif
-#if (TCP_SUPPORT == ENABLED)
-   tcpTickCounter = 0;
-#endif
 #if (DNS_CLIENT_SUPPORT == ENABLED || MDNS_CLIENT_SUPPORT == ENABLED || \
    NBNS_CLIENT_SUPPORT == ENABLED)
    dnsTickCounter = 0;
@@ -271,6 +274,9 @@ error_t netInit(void)
    dnsSdTickCounter = 0;
 #endif
 
+   //Schedule periodic operations
+   netStartTimer(&netTickTimer, NET_TICK_INTERVAL, netTick, NULL);
+
 #if (NET_STATIC_OS_RESOURCES == ENABLED)
    //Create a task to handle TCP/IP events
    osCreateStaticTask(&netTaskInstance, "TCP/IP Stack", (OsTaskCode) netTask,
@@ -1303,6 +1309,9 @@ void netProcessLinkChange(NetInterface *interface)
       //Point to the current socket
       socket = socketTable + i;
 
+      //Get exclusive access
+      SOCKET_LOCK(socket);
+
 #if (TCP_SUPPORT == ENABLED)
       //Connection-oriented socket?
       if(socket->type == SOCKET_TYPE_STREAM)
@@ -1327,6 +1336,9 @@ void netProcessLinkChange(NetInterface *interface)
          rawSocketUpdateEvents(socket);
       }
 #endif
+
+      //Release exclusive access
+      SOCKET_UNLOCK(socket);
    }
 }
 
@@ -1339,7 +1351,6 @@ void netTask(void)
 {
    uint_t i;
    bool_t status;
-   systime_t time;
    systime_t timeout;
    NetInterface *interface;
 
@@ -1377,14 +1388,12 @@ void netTask(void)
    while(1)
    {
 #endif
-      //Get current time
-      time = osGetSystemTime();
-
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
       //Compute the maximum blocking time when waiting for an event
-      if(timeCompare(time, netTimestamp) < 0)
-         timeout = netTimestamp - time;
-      else
-         timeout = 0;
+      timeout = netGetTimerTimeout();
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
 
       //Receive notifications when a frame has been received, or the
       //link state of any network interfaces has changed
@@ -1415,6 +1424,10 @@ void netTask(void)
                   interface->nicDriver->disableIrq(interface);
                   //Handle NIC events
                   interface->nicDriver->eventHandler(interface);
+
+                  //Process the frames queued by burst-capable drivers
+                  if(interface->nicDriver->receiveBurst != NULL)
+                     nicReceiveBurst(interface);
                   //Re-enable hardware interrupts
                   interface->nicDriver->enableIrq(interface);
                }
@@ -1443,22 +1456,12 @@ void netTask(void)
          osReleaseMutex(&netMutex);
       }
 
-      //Get current time
-      time = osGetSystemTime();
-
-      //Check current time
-      if(timeCompare(time, netTimestamp) >= 0)
-      {
-         //Get exclusive access
-         osAcquireMutex(&netMutex);
-         //Handle periodic operations
-         netTick();
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
-
-         //Next event
-         netTimestamp = time + NET_TICK_INTERVAL;
-      }
+      //Get exclusive access
+      osAcquireMutex(&netMutex);
+      //Invoke the callbacks of the timers that have expired
+      netProcessTimers();
+      //Release exclusive access
+      osReleaseMutex(&netMutex);
 #if (NET_RTOS_SUPPORT == ENABLED)
    }
 #endif
@@ -1467,14 +1470,31 @@ void netTask(void)
 
 /**
  * @brief Manage TCP/IP timers
+ *
+ * Periodic operations are handled by the timer wheel. The function is
+ * rescheduled for the time at which the earliest module is due
+ *
+ * @param[in] param Unused parameter
  **/
 
-void netTick(void)
+void netTick(void *param)
 {
    uint_t i;
+   systime_t time;
+   systime_t delta;
+   systime_t timeout;
+
+   //Get current time
+   time = osGetSystemTime();
+   //Time elapsed since the last invocation
+   delta = time - netTimestamp;
+   netTimestamp = time;
+
+   //Upper bound of the time before the next invocation
+   timeout = INFINITE_DELAY;
 
    //Increment tick counter
-   nicTickCounter += NET_TICK_INTERVAL;
+   nicTickCounter += delta;
 
    //Handle periodic operations such as polling the link state
    if(nicTickCounter >= NIC_TICK_INTERVAL)
@@ -1491,9 +1511,12 @@ void netTick(void)
       nicTickCounter = 0;
    }
 
+   //Next time the handler is due
+   timeout = MIN(timeout, NIC_TICK_INTERVAL - nicTickCounter);
+
 #if (PPP_SUPPORT == ENABLED)
    //Increment tick counter
-   pppTickCounter += NET_TICK_INTERVAL;
+   pppTickCounter += delta;
 
    //Manage PPP related timers
    if(pppTickCounter >= PPP_TICK_INTERVAL)
@@ -1509,31 +1532,14 @@ void netTick(void)
       //Reset tick counter
       pppTickCounter = 0;
    }
-#endif
 
-#if (IPV4_SUPPORT == ENABLED && ETH_SUPPORT == ENABLED)
-   //Increment tick counter
-   arpTickCounter += NET_TICK_INTERVAL;
-
-   //Manage ARP cache
-   if(arpTickCounter >= ARP_TICK_INTERVAL)
-   {
-      //Loop through network interfaces
-      for(i = 0; i < NET_INTERFACE_COUNT; i++)
-      {
-         //Make sure the interface has been properly configured
-         if(netInterface[i].configured)
-            arpTick(&netInterface[i]);
-      }
-
-      //Reset tick counter
-      arpTickCounter = 0;
-   }
+   //Next time the handler is due
+   timeout = MIN(timeout, PPP_TICK_INTERVAL - pppTickCounter);
 #endif
 
 #if (IPV4_SUPPORT == ENABLED && IPV4_FRAG_SUPPORT == ENABLED)
    //Increment tick counter
-   ipv4FragTickCounter += NET_TICK_INTERVAL;
+   ipv4FragTickCounter += delta;
 
    //Handle IPv4 fragment reassembly timeout
    if(ipv4FragTickCounter >= IPV4_FRAG_TICK_INTERVAL)
@@ -1549,11 +1555,14 @@ void netTick(void)
       //Reset tick counter
       ipv4FragTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, IPV4_FRAG_TICK_INTERVAL - ipv4FragTickCounter);
 #endif
 
 #if (IPV4_SUPPORT == ENABLED && IGMP_SUPPORT == ENABLED)
    //Increment tick counter
-   igmpTickCounter += NET_TICK_INTERVAL;
+   igmpTickCounter += delta;
 
    //Handle IGMP related timers
    if(igmpTickCounter >= IGMP_TICK_INTERVAL)
@@ -1569,11 +1578,14 @@ void netTick(void)
       //Reset tick counter
       igmpTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, IGMP_TICK_INTERVAL - igmpTickCounter);
 #endif
 
 #if (IPV4_SUPPORT == ENABLED && AUTO_IP_SUPPORT == ENABLED)
    //Increment tick counter
-   autoIpTickCounter += NET_TICK_INTERVAL;
+   autoIpTickCounter += delta;
 
    //Handle Auto-IP related timers
    if(autoIpTickCounter >= AUTO_IP_TICK_INTERVAL)
@@ -1585,11 +1597,14 @@ void netTick(void)
       //Reset tick counter
       autoIpTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, AUTO_IP_TICK_INTERVAL - autoIpTickCounter);
 #endif
 
 #if (IPV4_SUPPORT == ENABLED && DHCP_CLIENT_SUPPORT == ENABLED)
    //Increment tick counter
-   dhcpClientTickCounter += NET_TICK_INTERVAL;
+   dhcpClientTickCounter += delta;
 
    //Handle DHCP client related timers
    if(dhcpClientTickCounter >= DHCP_CLIENT_TICK_INTERVAL)
@@ -1601,11 +1616,14 @@ void netTick(void)
       //Reset tick counter
       dhcpClientTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, DHCP_CLIENT_TICK_INTERVAL - dhcpClientTickCounter);
 #endif
 
 #if (IPV4_SUPPORT == ENABLED && DHCP_SERVER_SUPPORT == ENABLED)
    //Increment tick counter
-   dhcpServerTickCounter += NET_TICK_INTERVAL;
+   dhcpServerTickCounter += delta;
 
    //Handle DHCP server related timers
    if(dhcpServerTickCounter >= DHCP_SERVER_TICK_INTERVAL)
@@ -1617,11 +1635,14 @@ void netTick(void)
       //Reset tick counter
       dhcpServerTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, DHCP_SERVER_TICK_INTERVAL - dhcpServerTickCounter);
 #endif
 
 #if (IPV6_SUPPORT == ENABLED && IPV6_FRAG_SUPPORT == ENABLED)
    //Increment tick counter
-   ipv6FragTickCounter += NET_TICK_INTERVAL;
+   ipv6FragTickCounter += delta;
 
    //Handle IPv6 fragment reassembly timeout
    if(ipv6FragTickCounter >= IPV6_FRAG_TICK_INTERVAL)
@@ -1637,11 +1658,14 @@ void netTick(void)
       //Reset tick counter
       ipv6FragTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, IPV6_FRAG_TICK_INTERVAL - ipv6FragTickCounter);
 #endif
 
 #if (IPV6_SUPPORT == ENABLED && MLD_SUPPORT == ENABLED)
    //Increment tick counter
-   mldTickCounter += NET_TICK_INTERVAL;
+   mldTickCounter += delta;
 
    //Handle MLD related timers
    if(mldTickCounter >= MLD_TICK_INTERVAL)
@@ -1657,11 +1681,14 @@ void netTick(void)
       //Reset tick counter
       mldTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, MLD_TICK_INTERVAL - mldTickCounter);
 #endif
 
 #if (IPV6_SUPPORT == ENABLED && NDP_SUPPORT == ENABLED)
    //Increment tick counter
-   ndpTickCounter += NET_TICK_INTERVAL;
+   ndpTickCounter += delta;
 
    //Handle NDP related timers
    if(ndpTickCounter >= NDP_TICK_INTERVAL)
@@ -1677,11 +1704,14 @@ void netTick(void)
       //Reset tick counter
       ndpTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, NDP_TICK_INTERVAL - ndpTickCounter);
 #endif
 
 #if (IPV6_SUPPORT == ENABLED && NDP_ROUTER_ADV_SUPPORT == ENABLED)
    //Increment tick counter
-   ndpRouterAdvTickCounter += NET_TICK_INTERVAL;
+   ndpRouterAdvTickCounter += delta;
 
    //Handle RA service related timers
    if(ndpRouterAdvTickCounter >= NDP_ROUTER_ADV_TICK_INTERVAL)
@@ -1693,11 +1723,14 @@ void netTick(void)
       //Reset tick counter
       ndpRouterAdvTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, NDP_ROUTER_ADV_TICK_INTERVAL - ndpRouterAdvTickCounter);
 #endif
 
 #if (IPV6_SUPPORT == ENABLED && DHCPV6_CLIENT_SUPPORT == ENABLED)
    //Increment tick counter
-   dhcpv6ClientTickCounter += NET_TICK_INTERVAL;
+   dhcpv6ClientTickCounter += delta;
 
    //Handle DHCPv6 client related timers
    if(dhcpv6ClientTickCounter >= DHCPV6_CLIENT_TICK_INTERVAL)
@@ -1709,26 +1742,15 @@ void netTick(void)
       //Reset tick counter
       dhcpv6ClientTickCounter = 0;
    }
-#endif
-
-#if (TCP_SUPPORT == ENABLED)
-   //Increment tick counter
-   tcpTickCounter += NET_TICK_INTERVAL;
 
-   //Manage TCP related timers
-   if(tcpTickCounter >= TCP_TICK_INTERVAL)
-   {
-      //TCP timer handler
-      tcpTick();
-      //Reset tick counter
-      tcpTickCounter = 0;
-   }
+   //Next time the handler is due
+   timeout = MIN(timeout, DHCPV6_CLIENT_TICK_INTERVAL - dhcpv6ClientTickCounter);
 #endif
 
 #if (DNS_CLIENT_SUPPORT == ENABLED || MDNS_CLIENT_SUPPORT == ENABLED || \
    NBNS_CLIENT_SUPPORT == ENABLED)
    //Increment tick counter
-   dnsTickCounter += NET_TICK_INTERVAL;
+   dnsTickCounter += delta;
 
    //Manage DNS cache
    if(dnsTickCounter >= DNS_TICK_INTERVAL)
@@ -1738,11 +1760,14 @@ void netTick(void)
       //Reset tick counter
       dnsTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, DNS_TICK_INTERVAL - dnsTickCounter);
 #endif
 
 #if (MDNS_RESPONDER_SUPPORT == ENABLED)
    //Increment tick counter
-   mdnsResponderTickCounter += NET_TICK_INTERVAL;
+   mdnsResponderTickCounter += delta;
 
    //Manage mDNS probing and announcing
    if(mdnsResponderTickCounter >= MDNS_RESPONDER_TICK_INTERVAL)
@@ -1754,11 +1779,14 @@ void netTick(void)
       //Reset tick counter
       mdnsResponderTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, MDNS_RESPONDER_TICK_INTERVAL - mdnsResponderTickCounter);
 #endif
 
 #if (DNS_SD_SUPPORT == ENABLED)
    //Increment tick counter
-   dnsSdTickCounter += NET_TICK_INTERVAL;
+   dnsSdTickCounter += delta;
 
    //Manage DNS-SD probing and announcing
    if(dnsSdTickCounter >= DNS_SD_TICK_INTERVAL)
@@ -1770,7 +1798,15 @@ void netTick(void)
       //Reset tick counter
       dnsSdTickCounter = 0;
    }
+
+   //Next time the handler is due
+   timeout = MIN(timeout, DNS_SD_TICK_INTERVAL - dnsSdTickCounter);
 #endif
+
+   //Do not run the handlers more often than every NET_TICK_INTERVAL
+   timeout = MAX(timeout, NET_TICK_INTERVAL);
+   //Schedule the next invocation
+   netStartTimer(&netTickTimer, timeout, netTick, NULL);
 }
 
 
@@ -155,6 +155,13 @@ struct _NetInterface;
    #error NET_STATIC_OS_RESOURCES parameter is not valid
 #endif
 
+//Fine-grained locking
+#ifndef NET_FINE_LOCK_SUPPORT
+   #define NET_FINE_LOCK_SUPPORT DISABLED
+#elif (NET_FINE_LOCK_SUPPORT != ENABLED && NET_FINE_LOCK_SUPPORT != DISABLED)
+   #error NET_FINE_LOCK_SUPPORT parameter is not valid
+#endif
+
 //Stack size required to run the TCP/IP task
 #ifndef NET_TASK_STACK_SIZE
    #define NET_TASK_STACK_SIZE 650
@@ -229,6 +236,9 @@ struct _NetInterface
 #if (IPV4_SUPPORT == ENABLED)
    Ipv4Context ipv4Context;                       ///<IPv4 context
    ArpCacheEntry arpCache[ARP_CACHE_SIZE];        ///<ARP cache
+   ArpCacheEntry *arpHashTable[ARP_HASH_TABLE_SIZE]; ///<Hash table used to search the ARP cache
+   ArpCacheEntry *arpLruHead;                     ///<Most recently used ARP cache entry
+   ArpCacheEntry *arpLruTail;                     ///<Least recently used ARP cache entry
 #if (IGMP_SUPPORT == ENABLED)
    systime_t igmpv1RouterPresentTimer;            ///<IGMPv1 router present timer
    bool_t igmpv1RouterPresent;                    ///<An IGMPv1 query has been recently heard
@@ -297,6 +307,16 @@ extern const NetAncillaryData NET_DEFAULT_ANCILLARY_DATA;
 
 //Global variables
 extern OsTask *netTaskHandle;
+
+//When fine-grained locking is enabled, the locks must be taken in the
+//following order, and none of them may be acquired recursively:
+// 1. netMutex protects the socket table, the interfaces, the protocol modules
+//    and the whole packet path (RX processing, timer callbacks, IP output,
+//    ARP and NDP caches, routing tables and NIC drivers)
+// 2. Socket mutex protects the control block, buffers and queues of a single
+//    socket. Only one socket mutex may be held at a time
+// 3. netTimerMutex protects the timer wheel
+// 4. Memory pool mutex
 extern OsMutex netMutex;
 extern OsEvent netEvent;
 extern NetInterface netInterface[NET_INTERFACE_COUNT];
@@ -341,7 +361,7 @@ error_t netStopInterface(NetInterface *interface);
 void netProcessLinkChange(NetInterface *interface);
 
 void netTask(void);
-void netTick(void);
+void netTick(void *param);
 
 NetInterface *netGetDefaultInterface(void);
 
@@ -34,6 +34,8 @@
 //Dependencies
 #include "core/net.h"
 #include "core/net_mem.h"
+#include "core/ip.h"
+#include "core/tcp.h"
 #include "debug.h"
 
 //Maximum number of chunks for dynamically allocated buffers
@@ -45,22 +47,121 @@
    #define MAX_CHUNK_COUNT (N(IPV6_MAX_FRAG_DATAGRAM_SIZE) + 3)
 #endif
 
+//TCP super-segments may be larger than reassembled datagrams
+#if (TCP_SUPPORT == ENABLED && TCP_GSO_SUPPORT == ENABLED)
+   #if ((N(TCP_GSO_MAX_SIZE) + 3) > MAX_CHUNK_COUNT)
+      #undef MAX_CHUNK_COUNT
+      #define MAX_CHUNK_COUNT (N(TCP_GSO_MAX_SIZE) + 3)
+   #endif
+#endif
+
+//Buffer caches rely on atomic operations
+#if (NET_MEM_POOL_SUPPORT == ENABLED && NET_MEM_POOL_CACHE_SUPPORT == ENABLED)
+   #if !defined(__GNUC__)
+      #error NET_MEM_POOL_CACHE_SUPPORT requires GCC-compatible atomic built-ins
+   #endif
+#endif
+
+//Size of the blocks, for each size class (in ascending order)
+static const size_t memPoolClassSize[NET_MEM_POOL_CLASS_COUNT] =
+{
+#if (NET_MEM_POOL_SIZE_CLASS_SUPPORT == ENABLED)
+   NET_MEM_POOL_SMALL_BUFFER_SIZE,
+   NET_MEM_POOL_MEDIUM_BUFFER_SIZE,
+   NET_MEM_POOL_BUFFER_SIZE,
+   NET_MEM_POOL_LARGE_BUFFER_SIZE
+#else
+   NET_MEM_POOL_BUFFER_SIZE
+#endif
+};
+
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
 
+/**
+ * @brief Per-task buffer cache
+ **/
+
+typedef struct
+{
+   bool_t busy;                             ///<The cache is currently owned by a task
+   uint_t count;                            ///<Number of free blocks held by the cache
+   uint_t index[NET_MEM_POOL_CACHE_SIZE];   ///<Indexes of the free blocks
+} MemPoolCache;
+
+
+/**
+ * @brief Memory pool size class
+ **/
+
+typedef struct
+{
+   uint8_t *pool;                                   ///<Memory blocks
+   uint_t blockCount;                               ///<Number of blocks
+   bool_t *allocTable;                              ///<Allocation table
+   uint_t *freeList;                                ///<Stack of free block indexes
+   uint_t freeCount;                                ///<Number of entries in the free list
+   uint_t currentUsage;                             ///<Number of blocks currently allocated
+   uint_t maxUsage;                                 ///<Maximum number of blocks that have been allocated so far
+#if (NET_MEM_POOL_CACHE_SUPPORT == ENABLED)
+   MemPoolCache cache[NET_MEM_POOL_CACHE_COUNT];    ///<Buffer caches
+#endif
+} MemPoolClass;
+
 //Mutex preventing simultaneous access to the memory pool
 static OsMutex memPoolMutex;
 //Memory pool
 static uint8_t memPool[NET_MEM_POOL_BUFFER_COUNT][NET_MEM_POOL_BUFFER_SIZE];
 //Allocation table
 static bool_t memPoolAllocTable[NET_MEM_POOL_BUFFER_COUNT];
+//Stack of free block indexes
+static uint_t memPoolFreeList[NET_MEM_POOL_BUFFER_COUNT];
+
+#if (NET_MEM_POOL_SIZE_CLASS_SUPPORT == ENABLED)
+//Small blocks
+static uint8_t memPoolSmall[NET_MEM_POOL_SMALL_BUFFER_COUNT][NET_MEM_POOL_SMALL_BUFFER_SIZE];
+static bool_t memPoolSmallAllocTable[NET_MEM_POOL_SMALL_BUFFER_COUNT];
+static uint_t memPoolSmallFreeList[NET_MEM_POOL_SMALL_BUFFER_COUNT];
+//Medium blocks
+static uint8_t memPoolMedium[NET_MEM_POOL_MEDIUM_BUFFER_COUNT][NET_MEM_POOL_MEDIUM_BUFFER_SIZE];
+static bool_t memPoolMediumAllocTable[NET_MEM_POOL_MEDIUM_BUFFER_COUNT];
+static uint_t memPoolMediumFreeList[NET_MEM_POOL_MEDIUM_BUFFER_COUNT];
+//Large blocks
+static uint8_t memPoolLarge[NET_MEM_POOL_LARGE_BUFFER_COUNT][NET_MEM_POOL_LARGE_BUFFER_SIZE];
+static bool_t memPoolLargeAllocTable[NET_MEM_POOL_LARGE_BUFFER_COUNT];
+static uint_t memPoolLargeFreeList[NET_MEM_POOL_LARGE_BUFFER_COUNT];
+#endif
+
+//Size classes
+static MemPoolClass memPoolClass[NET_MEM_POOL_CLASS_COUNT];
 //Number of buffers currently allocated
 uint_t memPoolCurrentUsage;
 //Maximum number of buffers that have been allocated so far
 uint_t memPoolMaxUsage;
 
+//Memory pool related functions
+static void memPoolInitClass(MemPoolClass *sizeClass, void *pool,
+   uint_t blockCount, bool_t *allocTable, uint_t *freeList);
+
+static void *memPoolClassAlloc(uint_t k);
+static bool_t memPoolClassFree(uint_t k, void *p);
+
+static void memPoolUpdateStats(MemPoolClass *sizeClass, int_t delta);
+
+#if (NET_MEM_POOL_CACHE_SUPPORT == ENABLED)
+static MemPoolCache *memPoolAcquireCache(MemPoolClass *sizeClass);
+static void memPoolReleaseCache(MemPoolCache *cache);
+static bool_t memPoolCacheAlloc(MemPoolClass *sizeClass, uint_t *index);
+static bool_t memPoolCacheSteal(MemPoolClass *sizeClass, uint_t *index);
+static bool_t memPoolCacheFree(MemPoolClass *sizeClass, uint_t index);
+#endif
+
 #endif
 
+//Multi-part buffer related functions
+static void *netBufferAllocBlock(size_t size, bool_t smallBlock,
+   size_t *blockSize);
+
 
 /**
  * @brief Memory pool initialization
@@ -71,6 +172,8 @@ error_t memPoolInit(void)
 {
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
+   uint_t k;
+
    //Create a mutex to prevent simultaneous access to the memory pool
    if(!osCreateMutex(&memPoolMutex))
    {
@@ -78,8 +181,28 @@ error_t memPoolInit(void)
       return ERROR_OUT_OF_RESOURCES;
    }
 
-   //Clear allocation table
-   osMemset(memPoolAllocTable, 0, sizeof(memPoolAllocTable));
+   //Size classes are sorted by block size
+   k = 0;
+
+#if (NET_MEM_POOL_SIZE_CLASS_SUPPORT == ENABLED)
+   //Small blocks
+   memPoolInitClass(&memPoolClass[k++], memPoolSmall,
+      NET_MEM_POOL_SMALL_BUFFER_COUNT, memPoolSmallAllocTable, memPoolSmallFreeList);
+
+   //Medium blocks
+   memPoolInitClass(&memPoolClass[k++], memPoolMedium,
+      NET_MEM_POOL_MEDIUM_BUFFER_COUNT, memPoolMediumAllocTable, memPoolMediumFreeList);
+#endif
+
+   //Regular blocks
+   memPoolInitClass(&memPoolClass[k++], memPool,
+      NET_MEM_POOL_BUFFER_COUNT, memPoolAllocTable, memPoolFreeList);
+
+#if (NET_MEM_POOL_SIZE_CLASS_SUPPORT == ENABLED)
+   //Large blocks
+   memPoolInitClass(&memPoolClass[k++], memPoolLarge,
+      NET_MEM_POOL_LARGE_BUFFER_COUNT, memPoolLargeAllocTable, memPoolLargeFreeList);
+#endif
 
    //Clear statistics
    memPoolCurrentUsage = 0;
@@ -100,7 +223,7 @@ error_t memPoolInit(void)
 void *memPoolAlloc(size_t size)
 {
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
-   uint_t i;
+   uint_t k;
 #endif
 
    //Pointer to the allocated memory block
@@ -111,36 +234,14 @@ void *memPoolAlloc(size_t size)
 
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
-   //Acquire exclusive access to the memory pool
-   osAcquireMutex(&memPoolMutex);
-
-   //Enforce block size
-   if(size <= NET_MEM_POOL_BUFFER_SIZE)
+   //Use the smallest size class that fits the request. Larger classes are
+   //tried in turn when the preferred one is exhausted
+   for(k = 0; k < NET_MEM_POOL_CLASS_COUNT && p == NULL; k++)
    {
-      //Loop through allocation table
-      for(i = 0; i < NET_MEM_POOL_BUFFER_COUNT; i++)
-      {
-         //Check whether the current block is free
-         if(!memPoolAllocTable[i])
-         {
-            //Mark the current entry as used
-            memPoolAllocTable[i] = TRUE;
-            //Point to the corresponding memory block
-            p = memPool[i];
-
-            //Update statistics
-            memPoolCurrentUsage++;
-            //Maximum number of buffers that have been allocated so far
-            memPoolMaxUsage = MAX(memPoolCurrentUsage, memPoolMaxUsage);
-
-            //Exit immediately
-            break;
-         }
-      }
+      //Enforce block size
+      if(size <= memPoolClassSize[k])
+         p = memPoolClassAlloc(k);
    }
-
-   //Release exclusive access to the memory pool
-   osReleaseMutex(&memPoolMutex);
 #else
    //Allocate a memory block
    p = osAllocMem(size);
@@ -167,29 +268,15 @@ void memPoolFree(void *p)
 {
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
-   uint_t i;
+   uint_t k;
 
-   //Acquire exclusive access to the memory pool
-   osAcquireMutex(&memPoolMutex);
-
-   //Loop through allocation table
-   for(i = 0; i < NET_MEM_POOL_BUFFER_COUNT; i++)
+   //Search for the size class the block belongs to
+   for(k = 0; k < NET_MEM_POOL_CLASS_COUNT; k++)
    {
-      if(memPool[i] == p)
-      {
-         //Mark the current block as free
-         memPoolAllocTable[i] = FALSE;
-
-         //Update statistics
-         memPoolCurrentUsage--;
-
-         //Exit immediately
+      //Release the block to the matching class
+      if(memPoolClassFree(k, p))
          break;
-      }
    }
-
-   //Release exclusive access to the memory pool
-   osReleaseMutex(&memPoolMutex);
 #else
    //Release memory block
    osFreeMem(p);
@@ -208,6 +295,8 @@ void memPoolGetStats(uint_t *currentUsage, uint_t *maxUsage, uint_t *size)
 {
 //Use fixed-size blocks allocation?
 #if (NET_MEM_POOL_SUPPORT == ENABLED)
+   uint_t k;
+
    //Number of buffers currently allocated
    if(currentUsage != NULL)
       *currentUsage = memPoolCurrentUsage;
@@ -218,7 +307,11 @@ void memPoolGetStats(uint_t *currentUsage, uint_t *maxUsage, uint_t *size)
 
    //Total number of buffers in the memory pool
    if(size != NULL)
-      *size = NET_MEM_POOL_BUFFER_COUNT;
+   {
+      //Sum the number of blocks of each size class
+      for(*size = 0, k = 0; k < NET_MEM_POOL_CLASS_COUNT; k++)
+         *size += memPoolClass[k].blockCount;
+   }
 #else
    //Memory pool is not used...
    if(currentUsage != NULL)
@@ -233,6 +326,542 @@ void memPoolGetStats(uint_t *currentUsage, uint_t *maxUsage, uint_t *size)
 }
 
 
+/**
+ * @brief Get the usage of a given size class
+ * @param[in] index Zero-based index of the size class (classes are sorted
+ *   by ascending block size)
+ * @param[out] blockSize Size of the blocks
+ * @param[out] currentUsage Number of blocks currently allocated
+ * @param[out] maxUsage Maximum number of blocks that have been allocated so far
+ * @param[out] size Total number of blocks in the size class
+ * @return Error code
+ **/
+
+error_t memPoolGetClassStats(uint_t index, size_t *blockSize,
+   uint_t *currentUsage, uint_t *maxUsage, uint_t *size)
+{
+   //Make sure the size class is valid
+   if(index >= NET_MEM_POOL_CLASS_COUNT)
+      return ERROR_INVALID_PARAMETER;
+
+   //Size of the blocks
+   if(blockSize != NULL)
+      *blockSize = memPoolClassSize[index];
+
+//Use fixed-size blocks allocation?
+#if (NET_MEM_POOL_SUPPORT == ENABLED)
+   //Number of blocks currently allocated
+   if(currentUsage != NULL)
+      *currentUsage = memPoolClass[index].currentUsage;
+
+   //Maximum number of blocks that have been allocated so far
+   if(maxUsage != NULL)
+      *maxUsage = memPoolClass[index].maxUsage;
+
+   //Total number of blocks in the size class
+   if(size != NULL)
+      *size = memPoolClass[index].blockCount;
+#else
+   //Memory pool is not used...
+   if(currentUsage != NULL)
+      *currentUsage = 0;
+
+   if(maxUsage != NULL)
+      *maxUsage = 0;
+
+   if(size != NULL)
+      *size = 0;
+#endif
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+//Use fixed-size blocks allocation?
+#if (NET_MEM_POOL_SUPPORT == ENABLED)
+
+/**
+ * @brief Initialize a size class
+ * @param[in] sizeClass Pointer to the size class
+ * @param[in] pool Memory blocks
+ * @param[in] blockCount Number of blocks
+ * @param[in] allocTable Allocation table
+ * @param[in] freeList Stack of free block indexes
+ **/
+
+static void memPoolInitClass(MemPoolClass *sizeClass, void *pool,
+   uint_t blockCount, bool_t *allocTable, uint_t *freeList)
+{
+   uint_t i;
+
+   //Clear the size class
+   osMemset(sizeClass, 0, sizeof(MemPoolClass));
+
+   //Save parameters
+   sizeClass->pool = pool;
+   sizeClass->blockCount = blockCount;
+   sizeClass->allocTable = allocTable;
+   sizeClass->freeList = freeList;
+
+   //Clear allocation table
+   osMemset(allocTable, 0, blockCount * sizeof(bool_t));
+
+   //All the blocks are initially free (the lowest indexes are popped first)
+   for(i = 0; i < blockCount; i++)
+      freeList[i] = blockCount - 1 - i;
+
+   //Number of free blocks
+   sizeClass->freeCount = blockCount;
+}
+
+
+/**
+ * @brief Allocate a block from a given size class
+ * @param[in] k Index of the size class
+ * @return Pointer to the allocated block or NULL if the class is exhausted
+ **/
+
+static void *memPoolClassAlloc(uint_t k)
+{
+   uint_t i;
+   void *p;
+   MemPoolClass *sizeClass;
+
+   //Point to the size class
+   sizeClass = &memPoolClass[k];
+   //Initialize pointer
+   p = NULL;
+
+#if (NET_MEM_POOL_CACHE_SUPPORT == ENABLED)
+   //Take a block from a buffer cache without locking the memory pool
+   if(memPoolCacheAlloc(sizeClass, &i))
+   {
+      //Mark the corresponding entry as used
+      __atomic_store_n(&sizeClass->allocTable[i], TRUE, __ATOMIC_RELEASE);
+      //Point to the corresponding memory block
+      p = sizeClass->pool + i * memPoolClassSize[k];
+
+      //Update statistics
+      memPoolUpdateStats(sizeClass, 1);
+   }
+   else
+#endif
+   {
+      //Acquire exclusive access to the memory pool
+      osAcquireMutex(&memPoolMutex);
+
+      //Any free block available?
+      if(sizeClass->freeCount > 0)
+      {
+         //Pop the index of a free block from the free list
+         i = sizeClass->freeList[--sizeClass->freeCount];
+
+         //Mark the corresponding entry as used
+         sizeClass->allocTable[i] = TRUE;
+         //Point to the corresponding memory block
+         p = sizeClass->pool + i * memPoolClassSize[k];
+
+         //Update statistics
+         memPoolUpdateStats(sizeClass, 1);
+      }
+
+      //Release exclusive access to the memory pool
+      osReleaseMutex(&memPoolMutex);
+   }
+
+   //Return a pointer to the allocated memory block
+   return p;
+}
+
+
+/**
+ * @brief Release a block to a given size class
+ * @param[in] k Index of the size class
+ * @param[in] p Previously allocated memory block to be freed
+ * @return TRUE if the block belongs to the size class, else FALSE
+ **/
+
+static bool_t memPoolClassFree(uint_t k, void *p)
+{
+   size_t offset;
+   uint_t i;
+   MemPoolClass *sizeClass;
+
+   //Point to the size class
+   sizeClass = &memPoolClass[k];
+
+   //Make sure the pointer belongs to the size class
+   if((uint8_t *) p < sizeClass->pool ||
+      (uint8_t *) p >= sizeClass->pool + sizeClass->blockCount * memPoolClassSize[k])
+   {
+      return FALSE;
+   }
+
+   //Retrieve the index of the block from its address
+   offset = (uint8_t *) p - sizeClass->pool;
+   i = offset / memPoolClassSize[k];
+
+   //The pointer must designate the beginning of a block
+   if((offset % memPoolClassSize[k]) != 0)
+      return TRUE;
+
+#if (NET_MEM_POOL_CACHE_SUPPORT == ENABLED)
+   //Atomically clear the allocation flag so that a block released twice
+   //is only returned once to the pool
+   if(__atomic_exchange_n(&sizeClass->allocTable[i], FALSE, __ATOMIC_ACQ_REL))
+   {
+      //Update statistics
+      memPoolUpdateStats(sizeClass, -1);
+
+      //Return the block to a buffer cache when possible
+      if(!memPoolCacheFree(sizeClass, i))
+      {
+         //Acquire exclusive access to the memory pool
+         osAcquireMutex(&memPoolMutex);
+         //Push the index of the block onto the free list
+         sizeClass->freeList[sizeClass->freeCount++] = i;
+         //Release exclusive access to the memory pool
+         osReleaseMutex(&memPoolMutex);
+      }
+   }
+#else
+   //Acquire exclusive access to the memory pool
+   osAcquireMutex(&memPoolMutex);
+
+   //Check whether the block is currently allocated
+   if(sizeClass->allocTable[i])
+   {
+      //Mark the current block as free
+      sizeClass->allocTable[i] = FALSE;
+      //Push the index of the block onto the free list
+      sizeClass->freeList[sizeClass->freeCount++] = i;
+
+      //Update statistics
+      memPoolUpdateStats(sizeClass, -1);
+   }
+
+   //Release exclusive access to the memory pool
+   osReleaseMutex(&memPoolMutex);
+#endif
+
+   //The block belongs to the size class
+   return TRUE;
+}
+
+
+/**
+ * @brief Update memory pool statistics
+ * @param[in] sizeClass Size class the block belongs to
+ * @param[in] delta Number of blocks that have been allocated (positive value)
+ *   or released (negative value)
+ **/
+
+static void memPoolUpdateStats(MemPoolClass *sizeClass, int_t delta)
+{
+#if (NET_MEM_POOL_CACHE_SUPPORT == ENABLED)
+   uint_t usage;
+   uint_t maxUsage;
+
+   //Statistics are updated outside of the critical section
+   usage = __atomic_add_fetch(&sizeClass->currentUsage, delta, __ATOMIC_RELAXED);
+   maxUsage = __atomic_load_n(&sizeClass->maxUsage, __ATOMIC_RELAXED);
+
+   //Maximum number of blocks of this class that have been allocated so far
+   while(usage > maxUsage)
+   {
+      if(__atomic_compare_exchange_n(&sizeClass->maxUsage, &maxUsage, usage,
+         FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      {
+         break;
+      }
+   }
+
+   //Same processing for the overall statistics
+   usage = __atomic_add_fetch(&memPoolCurrentUsage, delta, __ATOMIC_RELAXED);
+   maxUsage = __atomic_load_n(&memPoolMaxUsage, __ATOMIC_RELAXED);
+
+   //Maximum number of buffers that have been allocated so far
+   while(usage > maxUsage)
+   {
+      if(__atomic_compare_exchange_n(&memPoolMaxUsage, &maxUsage, usage,
+         FALSE, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+      {
+         break;
+      }
+   }
+#else
+   //Number of blocks of this class currently allocated
+   sizeClass->currentUsage += delta;
+   //Maximum number of blocks of this class that have been allocated so far
+   sizeClass->maxUsage = MAX(sizeClass->currentUsage, sizeClass->maxUsage);
+
+   //Number of buffers currently allocated
+   memPoolCurrentUsage += delta;
+   //Maximum number of buffers that have been allocated so far
+   memPoolMaxUsage = MAX(memPoolCurrentUsage, memPoolMaxUsage);
+#endif
+}
+
+
+#if (NET_MEM_POOL_CACHE_SUPPORT == ENABLED)
+
+/**
+ * @brief Take ownership of a buffer cache
+ * @param[in] sizeClass Size class
+ * @return Pointer to the buffer cache or NULL if all the caches are busy
+ **/
+
+static MemPoolCache *memPoolAcquireCache(MemPoolClass *sizeClass)
+{
+   uint_t i;
+   uint_t k;
+   MemPoolCache *cache;
+
+   //The location of the stack identifies the calling task, so that a given
+   //task keeps on hitting the same cache as long as there is no contention
+   k = ((uintptr_t) &cache >> 10) % NET_MEM_POOL_CACHE_COUNT;
+
+   //Loop through the buffer caches
+   for(i = 0; i < NET_MEM_POOL_CACHE_COUNT; i++)
+   {
+      //Point to the current cache
+      cache = &sizeClass->cache[(k + i) % NET_MEM_POOL_CACHE_COUNT];
+
+      //Try to take ownership of the cache without blocking
+      if(!__atomic_exchange_n(&cache->busy, TRUE, __ATOMIC_ACQUIRE))
+         return cache;
+   }
+
+   //All the caches are being used by other tasks
+   return NULL;
+}
+
+
+/**
+ * @brief Release ownership of a buffer cache
+ * @param[in] cache Pointer to the buffer cache
+ **/
+
+static void memPoolReleaseCache(MemPoolCache *cache)
+{
+   //The cache can now be used by other tasks
+   __atomic_store_n(&cache->busy, FALSE, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * @brief Take a free block from a buffer cache
+ * @param[in] sizeClass Size class
+ * @param[out] index Index of the allocated block
+ * @return TRUE if a block has been allocated, else FALSE
+ **/
+
+static bool_t memPoolCacheAlloc(MemPoolClass *sizeClass, uint_t *index)
+{
+   bool_t status;
+   MemPoolCache *cache;
+
+   //Take ownership of a buffer cache
+   cache = memPoolAcquireCache(sizeClass);
+   //All the caches are busy?
+   if(cache == NULL)
+      return FALSE;
+
+   //Empty cache?
+   if(cache->count == 0)
+   {
+      //Acquire exclusive access to the memory pool
+      osAcquireMutex(&memPoolMutex);
+
+      //Refill half of the cache at once to amortize the cost of the lock
+      while(sizeClass->freeCount > 0 && cache->count < (NET_MEM_POOL_CACHE_SIZE / 2))
+         cache->index[cache->count++] = sizeClass->freeList[--sizeClass->freeCount];
+
+      //Release exclusive access to the memory pool
+      osReleaseMutex(&memPoolMutex);
+   }
+
+   //Any free block available?
+   if(cache->count > 0)
+   {
+      //Pop the index of a free block from the cache
+      *index = cache->index[--cache->count];
+      //Successful allocation
+      status = TRUE;
+   }
+   else
+   {
+      //The memory pool is exhausted
+      status = FALSE;
+   }
+
+   //Release ownership of the cache
+   memPoolReleaseCache(cache);
+
+   //The remaining free blocks may be held by the caches of other tasks
+   if(!status)
+      status = memPoolCacheSteal(sizeClass, index);
+
+   //Return status code
+   return status;
+}
+
+
+/**
+ * @brief Take a free block from any buffer cache
+ * @param[in] sizeClass Size class
+ * @param[out] index Index of the allocated block
+ * @return TRUE if a block has been allocated, else FALSE
+ **/
+
+static bool_t memPoolCacheSteal(MemPoolClass *sizeClass, uint_t *index)
+{
+   uint_t i;
+   bool_t status;
+   MemPoolCache *cache;
+
+   //Initialize status code
+   status = FALSE;
+
+   //Loop through the buffer caches
+   for(i = 0; i < NET_MEM_POOL_CACHE_COUNT && !status; i++)
+   {
+      //Point to the current cache
+      cache = &sizeClass->cache[i];
+
+      //Skip the caches that are currently used by other tasks
+      if(!__atomic_exchange_n(&cache->busy, TRUE, __ATOMIC_ACQUIRE))
+      {
+         //Any free block available?
+         if(cache->count > 0)
+         {
+            //Pop the index of a free block from the cache
+            *index = cache->index[--cache->count];
+            //Successful allocation
+            status = TRUE;
+         }
+
+         //Release ownership of the cache
+         memPoolReleaseCache(cache);
+      }
+   }
+
+   //Return status code
+   return status;
+}
+
+
+/**
+ * @brief Return a free block to a buffer cache
+ * @param[in] sizeClass Size class
+ * @param[in] index Index of the block to be released
+ * @return TRUE if the block has been stored in a cache, else FALSE
+ **/
+
+static bool_t memPoolCacheFree(MemPoolClass *sizeClass, uint_t index)
+{
+   MemPoolCache *cache;
+
+   //Take ownership of a buffer cache
+   cache = memPoolAcquireCache(sizeClass);
+   //All the caches are busy?
+   if(cache == NULL)
+      return FALSE;
+
+   //Full cache?
+   if(cache->count >= NET_MEM_POOL_CACHE_SIZE)
+   {
+      //Acquire exclusive access to the memory pool
+      osAcquireMutex(&memPoolMutex);
+
+      //Flush half of the cache at once to amortize the cost of the lock
+      while(cache->count > (NET_MEM_POOL_CACHE_SIZE / 2))
+         sizeClass->freeList[sizeClass->freeCount++] = cache->index[--cache->count];
+
+      //Release exclusive access to the memory pool
+      osReleaseMutex(&memPoolMutex);
+   }
+
+   //Push the index of the block onto the cache
+   cache->index[cache->count++] = index;
+
+   //Release ownership of the cache
+   memPoolReleaseCache(cache);
+
+   //The block has been successfully released
+   return TRUE;
+}
+
+#endif
+#endif
+
+
+/**
+ * @brief Allocate a block to hold a chunk of data
+ * @param[in] size Number of bytes the chunk should hold
+ * @param[in] smallBlock Blocks smaller than NET_MEM_POOL_BUFFER_SIZE
+ *   may be used
+ * @param[out] blockSize Actual size of the allocated block
+ * @return Pointer to the allocated block or NULL if there is insufficient
+ *   memory available
+ **/
+
+static void *netBufferAllocBlock(size_t size, bool_t smallBlock,
+   size_t *blockSize)
+{
+   uint_t k;
+   size_t n;
+   void *p;
+
+   //Skip the size classes that are too small to hold the requested data.
+   //The largest class is used if none of them is large enough
+   for(k = 0; (k + 1) < NET_MEM_POOL_CLASS_COUNT; k++)
+   {
+      //Small blocks may be forbidden by the caller
+      if(memPoolClassSize[k] >= NET_MEM_POOL_BUFFER_SIZE || smallBlock)
+      {
+         if(size <= memPoolClassSize[k])
+            break;
+      }
+   }
+
+   //Allocate a memory block
+   n = memPoolClassSize[k];
+   p = memPoolAlloc(n);
+
+   //Large blocks are not mandatory, so fall back to regular blocks when
+   //they are exhausted
+   if(p == NULL && n > NET_MEM_POOL_BUFFER_SIZE)
+   {
+      n = NET_MEM_POOL_BUFFER_SIZE;
+      p = memPoolAlloc(n);
+   }
+
+   //Successful allocation?
+   if(p != NULL)
+   {
+#if (NET_MEM_POOL_SUPPORT == ENABLED)
+      //The block may come from a larger size class than the requested one
+      for(k = 0; k < NET_MEM_POOL_CLASS_COUNT; k++)
+      {
+         if((uint8_t *) p >= memPoolClass[k].pool &&
+            (uint8_t *) p < memPoolClass[k].pool + memPoolClass[k].blockCount * memPoolClassSize[k])
+         {
+            n = memPoolClassSize[k];
+            break;
+         }
+      }
+#endif
+      //Actual size of the block
+      *blockSize = n;
+   }
+
+   //Return a pointer to the allocated block
+   return p;
+}
+
+
 /**
  * @brief Allocate a multi-part buffer
  * @param[in] length Desired length
@@ -243,10 +872,13 @@ void memPoolGetStats(uint_t *currentUsage, uint_t *maxUsage, uint_t *size)
 NetBuffer *netBufferAlloc(size_t length)
 {
    error_t error;
+   size_t blockSize;
    NetBuffer *buffer;
 
-   //Allocate memory to hold the multi-part buffer
-   buffer = memPoolAlloc(NET_MEM_POOL_BUFFER_SIZE);
+   //Allocate memory to hold the multi-part buffer. The smallest block that
+   //can hold both the header and the data is preferred
+   buffer = netBufferAllocBlock(CHUNKED_BUFFER_HEADER_SIZE + length, TRUE,
+      &blockSize);
    //Failed to allocate memory?
    if(buffer == NULL)
       return NULL;
@@ -255,7 +887,7 @@ NetBuffer *netBufferAlloc(size_t length)
    buffer->chunkCount = 1;
    buffer->maxChunkCount = MAX_CHUNK_COUNT;
    buffer->chunk[0].address = (uint8_t *) buffer + CHUNKED_BUFFER_HEADER_SIZE;
-   buffer->chunk[0].length = NET_MEM_POOL_BUFFER_SIZE - CHUNKED_BUFFER_HEADER_SIZE;
+   buffer->chunk[0].length = blockSize - CHUNKED_BUFFER_HEADER_SIZE;
    buffer->chunk[0].size = 0;
 
    //Adjust the length of the buffer
@@ -321,6 +953,7 @@ error_t netBufferSetLength(NetBuffer *buffer, size_t length)
 {
    uint_t i;
    uint_t chunkCount;
+   size_t blockSize;
    ChunkDesc *chunk;
 
    //Get the actual number of chunks
@@ -380,16 +1013,19 @@ error_t netBufferSetLength(NetBuffer *buffer, size_t length)
          //Point to the chunk descriptor;
          chunk = &buffer->chunk[i];
 
-         //Allocate memory to hold a new chunk
-         chunk->address = memPoolAlloc(NET_MEM_POOL_BUFFER_SIZE);
+         //Allocate memory to hold a new chunk. Blocks smaller than the
+         //regular size are only used when the buffer is created, so that
+         //a buffer that keeps on growing does not end up with many chunks
+         chunk->address = netBufferAllocBlock(length, chunkCount == 0,
+            &blockSize);
          //Failed to allocate memory?
          if(!chunk->address)
             return ERROR_OUT_OF_MEMORY;
 
          //Allocated memory
-         chunk->size = NET_MEM_POOL_BUFFER_SIZE;
+         chunk->size = (uint16_t) blockSize;
          //Actual length of the data chunk
-         chunk->length = MIN(length, NET_MEM_POOL_BUFFER_SIZE);
+         chunk->length = (uint16_t) MIN(length, blockSize);
 
          //Prepare to process next chunk
          length -= chunk->length;
@@ -430,6 +1066,40 @@ void *netBufferAt(const NetBuffer *buffer, size_t offset)
 }
 
 
+/**
+ * @brief Returns a pointer to the contiguous data at the specified position
+ * @param[in] buffer Pointer to a multi-part buffer
+ * @param[in] offset Offset from the beginning of the buffer
+ * @param[out] length Number of contiguous bytes available at that position
+ * @return Pointer the data at the specified position
+ **/
+
+void *netBufferAtEx(const NetBuffer *buffer, size_t offset, size_t *length)
+{
+   uint_t i;
+
+   //Loop through data chunks
+   for(i = 0; i < buffer->chunkCount; i++)
+   {
+      //The data at the specified offset resides in the current chunk?
+      if(offset < buffer->chunk[i].length)
+      {
+         //The data is contiguous up to the end of the chunk
+         *length = buffer->chunk[i].length - offset;
+         //Return a pointer to the data
+         return (uint8_t *) buffer->chunk[i].address + offset;
+      }
+
+      //Jump to the next chunk
+      offset -= buffer->chunk[i].length;
+   }
+
+   //Invalid offset...
+   *length = 0;
+   return NULL;
+}
+
+
 /**
  * @brief Concatenate two multi-part buffers
  * @param[out] dest Pointer to the destination buffer
@@ -575,6 +1245,111 @@ error_t netBufferCopy(NetBuffer *dest, size_t destOffset,
 }
 
 
+/**
+ * @brief Copy data between multi-part buffers and compute its checksum
+ *
+ * The 1's complement sum of the copied data is computed on the fly, so
+ * that each byte is only touched once
+ *
+ * @param[out] dest Pointer to the destination buffer
+ * @param[in] destOffset Write offset
+ * @param[in] src Pointer to the source buffer
+ * @param[in] srcOffset Read offset
+ * @param[in] length Number of bytes to be copied
+ * @param[out] checksum Partial sum of the copied data (not folded)
+ * @return Error code
+ **/
+
+error_t netBufferCopyWithChecksum(NetBuffer *dest, size_t destOffset,
+   const NetBuffer *src, size_t srcOffset, size_t length, uint64_t *checksum)
+{
+   uint_t i;
+   uint_t j;
+   uint_t n;
+   uint_t pos;
+   uint8_t *p;
+   uint8_t *q;
+   uint32_t partial;
+
+   //Checksum preset value
+   *checksum = 0;
+
+   //Skip the beginning of the source data
+   for(i = 0; i < dest->chunkCount; i++)
+   {
+      //The data at the specified offset resides in the current chunk?
+      if(destOffset < dest->chunk[i].length)
+         break;
+
+      //Jump to the next chunk
+      destOffset -= dest->chunk[i].length;
+   }
+
+   //Invalid offset?
+   if(i >= dest->chunkCount)
+      return ERROR_INVALID_PARAMETER;
+
+   //Skip the beginning of the source data
+   for(j = 0; j < src->chunkCount; j++)
+   {
+      //The data at the specified offset resides in the current chunk?
+      if(srcOffset < src->chunk[j].length)
+         break;
+
+      //Jump to the next chunk
+      srcOffset -= src->chunk[j].length;
+   }
+
+   //Invalid offset?
+   if(j >= src->chunkCount)
+      return ERROR_INVALID_PARAMETER;
+
+   //Current position in the copied data
+   pos = 0;
+
+   while(length > 0 && i < dest->chunkCount && j < src->chunkCount)
+   {
+      //Point to the first data byte
+      p = (uint8_t *) dest->chunk[i].address + destOffset;
+      q = (uint8_t *) src->chunk[j].address + srcOffset;
+
+      //Compute the number of bytes to copy
+      n = MIN(length, dest->chunk[i].length - destOffset);
+      n = MIN(n, src->chunk[j].length - srcOffset);
+
+      //Copy data and compute its partial sum
+      partial = ipCalcChecksumCopy(p, q, n);
+
+      //Take care of alignment issues
+      if((pos & 1) != 0)
+         partial = IP_CHECKSUM_SWAP(partial);
+
+      //Partial sums are accumulated without intermediate folding
+      *checksum += partial;
+
+      pos += n;
+      destOffset += n;
+      srcOffset += n;
+      length -= n;
+
+      if(destOffset >= dest->chunk[i].length)
+      {
+         destOffset = 0;
+         i++;
+      }
+
+      if(srcOffset >= src->chunk[j].length)
+      {
+         srcOffset = 0;
+         j++;
+      }
+   }
+
+   //Return status code
+   return (length > 0) ? ERROR_FAILURE : NO_ERROR;
+}
+
+
 /**
  * @brief Append data a multi-part buffer
  * @param[out] dest Pointer to a multi-part buffer
@@ -660,6 +1435,70 @@ size_t netBufferWrite(NetBuffer *dest,
 }
 
 
+/**
+ * @brief Write data to a multi-part buffer and compute its checksum
+ * @param[out] dest Pointer to the multi-part buffer
+ * @param[in] destOffset Write offset
+ * @param[in] src Pointer to the data to be written
+ * @param[in] length Number of bytes to copy
+ * @param[out] checksum Partial sum of the written data (not folded)
+ * @return Actual number of bytes written
+ **/
+
+size_t netBufferWriteWithChecksum(NetBuffer *dest, size_t destOffset,
+   const void *src, size_t length, uint64_t *checksum)
+{
+   uint_t i;
+   uint_t n;
+   size_t totalLength;
+   uint8_t *p;
+   uint32_t partial;
+
+   //Checksum preset value
+   *checksum = 0;
+   //Total number of bytes written
+   totalLength = 0;
+
+   //Loop through data chunks
+   for(i = 0; i < dest->chunkCount && totalLength < length; i++)
+   {
+      //Is there any data to copy in the current chunk?
+      if(destOffset < dest->chunk[i].length)
+      {
+         //Point to the first byte to be written
+         p = (uint8_t *) dest->chunk[i].address + destOffset;
+         //Compute the number of bytes to copy at a time
+         n = MIN(length - totalLength, dest->chunk[i].length - destOffset);
+
+         //Copy data and compute its partial sum
+         partial = ipCalcChecksumCopy(p, src, n);
+
+         //Take care of alignment issues
+         if((totalLength & 1) != 0)
+            partial = IP_CHECKSUM_SWAP(partial);
+
+         //Partial sums are accumulated without intermediate folding
+         *checksum += partial;
+
+         //Advance read pointer
+         src = (uint8_t *) src + n;
+         //Total number of bytes written
+         totalLength += n;
+         //Process the next block from the start
+         destOffset = 0;
+      }
+      else
+      {
+         //Skip the current chunk
+         destOffset -= dest->chunk[i].length;
+      }
+   }
+
+   //Return the actual number of bytes written
+   return totalLength;
+}
+
+
 /**
  * @brief Read data from a multi-part buffer
  * @param[out] dest Pointer to the buffer where to return the data
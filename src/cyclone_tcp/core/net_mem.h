@@ -57,6 +57,85 @@
    #error NET_MEM_POOL_BUFFER_SIZE parameter is not valid
 #endif
 
+//Multiple buffer size classes
+#ifndef NET_MEM_POOL_SIZE_CLASS_SUPPORT
+   #define NET_MEM_POOL_SIZE_CLASS_SUPPORT DISABLED
+#elif (NET_MEM_POOL_SIZE_CLASS_SUPPORT != ENABLED && NET_MEM_POOL_SIZE_CLASS_SUPPORT != DISABLED)
+   #error NET_MEM_POOL_SIZE_CLASS_SUPPORT parameter is not valid
+#endif
+
+//Number of small buffers
+#ifndef NET_MEM_POOL_SMALL_BUFFER_COUNT
+   #define NET_MEM_POOL_SMALL_BUFFER_COUNT 32
+#elif (NET_MEM_POOL_SMALL_BUFFER_COUNT < 1)
+   #error NET_MEM_POOL_SMALL_BUFFER_COUNT parameter is not valid
+#endif
+
+//Size of the small buffers
+#ifndef NET_MEM_POOL_SMALL_BUFFER_SIZE
+   #define NET_MEM_POOL_SMALL_BUFFER_SIZE 256
+#elif (NET_MEM_POOL_SMALL_BUFFER_SIZE < 32)
+   #error NET_MEM_POOL_SMALL_BUFFER_SIZE parameter is not valid
+#endif
+
+//Number of medium buffers
+#ifndef NET_MEM_POOL_MEDIUM_BUFFER_COUNT
+   #define NET_MEM_POOL_MEDIUM_BUFFER_COUNT 16
+#elif (NET_MEM_POOL_MEDIUM_BUFFER_COUNT < 1)
+   #error NET_MEM_POOL_MEDIUM_BUFFER_COUNT parameter is not valid
+#endif
+
+//Size of the medium buffers
+#ifndef NET_MEM_POOL_MEDIUM_BUFFER_SIZE
+   #define NET_MEM_POOL_MEDIUM_BUFFER_SIZE 512
+#elif (NET_MEM_POOL_MEDIUM_BUFFER_SIZE <= NET_MEM_POOL_SMALL_BUFFER_SIZE || \
+   NET_MEM_POOL_MEDIUM_BUFFER_SIZE >= NET_MEM_POOL_BUFFER_SIZE)
+   #error NET_MEM_POOL_MEDIUM_BUFFER_SIZE parameter is not valid
+#endif
+
+//Number of large buffers
+#ifndef NET_MEM_POOL_LARGE_BUFFER_COUNT
+   #define NET_MEM_POOL_LARGE_BUFFER_COUNT 4
+#elif (NET_MEM_POOL_LARGE_BUFFER_COUNT < 1)
+   #error NET_MEM_POOL_LARGE_BUFFER_COUNT parameter is not valid
+#endif
+
+//Size of the large buffers
+#ifndef NET_MEM_POOL_LARGE_BUFFER_SIZE
+   #define NET_MEM_POOL_LARGE_BUFFER_SIZE 4096
+#elif (NET_MEM_POOL_LARGE_BUFFER_SIZE <= NET_MEM_POOL_BUFFER_SIZE || \
+   NET_MEM_POOL_LARGE_BUFFER_SIZE > 65535)
+   #error NET_MEM_POOL_LARGE_BUFFER_SIZE parameter is not valid
+#endif
+
+//Number of size classes
+#if (NET_MEM_POOL_SIZE_CLASS_SUPPORT == ENABLED)
+   #define NET_MEM_POOL_CLASS_COUNT 4
+#else
+   #define NET_MEM_POOL_CLASS_COUNT 1
+#endif
+
+//Per-task buffer caches
+#ifndef NET_MEM_POOL_CACHE_SUPPORT
+   #define NET_MEM_POOL_CACHE_SUPPORT DISABLED
+#elif (NET_MEM_POOL_CACHE_SUPPORT != ENABLED && NET_MEM_POOL_CACHE_SUPPORT != DISABLED)
+   #error NET_MEM_POOL_CACHE_SUPPORT parameter is not valid
+#endif
+
+//Number of buffer caches
+#ifndef NET_MEM_POOL_CACHE_COUNT
+   #define NET_MEM_POOL_CACHE_COUNT 4
+#elif (NET_MEM_POOL_CACHE_COUNT < 1)
+   #error NET_MEM_POOL_CACHE_COUNT parameter is not valid
+#endif
+
+//Maximum number of buffers held by each cache
+#ifndef NET_MEM_POOL_CACHE_SIZE
+   #define NET_MEM_POOL_CACHE_SIZE 8
+#elif (NET_MEM_POOL_CACHE_SIZE < 2)
+   #error NET_MEM_POOL_CACHE_SIZE parameter is not valid
+#endif
+
 //Size of the header part of the buffer
 #define CHUNKED_BUFFER_HEADER_SIZE (sizeof(NetBuffer) + MAX_CHUNK_COUNT * sizeof(ChunkDesc))
 
@@ -107,6 +186,9 @@ void *memPoolAlloc(size_t size);
 void memPoolFree(void *p);
 void memPoolGetStats(uint_t *currentUsage, uint_t *maxUsage, uint_t *size);
 
+error_t memPoolGetClassStats(uint_t index, size_t *blockSize,
+   uint_t *currentUsage, uint_t *maxUsage, uint_t *size);
+
 NetBuffer *netBufferAlloc(size_t length);
 void netBufferFree(NetBuffer *buffer);
 
@@ -114,6 +196,7 @@ size_t netBufferGetLength(const NetBuffer *buffer);
 error_t netBufferSetLength(NetBuffer *buffer, size_t length);
 
 void *netBufferAt(const NetBuffer *buffer, size_t offset);
+void *netBufferAtEx(const NetBuffer *buffer, size_t offset, size_t *length);
 
 error_t netBufferConcat(NetBuffer *dest,
    const NetBuffer *src, size_t srcOffset, size_t length);
@@ -121,11 +204,17 @@ error_t netBufferConcat(NetBuffer *dest,
 error_t netBufferCopy(NetBuffer *dest, size_t destOffset,
    const NetBuffer *src, size_t srcOffset, size_t length);
 
+error_t netBufferCopyWithChecksum(NetBuffer *dest, size_t destOffset,
+   const NetBuffer *src, size_t srcOffset, size_t length, uint64_t *checksum);
+
 error_t netBufferAppend(NetBuffer *dest, const void *src, size_t length);
 
 size_t netBufferWrite(NetBuffer *dest,
    size_t destOffset, const void *src, size_t length);
 
+size_t netBufferWriteWithChecksum(NetBuffer *dest, size_t destOffset,
+   const void *src, size_t length, uint64_t *checksum);
+
 size_t netBufferRead(void *dest, const NetBuffer *src,
    size_t srcOffset, size_t length);
 
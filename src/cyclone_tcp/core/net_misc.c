@@ -52,4 +52,7 @@ const NetAncillaryData NET_DEFAULT_ANCILLARY_DATA =
 #if (ETH_PORT_TAGGING_SUPPORT == ENABLED)
    0,     ///<Switch port identifier
 #endif
+#if (TCP_GSO_SUPPORT == ENABLED)
+   0,     ///<Segment size of a TCP super-segment
+#endif
 };
@@ -64,6 +64,9 @@ struct _NetAncillaryData
 #if (ETH_PORT_TAGGING_SUPPORT == ENABLED)
    uint8_t port;     ///<Switch port identifier
 #endif
+#if (TCP_GSO_SUPPORT == ENABLED)
+   size_t gsoSize;   ///<Segment size of a TCP super-segment (0 if none)
+#endif
 };
 
 
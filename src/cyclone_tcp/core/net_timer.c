@@ -0,0 +1,489 @@
+/**
+ * @file net_timer.c
+ * @brief Timer wheel
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *
+ * @section Description
+ *
+ * Protocol modules register their deadlines with a hierarchical timer wheel
+ * rather than being polled periodically. Level 0 has one slot per tick of
+ * NET_TIMER_RESOLUTION milliseconds, and each slot of level n covers a full
+ * revolution of level n-1. Starting and stopping a timer are O(1), timers of
+ * the upper levels are moved down when the lower level wraps around, and the
+ * TCP/IP stack task sleeps until the next slot that holds a pending timer
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL NIC_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/net_timer.h"
+#include "debug.h"
+
+//Timer wheel
+NetTimerWheel netTimerWheel;
+
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+
+//Mutex protecting the timer wheel
+OsMutex netTimerMutex;
+
+//Get exclusive access to the timer wheel
+#define NET_TIMER_LOCK() osAcquireMutex(&netTimerMutex)
+#define NET_TIMER_UNLOCK() osReleaseMutex(&netTimerMutex)
+
+#else
+
+//The timer wheel is protected by the netMutex
+#define NET_TIMER_LOCK()
+#define NET_TIMER_UNLOCK()
+
+#endif
+
+
+/**
+ * @brief Timer wheel initialization
+ * @return Error code
+ **/
+
+error_t netTimerInit(void)
+{
+   //Clear the timer wheel
+   osMemset(&netTimerWheel, 0, sizeof(NetTimerWheel));
+
+   //The first tick is due immediately
+   netTimerWheel.time = osGetSystemTime();
+   netTimerWheel.wakeUp = netTimerWheel.time;
+
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+   //Timers are started and stopped by the application tasks as well
+   if(!osCreateMutex(&netTimerMutex))
+   {
+      //Failed to create mutex
+      return ERROR_OUT_OF_RESOURCES;
+   }
+#endif
+
+   //Successful initialization
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Start a timer
+ * @param[in] timer Pointer to the timer
+ * @param[in] delay Time interval before the timer expires, in milliseconds
+ * @param[in] callback Function to be invoked when the timer expires
+ * @param[in] param Opaque parameter passed to the callback
+ **/
+
+void netStartTimer(NetTimer *timer, systime_t delay, NetTimerCallback callback,
+   void *param)
+{
+   uint32_t n;
+   systime_t time;
+
+   //Get exclusive access
+   NET_TIMER_LOCK();
+
+   //Restart the timer if it is already pending
+   netRemoveTimer(timer);
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //The wheel is not advanced while no timer is pending
+   if(netTimerWheel.count == 0 && timeCompare(time, netTimerWheel.time) >= 0)
+   {
+      //Skip the ticks that have elapsed in the meantime
+      n = (time - netTimerWheel.time) / NET_TIMER_RESOLUTION + 1;
+      netTimerWheel.tick += n;
+      netTimerWheel.time += n * NET_TIMER_RESOLUTION;
+   }
+
+   //Save timer parameters
+   timer->expiry = time + delay;
+   timer->callback = callback;
+   timer->param = param;
+
+   //Insert the timer in the relevant slot
+   netInsertTimer(timer);
+   //Number of pending timers
+   netTimerWheel.count++;
+
+   //The TCP/IP stack task may be sleeping beyond the expiration time
+   if(timeCompare(timer->expiry, netTimerWheel.wakeUp) < 0)
+   {
+      //Wake up the task so that it computes a new timeout
+      netTimerWheel.wakeUp = timer->expiry;
+      osSetEvent(&netEvent);
+   }
+
+   //Release exclusive access
+   NET_TIMER_UNLOCK();
+}
+
+
+/**
+ * @brief Stop a timer
+ * @param[in] timer Pointer to the timer
+ **/
+
+void netStopTimer(NetTimer *timer)
+{
+   //Get exclusive access
+   NET_TIMER_LOCK();
+   //Remove the timer from the wheel
+   netRemoveTimer(timer);
+   //Release exclusive access
+   NET_TIMER_UNLOCK();
+}
+
+
+/**
+ * @brief Check whether a timer is pending
+ * @param[in] timer Pointer to the timer
+ * @return TRUE if the timer is pending, else FALSE
+ **/
+
+bool_t netTimerPending(NetTimer *timer)
+{
+   bool_t pending;
+
+   //Get exclusive access
+   NET_TIMER_LOCK();
+   //A pending timer is linked to a slot of the wheel
+   pending = (timer->pprev != NULL) ? TRUE : FALSE;
+   //Release exclusive access
+   NET_TIMER_UNLOCK();
+
+   //Return the state of the timer
+   return pending;
+}
+
+
+/**
+ * @brief Process expired timers
+ *
+ * This function is called by the TCP/IP stack task, with the netMutex held
+ *
+ **/
+
+void netProcessTimers(void)
+{
+   uint_t i;
+   uint_t level;
+   uint32_t n;
+   systime_t time;
+   NetTimer *timer;
+   NetTimer *expired;
+   NetTimerCallback callback;
+   void *param;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Get exclusive access
+   NET_TIMER_LOCK();
+
+   //No timer is pending?
+   if(netTimerWheel.count == 0)
+   {
+      //Skip the ticks that have elapsed
+      if(timeCompare(time, netTimerWheel.time) >= 0)
+      {
+         n = (time - netTimerWheel.time) / NET_TIMER_RESOLUTION + 1;
+         netTimerWheel.tick += n;
+         netTimerWheel.time += n * NET_TIMER_RESOLUTION;
+      }
+
+      //Release exclusive access
+      NET_TIMER_UNLOCK();
+      //We are done
+      return;
+   }
+
+   //Process the ticks that are due
+   while(timeCompare(time, netTimerWheel.time) >= 0)
+   {
+      //Index of the current slot in level 0
+      i = netTimerWheel.tick & NET_TIMER_WHEEL_MASK;
+
+      //Level 0 wraps around?
+      if(i == 0)
+      {
+         //Move the timers of the upper levels down, one level at a time
+         for(level = 1; level < NET_TIMER_WHEEL_LEVELS; level++)
+         {
+            //Index of the current slot in this level
+            i = (netTimerWheel.tick >> (level * NET_TIMER_WHEEL_BITS)) &
+               NET_TIMER_WHEEL_MASK;
+
+            //Redistribute the timers of the slot
+            netCascadeTimers(level, i);
+
+            //The next level is only cascaded when this one wraps around
+            if(i != 0)
+               break;
+         }
+
+         //Restore the index of the current slot in level 0
+         i = 0;
+      }
+
+      //Detach the list of expired timers, so that callbacks can start timers
+      //that fall in the same slot of the next revolution
+      expired = netTimerWheel.slot[0][i];
+      netTimerWheel.slot[0][i] = NULL;
+
+      if(expired != NULL)
+         expired->pprev = &expired;
+
+      //Advance to the next tick
+      netTimerWheel.tick++;
+      netTimerWheel.time += NET_TIMER_RESOLUTION;
+
+      //Invoke the callbacks of the expired timers
+      while(expired != NULL)
+      {
+         //Remove the first timer from the list
+         timer = expired;
+         netRemoveTimer(timer);
+
+         //Save callback parameters
+         callback = timer->callback;
+         param = timer->param;
+
+         //The wheel is unlocked while the callback runs, since it may start
+         //or stop timers (expired timers that are stopped meanwhile are
+         //removed from the list)
+         NET_TIMER_UNLOCK();
+         //Invoke the user callback
+         callback(param);
+         //Get exclusive access
+         NET_TIMER_LOCK();
+      }
+   }
+
+   //Release exclusive access
+   NET_TIMER_UNLOCK();
+}
+
+
+/**
+ * @brief Compute the time the TCP/IP stack task can sleep
+ *
+ * This function is called by the TCP/IP stack task, with the netMutex held
+ *
+ * @return Time until the next pending timer is due, in milliseconds
+ **/
+
+systime_t netGetTimerTimeout(void)
+{
+   uint_t k;
+   uint_t level;
+   uint_t shift;
+   uint32_t c;
+   uint32_t n;
+   uint32_t ticks;
+   systime_t time;
+   systime_t timeout;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Get exclusive access
+   NET_TIMER_LOCK();
+
+   //No timer is pending?
+   if(netTimerWheel.count == 0)
+   {
+      //Wait for an event
+      netTimerWheel.wakeUp = time + INT32_MAX;
+
+      //Release exclusive access
+      NET_TIMER_UNLOCK();
+      //Sleep until an event is signaled
+      return INFINITE_DELAY;
+   }
+
+   //Initialize the number of ticks until the next deadline
+   ticks = UINT32_MAX;
+
+   //Search level 0 for the first slot that holds a pending timer
+   for(k = 0; k < NET_TIMER_WHEEL_SLOTS; k++)
+   {
+      if(netTimerWheel.slot[0][(netTimerWheel.tick + k) &
+         NET_TIMER_WHEEL_MASK] != NULL)
+      {
+         ticks = k;
+         break;
+      }
+   }
+
+   //The timers of the upper levels are due no earlier than the tick at which
+   //their slot is cascaded
+   for(level = 1; level < NET_TIMER_WHEEL_LEVELS; level++)
+   {
+      //Each slot of this level covers 2^shift ticks
+      shift = level * NET_TIMER_WHEEL_BITS;
+      //First slot boundary that has not been processed yet
+      c = (netTimerWheel.tick + (1UL << shift) - 1) >> shift;
+
+      //Search the first non-empty slot
+      for(k = 0; k < NET_TIMER_WHEEL_SLOTS; k++)
+      {
+         if(netTimerWheel.slot[level][(c + k) & NET_TIMER_WHEEL_MASK] != NULL)
+         {
+            //Number of ticks until the slot is cascaded
+            n = ((c + k) << shift) - netTimerWheel.tick;
+            //Keep the earliest deadline
+            ticks = MIN(ticks, n);
+            break;
+         }
+      }
+   }
+
+   //Time at which the next deadline is due
+   netTimerWheel.wakeUp = netTimerWheel.time + ticks * NET_TIMER_RESOLUTION;
+
+   //Compute the time to sleep
+   if(timeCompare(netTimerWheel.wakeUp, time) > 0)
+      timeout = netTimerWheel.wakeUp - time;
+   else
+      timeout = 0;
+
+   //Release exclusive access
+   NET_TIMER_UNLOCK();
+
+   //Return the timeout value
+   return timeout;
+}
+
+
+/**
+ * @brief Insert a timer in the relevant slot of the wheel
+ * @param[in] timer Pointer to the timer
+ **/
+
+void netInsertTimer(NetTimer *timer)
+{
+   uint_t i;
+   uint_t level;
+   int32_t delta;
+   uint32_t ticks;
+   NetTimer **head;
+
+   //Time remaining before the timer expires
+   delta = timeCompare(timer->expiry, netTimerWheel.time);
+
+   //Number of ticks until the timer expires, rounded up
+   if(delta > 0)
+      ticks = ((uint32_t) delta + NET_TIMER_RESOLUTION - 1) / NET_TIMER_RESOLUTION;
+   else
+      ticks = 0;
+
+   //Timers beyond the range of the wheel are parked in the last level, and
+   //will be redistributed when their slot is cascaded
+   ticks = MIN(ticks, (1UL << (NET_TIMER_WHEEL_LEVELS * NET_TIMER_WHEEL_BITS)) - 1);
+
+   //Select the lowest level whose range covers the expiration time
+   for(level = 0; level < (NET_TIMER_WHEEL_LEVELS - 1); level++)
+   {
+      if(ticks < (1UL << ((level + 1) * NET_TIMER_WHEEL_BITS)))
+         break;
+   }
+
+   //Index of the slot in the selected level
+   i = ((netTimerWheel.tick + ticks) >> (level * NET_TIMER_WHEEL_BITS)) &
+      NET_TIMER_WHEEL_MASK;
+
+   //Point to the head of the list
+   head = &netTimerWheel.slot[level][i];
+
+   //Insert the timer at the head of the list
+   timer->next = *head;
+   timer->pprev = head;
+
+   if(timer->next != NULL)
+      timer->next->pprev = &timer->next;
+
+   *head = timer;
+}
+
+
+/**
+ * @brief Remove a timer from the wheel
+ * @param[in] timer Pointer to the timer
+ **/
+
+void netRemoveTimer(NetTimer *timer)
+{
+   //Check whether the timer is pending
+   if(timer->pprev != NULL)
+   {
+      //Remove the timer from its list
+      *timer->pprev = timer->next;
+
+      if(timer->next != NULL)
+         timer->next->pprev = timer->pprev;
+
+      //The timer is no longer pending
+      timer->next = NULL;
+      timer->pprev = NULL;
+
+      //Number of pending timers
+      netTimerWheel.count--;
+   }
+}
+
+
+/**
+ * @brief Move the timers of a given slot to the lower levels
+ * @param[in] level Level of the wheel
+ * @param[in] index Index of the slot
+ **/
+
+void netCascadeTimers(uint_t level, uint_t index)
+{
+   NetTimer *timer;
+   NetTimer *next;
+
+   //Detach the list of timers
+   timer = netTimerWheel.slot[level][index];
+   netTimerWheel.slot[level][index] = NULL;
+
+   //Redistribute the timers according to their expiration time
+   while(timer != NULL)
+   {
+      next = timer->next;
+      netInsertTimer(timer);
+      timer = next;
+   }
+}
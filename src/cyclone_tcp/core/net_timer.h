@@ -0,0 +1,139 @@
+/**
+ * @file net_timer.h
+ * @brief Timer wheel
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+#ifndef _NET_TIMER_H
+#define _NET_TIMER_H
+
+//Forward declaration of NetTimer structure
+struct _NetTimer;
+#define NetTimer struct _NetTimer
+
+//Dependencies
+#include "net_config.h"
+#include "os_port.h"
+
+//Resolution of the timer wheel, in milliseconds
+#ifndef NET_TIMER_RESOLUTION
+   #define NET_TIMER_RESOLUTION 10
+#elif (NET_TIMER_RESOLUTION < 1)
+   #error NET_TIMER_RESOLUTION parameter is not valid
+#endif
+
+//Number of levels of the timer wheel
+#ifndef NET_TIMER_WHEEL_LEVELS
+   #define NET_TIMER_WHEEL_LEVELS 4
+#elif (NET_TIMER_WHEEL_LEVELS < 1 || NET_TIMER_WHEEL_LEVELS > 5)
+   #error NET_TIMER_WHEEL_LEVELS parameter is not valid
+#endif
+
+//Number of slots per level (base 2 logarithm)
+#ifndef NET_TIMER_WHEEL_BITS
+   #define NET_TIMER_WHEEL_BITS 6
+#elif (NET_TIMER_WHEEL_BITS < 2 || NET_TIMER_WHEEL_BITS > 8 || \
+   (NET_TIMER_WHEEL_BITS * NET_TIMER_WHEEL_LEVELS) > 30)
+   #error NET_TIMER_WHEEL_BITS parameter is not valid
+#endif
+
+//Number of slots per level
+#define NET_TIMER_WHEEL_SLOTS (1U << NET_TIMER_WHEEL_BITS)
+//Mask used to compute slot indexes
+#define NET_TIMER_WHEEL_MASK (NET_TIMER_WHEEL_SLOTS - 1)
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Timer expiration callback
+ **/
+
+typedef void (*NetTimerCallback)(void *param);
+
+
+/**
+ * @brief Timer
+ **/
+
+struct _NetTimer
+{
+   NetTimer *next;            ///<Next timer in the same slot
+   NetTimer **pprev;          ///<Link pointing to this timer (NULL if the timer is not pending)
+   systime_t expiry;          ///<Expiration time
+   NetTimerCallback callback; ///<Function to be invoked when the timer expires
+   void *param;               ///<Opaque parameter passed to the callback
+};
+
+
+/**
+ * @brief Hierarchical timer wheel
+ **/
+
+typedef struct
+{
+   NetTimer *slot[NET_TIMER_WHEEL_LEVELS][NET_TIMER_WHEEL_SLOTS]; ///<Lists of pending timers
+   uint32_t tick;     ///<Next tick to be processed
+   systime_t time;    ///<Time at which the next tick is due
+   systime_t wakeUp;  ///<Time at which the TCP/IP stack task will wake up
+   uint_t count;      ///<Number of pending timers
+} NetTimerWheel;
+
+
+//Global variables
+extern NetTimerWheel netTimerWheel;
+
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+extern OsMutex netTimerMutex;
+#endif
+
+//Timer wheel related functions
+error_t netTimerInit(void);
+
+void netStartTimer(NetTimer *timer, systime_t delay, NetTimerCallback callback,
+   void *param);
+
+void netStopTimer(NetTimer *timer);
+bool_t netTimerPending(NetTimer *timer);
+
+void netProcessTimers(void);
+systime_t netGetTimerTimeout(void);
+
+void netInsertTimer(NetTimer *timer);
+void netRemoveTimer(NetTimer *timer);
+void netCascadeTimers(uint_t level, uint_t index);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
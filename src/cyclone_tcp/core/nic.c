@@ -34,7 +34,9 @@
 //Dependencies
 #include "core/net.h"
 #include "core/nic.h"
+#include "core/socket.h"
 #include "core/ethernet.h"
+#include "core/tcp_gro.h"
 #include "ipv4/ipv4.h"
 #include "ipv6/ipv6.h"
 #include "debug.h"
@@ -337,6 +339,69 @@ error_t nicSendPacket(NetInterface *interface, const NetBuffer *buffer,
 }
 
 
+/**
+ * @brief Send a TCP super-segment that the hardware will split
+ * @param[in] interface Underlying network interface
+ * @param[in] buffer Multi-part buffer containing the frame
+ * @param[in] offset Offset to the first byte of the frame
+ * @param[in] mss Amount of TCP data to be carried by each segment
+ * @return Error code
+ **/
+
+error_t nicSendTso(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset, size_t mss)
+{
+   error_t error;
+   bool_t status;
+
+#if (TRACE_LEVEL >= TRACE_LEVEL_DEBUG)
+   //Retrieve the length of the packet
+   size_t length = netBufferGetLength(buffer) - offset;
+
+   //Debug message
+   TRACE_DEBUG("Sending super-segment (%" PRIuSIZE " bytes, MSS %" PRIuSIZE ")...\r\n",
+      length, mss);
+#endif
+
+   //Check whether the interface is enabled for operation
+   if(interface->configured && interface->nicDriver != NULL &&
+      interface->nicDriver->sendTso != NULL)
+   {
+      //Wait for the transmitter to be ready to send
+      status = osWaitForEvent(&interface->nicTxEvent, NIC_MAX_BLOCKING_TIME);
+
+      //Check whether the specified event is in signaled state
+      if(status)
+      {
+         //Disable interrupts
+         interface->nicDriver->disableIrq(interface);
+
+         //The hardware takes care of segmentation and checksum calculation
+         error = interface->nicDriver->sendTso(interface, buffer, offset, mss);
+
+         //Re-enable interrupts if necessary
+         if(interface->configured)
+         {
+            interface->nicDriver->enableIrq(interface);
+         }
+      }
+      else
+      {
+         //The transmitter is busy
+         error = ERROR_TRANSMITTER_BUSY;
+      }
+   }
+   else
+   {
+      //Report an error
+      error = ERROR_INVALID_INTERFACE;
+   }
+
+   //Return status code
+   return error;
+}
+
+
 /**
  * @brief Configure MAC address filtering
  * @param[in] interface Underlying network interface
@@ -382,11 +447,69 @@ error_t nicUpdateMacAddrFilter(NetInterface *interface)
 
 void nicProcessPacket(NetInterface *interface, uint8_t *packet, size_t length)
 {
-   NicType type;
-   NetAncillaryData ancillary;
+   //Check whether the interface is enabled for operation
+   if(interface->configured)
+   {
+      //Re-enable interrupts
+      interface->nicDriver->enableIrq(interface);
+
+      //Pass the packet to the upper layer
+      nicDispatchPacket(interface, packet, length);
+
+      //Disable interrupts
+      interface->nicDriver->disableIrq(interface);
+   }
+}
+
+
+/**
+ * @brief Retrieve and process the frames queued by a burst-capable driver
+ *
+ * The frames returned by the driver remain valid until the next call to its
+ * receiveBurst callback. The queue is drained when the callback returns 0,
+ * which also releases the last burst
+ *
+ * @param[in] interface Underlying network interface
+ **/
+
+void nicReceiveBurst(NetInterface *interface)
+{
+   uint_t n;
+   NicRxDesc desc[NIC_RX_BURST_SIZE];
+
+   //Process received frames until the queue is empty
+   do
+   {
+      //Retrieve a burst of frames
+      n = interface->nicDriver->receiveBurst(interface, desc,
+         NIC_RX_BURST_SIZE);
+
+      //Any frame received?
+      if(n > 0)
+      {
+         //Pass the frames to the upper layer
+         nicProcessBurst(interface, desc, n);
+      }
+   } while(n > 0);
+}
 
-   //Additional options passed to the stack along with the packet
-   ancillary = NET_DEFAULT_ANCILLARY_DATA;
+
+/**
+ * @brief Handle a burst of packets received by the network controller
+ *
+ * Interrupts are re-enabled once for the whole burst, and the socket that
+ * matched the previous segment is tried first when demultiplexing TCP
+ * segments, since consecutive frames usually belong to the same connection
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] desc List of received frames
+ * @param[in] count Number of entries in the list
+ **/
+
+void nicProcessBurst(NetInterface *interface, const NicRxDesc *desc,
+   uint_t count)
+{
+   uint_t i;
 
    //Check whether the interface is enabled for operation
    if(interface->configured)
@@ -394,130 +517,171 @@ void nicProcessPacket(NetInterface *interface, uint8_t *packet, size_t length)
       //Re-enable interrupts
       interface->nicDriver->enableIrq(interface);
 
-      //Debug message
-      TRACE_DEBUG("Packet received (%" PRIuSIZE " bytes)...\r\n", length);
-      TRACE_DEBUG_ARRAY("  ", packet, length);
+      //Start caching the result of socket lookups
+      socketSetLookupCache(TRUE);
 
-      //Retrieve network interface type
-      type = interface->nicDriver->type;
+#if (TCP_SUPPORT == ENABLED && TCP_GRO_SUPPORT == ENABLED)
+      //Coalesce TCP segments until the end of the burst
+      tcpGroSetEnabled(TRUE);
+#endif
 
-#if (ETH_SUPPORT == ENABLED)
-      //Ethernet interface?
-      if(type == NIC_TYPE_ETHERNET)
+      //Loop through the received frames
+      for(i = 0; i < count; i++)
       {
-         //Process incoming Ethernet frame
-         ethProcessFrame(interface, packet, length, &ancillary);
+         //Pass the current packet to the upper layer
+         nicDispatchPacket(interface, desc[i].data, desc[i].length);
       }
-      else
+
+#if (TCP_SUPPORT == ENABLED && TCP_GRO_SUPPORT == ENABLED)
+      //Deliver the segment being held while the frames are still valid
+      tcpGroSetEnabled(FALSE);
+#endif
+
+      //Sockets may be closed once the burst has been processed
+      socketSetLookupCache(FALSE);
+
+      //Disable interrupts
+      interface->nicDriver->disableIrq(interface);
+   }
+}
+
+
+/**
+ * @brief Pass a received packet to the relevant protocol handler
+ * @param[in] interface Underlying network interface
+ * @param[in] packet Incoming packet to process
+ * @param[in] length Total packet length
+ **/
+
+void nicDispatchPacket(NetInterface *interface, uint8_t *packet,
+   size_t length)
+{
+   NicType type;
+   NetAncillaryData ancillary;
+
+   //Additional options passed to the stack along with the packet
+   ancillary = NET_DEFAULT_ANCILLARY_DATA;
+
+   //Debug message
+   TRACE_DEBUG("Packet received (%" PRIuSIZE " bytes)...\r\n", length);
+   TRACE_DEBUG_ARRAY("  ", packet, length);
+
+   //Retrieve network interface type
+   type = interface->nicDriver->type;
+
+#if (ETH_SUPPORT == ENABLED)
+   //Ethernet interface?
+   if(type == NIC_TYPE_ETHERNET)
+   {
+      //Process incoming Ethernet frame
+      ethProcessFrame(interface, packet, length, &ancillary);
+   }
+   else
 #endif
 #if (PPP_SUPPORT == ENABLED)
-      //PPP interface?
-      if(type == NIC_TYPE_PPP)
-      {
-         //Process incoming PPP frame
-         pppProcessFrame(interface, packet, length, &ancillary);
-      }
-      else
+   //PPP interface?
+   if(type == NIC_TYPE_PPP)
+   {
+      //Process incoming PPP frame
+      pppProcessFrame(interface, packet, length, &ancillary);
+   }
+   else
 #endif
 #if (IPV6_SUPPORT == ENABLED)
-      //6LoWPAN interface?
-      if(type == NIC_TYPE_6LOWPAN)
-      {
-         NetBuffer1 buffer;
+   //6LoWPAN interface?
+   if(type == NIC_TYPE_6LOWPAN)
+   {
+      NetBuffer1 buffer;
 
-         //The incoming packet fits in a single chunk
-         buffer.chunkCount = 1;
-         buffer.maxChunkCount = 1;
-         buffer.chunk[0].address = packet;
-         buffer.chunk[0].length = (uint16_t) length;
-         buffer.chunk[0].size = 0;
+      //The incoming packet fits in a single chunk
+      buffer.chunkCount = 1;
+      buffer.maxChunkCount = 1;
+      buffer.chunk[0].address = packet;
+      buffer.chunk[0].length = (uint16_t) length;
+      buffer.chunk[0].size = 0;
 
-         //Process incoming IPv6 packet
-         ipv6ProcessPacket(interface, (NetBuffer *) &buffer, 0, &ancillary);
-      }
-      else
+      //Process incoming IPv6 packet
+      ipv6ProcessPacket(interface, (NetBuffer *) &buffer, 0, &ancillary);
+   }
+   else
 #endif
 #if (NET_LOOPBACK_IF_SUPPORT == ENABLED)
-      //Loopback interface?
-      if(type == NIC_TYPE_LOOPBACK)
-      {
+   //Loopback interface?
+   if(type == NIC_TYPE_LOOPBACK)
+   {
 #if (IPV4_SUPPORT == ENABLED)
-         //IPv4 packet received?
-         if(length >= sizeof(Ipv4Header) && (packet[0] >> 4) == 4)
-         {
-            error_t error;
-            uint_t i;
-            Ipv4Header *header;
+      //IPv4 packet received?
+      if(length >= sizeof(Ipv4Header) && (packet[0] >> 4) == 4)
+      {
+         error_t error;
+         uint_t i;
+         Ipv4Header *header;
 
-            //Point to the IPv4 header
-            header = (Ipv4Header *) packet;
+         //Point to the IPv4 header
+         header = (Ipv4Header *) packet;
 
-            //Loop through network interfaces
-            for(i = 0; i < NET_INTERFACE_COUNT; i++)
+         //Loop through network interfaces
+         for(i = 0; i < NET_INTERFACE_COUNT; i++)
+         {
+            //Check destination address
+            error = ipv4CheckDestAddr(&netInterface[i], header->destAddr);
+
+            //Valid destination address?
+            if(!error)
             {
-               //Check destination address
-               error = ipv4CheckDestAddr(&netInterface[i], header->destAddr);
-
-               //Valid destination address?
-               if(!error)
-               {
-                  //Process incoming IPv4 packet
-                  ipv4ProcessPacket(&netInterface[i], (Ipv4Header *) packet,
-                     length, &ancillary);
-               }
+               //Process incoming IPv4 packet
+               ipv4ProcessPacket(&netInterface[i], (Ipv4Header *) packet,
+                  length, &ancillary);
             }
          }
-         else
+      }
+      else
 #endif
 #if (IPV6_SUPPORT == ENABLED)
-         //IPv6 packet received?
-         if(length >= sizeof(Ipv6Header) && (packet[0] >> 4) == 6)
-         {
-            error_t error;
-            uint_t i;
-            NetBuffer1 buffer;
-            Ipv6Header *header;
+      //IPv6 packet received?
+      if(length >= sizeof(Ipv6Header) && (packet[0] >> 4) == 6)
+      {
+         error_t error;
+         uint_t i;
+         NetBuffer1 buffer;
+         Ipv6Header *header;
 
-            //Point to the IPv6 header
-            header = (Ipv6Header *) packet;
+         //Point to the IPv6 header
+         header = (Ipv6Header *) packet;
 
-            //Loop through network interfaces
-            for(i = 0; i < NET_INTERFACE_COUNT; i++)
+         //Loop through network interfaces
+         for(i = 0; i < NET_INTERFACE_COUNT; i++)
+         {
+            //Check destination address
+            error = ipv6CheckDestAddr(&netInterface[i], &header->destAddr);
+
+            //Valid destination address?
+            if(!error)
             {
-               //Check destination address
-               error = ipv6CheckDestAddr(&netInterface[i], &header->destAddr);
-
-               //Valid destination address?
-               if(!error)
-               {
-                  //The incoming packet fits in a single chunk
-                  buffer.chunkCount = 1;
-                  buffer.maxChunkCount = 1;
-                  buffer.chunk[0].address = packet;
-                  buffer.chunk[0].length = (uint16_t) length;
-                  buffer.chunk[0].size = 0;
-
-                  //Process incoming IPv6 packet
-                  ipv6ProcessPacket(&netInterface[i], (NetBuffer *) &buffer, 0,
-                     &ancillary);
-               }
+               //The incoming packet fits in a single chunk
+               buffer.chunkCount = 1;
+               buffer.maxChunkCount = 1;
+               buffer.chunk[0].address = packet;
+               buffer.chunk[0].length = (uint16_t) length;
+               buffer.chunk[0].size = 0;
+
+               //Process incoming IPv6 packet
+               ipv6ProcessPacket(&netInterface[i], (NetBuffer *) &buffer, 0,
+                  &ancillary);
             }
          }
-         else
-#endif
-         {
-            //Invalid version number
-         }
       }
       else
 #endif
-      //Unknown interface type?
       {
-         //Silently discard the received packet
+         //Invalid version number
       }
-
-      //Disable interrupts
-      interface->nicDriver->disableIrq(interface);
+   }
+   else
+#endif
+   //Unknown interface type?
+   {
+      //Silently discard the received packet
    }
 }
 
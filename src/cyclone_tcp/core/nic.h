@@ -55,6 +55,13 @@
    #error NIC_CONTEXT_SIZE parameter is not valid
 #endif
 
+//Maximum number of frames retrieved at a time from burst-capable drivers
+#ifndef NIC_RX_BURST_SIZE
+   #define NIC_RX_BURST_SIZE 16
+#elif (NIC_RX_BURST_SIZE < 1)
+   #error NIC_RX_BURST_SIZE parameter is not valid
+#endif
+
 //Serial Management Interface
 #define SMI_SYNC         0xFFFFFFFF
 #define SMI_START        1
@@ -120,6 +127,17 @@ typedef enum
 } NicDuplexMode;
 
 
+/**
+ * @brief Received frame descriptor
+ **/
+
+typedef struct
+{
+   uint8_t *data; ///<Frame contents, owned by the driver
+   size_t length; ///<Length of the frame, in bytes
+} NicRxDesc;
+
+
 //NIC abstraction layer
 typedef error_t (*NicInit)(NetInterface *interface);
 typedef void (*NicTick)(NetInterface *interface);
@@ -130,6 +148,12 @@ typedef void (*NicEventHandler)(NetInterface *interface);
 typedef error_t (*NicSendPacket)(NetInterface *interface,
    const NetBuffer *buffer, size_t offset);
 
+typedef uint_t (*NicReceiveBurst)(NetInterface *interface,
+   NicRxDesc *desc, uint_t count);
+
+typedef error_t (*NicSendTso)(NetInterface *interface,
+   const NetBuffer *buffer, size_t offset, size_t mss);
+
 typedef error_t (*NicUpdateMacAddrFilter)(NetInterface *interface);
 typedef error_t (*NicUpdateMacConfig)(NetInterface *interface);
 
@@ -204,6 +228,8 @@ typedef struct
    //bool_t autoTcpChecksumVerif;
    //bool_t autoUdpChecksumCalc;
    //bool_t autoUdpChecksumVerif;
+   NicReceiveBurst receiveBurst;
+   NicSendTso sendTso;
 } NicDriver;
 
 
@@ -280,8 +306,16 @@ void nicTick(NetInterface *interface);
 error_t nicSendPacket(NetInterface *interface, const NetBuffer *buffer,
    size_t offset);
 
+error_t nicSendTso(NetInterface *interface, const NetBuffer *buffer,
+   size_t offset, size_t mss);
+
 error_t nicUpdateMacAddrFilter(NetInterface *interface);
 void nicProcessPacket(NetInterface *interface, uint8_t *packet, size_t length);
+void nicReceiveBurst(NetInterface *interface);
+void nicProcessBurst(NetInterface *interface, const NicRxDesc *desc,
+   uint_t count);
+void nicDispatchPacket(NetInterface *interface, uint8_t *packet,
+   size_t length);
 void nicNotifyLinkChange(NetInterface *interface);
 
 //C++ guard
@@ -40,6 +40,7 @@
 #include <string.h>
 #include "core/net.h"
 #include "core/socket.h"
+#include "core/socket_event_set.h"
 #include "core/raw_socket.h"
 #include "core/ethernet_misc.h"
 #include "ipv4/ipv4.h"
@@ -167,6 +168,9 @@ error_t rawSocketProcessIpPacket(NetInterface *interface,
    if(i >= SOCKET_MAX_COUNT)
       return ERROR_PROTOCOL_UNREACHABLE;
 
+   //Get exclusive access to the matching socket
+   SOCKET_LOCK(socket);
+
    //Empty receive queue?
    if(!socket->receiveQueue)
    {
@@ -201,7 +205,11 @@ error_t rawSocketProcessIpPacket(NetInterface *interface,
 
       //Make sure the receive queue is not full
       if(i >= RAW_SOCKET_RX_QUEUE_SIZE)
+      {
+         //Release exclusive access
+         SOCKET_UNLOCK(socket);
          return ERROR_RECEIVE_QUEUE_FULL;
+      }
 
       //Allocate a memory buffer to hold the data and the associated descriptor
       p = netBufferAlloc(sizeof(SocketQueueItem) + length);
@@ -224,7 +232,11 @@ error_t rawSocketProcessIpPacket(NetInterface *interface,
 
    //Failed to allocate memory?
    if(queueItem == NULL)
+   {
+      //Release exclusive access
+      SOCKET_UNLOCK(socket);
       return ERROR_OUT_OF_MEMORY;
+   }
 
    //Initialize next field
    queueItem->next = NULL;
@@ -266,6 +278,8 @@ error_t rawSocketProcessIpPacket(NetInterface *interface,
 
    //Notify user that data is available
    rawSocketUpdateEvents(socket);
+   //Release exclusive access
+   SOCKET_UNLOCK(socket);
 
    //Successful processing
    return NO_ERROR;
@@ -329,6 +343,9 @@ void rawSocketProcessEthPacket(NetInterface *interface, EthHeader *header,
    if(i >= SOCKET_MAX_COUNT)
       return;
 
+   //Get exclusive access to the matching socket
+   SOCKET_LOCK(socket);
+
    //Empty receive queue?
    if(!socket->receiveQueue)
    {
@@ -363,7 +380,11 @@ void rawSocketProcessEthPacket(NetInterface *interface, EthHeader *header,
 
       //Make sure the receive queue is not full
       if(i >= RAW_SOCKET_RX_QUEUE_SIZE)
+      {
+         //Release exclusive access
+         SOCKET_UNLOCK(socket);
          return;
+      }
 
       //Allocate a memory buffer to hold the data and the associated descriptor
       p = netBufferAlloc(sizeof(SocketQueueItem) + sizeof(EthHeader) + length);
@@ -386,7 +407,11 @@ void rawSocketProcessEthPacket(NetInterface *interface, EthHeader *header,
 
    //Failed to allocate memory?
    if(queueItem == NULL)
+   {
+      //Release exclusive access
+      SOCKET_UNLOCK(socket);
       return;
+   }
 
    //Initialize next field
    queueItem->next = NULL;
@@ -411,6 +436,8 @@ void rawSocketProcessEthPacket(NetInterface *interface, EthHeader *header,
 
    //Notify user that data is available
    rawSocketUpdateEvents(socket);
+   //Release exclusive access
+   SOCKET_UNLOCK(socket);
 }
 
 
@@ -697,12 +724,8 @@ error_t rawSocketReceiveIpPacket(Socket *socket, IpAddr *srcIpAddr,
          //Reset the event object
          osResetEvent(&socket->event);
 
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
          //Wait until an event is triggered
-         osWaitForEvent(&socket->event, socket->timeout);
-         //Get exclusive access
-         osAcquireMutex(&netMutex);
+         socketWaitForEvent(socket, socket->timeout);
       }
    }
 
@@ -772,12 +795,8 @@ error_t rawSocketReceiveEthPacket(Socket *socket, void *data, size_t size,
          //Reset the event object
          osResetEvent(&socket->event);
 
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
          //Wait until an event is triggered
-         osWaitForEvent(&socket->event, socket->timeout);
-         //Get exclusive access
-         osAcquireMutex(&netMutex);
+         socketWaitForEvent(socket, socket->timeout);
       }
    }
 
@@ -837,6 +856,11 @@ void rawSocketUpdateEvents(Socket *socket)
          socket->eventFlags |= SOCKET_EVENT_LINK_DOWN;
    }
 
+#if (SOCKET_EVENT_SET_SUPPORT == ENABLED)
+   //Report the events monitored through an event set
+   socketEventSetNotify(socket, socket->eventFlags);
+#endif
+
    //Mask unused events
    socket->eventFlags &= socket->eventMask;
 
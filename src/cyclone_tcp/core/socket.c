@@ -39,6 +39,9 @@
 #include "core/udp.h"
 #include "core/tcp.h"
 #include "core/tcp_misc.h"
+#include "core/tcp_timer.h"
+#include "core/tcp_congest.h"
+#include "core/socket_event_set.h"
 #include "dns/dns_client.h"
 #include "mdns/mdns_client.h"
 #include "netbios/nbns_client.h"
@@ -48,6 +51,22 @@
 //Socket table
 Socket socketTable[SOCKET_MAX_COUNT];
 
+#if (SOCKET_HASH_SUPPORT == ENABLED)
+//Hash table of connected sockets
+static Socket *socketConnHashTable[SOCKET_HASH_TABLE_SIZE];
+//Hash table of listening and unconnected sockets
+static Socket *socketListenHashTable[SOCKET_HASH_TABLE_SIZE];
+//Next socket in the same hash chain
+static Socket *socketHashNext[SOCKET_MAX_COUNT];
+//Bucket the socket is currently linked to
+static Socket **socketHashBucket[SOCKET_MAX_COUNT];
+#endif
+
+//Lookup cache used while a burst of frames is being processed
+static bool_t socketLookupCacheEnabled;
+//TCP socket that matched the previous segment
+static Socket *socketLookupCache;
+
 
 /**
  * @brief Socket related initialization
@@ -62,6 +81,14 @@ error_t socketInit(void)
    //Initialize socket descriptors
    osMemset(socketTable, 0, sizeof(socketTable));
 
+#if (SOCKET_HASH_SUPPORT == ENABLED)
+   //Clear hash tables
+   osMemset(socketConnHashTable, 0, sizeof(socketConnHashTable));
+   osMemset(socketListenHashTable, 0, sizeof(socketListenHashTable));
+   osMemset(socketHashNext, 0, sizeof(socketHashNext));
+   osMemset(socketHashBucket, 0, sizeof(socketHashBucket));
+#endif
+
    //Loop through socket descriptors
    for(i = 0; i < SOCKET_MAX_COUNT; i++)
    {
@@ -73,13 +100,38 @@ error_t socketInit(void)
       {
          //Clean up side effects
          for(j = 0; j < i; j++)
+         {
+            osDeleteEvent(&socketTable[j].event);
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+            osDeleteMutex(&socketTable[j].mutex);
+#endif
+         }
+
+         //Report an error
+         return ERROR_OUT_OF_RESOURCES;
+      }
+
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+      //Create a mutex to protect the socket
+      if(!osCreateMutex(&socketTable[i].mutex))
+      {
+         //Clean up side effects
+         for(j = 0; j < i; j++)
+            osDeleteMutex(&socketTable[j].mutex);
+         for(j = 0; j <= i; j++)
             osDeleteEvent(&socketTable[j].event);
 
          //Report an error
          return ERROR_OUT_OF_RESOURCES;
       }
+#endif
    }
 
+#if (SOCKET_EVENT_SET_SUPPORT == ENABLED)
+   //Initialize event sets
+   socketEventSetInit();
+#endif
+
    //Successful initialization
    return NO_ERROR;
 }
@@ -99,6 +151,9 @@ Socket *socketOpen(uint_t type, uint_t protocol)
    uint16_t port;
    Socket *socket;
    OsEvent event;
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+   OsMutex mutex;
+#endif
 
    //Initialize socket handle
    socket = NULL;
@@ -181,11 +236,19 @@ Socket *socketOpen(uint_t type, uint_t protocol)
          i = socket->descriptor;
          //Save event object instance
          osMemcpy(&event, &socket->event, sizeof(OsEvent));
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+         //Save mutex instance
+         osMemcpy(&mutex, &socket->mutex, sizeof(OsMutex));
+#endif
 
          //Clear associated structure
          osMemset(socket, 0, sizeof(Socket));
          //Reuse event objects and avoid recreating them whenever possible
          osMemcpy(&socket->event, &event, sizeof(OsEvent));
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+         //The mutex is reused as well
+         osMemcpy(&socket->mutex, &mutex, sizeof(OsMutex));
+#endif
 
          //Save socket characteristics
          socket->descriptor = i;
@@ -194,6 +257,9 @@ Socket *socketOpen(uint_t type, uint_t protocol)
          socket->localPort = port;
          socket->timeout = INFINITE_DELAY;
 
+         //Index the socket by local port
+         socketUpdateHash(socket);
+
 #if (ETH_VLAN_SUPPORT == ENABLED)
          //Default VLAN PCP and DEI fields
          socket->vlanPcp = -1;
@@ -211,6 +277,16 @@ Socket *socketOpen(uint_t type, uint_t protocol)
          socket->txBufferSize = MIN(TCP_DEFAULT_TX_BUFFER_SIZE, TCP_MAX_TX_BUFFER_SIZE);
          socket->rxBufferSize = MIN(TCP_DEFAULT_RX_BUFFER_SIZE, TCP_MAX_RX_BUFFER_SIZE);
 #endif
+
+#if (TCP_SUPPORT == ENABLED && TCP_DELAYED_ACK_SUPPORT == ENABLED)
+         //Delayed ACKs are enabled by default
+         socket->delayedAckEnabled = TRUE;
+#endif
+
+#if (TCP_SUPPORT == ENABLED && TCP_PACING_SUPPORT == ENABLED)
+         //Default pacing rate
+         socket->pacingRate = TCP_DEFAULT_PACING_RATE;
+#endif
       }
    }
 
@@ -236,11 +312,11 @@ error_t socketSetTimeout(Socket *socket, systime_t timeout)
       return ERROR_INVALID_PARAMETER;
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(socket, FALSE);
    //Record timeout value
    socket->timeout = timeout;
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //No error to report
    return NO_ERROR;
@@ -261,11 +337,11 @@ error_t socketSetTtl(Socket *socket, uint8_t ttl)
       return ERROR_INVALID_PARAMETER;
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(socket, FALSE);
    //Set TTL value
    socket->ttl = ttl;
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //No error to report
    return NO_ERROR;
@@ -286,11 +362,11 @@ error_t socketSetMulticastTtl(Socket *socket, uint8_t ttl)
       return ERROR_INVALID_PARAMETER;
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(socket, FALSE);
    //Set TTL value
    socket->multicastTtl = ttl;
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //No error to report
    return NO_ERROR;
@@ -312,14 +388,14 @@ error_t socketSetVlanPcp(Socket *socket, uint8_t pcp)
       return ERROR_INVALID_PARAMETER;
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(socket, FALSE);
 
    //The PCP field specifies the frame priority level. Different PCP values
    //can be used to prioritize different classes of traffic
    socket->vlanPcp = pcp;
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //No error to report
    return NO_ERROR;
@@ -345,14 +421,14 @@ error_t socketSetVlanDei(Socket *socket, bool_t dei)
       return ERROR_INVALID_PARAMETER;
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(socket, FALSE);
 
    //The DEI flag may be used to indicate frames eligible to be dropped in
    //the presence of congestion
    socket->vlanDei = dei;
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //No error to report
    return NO_ERROR;
@@ -378,14 +454,14 @@ error_t socketSetVmanPcp(Socket *socket, uint8_t pcp)
       return ERROR_INVALID_PARAMETER;
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(socket, FALSE);
 
    //The PCP field specifies the frame priority level. Different PCP values
    //can be used to prioritize different classes of traffic
    socket->vmanPcp = pcp;
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //No error to report
    return NO_ERROR;
@@ -411,14 +487,14 @@ error_t socketSetVmanDei(Socket *socket, bool_t dei)
       return ERROR_INVALID_PARAMETER;
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(socket, FALSE);
 
    //The DEI flag may be used to indicate frames eligible to be dropped in
    //the presence of congestion
    socket->vmanDei = dei;
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //No error to report
    return NO_ERROR;
@@ -497,6 +573,115 @@ error_t socketSetRxBufferSize(Socket *socket, size_t size)
 }
 
 
+/**
+ * @brief Select the congestion control algorithm
+ * @param[in] socket Handle to a socket
+ * @param[in] algo Congestion control algorithm (Reno, CUBIC or BBR)
+ * @return Error code
+ **/
+
+error_t socketSetCongestControl(Socket *socket, TcpCongestAlgo algo)
+{
+#if (TCP_SUPPORT == ENABLED && TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+   error_t error;
+
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //This function shall be used with connection-oriented socket types
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
+
+   //Get exclusive access
+   socketAcquireMutex(socket, FALSE);
+   //Switch to the specified algorithm
+   error = tcpSetCongestAlgo(socket, algo);
+   //Release exclusive access
+   socketReleaseMutex(socket);
+
+   //Return status code
+   return error;
+#else
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Enable or disable delayed ACKs
+ * @param[in] socket Handle to a socket
+ * @param[in] enabled If FALSE, every data segment is acknowledged immediately
+ * @return Error code
+ **/
+
+error_t socketSetDelayedAck(Socket *socket, bool_t enabled)
+{
+#if (TCP_SUPPORT == ENABLED && TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //This function shall be used with connection-oriented socket types
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
+
+   //Get exclusive access
+   socketAcquireMutex(socket, FALSE);
+   //Enable or disable delayed ACKs
+   socket->delayedAckEnabled = enabled;
+   //Release exclusive access
+   socketReleaseMutex(socket);
+
+   //No error to report
+   return NO_ERROR;
+#else
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Set the pacing rate of a connection
+ * @param[in] socket Handle to a socket
+ * @param[in] rate Pacing rate, in bytes per second. 0 disables pacing and
+ *   TCP_PACING_RATE_AUTO derives the rate from the congestion window and
+ *   the smoothed RTT
+ * @return Error code
+ **/
+
+error_t socketSetPacingRate(Socket *socket, uint32_t rate)
+{
+#if (TCP_SUPPORT == ENABLED && TCP_PACING_SUPPORT == ENABLED)
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //This function shall be used with connection-oriented socket types
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
+
+   //Get exclusive access
+   socketAcquireMutex(socket, TRUE);
+
+   //Save the pacing rate
+   socket->pacingRate = rate;
+
+   //Segments held back at the previous rate are sent at the new rate
+   if(tcpTimerRunning(&socket->pacingTimer))
+      tcpTimerStart(&socket->pacingTimer, 0);
+
+   //Release exclusive access
+   socketReleaseMutex(socket);
+
+   //No error to report
+   return NO_ERROR;
+#else
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
 /**
  * @brief Bind a socket to a particular network interface
  * @param[in] socket Handle to a socket
@@ -556,9 +741,17 @@ error_t socketBind(Socket *socket, const IpAddr *localIpAddr, uint16_t localPort
    if(socket->type != SOCKET_TYPE_STREAM && socket->type != SOCKET_TYPE_DGRAM)
       return ERROR_INVALID_SOCKET;
 
+   //Get exclusive access
+   socketAcquireMutex(socket, TRUE);
+
    //Associate the specified IP address and port number
    socket->localIpAddr = *localIpAddr;
    socket->localPort = localPort;
+   //Update the position of the socket in the hash tables
+   socketUpdateHash(socket);
+
+   //Release exclusive access
+   socketReleaseMutex(socket);
 
    //No error to report
    return NO_ERROR;
@@ -586,22 +779,31 @@ error_t socketConnect(Socket *socket, const IpAddr *remoteIpAddr, uint16_t remot
    if(socket->type == SOCKET_TYPE_STREAM)
    {
       //Get exclusive access
-      osAcquireMutex(&netMutex);
+      socketAcquireMutex(socket, TRUE);
 
       //Establish TCP connection
       error = tcpConnect(socket, remoteIpAddr, remotePort);
 
       //Release exclusive access
-      osReleaseMutex(&netMutex);
+      socketReleaseMutex(socket);
    }
    else
 #endif
    //Connectionless socket?
    if(socket->type == SOCKET_TYPE_DGRAM)
    {
+      //Get exclusive access
+      socketAcquireMutex(socket, TRUE);
+
       //Save port number and IP address of the remote host
       socket->remoteIpAddr = *remoteIpAddr;
       socket->remotePort = remotePort;
+      //Update the position of the socket in the hash tables
+      socketUpdateHash(socket);
+
+      //Release exclusive access
+      socketReleaseMutex(socket);
+
       //No error to report
       error = NO_ERROR;
    }
@@ -649,13 +851,13 @@ error_t socketListen(Socket *socket, uint_t backlog)
       return ERROR_INVALID_SOCKET;
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(socket, TRUE);
 
    //Start listening for an incoming connection
    error = tcpListen(socket, backlog);
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //Return status code
    return error;
@@ -740,8 +942,9 @@ error_t socketSendTo(Socket *socket, const IpAddr *destIpAddr, uint16_t destPort
    if(socket == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //Get exclusive access
-   osAcquireMutex(&netMutex);
+   //Get exclusive access. TCP data is copied to the send buffer without
+   //holding the netMutex, whereas datagrams are sent right away
+   socketAcquireMutex(socket, socket->type != SOCKET_TYPE_STREAM);
 
 #if (TCP_SUPPORT == ENABLED)
    //Connection-oriented socket?
@@ -784,7 +987,7 @@ error_t socketSendTo(Socket *socket, const IpAddr *destIpAddr, uint16_t destPort
    }
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //Return status code
    return error;
@@ -792,86 +995,138 @@ error_t socketSendTo(Socket *socket, const IpAddr *destIpAddr, uint16_t destPort
 
 
 /**
- * @brief Receive data from a connected socket
- * @param[in] socket Handle that identifies a connected socket
- * @param[out] data Buffer where to store the incoming data
- * @param[in] size Maximum number of bytes that can be received
- * @param[out] received Number of bytes that have been received
- * @param[in] flags Set of flags that influences the behavior of this function
- * @return Error code
+ * @brief Allocate a buffer to be filled in place and passed to socketSendBuffer
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] length Number of data bytes to allocate
+ * @param[out] offset Offset to the first data byte
+ * @return Pointer to the allocated buffer, or NULL on failure
  **/
 
-error_t socketReceive(Socket *socket, void *data,
-   size_t size, size_t *received, uint_t flags)
+NetBuffer *socketAllocTxBuffer(Socket *socket, size_t length, size_t *offset)
 {
-   //For connection-oriented sockets, source and destination addresses are no use
-   return socketReceiveEx(socket, NULL, NULL, NULL, data, size, received, flags);
+   NetBuffer *buffer;
+
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return NULL;
+
+#if (TCP_SUPPORT == ENABLED)
+   //Connection-oriented socket?
+   if(socket->type == SOCKET_TYPE_STREAM)
+   {
+      //TCP headers are built separately, so the whole buffer holds data
+      buffer = netBufferAlloc(length);
+      *offset = 0;
+   }
+   else
+#endif
+#if (UDP_SUPPORT == ENABLED)
+   //Connectionless socket?
+   if(socket->type == SOCKET_TYPE_DGRAM)
+   {
+      //Reserve room for the UDP header and the lower layer headers
+      buffer = udpAllocBuffer(length, offset);
+   }
+   else
+#endif
+   //Socket type not supported...
+   {
+      //Raw sockets do not support zero-copy transmission
+      buffer = NULL;
+   }
+
+   //Return a pointer to the allocated buffer
+   return buffer;
 }
 
 
 /**
- * @brief Receive a datagram from a connectionless socket
- * @param[in] socket Handle that identifies a socket
- * @param[out] srcIpAddr Source IP address (optional)
- * @param[out] srcPort Source port number (optional)
- * @param[out] data Buffer where to store the incoming data
- * @param[in] size Maximum number of bytes that can be received
- * @param[out] received Number of bytes that have been received
+ * @brief Send the contents of a buffer to a connected socket
+ * @param[in] socket Handle that identifies a connected socket
+ * @param[in] buffer Buffer returned by socketAllocTxBuffer. The buffer is
+ *   always released by the stack, even if an error is returned
+ * @param[in] offset Offset to the first data byte
+ * @param[out] written Actual number of bytes written (optional parameter)
  * @param[in] flags Set of flags that influences the behavior of this function
  * @return Error code
  **/
 
-error_t socketReceiveFrom(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
-   void *data, size_t size, size_t *received, uint_t flags)
+error_t socketSendBuffer(Socket *socket, NetBuffer *buffer, size_t offset,
+   size_t *written, uint_t flags)
 {
-   //Destination address is no use
-   return socketReceiveEx(socket, srcIpAddr, srcPort, NULL, data, size, received, flags);
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+   {
+      //Release the buffer
+      if(buffer != NULL)
+         netBufferFree(buffer);
+
+      //Report an error
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //Use default remote IP address for connectionless sockets
+   return socketSendBufferTo(socket, &socket->remoteIpAddr,
+      socket->remotePort, buffer, offset, written, flags);
 }
 
 
 /**
- * @brief Receive a datagram
+ * @brief Send the contents of a buffer to a specific destination
+ *
+ * The data extends from the specified offset to the end of the buffer. TCP
+ * segments refer to the buffer until the data has been acknowledged, so that
+ * the payload is never copied (refer to TCP_ZERO_COPY_TX_SUPPORT), whereas a
+ * UDP datagram is built around the buffer itself
+ *
  * @param[in] socket Handle that identifies a socket
- * @param[out] srcIpAddr Source IP address (optional)
- * @param[out] srcPort Source port number (optional)
- * @param[out] destIpAddr Destination IP address (optional)
- * @param[out] data Buffer where to store the incoming data
- * @param[in] size Maximum number of bytes that can be received
- * @param[out] received Number of bytes that have been received
+ * @param[in] destIpAddr IP address of the target host
+ * @param[in] destPort Target port number
+ * @param[in] buffer Buffer returned by socketAllocTxBuffer. The buffer is
+ *   always released by the stack, even if an error is returned
+ * @param[in] offset Offset to the first data byte
+ * @param[out] written Actual number of bytes written (optional parameter)
  * @param[in] flags Set of flags that influences the behavior of this function
  * @return Error code
  **/
 
-error_t socketReceiveEx(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
-   IpAddr *destIpAddr, void *data, size_t size, size_t *received, uint_t flags)
+error_t socketSendBufferTo(Socket *socket, const IpAddr *destIpAddr,
+   uint16_t destPort, NetBuffer *buffer, size_t offset, size_t *written,
+   uint_t flags)
 {
    error_t error;
+   size_t length;
 
-   //Make sure the socket handle is valid
-   if(socket == NULL)
+   //No data has been transmitted yet
+   if(written)
+      *written = 0;
+
+   //Check parameters
+   if(buffer == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //Get exclusive access
-   osAcquireMutex(&netMutex);
+   //Retrieve the length of the buffer
+   length = netBufferGetLength(buffer);
+
+   //Make sure the socket handle and the offset are valid
+   if(socket == NULL || offset > length)
+   {
+      //Release the buffer
+      netBufferFree(buffer);
+      //Report an error
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //Get exclusive access. TCP data is queued without holding the netMutex,
+   //whereas datagrams are sent right away
+   socketAcquireMutex(socket, socket->type != SOCKET_TYPE_STREAM);
 
 #if (TCP_SUPPORT == ENABLED)
    //Connection-oriented socket?
    if(socket->type == SOCKET_TYPE_STREAM)
    {
-      //Receive data
-      error = tcpReceive(socket, data, size, received, flags);
-
-      //Save the source IP address
-      if(srcIpAddr != NULL)
-         *srcIpAddr = socket->remoteIpAddr;
-
-      //Save the source port number
-      if(srcPort != NULL)
-         *srcPort = socket->remotePort;
-
-      //Save the destination IP address
-      if(destIpAddr != NULL)
-         *destIpAddr = socket->localIpAddr;
+      //The TCP layer takes ownership of the buffer
+      error = tcpSendBuffer(socket, buffer, offset, written, flags);
    }
    else
 #endif
@@ -879,389 +1134,1400 @@ error_t socketReceiveEx(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
    //Connectionless socket?
    if(socket->type == SOCKET_TYPE_DGRAM)
    {
-      //Receive UDP datagram
-      error = udpReceiveDatagram(socket, srcIpAddr,
-         srcPort, destIpAddr, data, size, received, flags);
-   }
-   else
-#endif
-#if (RAW_SOCKET_SUPPORT == ENABLED)
-   //Raw socket?
-   if(socket->type == SOCKET_TYPE_RAW_IP)
-   {
-      //Receive a raw IP packet
-      error = rawSocketReceiveIpPacket(socket,
-         srcIpAddr, destIpAddr, data, size, received, flags);
-   }
-   else if(socket->type == SOCKET_TYPE_RAW_ETH)
-   {
-      //Receive a raw Ethernet packet
-      error = rawSocketReceiveEthPacket(socket, data, size, received, flags);
+      //Send UDP datagram
+      error = udpSendBuffer(socket, destIpAddr, destPort, buffer, offset,
+         flags);
+
+      //Total number of data bytes successfully transmitted
+      if(!error && written != NULL)
+         *written = length - offset;
+
+      //Release the buffer
+      netBufferFree(buffer);
    }
    else
 #endif
    //Socket type not supported...
    {
-      //No data can be read
-      *received = 0;
+      //Release the buffer
+      netBufferFree(buffer);
       //Invalid socket type
       error = ERROR_INVALID_SOCKET;
    }
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //Return status code
    return error;
 }
 
 
+#if (SOCKET_SEND_FILE_SUPPORT == ENABLED)
+
 /**
- * @brief Retrieve the local address for a given socket
- * @param[in] socket Handle that identifies a socket
- * @param[out] localIpAddr Local IP address (optional)
- * @param[out] localPort Local port number (optional)
+ * @brief Send the contents of a file to a connected socket
+ *
+ * The file is read straight into transmit buffers, which are then handed
+ * over to the TCP layer without any intermediate copy. The file pointer is
+ * not used, so that a partial transfer can be resumed at offset + written
+ *
+ * @param[in] socket Handle that identifies a connected socket
+ * @param[in] file Handle that identifies the file to be sent
+ * @param[in] offset Position of the first byte to send, in the file
+ * @param[in] length Number of bytes to send
+ * @param[out] written Actual number of bytes written (optional parameter)
+ * @param[in] flags Set of flags that influences the behavior of this function
  * @return Error code
  **/
 
-error_t socketGetLocalAddr(Socket *socket, IpAddr *localIpAddr, uint16_t *localPort)
+error_t socketSendFile(Socket *socket, FsFile *file, uint32_t offset,
+   size_t length, size_t *written, uint_t flags)
 {
-   //Make sure the socket handle is valid
-   if(socket == NULL)
+   error_t error;
+   uint_t i;
+   size_t k;
+   size_t m;
+   size_t n;
+   size_t bufferOffset;
+   NetBuffer *buffer;
+
+   //No data has been transmitted yet
+   if(written)
+      *written = 0;
+
+   //Check parameters
+   if(socket == NULL || file == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //Retrieve local IP address
-   if(localIpAddr != NULL)
-      *localIpAddr = socket->localIpAddr;
+   //Only connection-oriented sockets are supported
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
 
-   //Retrieve local port number
-   if(localPort != NULL)
-      *localPort = socket->localPort;
+   //Initialize status code
+   error = NO_ERROR;
 
-   //Successful processing
-   return NO_ERROR;
+   //Send as much data as possible
+   while(length > 0 && !error)
+   {
+      //Number of bytes to read at a time
+      n = MIN(length, SOCKET_SEND_FILE_BATCH_SIZE);
+
+#if (TCP_SUPPORT == ENABLED)
+      //Get exclusive access
+      socketAcquireMutex(socket, FALSE);
+
+      //Check whether the connection accepts data
+      if(socket->state == TCP_STATE_ESTABLISHED ||
+         socket->state == TCP_STATE_CLOSE_WAIT)
+      {
+         //Determine the actual number of bytes in the send buffer
+         m = socket->sndUser + socket->sndNxt - socket->sndUna;
+         //Number of bytes available for writing
+         m = (m < socket->txBufferSize) ? socket->txBufferSize - m : 0;
+      }
+      else
+      {
+         //The TCP layer reports the appropriate error
+         m = n;
+      }
+
+      //Release exclusive access
+      socketReleaseMutex(socket);
+
+      //The send buffer is full and the socket operates in non-blocking mode?
+      if(m == 0 && socket->timeout == 0)
+      {
+         //Report a timeout error without reading the file
+         error = ERROR_TIMEOUT;
+         break;
+      }
+
+      //Do not read more than the send buffer can take. Any data that the
+      //TCP layer does not accept would have to be read again by the next call
+      if(m > 0)
+         n = MIN(n, m);
+#endif
+
+      //Allocate a transmit buffer (no room is reserved for headers)
+      buffer = socketAllocTxBuffer(socket, n, &bufferOffset);
+      //Failed to allocate memory?
+      if(buffer == NULL)
+      {
+         //Report an error
+         error = ERROR_OUT_OF_MEMORY;
+         break;
+      }
+
+      //Read the file contents directly into the chunks of the buffer
+      for(k = 0, i = 0; k < n && i < buffer->chunkCount; i++)
+      {
+         //Fill the current chunk
+         error = fsReadFileAt(file, offset + k, buffer->chunk[i].address,
+            buffer->chunk[i].length, &m);
+
+         //Total number of bytes read so far
+         k += m;
+
+         //Stop on error or short read
+         if(error || m < buffer->chunk[i].length)
+            break;
+      }
+
+      //Nothing has been read?
+      if(k == 0)
+      {
+         //Release the buffer
+         netBufferFree(buffer);
+
+         //Report an error (the end of the file has been reached if the
+         //transfer is incomplete)
+         if(!error)
+            error = ERROR_END_OF_FILE;
+
+         //Exit immediately
+         break;
+      }
+
+      //The file turned out to be shorter than expected?
+      if(k < n)
+      {
+         //Send the data that have been read and stop. The next call will
+         //report the end of the file
+         length = k;
+         error = NO_ERROR;
+      }
+
+      //Adjust the length of the buffer
+      netBufferSetLength(buffer, k);
+
+      //The TCP layer takes ownership of the buffer
+      error = socketSendBuffer(socket, buffer, 0, &m, flags);
+
+      //Advance data pointer
+      offset += m;
+      length -= m;
+
+      //Total number of data that have been written
+      if(written)
+         *written += m;
+
+      //Partial write?
+      if(!error && m < k)
+         break;
+   }
+
+   //Return status code
+   return error;
 }
 
+#endif
+
 
 /**
- * @brief Retrieve the address of the peer to which a socket is connected
+ * @brief Receive data from a connected socket
+ * @param[in] socket Handle that identifies a connected socket
+ * @param[out] data Buffer where to store the incoming data
+ * @param[in] size Maximum number of bytes that can be received
+ * @param[out] received Number of bytes that have been received
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t socketReceive(Socket *socket, void *data,
+   size_t size, size_t *received, uint_t flags)
+{
+   //For connection-oriented sockets, source and destination addresses are no use
+   return socketReceiveEx(socket, NULL, NULL, NULL, data, size, received, flags);
+}
+
+
+/**
+ * @brief Receive a datagram from a connectionless socket
  * @param[in] socket Handle that identifies a socket
- * @param[out] remoteIpAddr IP address of the remote host (optional)
- * @param[out] remotePort Remote port number (optional)
+ * @param[out] srcIpAddr Source IP address (optional)
+ * @param[out] srcPort Source port number (optional)
+ * @param[out] data Buffer where to store the incoming data
+ * @param[in] size Maximum number of bytes that can be received
+ * @param[out] received Number of bytes that have been received
+ * @param[in] flags Set of flags that influences the behavior of this function
  * @return Error code
  **/
 
-error_t socketGetRemoteAddr(Socket *socket, IpAddr *remoteIpAddr, uint16_t *remotePort)
+error_t socketReceiveFrom(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
+   void *data, size_t size, size_t *received, uint_t flags)
+{
+   //Destination address is no use
+   return socketReceiveEx(socket, srcIpAddr, srcPort, NULL, data, size, received, flags);
+}
+
+
+/**
+ * @brief Receive a datagram
+ * @param[in] socket Handle that identifies a socket
+ * @param[out] srcIpAddr Source IP address (optional)
+ * @param[out] srcPort Source port number (optional)
+ * @param[out] destIpAddr Destination IP address (optional)
+ * @param[out] data Buffer where to store the incoming data
+ * @param[in] size Maximum number of bytes that can be received
+ * @param[out] received Number of bytes that have been received
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t socketReceiveEx(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
+   IpAddr *destIpAddr, void *data, size_t size, size_t *received, uint_t flags)
 {
+   error_t error;
+
    //Make sure the socket handle is valid
    if(socket == NULL)
       return ERROR_INVALID_PARAMETER;
 
-   //Retrieve local IP address
-   if(remoteIpAddr != NULL)
-      *remoteIpAddr = socket->remoteIpAddr;
+   //Get exclusive access
+   socketAcquireMutex(socket, FALSE);
 
-   //Retrieve local port number
-   if(remotePort != NULL)
-      *remotePort = socket->remotePort;
+#if (TCP_SUPPORT == ENABLED)
+   //Connection-oriented socket?
+   if(socket->type == SOCKET_TYPE_STREAM)
+   {
+      //Receive data
+      error = tcpReceive(socket, data, size, received, flags);
 
-   //Successful processing
-   return NO_ERROR;
+      //Save the source IP address
+      if(srcIpAddr != NULL)
+         *srcIpAddr = socket->remoteIpAddr;
+
+      //Save the source port number
+      if(srcPort != NULL)
+         *srcPort = socket->remotePort;
+
+      //Save the destination IP address
+      if(destIpAddr != NULL)
+         *destIpAddr = socket->localIpAddr;
+   }
+   else
+#endif
+#if (UDP_SUPPORT == ENABLED)
+   //Connectionless socket?
+   if(socket->type == SOCKET_TYPE_DGRAM)
+   {
+      //Receive UDP datagram
+      error = udpReceiveDatagram(socket, srcIpAddr,
+         srcPort, destIpAddr, data, size, received, flags);
+   }
+   else
+#endif
+#if (RAW_SOCKET_SUPPORT == ENABLED)
+   //Raw socket?
+   if(socket->type == SOCKET_TYPE_RAW_IP)
+   {
+      //Receive a raw IP packet
+      error = rawSocketReceiveIpPacket(socket,
+         srcIpAddr, destIpAddr, data, size, received, flags);
+   }
+   else if(socket->type == SOCKET_TYPE_RAW_ETH)
+   {
+      //Receive a raw Ethernet packet
+      error = rawSocketReceiveEthPacket(socket, data, size, received, flags);
+   }
+   else
+#endif
+   //Socket type not supported...
+   {
+      //No data can be read
+      *received = 0;
+      //Invalid socket type
+      error = ERROR_INVALID_SOCKET;
+   }
+
+   //Release exclusive access
+   socketReleaseMutex(socket);
+
+   //Return status code
+   return error;
 }
 
 
 /**
- * @brief Disable reception, transmission, or both
+ * @brief Loan the application a read-only view of received data
  *
- * Note that socketShutdown() does not close the socket, and resources attached
- * to the socket will not be freed until socketClose() is invoked
+ * The data is not copied to a user buffer. It must be released by calling
+ * socketReleaseLoan before any other receive operation is performed
  *
- * @param[in] socket Handle to a socket
- * @param[in] how Flag that describes what types of operation will no longer be allowed
+ * @param[in] socket Handle that identifies a socket
+ * @param[out] data Pointer to the first byte of the view
+ * @param[out] length Number of contiguous bytes in the view
+ * @param[in] flags Set of flags that influences the behavior of this function
  * @return Error code
  **/
 
-error_t socketShutdown(Socket *socket, uint_t how)
+error_t socketReceiveLoan(Socket *socket, const uint8_t **data,
+   size_t *length, uint_t flags)
+{
+   //For connection-oriented sockets, source address is no use
+   return socketReceiveLoanFrom(socket, NULL, NULL, data, length, flags);
+}
+
+
+/**
+ * @brief Loan the application a read-only view of received data
+ * @param[in] socket Handle that identifies a socket
+ * @param[out] srcIpAddr Source IP address (optional)
+ * @param[out] srcPort Source port number (optional)
+ * @param[out] data Pointer to the first byte of the view
+ * @param[out] length Number of contiguous bytes in the view
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t socketReceiveLoanFrom(Socket *socket, IpAddr *srcIpAddr,
+   uint16_t *srcPort, const uint8_t **data, size_t *length, uint_t flags)
 {
-#if (TCP_SUPPORT == ENABLED)
    error_t error;
 
-   //Make sure the socket handle is valid
-   if(socket == NULL)
-      return ERROR_INVALID_PARAMETER;
-   //Make sure the socket type is correct
-   if(socket->type != SOCKET_TYPE_STREAM)
-      return ERROR_INVALID_SOCKET;
-   //Check flags
-   if((how != SOCKET_SD_SEND) && (how != SOCKET_SD_RECEIVE) && (how != SOCKET_SD_BOTH))
+   //Check parameters
+   if(socket == NULL || data == NULL || length == NULL)
       return ERROR_INVALID_PARAMETER;
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(socket, FALSE);
+
+#if (TCP_SUPPORT == ENABLED && TCP_ZERO_COPY_RX_SUPPORT == ENABLED)
+   //Connection-oriented socket?
+   if(socket->type == SOCKET_TYPE_STREAM)
+   {
+      //Loan a view of the receive buffer
+      error = tcpReceiveLoan(socket, data, length, flags);
+
+      //Save the source IP address
+      if(srcIpAddr != NULL)
+         *srcIpAddr = socket->remoteIpAddr;
+
+      //Save the source port number
+      if(srcPort != NULL)
+         *srcPort = socket->remotePort;
+   }
+   else
+#endif
+#if (UDP_SUPPORT == ENABLED && UDP_ZERO_COPY_RX_SUPPORT == ENABLED)
+   //Connectionless socket?
+   if(socket->type == SOCKET_TYPE_DGRAM)
+   {
+      //Loan a view of the next datagram
+      error = udpReceiveLoan(socket, srcIpAddr, srcPort, data, length, flags);
+   }
+   else
+#endif
+   //Socket type not supported...
+   {
+      //Nothing can be loaned
+      *data = NULL;
+      *length = 0;
+      //Invalid socket type
+      error = ERROR_INVALID_SOCKET;
+   }
+
+   //Release exclusive access
+   socketReleaseMutex(socket);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Release data loaned by socketReceiveLoan
+ *
+ * For connection-oriented sockets, the specified number of bytes is removed
+ * from the receive buffer. For connectionless sockets, the whole datagram is
+ * discarded
+ *
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] length Number of bytes consumed by the application
+ * @return Error code
+ **/
+
+error_t socketReleaseLoan(Socket *socket, size_t length)
+{
+   error_t error;
+
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   socketAcquireMutex(socket, FALSE);
+
+#if (TCP_SUPPORT == ENABLED && TCP_ZERO_COPY_RX_SUPPORT == ENABLED)
+   //Connection-oriented socket?
+   if(socket->type == SOCKET_TYPE_STREAM)
+   {
+      //Consume the loaned data
+      error = tcpReleaseLoan(socket, length);
+   }
+   else
+#endif
+#if (UDP_SUPPORT == ENABLED && UDP_ZERO_COPY_RX_SUPPORT == ENABLED)
+   //Connectionless socket?
+   if(socket->type == SOCKET_TYPE_DGRAM)
+   {
+      //Discard the datagram
+      error = udpReleaseLoan(socket);
+   }
+   else
+#endif
+   //Socket type not supported...
+   {
+      //Invalid socket type
+      error = ERROR_INVALID_SOCKET;
+   }
+
+   //Release exclusive access
+   socketReleaseMutex(socket);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Retrieve the local address for a given socket
+ * @param[in] socket Handle that identifies a socket
+ * @param[out] localIpAddr Local IP address (optional)
+ * @param[out] localPort Local port number (optional)
+ * @return Error code
+ **/
+
+error_t socketGetLocalAddr(Socket *socket, IpAddr *localIpAddr, uint16_t *localPort)
+{
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Retrieve local IP address
+   if(localIpAddr != NULL)
+      *localIpAddr = socket->localIpAddr;
+
+   //Retrieve local port number
+   if(localPort != NULL)
+      *localPort = socket->localPort;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Retrieve the address of the peer to which a socket is connected
+ * @param[in] socket Handle that identifies a socket
+ * @param[out] remoteIpAddr IP address of the remote host (optional)
+ * @param[out] remotePort Remote port number (optional)
+ * @return Error code
+ **/
+
+error_t socketGetRemoteAddr(Socket *socket, IpAddr *remoteIpAddr, uint16_t *remotePort)
+{
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Retrieve local IP address
+   if(remoteIpAddr != NULL)
+      *remoteIpAddr = socket->remoteIpAddr;
+
+   //Retrieve local port number
+   if(remotePort != NULL)
+      *remotePort = socket->remotePort;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Disable reception, transmission, or both
+ *
+ * Note that socketShutdown() does not close the socket, and resources attached
+ * to the socket will not be freed until socketClose() is invoked
+ *
+ * @param[in] socket Handle to a socket
+ * @param[in] how Flag that describes what types of operation will no longer be allowed
+ * @return Error code
+ **/
+
+error_t socketShutdown(Socket *socket, uint_t how)
+{
+#if (TCP_SUPPORT == ENABLED)
+   error_t error;
+
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+   //Make sure the socket type is correct
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return ERROR_INVALID_SOCKET;
+   //Check flags
+   if((how != SOCKET_SD_SEND) && (how != SOCKET_SD_RECEIVE) && (how != SOCKET_SD_BOTH))
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   socketAcquireMutex(socket, TRUE);
+
+   //Graceful shutdown
+   error = tcpShutdown(socket, how);
+
+   //Release exclusive access
+   socketReleaseMutex(socket);
+
+   //Return status code
+   return error;
+#else
+   return ERROR_NOT_IMPLEMENTED;
+#endif
+}
+
+
+/**
+ * @brief Close an existing socket
+ * @param[in] socket Handle identifying the socket to close
+ **/
+
+void socketClose(Socket *socket)
+{
+   //Make sure the socket handle is valid
+   if(socket == NULL)
+      return;
+
+   //Get exclusive access
+   socketAcquireMutex(socket, TRUE);
+
+#if (SOCKET_EVENT_SET_SUPPORT == ENABLED)
+   //The socket can no longer be monitored once it has been closed
+   socketEventSetDetach(socket);
+#endif
+
+#if (TCP_SUPPORT == ENABLED)
+   //Connection-oriented socket?
+   if(socket->type == SOCKET_TYPE_STREAM)
+   {
+#if (TCP_ZERO_COPY_RX_SUPPORT == ENABLED)
+      //Any data loaned to the application is reclaimed
+      socket->rxLoanLength = 0;
+#endif
+      //Abort the current TCP connection
+      tcpAbort(socket);
+   }
+#endif
+#if (UDP_SUPPORT == ENABLED || RAW_SOCKET_SUPPORT == ENABLED)
+   //Connectionless socket or raw socket?
+   if(socket->type == SOCKET_TYPE_DGRAM ||
+      socket->type == SOCKET_TYPE_RAW_IP ||
+      socket->type == SOCKET_TYPE_RAW_ETH)
+   {
+      //Point to the first item in the receive queue
+      SocketQueueItem *queueItem = socket->receiveQueue;
+
+      //Purge the receive queue
+      while(queueItem)
+      {
+         //Keep track of the next item in the queue
+         SocketQueueItem *nextQueueItem = queueItem->next;
+         //Free previously allocated memory
+         memPoolFree(queueItem->buffer);
+         //Point to the next item
+         queueItem = nextQueueItem;
+      }
+
+#if (UDP_SUPPORT == ENABLED && UDP_ZERO_COPY_RX_SUPPORT == ENABLED)
+      //Any datagram loaned to the application is reclaimed
+      socket->rxLoanDatagram = FALSE;
+#endif
+
+      //Mark the socket as closed
+      socket->type = SOCKET_TYPE_UNUSED;
+      //Remove the socket from the hash tables
+      socketUpdateHash(socket);
+   }
+#endif
+
+   //Release exclusive access
+   socketReleaseMutex(socket);
+}
+
+
+/**
+ * @brief Wait for one of a set of sockets to become ready to perform I/O
+ *
+ * The socketPoll function determines the status of one or more sockets,
+ * waiting if necessary, to perform synchronous I/O
+ *
+ * @param[in,out] eventDesc Set of entries specifying the events the user is interested in
+ * @param[in] size Number of entries in the descriptor set
+ * @param[in] extEvent External event that can abort the wait if necessary (optional)
+ * @param[in] timeout Maximum time to wait before returning
+ * @return Error code
+ **/
+
+error_t socketPoll(SocketEventDesc *eventDesc, uint_t size, OsEvent *extEvent,
+   systime_t timeout)
+{
+   uint_t i;
+   bool_t status;
+   OsEvent *event;
+   OsEvent eventObject;
+
+   //Check parameters
+   if(eventDesc == NULL || size == 0)
+      return ERROR_INVALID_PARAMETER;
+
+   //Try to use the supplied event object to receive notifications
+   if(!extEvent)
+   {
+      //Create an event object only if necessary
+      if(!osCreateEvent(&eventObject))
+      {
+         //Report an error
+         return ERROR_OUT_OF_RESOURCES;
+      }
+
+      //Reference to the newly created event
+      event = &eventObject;
+   }
+   else
+   {
+      //Reference to the external event
+      event = extEvent;
+   }
+
+   //Loop through descriptors
+   for(i = 0; i < size; i++)
+   {
+      //Valid socket handle?
+      if(eventDesc[i].socket != NULL)
+      {
+         //Clear event flags
+         eventDesc[i].eventFlags = 0;
+         //Subscribe to the requested events
+         socketRegisterEvents(eventDesc[i].socket, event, eventDesc[i].eventMask);
+      }
+   }
+
+   //Block the current task until an event occurs
+   status = osWaitForEvent(event, timeout);
+
+   //Loop through descriptors
+   for(i = 0; i < size; i++)
+   {
+      //Valid socket handle?
+      if(eventDesc[i].socket != NULL)
+      {
+         //Any socket event in the signaled state?
+         if(status)
+         {
+            //Retrieve event flags for the current socket
+            eventDesc[i].eventFlags = socketGetEvents(eventDesc[i].socket);
+            //Clear unnecessary flags
+            eventDesc[i].eventFlags &= eventDesc[i].eventMask;
+         }
+
+         //Unsubscribe previously registered events
+         socketUnregisterEvents(eventDesc[i].socket);
+      }
+   }
+
+   //Reset event object
+   osResetEvent(event);
+
+   //Release previously allocated resources
+   if(!extEvent)
+      osDeleteEvent(&eventObject);
+
+   //Return status code
+   return status ? NO_ERROR : ERROR_TIMEOUT;
+}
+
+
+/**
+ * @brief Subscribe to the specified socket events
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] event Event object used to receive notifications
+ * @param[in] eventMask Logic OR of the requested socket events
+ **/
+
+void socketRegisterEvents(Socket *socket, OsEvent *event, uint_t eventMask)
+{
+   //Valid socket handle?
+   if(socket != NULL)
+   {
+      //Get exclusive access
+      socketAcquireMutex(socket, FALSE);
+
+      //An user event may have been previously registered...
+      if(socket->userEvent != NULL)
+         socket->eventMask |= eventMask;
+      else
+         socket->eventMask = eventMask;
+
+      //Suscribe to get notified of events
+      socket->userEvent = event;
+
+      //Check whether some of the requested events are already signaled
+      socketUpdateEvents(socket);
+
+      //Release exclusive access
+      socketReleaseMutex(socket);
+   }
+}
+
+
+/**
+ * @brief Unsubscribe previously registered events
+ * @param[in] socket Handle that identifies a socket
+ **/
+
+void socketUnregisterEvents(Socket *socket)
+{
+   //Valid socket handle?
+   if(socket != NULL)
+   {
+      //Get exclusive access
+      socketAcquireMutex(socket, FALSE);
+
+      //Unsuscribe socket events
+      socket->userEvent = NULL;
+
+      //Release exclusive access
+      socketReleaseMutex(socket);
+   }
+}
+
+
+/**
+ * @brief Retrieve event flags for a specified socket
+ * @param[in] socket Handle that identifies a socket
+ * @return Logic OR of events in the signaled state
+ **/
+
+uint_t socketGetEvents(Socket *socket)
+{
+   uint_t eventFlags;
+
+   //Valid socket handle?
+   if(socket != NULL)
+   {
+      //Get exclusive access
+      socketAcquireMutex(socket, FALSE);
+
+      //Read event flags for the specified socket
+      eventFlags = socket->eventFlags;
+
+      //Release exclusive access
+      socketReleaseMutex(socket);
+   }
+   else
+   {
+      //The socket handle is not valid
+      eventFlags = 0;
+   }
+
+   //Return the events in the signaled state
+   return eventFlags;
+}
+
+
+/**
+ * @brief Update the event flags of a socket
+ *
+ * The caller must hold exclusive access to the socket
+ *
+ * @param[in] socket Handle that identifies a socket
+ **/
+
+void socketUpdateEvents(Socket *socket)
+{
+#if (TCP_SUPPORT == ENABLED)
+   //Handle TCP specific events
+   if(socket->type == SOCKET_TYPE_STREAM)
+   {
+      tcpUpdateEvents(socket);
+   }
+#endif
+#if (UDP_SUPPORT == ENABLED)
+   //Handle UDP specific events
+   if(socket->type == SOCKET_TYPE_DGRAM)
+   {
+      udpUpdateEvents(socket);
+   }
+#endif
+#if (RAW_SOCKET_SUPPORT == ENABLED)
+   //Handle events that are specific to raw sockets
+   if(socket->type == SOCKET_TYPE_RAW_IP ||
+      socket->type == SOCKET_TYPE_RAW_ETH)
+   {
+      rawSocketUpdateEvents(socket);
+   }
+#endif
+}
+
+
+/**
+ * @brief Get exclusive access to a socket
+ *
+ * When fine-grained locking is disabled, all the sockets are protected by the
+ * netMutex. Otherwise the socket mutex is acquired, preceded by the netMutex
+ * when the caller also needs to access the socket table or the packet path
+ *
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] netLock The netMutex must be acquired as well
+ **/
+
+void socketAcquireMutex(Socket *socket, bool_t netLock)
+{
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+   //The netMutex must be acquired first
+   if(netLock)
+      osAcquireMutex(&netMutex);
+
+   //Get exclusive access to the socket
+   osAcquireMutex(&socket->mutex);
+   //Keep track of the locks held by the owner of the socket
+   socket->netLocked = netLock;
+#else
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+#endif
+}
+
+
+/**
+ * @brief Release exclusive access to a socket
+ * @param[in] socket Handle that identifies a socket
+ **/
+
+void socketReleaseMutex(Socket *socket)
+{
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+   bool_t netLocked;
+
+   //Check whether the netMutex is held as well
+   netLocked = socket->netLocked;
+   socket->netLocked = FALSE;
+
+   //Release exclusive access to the socket
+   osReleaseMutex(&socket->mutex);
+
+   //Release the netMutex last
+   if(netLocked)
+      osReleaseMutex(&netMutex);
+#else
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+#endif
+}
+
+
+/**
+ * @brief Acquire the netMutex on behalf of the owner of a socket
+ *
+ * The socket mutex is temporarily released in order to respect the lock
+ * ordering. The caller must therefore check the state of the socket again
+ *
+ * @param[in] socket Handle that identifies a socket
+ * @return TRUE if the netMutex has been acquired, FALSE if it was already held
+ **/
+
+bool_t socketAcquireNetMutex(Socket *socket)
+{
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+   //The netMutex is already held?
+   if(socket->netLocked)
+      return FALSE;
+
+   //Acquire the locks in the right order
+   osReleaseMutex(&socket->mutex);
+   osAcquireMutex(&netMutex);
+   osAcquireMutex(&socket->mutex);
+
+   //The owner of the socket now holds the netMutex
+   socket->netLocked = TRUE;
+   return TRUE;
+#else
+   //The netMutex is always held by the owner of the socket
+   return FALSE;
+#endif
+}
+
+
+/**
+ * @brief Release the netMutex previously acquired by socketAcquireNetMutex()
+ * @param[in] socket Handle that identifies a socket
+ **/
+
+void socketReleaseNetMutex(Socket *socket)
+{
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+   //The socket mutex is kept
+   if(socket->netLocked)
+   {
+      socket->netLocked = FALSE;
+      osReleaseMutex(&netMutex);
+   }
+#endif
+}
+
+
+/**
+ * @brief Wait for the event object of a socket to be signaled
+ *
+ * The locks held by the owner of the socket are released while waiting and
+ * acquired again before returning
+ *
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] timeout Maximum time to wait
+ **/
 
-   //Graceful shutdown
-   error = tcpShutdown(socket, how);
+void socketWaitForEvent(Socket *socket, systime_t timeout)
+{
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+   bool_t netLocked;
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   netLocked = socket->netLocked;
+   socketReleaseMutex(socket);
 
-   //Return status code
-   return error;
+   //Wait until an event is triggered
+   osWaitForEvent(&socket->event, timeout);
+
+   //Get exclusive access
+   socketAcquireMutex(socket, netLocked);
 #else
-   return ERROR_NOT_IMPLEMENTED;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+   //Wait until an event is triggered
+   osWaitForEvent(&socket->event, timeout);
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
 #endif
 }
 
 
 /**
- * @brief Close an existing socket
- * @param[in] socket Handle identifying the socket to close
+ * @brief Update the position of a socket in the lookup hash tables
+ *
+ * This function must be called whenever the type, the local port or the
+ * remote endpoint of a socket is modified, and when a TCP socket enters the
+ * LISTEN state. Connected sockets are indexed by local port, remote port and
+ * remote IP address, whereas the other sockets are indexed by local port only
+ *
+ * @param[in] socket Handle referencing the socket
  **/
 
-void socketClose(Socket *socket)
+void socketUpdateHash(Socket *socket)
 {
-   //Make sure the socket handle is valid
-   if(socket == NULL)
-      return;
+#if (SOCKET_HASH_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t n;
+   Socket **p;
+   Socket **bucket;
 
-   //Get exclusive access
-   osAcquireMutex(&netMutex);
+   //Index of the socket in the socket table
+   i = socket - socketTable;
 
-#if (TCP_SUPPORT == ENABLED)
-   //Connection-oriented socket?
-   if(socket->type == SOCKET_TYPE_STREAM)
+   //Remove the socket from the hash chain it currently belongs to
+   if(socketHashBucket[i] != NULL)
    {
-      //Abort the current TCP connection
-      tcpAbort(socket);
+      //Search the hash chain for the current socket
+      for(p = socketHashBucket[i]; *p != socket; p = &socketHashNext[*p - socketTable])
+      {
+      }
+
+      //Unlink the socket
+      *p = socketHashNext[i];
+      socketHashNext[i] = NULL;
+      socketHashBucket[i] = NULL;
    }
-#endif
-#if (UDP_SUPPORT == ENABLED || RAW_SOCKET_SUPPORT == ENABLED)
-   //Connectionless socket or raw socket?
-   if(socket->type == SOCKET_TYPE_DGRAM ||
-      socket->type == SOCKET_TYPE_RAW_IP ||
-      socket->type == SOCKET_TYPE_RAW_ETH)
+
+   //Only TCP and UDP sockets bound to a port are indexed
+   if((socket->type == SOCKET_TYPE_STREAM || socket->type == SOCKET_TYPE_DGRAM) &&
+      socket->localPort != 0)
    {
-      //Point to the first item in the receive queue
-      SocketQueueItem *queueItem = socket->receiveQueue;
+      //Retrieve the length of the remote IP address
+      n = socket->remoteIpAddr.length;
 
-      //Purge the receive queue
-      while(queueItem)
+      //Connected socket?
+      if(socket->remotePort != 0 && (n == sizeof(Ipv4Addr) || n == sizeof(Ipv6Addr)) &&
+         (socket->type != SOCKET_TYPE_STREAM || socket->state != TCP_STATE_LISTEN))
       {
-         //Keep track of the next item in the queue
-         SocketQueueItem *nextQueueItem = queueItem->next;
-         //Free previously allocated memory
-         memPoolFree(queueItem->buffer);
-         //Point to the next item
-         queueItem = nextQueueItem;
+         //Index the socket by local port, remote port and remote IP address
+         bucket = &socketConnHashTable[socketComputeHash(socket->localPort,
+            &socket->remoteIpAddr.ipv4Addr, n, socket->remotePort)];
+      }
+      else
+      {
+         //Index the socket by local port only
+         bucket = &socketListenHashTable[socketComputeHash(socket->localPort,
+            NULL, 0, 0)];
       }
 
-      //Mark the socket as closed
-      socket->type = SOCKET_TYPE_UNUSED;
+      //Hash chains are sorted in ascending order of socket index, so that
+      //lookups return the same socket as a linear scan of the socket table
+      for(p = bucket; *p != NULL && *p < socket; p = &socketHashNext[*p - socketTable])
+      {
+      }
+
+      //Insert the socket into the hash chain
+      socketHashNext[i] = *p;
+      *p = socket;
+      socketHashBucket[i] = bucket;
    }
 #endif
+}
 
-   //Release exclusive access
-   osReleaseMutex(&netMutex);
+
+/**
+ * @brief Compute the hash table index of a socket
+ * @param[in] localPort Local port number
+ * @param[in] remoteIpAddr Remote IP address (optional parameter)
+ * @param[in] length Length of the remote IP address, in bytes
+ * @param[in] remotePort Remote port number
+ * @return Index of the relevant bucket
+ **/
+
+uint_t socketComputeHash(uint16_t localPort, const void *remoteIpAddr,
+   size_t length, uint16_t remotePort)
+{
+   size_t i;
+   uint32_t h;
+   const uint8_t *p;
+
+   //Point to the remote IP address
+   p = (const uint8_t *) remoteIpAddr;
+
+   //Mix the port numbers
+   h = ((uint32_t) localPort << 16) | remotePort;
+
+   //Mix the remote IP address (FNV-1a)
+   for(i = 0; i < length; i++)
+   {
+      h ^= p[i];
+      h *= 0x01000193;
+   }
+
+   //Final avalanche
+   h ^= h >> 16;
+   h *= 0x9E3779B1;
+   h ^= h >> 15;
+
+   //Return the index of the bucket
+   return h & (SOCKET_HASH_TABLE_SIZE - 1);
 }
 
 
 /**
- * @brief Wait for one of a set of sockets to become ready to perform I/O
+ * @brief Find the socket that matches an incoming TCP segment or UDP datagram
  *
- * The socketPoll function determines the status of one or more sockets,
- * waiting if necessary, to perform synchronous I/O
+ * TCP sockets must match the source port exactly, whereas UDP sockets that
+ * are not connected accept datagrams from any source port. If several sockets
+ * match, the one with the lowest index in the socket table is returned
  *
- * @param[in,out] eventDesc Set of entries specifying the events the user is interested in
- * @param[in] size Number of entries in the descriptor set
- * @param[in] extEvent External event that can abort the wait if necessary (optional)
- * @param[in] timeout Maximum time to wait before returning
- * @return Error code
+ * @param[in] type Socket type (SOCKET_TYPE_STREAM or SOCKET_TYPE_DGRAM)
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader Pseudo header of the incoming packet
+ * @param[in] localPort Destination port number of the incoming packet
+ * @param[in] remotePort Source port number of the incoming packet
+ * @return Handle referencing the matching socket, if any
  **/
 
-error_t socketPoll(SocketEventDesc *eventDesc, uint_t size, OsEvent *extEvent,
-   systime_t timeout)
+Socket *socketLookup(uint_t type, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, uint16_t localPort, uint16_t remotePort)
 {
+   Socket *socket;
+   Socket *match;
+#if (SOCKET_HASH_SUPPORT == ENABLED)
+   const void *srcAddr;
+   size_t srcAddrLen;
+#else
    uint_t i;
-   bool_t status;
-   OsEvent *event;
-   OsEvent eventObject;
+#endif
 
-   //Check parameters
-   if(eventDesc == NULL || size == 0)
-      return ERROR_INVALID_PARAMETER;
+   //No matching socket for the moment
+   match = NULL;
 
-   //Try to use the supplied event object to receive notifications
-   if(!extEvent)
+   //The destination port must be valid
+   if(localPort == 0)
+      return NULL;
+
+   //Consecutive segments of a burst usually belong to the same connection
+   if(type == SOCKET_TYPE_STREAM && socketLookupCache != NULL)
    {
-      //Create an event object only if necessary
-      if(!osCreateEvent(&eventObject))
+      //Point to the socket that matched the previous segment
+      socket = socketLookupCache;
+
+      //A connected TCP socket is the only one that can match the segment
+      if(socket->remotePort == remotePort &&
+         socketMatchPacket(socket, type, interface, pseudoHeader, localPort))
       {
-         //Report an error
-         return ERROR_OUT_OF_RESOURCES;
+         return socket;
       }
+   }
 
-      //Reference to the newly created event
-      event = &eventObject;
+#if (SOCKET_HASH_SUPPORT == ENABLED)
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 packet received?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Point to the source IPv4 address
+      srcAddr = &pseudoHeader->ipv4Data.srcAddr;
+      srcAddrLen = sizeof(Ipv4Addr);
    }
    else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 packet received?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
    {
-      //Reference to the external event
-      event = extEvent;
+      //Point to the source IPv6 address
+      srcAddr = &pseudoHeader->ipv6Data.srcAddr;
+      srcAddrLen = sizeof(Ipv6Addr);
+   }
+   else
+#endif
+   //Invalid packet received?
+   {
+      //This should never occur...
+      return NULL;
    }
 
-   //Loop through descriptors
-   for(i = 0; i < size; i++)
+   //Search the connection hash table first
+   socket = socketConnHashTable[socketComputeHash(localPort, srcAddr,
+      srcAddrLen, remotePort)];
+
+   //Loop through the hash chain
+   for(; socket != NULL; socket = socketHashNext[socket - socketTable])
    {
-      //Valid socket handle?
-      if(eventDesc[i].socket != NULL)
+      //Check the remote port number and the address filters
+      if(socket->remotePort == remotePort &&
+         socketMatchPacket(socket, type, interface, pseudoHeader, localPort))
       {
-         //Clear event flags
-         eventDesc[i].eventFlags = 0;
-         //Subscribe to the requested events
-         socketRegisterEvents(eventDesc[i].socket, event, eventDesc[i].eventMask);
+         //The chain is sorted, so the first match has the lowest index
+         match = socket;
+         break;
       }
    }
 
-   //Block the current task until an event occurs
-   status = osWaitForEvent(event, timeout);
+   //Then search the listener hash table
+   socket = socketListenHashTable[socketComputeHash(localPort, NULL, 0, 0)];
 
-   //Loop through descriptors
-   for(i = 0; i < size; i++)
+   //Sockets with a higher index than the current match can be skipped
+   for(; socket != NULL && (match == NULL || socket < match);
+      socket = socketHashNext[socket - socketTable])
    {
-      //Valid socket handle?
-      if(eventDesc[i].socket != NULL)
+      //UDP sockets that are not connected accept any source port
+      if((socket->remotePort == remotePort ||
+         (type == SOCKET_TYPE_DGRAM && socket->remotePort == 0)) &&
+         socketMatchPacket(socket, type, interface, pseudoHeader, localPort))
       {
-         //Any socket event in the signaled state?
-         if(status)
-         {
-            //Retrieve event flags for the current socket
-            eventDesc[i].eventFlags = socketGetEvents(eventDesc[i].socket);
-            //Clear unnecessary flags
-            eventDesc[i].eventFlags &= eventDesc[i].eventMask;
-         }
-
-         //Unsubscribe previously registered events
-         socketUnregisterEvents(eventDesc[i].socket);
+         //A matching socket has been found
+         match = socket;
+         break;
       }
    }
+#else
+   //Loop through opened sockets
+   for(i = 0; i < SOCKET_MAX_COUNT; i++)
+   {
+      //Point to the current socket
+      socket = socketTable + i;
 
-   //Reset event object
-   osResetEvent(event);
+      //UDP sockets that are not connected accept any source port
+      if((socket->remotePort == remotePort ||
+         (type == SOCKET_TYPE_DGRAM && socket->remotePort == 0)) &&
+         socketMatchPacket(socket, type, interface, pseudoHeader, localPort))
+      {
+         //A matching socket has been found
+         match = socket;
+         break;
+      }
+   }
+#endif
 
-   //Release previously allocated resources
-   if(!extEvent)
-      osDeleteEvent(&eventObject);
+   //Save the connection for the next segment of the burst
+   if(socketLookupCacheEnabled && type == SOCKET_TYPE_STREAM &&
+      match != NULL && remotePort != 0)
+   {
+      socketLookupCache = match;
+   }
 
-   //Return status code
-   return status ? NO_ERROR : ERROR_TIMEOUT;
+   //Return the matching socket, if any
+   return match;
 }
 
 
 /**
- * @brief Subscribe to the specified socket events
- * @param[in] socket Handle that identifies a socket
- * @param[in] event Event object used to receive notifications
- * @param[in] eventMask Logic OR of the requested socket events
+ * @brief Enable or disable the socket lookup cache
+ *
+ * The cache is only used while a burst of frames is being processed, so
+ * that it never refers to a socket that has been closed in the meantime
+ *
+ * @param[in] enable This flag specifies whether the cache is used
  **/
 
-void socketRegisterEvents(Socket *socket, OsEvent *event, uint_t eventMask)
+void socketSetLookupCache(bool_t enable)
 {
-   //Valid socket handle?
-   if(socket != NULL)
-   {
-      //Get exclusive access
-      osAcquireMutex(&netMutex);
-
-      //An user event may have been previously registered...
-      if(socket->userEvent != NULL)
-         socket->eventMask |= eventMask;
-      else
-         socket->eventMask = eventMask;
+   //Start with an empty cache
+   socketLookupCacheEnabled = enable;
+   socketLookupCache = NULL;
+}
 
-      //Suscribe to get notified of events
-      socket->userEvent = event;
 
 #if (TCP_SUPPORT == ENABLED)
-      //Handle TCP specific events
-      if(socket->type == SOCKET_TYPE_STREAM)
-      {
-         tcpUpdateEvents(socket);
-      }
-#endif
-#if (UDP_SUPPORT == ENABLED)
-      //Handle UDP specific events
-      if(socket->type == SOCKET_TYPE_DGRAM)
-      {
-         udpUpdateEvents(socket);
-      }
-#endif
-#if (RAW_SOCKET_SUPPORT == ENABLED)
-      //Handle events that are specific to raw sockets
-      if(socket->type == SOCKET_TYPE_RAW_IP ||
-         socket->type == SOCKET_TYPE_RAW_ETH)
-      {
-         rawSocketUpdateEvents(socket);
-      }
-#endif
-
-      //Release exclusive access
-      osReleaseMutex(&netMutex);
-   }
-}
-
 
 /**
- * @brief Unsubscribe previously registered events
- * @param[in] socket Handle that identifies a socket
+ * @brief Find the TCP socket in the LISTEN state that matches a segment
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader Pseudo header of the incoming segment
+ * @param[in] localPort Destination port number of the incoming segment
+ * @return Handle referencing the listening socket, if any
  **/
 
-void socketUnregisterEvents(Socket *socket)
+Socket *socketLookupListener(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, uint16_t localPort)
 {
-   //Valid socket handle?
-   if(socket != NULL)
-   {
-      //Get exclusive access
-      osAcquireMutex(&netMutex);
+   Socket *socket;
+#if (SOCKET_HASH_SUPPORT == DISABLED)
+   uint_t i;
+#endif
 
-      //Unsuscribe socket events
-      socket->userEvent = NULL;
+   //The destination port must be valid
+   if(localPort == 0)
+      return NULL;
 
-      //Release exclusive access
-      osReleaseMutex(&netMutex);
+#if (SOCKET_HASH_SUPPORT == ENABLED)
+   //Listening sockets are indexed by local port only
+   socket = socketListenHashTable[socketComputeHash(localPort, NULL, 0, 0)];
+
+   //Loop through the hash chain
+   for(; socket != NULL; socket = socketHashNext[socket - socketTable])
+   {
+      //The chain is sorted, so the first match has the lowest index
+      if(socket->state == TCP_STATE_LISTEN && socketMatchPacket(socket,
+         SOCKET_TYPE_STREAM, interface, pseudoHeader, localPort))
+      {
+         return socket;
+      }
+   }
+#else
+   //Loop through opened sockets
+   for(i = 0; i < SOCKET_MAX_COUNT; i++)
+   {
+      //Point to the current socket
+      socket = socketTable + i;
+
+      //Return the first matching socket in the LISTEN state
+      if(socket->state == TCP_STATE_LISTEN && socketMatchPacket(socket,
+         SOCKET_TYPE_STREAM, interface, pseudoHeader, localPort))
+      {
+         return socket;
+      }
    }
+#endif
+
+   //No matching socket in the LISTEN state
+   return NULL;
 }
 
+#endif
+
 
 /**
- * @brief Retrieve event flags for a specified socket
- * @param[in] socket Handle that identifies a socket
- * @return Logic OR of events in the signaled state
+ * @brief Check whether a socket accepts a given incoming packet
+ * @param[in] socket Handle referencing the socket
+ * @param[in] type Expected socket type
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader Pseudo header of the incoming packet
+ * @param[in] localPort Destination port number of the incoming packet
+ * @return TRUE if the socket type, the interface, the local port and the
+ *   IP addresses match, else FALSE
  **/
 
-uint_t socketGetEvents(Socket *socket)
+bool_t socketMatchPacket(Socket *socket, uint_t type, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, uint16_t localPort)
 {
-   uint_t eventFlags;
+   //Check socket type
+   if(socket->type != type)
+      return FALSE;
+   //Check whether the socket is bound to a particular interface
+   if(socket->interface && socket->interface != interface)
+      return FALSE;
+   //Check destination port number
+   if(socket->localPort == 0 || socket->localPort != localPort)
+      return FALSE;
 
-   //Valid socket handle?
-   if(socket != NULL)
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 packet received?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
    {
-      //Get exclusive access
-      osAcquireMutex(&netMutex);
+      //Destination IP address filtering
+      if(socket->localIpAddr.length != 0)
+      {
+         //An IPv4 address is expected
+         if(socket->localIpAddr.length != sizeof(Ipv4Addr))
+            return FALSE;
+         //Filter out non-matching addresses
+         if(socket->localIpAddr.ipv4Addr != pseudoHeader->ipv4Data.destAddr)
+            return FALSE;
+      }
 
-      //Read event flags for the specified socket
-      eventFlags = socket->eventFlags;
+      //Source IP address filtering
+      if(socket->remoteIpAddr.length != 0)
+      {
+         //An IPv4 address is expected
+         if(socket->remoteIpAddr.length != sizeof(Ipv4Addr))
+            return FALSE;
+         //Filter out non-matching addresses
+         if(socket->remoteIpAddr.ipv4Addr != pseudoHeader->ipv4Data.srcAddr)
+            return FALSE;
+      }
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 packet received?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Destination IP address filtering
+      if(socket->localIpAddr.length != 0)
+      {
+         //An IPv6 address is expected
+         if(socket->localIpAddr.length != sizeof(Ipv6Addr))
+            return FALSE;
+         //Filter out non-matching addresses
+         if(!ipv6CompAddr(&socket->localIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.destAddr))
+            return FALSE;
+      }
 
-      //Release exclusive access
-      osReleaseMutex(&netMutex);
+      //Source IP address filtering
+      if(socket->remoteIpAddr.length != 0)
+      {
+         //An IPv6 address is expected
+         if(socket->remoteIpAddr.length != sizeof(Ipv6Addr))
+            return FALSE;
+         //Filter out non-matching addresses
+         if(!ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.srcAddr))
+            return FALSE;
+      }
    }
    else
+#endif
+   //Invalid packet received?
    {
-      //The socket handle is not valid
-      eventFlags = 0;
+      //This should never occur...
+      return FALSE;
    }
 
-   //Return the events in the signaled state
-   return eventFlags;
+   //The socket meets all the criteria
+   return TRUE;
 }
 
 
@@ -35,6 +35,9 @@
 struct _Socket;
 #define Socket struct _Socket
 
+//Forward declaration of SocketEventSet structure
+struct _SocketEventSet;
+
 //Dependencies
 #include "core/net.h"
 #include "core/ethernet.h"
@@ -62,6 +65,62 @@ struct _Socket;
    #error SOCKET_EPHEMERAL_PORT_MAX parameter is not valid
 #endif
 
+//Hash-based socket lookup
+#ifndef SOCKET_HASH_SUPPORT
+   #define SOCKET_HASH_SUPPORT ENABLED
+#elif (SOCKET_HASH_SUPPORT != ENABLED && SOCKET_HASH_SUPPORT != DISABLED)
+   #error SOCKET_HASH_SUPPORT parameter is not valid
+#endif
+
+//Number of buckets in the connection and listener hash tables
+#ifndef SOCKET_HASH_TABLE_SIZE
+   #define SOCKET_HASH_TABLE_SIZE 64
+#elif (SOCKET_HASH_TABLE_SIZE < 1 || (SOCKET_HASH_TABLE_SIZE & (SOCKET_HASH_TABLE_SIZE - 1)) != 0)
+   #error SOCKET_HASH_TABLE_SIZE parameter is not valid
+#endif
+
+//File transmission support
+#ifndef SOCKET_SEND_FILE_SUPPORT
+   #define SOCKET_SEND_FILE_SUPPORT DISABLED
+#elif (SOCKET_SEND_FILE_SUPPORT != ENABLED && SOCKET_SEND_FILE_SUPPORT != DISABLED)
+   #error SOCKET_SEND_FILE_SUPPORT parameter is not valid
+#endif
+
+//Number of file bytes read at a time by socketSendFile
+#ifndef SOCKET_SEND_FILE_BATCH_SIZE
+   #define SOCKET_SEND_FILE_BATCH_SIZE 8192
+#elif (SOCKET_SEND_FILE_BATCH_SIZE < 536)
+   #error SOCKET_SEND_FILE_BATCH_SIZE parameter is not valid
+#endif
+
+//Persistent event sets
+#ifndef SOCKET_EVENT_SET_SUPPORT
+   #define SOCKET_EVENT_SET_SUPPORT DISABLED
+#elif (SOCKET_EVENT_SET_SUPPORT != ENABLED && SOCKET_EVENT_SET_SUPPORT != DISABLED)
+   #error SOCKET_EVENT_SET_SUPPORT parameter is not valid
+#endif
+
+//Number of event sets that can be created simultaneously
+#ifndef SOCKET_EVENT_SET_MAX_COUNT
+   #define SOCKET_EVENT_SET_MAX_COUNT 2
+#elif (SOCKET_EVENT_SET_MAX_COUNT < 1)
+   #error SOCKET_EVENT_SET_MAX_COUNT parameter is not valid
+#endif
+
+//File system support?
+#if (SOCKET_SEND_FILE_SUPPORT == ENABLED)
+   #include "fs_port.h"
+#endif
+
+//Lock a socket from a context that already holds the netMutex
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+   #define SOCKET_LOCK(socket) osAcquireMutex(&(socket)->mutex)
+   #define SOCKET_UNLOCK(socket) osReleaseMutex(&(socket)->mutex)
+#else
+   #define SOCKET_LOCK(socket)
+   #define SOCKET_UNLOCK(socket)
+#endif
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -237,6 +296,17 @@ struct _Socket
    uint_t eventMask;
    uint_t eventFlags;
    OsEvent *userEvent;
+#if (SOCKET_EVENT_SET_SUPPORT == ENABLED)
+   struct _SocketEventSet *eventSet; ///<Event set the socket belongs to
+   uint_t eventSetMask;              ///<Events monitored through the event set
+   uint_t eventSetFlags;             ///<Monitored events in the signaled state
+   bool_t eventSetQueued;            ///<The socket is in the ready list of the set
+   Socket *eventSetNext;             ///<Next socket in the ready list
+#endif
+#if (NET_FINE_LOCK_SUPPORT == ENABLED)
+   OsMutex mutex;                 ///<Mutex protecting the socket
+   bool_t netLocked;              ///<The owner of the mutex holds the netMutex as well
+#endif
 
 //TCP specific variables
 #if (TCP_SUPPORT == ENABLED)
@@ -252,15 +322,28 @@ struct _Socket
 
    uint32_t sndUna;               ///<Data that have been sent but not yet acknowledged
    uint32_t sndNxt;               ///<Sequence number of the next byte to be sent
-   uint16_t sndUser;              ///<Amount of data buffered but not yet sent
-   uint16_t sndWnd;               ///<Size of the send window
-   uint16_t maxSndWnd;            ///<Maximum send window it has seen so far on the connection
+   uint32_t sndUser;              ///<Amount of data buffered but not yet sent
+   uint32_t sndWnd;               ///<Size of the send window
+   uint32_t maxSndWnd;            ///<Maximum send window it has seen so far on the connection
    uint32_t sndWl1;               ///<Segment sequence number used for last window update
    uint32_t sndWl2;               ///<Segment acknowledgment number used for last window update
 
    uint32_t rcvNxt;               ///<Receive next sequence number
-   uint16_t rcvUser;              ///<Number of data received but not yet consumed
-   uint16_t rcvWnd;               ///<Receive window
+   uint32_t rcvUser;              ///<Number of data received but not yet consumed
+   uint32_t rcvWnd;               ///<Receive window
+
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+   bool_t wndScaleOptionReceived; ///<Window Scale option received
+   uint8_t sndWndShift;           ///<Scale factor applied to the windows advertised by the peer
+   uint8_t rcvWndShift;           ///<Scale factor applied to the windows we advertise
+#endif
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   bool_t tsOptionReceived;       ///<Timestamps option received
+   uint32_t tsRecent;             ///<Timestamp value to be echoed to the peer
+   systime_t tsRecentAge;         ///<Time at which TS.Recent was last updated
+   uint32_t lastAckSent;          ///<Last acknowledgment number sent
+#endif
 
    bool_t rttBusy;                ///<RTT measurement is being performed
    uint32_t rttSeqNum;            ///<Sequence number identifying a TCP segment
@@ -271,19 +354,32 @@ struct _Socket
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
    TcpCongestState congestState;  ///<Congestion state
-   uint16_t cwnd;                 ///<Congestion window
-   uint16_t ssthresh;             ///<Slow start threshold
+   uint32_t cwnd;                 ///<Congestion window
+   uint32_t ssthresh;             ///<Slow start threshold
    uint_t dupAckCount;            ///<Number of consecutive duplicate ACKs
    uint_t n;                      ///<Number of bytes acknowledged during the whole round-trip
    uint32_t recover;              ///<NewReno modification to TCP's fast recovery algorithm
+   TcpCongestAlgo congestAlgo;    ///<Congestion control algorithm
+#if (TCP_CUBIC_SUPPORT == ENABLED)
+   TcpCubicContext cubicContext;  ///<CUBIC context
+#endif
+#if (TCP_BBR_SUPPORT == ENABLED)
+   TcpBbrContext bbrContext;      ///<BBR context
+#endif
 #endif
 
    TcpTxBuffer txBuffer;          ///<Send buffer
    size_t txBufferSize;           ///<Size of the send buffer
    TcpRxBuffer rxBuffer;          ///<Receive buffer
    size_t rxBufferSize;           ///<Size of the receive buffer
+#if (TCP_ZERO_COPY_RX_SUPPORT == ENABLED)
+   size_t rxLoanLength;           ///<Number of bytes loaned to the application
+#endif
 
    TcpQueueItem *retransmitQueue; ///<Retransmission queue
+#if (TCP_ZERO_COPY_TX_SUPPORT == ENABLED)
+   TcpTxRef *txRefQueue;          ///<Data held in caller-supplied buffers
+#endif
    TcpTimer retransmitTimer;      ///<Retransmission timer
    uint_t retransmitCount;        ///<Number of retransmissions
 
@@ -298,15 +394,37 @@ struct _Socket
    TcpTimer finWait2Timer;        ///<FIN-WAIT-2 timer
    TcpTimer timeWaitTimer;        ///<2MSL timer
 
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   bool_t delayedAckEnabled;      ///<Delayed ACKs are enabled on this connection
+   uint32_t delayedAckBytes;      ///<Number of bytes received but not yet acknowledged
+   TcpTimer delayedAckTimer;      ///<Delayed ACK timer
+#endif
+
+#if (TCP_PACING_SUPPORT == ENABLED)
+   uint32_t pacingRate;           ///<Pacing rate requested by the user
+   int32_t pacingCredit;          ///<Number of bytes that can be sent without waiting
+   systime_t pacingTime;          ///<Time at which the credit was last refilled
+   uint_t pacingFlags;            ///<Flags of the transmission that has been deferred
+   TcpTimer pacingTimer;          ///<Pacing timer
+#endif
+
    bool_t sackPermitted;                        ///<SACK Permitted option received
    TcpSackBlock sackBlock[TCP_MAX_SACK_BLOCKS]; ///<List of non-contiguous blocks that have been received
    uint_t sackBlockCount;                       ///<Number of non-contiguous blocks that have been received
+
+#if (TCP_CHECKSUM_COPY_SUPPORT == ENABLED)
+   bool_t rxDataCopied;                              ///<Segment data copied while verifying the checksum
+   uint16_t txChecksum[TCP_TX_CHECKSUM_BLOCK_COUNT]; ///<Partial sums of the send buffer blocks
+#endif
 #endif
 
 //UDP specific variables
 #if (UDP_SUPPORT == ENABLED || RAW_SOCKET_SUPPORT == ENABLED)
    SocketQueueItem *receiveQueue;
 #endif
+#if (UDP_SUPPORT == ENABLED && UDP_ZERO_COPY_RX_SUPPORT == ENABLED)
+   bool_t rxLoanDatagram;         ///<The datagram at the head of the queue is loaned
+#endif
 };
 
 
@@ -342,6 +460,9 @@ error_t socketSetVmanDei(Socket *socket, bool_t dei);
 
 error_t socketSetTxBufferSize(Socket *socket, size_t size);
 error_t socketSetRxBufferSize(Socket *socket, size_t size);
+error_t socketSetCongestControl(Socket *socket, TcpCongestAlgo algo);
+error_t socketSetDelayedAck(Socket *socket, bool_t enabled);
+error_t socketSetPacingRate(Socket *socket, uint32_t rate);
 
 error_t socketSetInterface(Socket *socket, NetInterface *interface);
 NetInterface *socketGetInterface(Socket *socket);
@@ -357,6 +478,22 @@ error_t socketSend(Socket *socket, const void *data,
 error_t socketSendTo(Socket *socket, const IpAddr *destIpAddr, uint16_t destPort,
    const void *data, size_t length, size_t *written, uint_t flags);
 
+NetBuffer *socketAllocTxBuffer(Socket *socket, size_t length, size_t *offset);
+
+error_t socketSendBuffer(Socket *socket, NetBuffer *buffer, size_t offset,
+   size_t *written, uint_t flags);
+
+error_t socketSendBufferTo(Socket *socket, const IpAddr *destIpAddr,
+   uint16_t destPort, NetBuffer *buffer, size_t offset, size_t *written,
+   uint_t flags);
+
+#if (SOCKET_SEND_FILE_SUPPORT == ENABLED)
+
+error_t socketSendFile(Socket *socket, FsFile *file, uint32_t offset,
+   size_t length, size_t *written, uint_t flags);
+
+#endif
+
 error_t socketReceive(Socket *socket, void *data,
    size_t size, size_t *received, uint_t flags);
 
@@ -366,6 +503,14 @@ error_t socketReceiveFrom(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
 error_t socketReceiveEx(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
    IpAddr *destIpAddr, void *data, size_t size, size_t *received, uint_t flags);
 
+error_t socketReceiveLoan(Socket *socket, const uint8_t **data,
+   size_t *length, uint_t flags);
+
+error_t socketReceiveLoanFrom(Socket *socket, IpAddr *srcIpAddr,
+   uint16_t *srcPort, const uint8_t **data, size_t *length, uint_t flags);
+
+error_t socketReleaseLoan(Socket *socket, size_t length);
+
 error_t socketGetLocalAddr(Socket *socket, IpAddr *localIpAddr, uint16_t *localPort);
 error_t socketGetRemoteAddr(Socket *socket, IpAddr *remoteIpAddr, uint16_t *remotePort);
 
@@ -378,6 +523,28 @@ error_t socketPoll(SocketEventDesc *eventDesc, uint_t size, OsEvent *extEvent,
 void socketRegisterEvents(Socket *socket, OsEvent *event, uint_t eventMask);
 void socketUnregisterEvents(Socket *socket);
 uint_t socketGetEvents(Socket *socket);
+void socketUpdateEvents(Socket *socket);
+
+void socketAcquireMutex(Socket *socket, bool_t netLock);
+void socketReleaseMutex(Socket *socket);
+bool_t socketAcquireNetMutex(Socket *socket);
+void socketReleaseNetMutex(Socket *socket);
+void socketWaitForEvent(Socket *socket, systime_t timeout);
+
+void socketUpdateHash(Socket *socket);
+uint_t socketComputeHash(uint16_t localPort, const void *remoteIpAddr,
+   size_t length, uint16_t remotePort);
+
+Socket *socketLookup(uint_t type, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, uint16_t localPort, uint16_t remotePort);
+
+void socketSetLookupCache(bool_t enable);
+
+Socket *socketLookupListener(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, uint16_t localPort);
+
+bool_t socketMatchPacket(Socket *socket, uint_t type, NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, uint16_t localPort);
 
 error_t getHostByName(NetInterface *interface,
    const char_t *name, IpAddr *ipAddr, uint_t flags);
@@ -0,0 +1,597 @@
+/**
+ * @file socket_event_set.c
+ * @brief Persistent socket event sets
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Unlike socketPoll, which registers an event on every socket of the
+ * descriptor array and scans all of them after each wakeup, an event set
+ * keeps its members registered between calls. Whenever the event flags of
+ * a member socket are updated, the socket is appended to the ready list of
+ * the set, so that waiting for events only costs as much as the number of
+ * sockets that are actually ready. Readiness is level-triggered: a socket
+ * that is still ready once it has been reported is queued again
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL SOCKET_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/socket_event_set.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (SOCKET_EVENT_SET_SUPPORT == ENABLED)
+
+//Event set table
+SocketEventSet socketEventSetTable[SOCKET_EVENT_SET_MAX_COUNT];
+
+
+/**
+ * @brief Event set related initialization
+ **/
+
+void socketEventSetInit(void)
+{
+   //Initialize event sets
+   osMemset(socketEventSetTable, 0, sizeof(socketEventSetTable));
+}
+
+
+/**
+ * @brief Create an event set
+ * @return Handle to the newly created event set, or NULL if no more
+ *   event sets are available
+ **/
+
+SocketEventSet *socketEventSetCreate(void)
+{
+   uint_t i;
+   SocketEventSet *set;
+
+   //Initialize pointer
+   set = NULL;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Loop through the event set table
+   for(i = 0; i < SOCKET_EVENT_SET_MAX_COUNT; i++)
+   {
+      //Unused entry found?
+      if(!socketEventSetTable[i].used)
+      {
+         set = &socketEventSetTable[i];
+         break;
+      }
+   }
+
+   //Check whether the current entry is free
+   if(set != NULL)
+   {
+      //Clear associated structure
+      osMemset(set, 0, sizeof(SocketEventSet));
+
+      //Create a mutex to protect the ready list
+      if(osCreateMutex(&set->mutex))
+      {
+         //Create an event object to get notified of ready sockets
+         if(osCreateEvent(&set->event))
+         {
+            //The event set is now in use
+            set->used = TRUE;
+         }
+         else
+         {
+            //Clean up side effects
+            osDeleteMutex(&set->mutex);
+            set = NULL;
+         }
+      }
+      else
+      {
+         //Failed to create mutex
+         set = NULL;
+      }
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return a handle to the freshly created event set
+   return set;
+}
+
+
+/**
+ * @brief Delete an event set
+ *
+ * The member sockets are removed from the set. The caller must make sure no
+ * task is waiting on the event set
+ *
+ * @param[in] set Handle to an event set
+ **/
+
+void socketEventSetDelete(SocketEventSet *set)
+{
+   uint_t i;
+   Socket *socket;
+
+   //Make sure the event set handle is valid
+   if(set == NULL || !set->used)
+      return;
+
+   //Loop through socket descriptors
+   for(i = 0; i < SOCKET_MAX_COUNT; i++)
+   {
+      //Point to the current socket
+      socket = &socketTable[i];
+
+      //Get exclusive access
+      socketAcquireMutex(socket, FALSE);
+
+      //Remove the socket from the event set
+      if(socket->eventSet == set)
+         socketEventSetDetach(socket);
+
+      //Release exclusive access
+      socketReleaseMutex(socket);
+   }
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Release previously allocated resources
+   osDeleteEvent(&set->event);
+   osDeleteMutex(&set->mutex);
+
+   //Mark the entry as free
+   set->used = FALSE;
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+}
+
+
+/**
+ * @brief Add a socket to an event set
+ *
+ * A socket belongs to at most one event set at a time
+ *
+ * @param[in] set Handle to an event set
+ * @param[in] socket Handle that identifies the socket to monitor
+ * @param[in] eventMask Logic OR of the requested socket events
+ * @return Error code
+ **/
+
+error_t socketEventSetAdd(SocketEventSet *set, Socket *socket,
+   uint_t eventMask)
+{
+   error_t error;
+
+   //Check parameters
+   if(set == NULL || !set->used || socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   socketAcquireMutex(socket, FALSE);
+
+   //Check the state of the socket
+   if(socket->type == SOCKET_TYPE_UNUSED)
+   {
+      //The socket has been closed
+      error = ERROR_INVALID_SOCKET;
+   }
+   else if(socket->eventSet != NULL)
+   {
+      //The socket is already monitored
+      error = ERROR_WRONG_STATE;
+   }
+   else
+   {
+      //Register the socket
+      socket->eventSet = set;
+      socket->eventSetMask = eventMask;
+      socket->eventSetFlags = 0;
+
+      //The socket may already be ready
+      socketUpdateEvents(socket);
+
+      //Successful processing
+      error = NO_ERROR;
+   }
+
+   //Release exclusive access
+   socketReleaseMutex(socket);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Change the events monitored on a socket
+ * @param[in] set Handle to an event set
+ * @param[in] socket Handle that identifies a socket belonging to the set
+ * @param[in] eventMask Logic OR of the requested socket events
+ * @return Error code
+ **/
+
+error_t socketEventSetModify(SocketEventSet *set, Socket *socket,
+   uint_t eventMask)
+{
+   error_t error;
+
+   //Check parameters
+   if(set == NULL || !set->used || socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   socketAcquireMutex(socket, FALSE);
+
+   //Make sure the socket belongs to the event set
+   if(socket->eventSet == set)
+   {
+      //Save the new event mask
+      socket->eventSetMask = eventMask;
+
+      //The newly requested events may already be signaled
+      socketUpdateEvents(socket);
+
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else
+   {
+      //The socket is not a member of the set
+      error = ERROR_NOT_FOUND;
+   }
+
+   //Release exclusive access
+   socketReleaseMutex(socket);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Remove a socket from an event set
+ * @param[in] set Handle to an event set
+ * @param[in] socket Handle that identifies a socket belonging to the set
+ * @return Error code
+ **/
+
+error_t socketEventSetRemove(SocketEventSet *set, Socket *socket)
+{
+   error_t error;
+
+   //Check parameters
+   if(set == NULL || !set->used || socket == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   socketAcquireMutex(socket, FALSE);
+
+   //Make sure the socket belongs to the event set
+   if(socket->eventSet == set)
+   {
+      //Unregister the socket
+      socketEventSetDetach(socket);
+      //Successful processing
+      error = NO_ERROR;
+   }
+   else
+   {
+      //The socket is not a member of the set
+      error = ERROR_NOT_FOUND;
+   }
+
+   //Release exclusive access
+   socketReleaseMutex(socket);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Wait for sockets of an event set to become ready
+ *
+ * Only the sockets present in the ready list are examined, so that the
+ * cost of the call does not depend on the number of member sockets
+ *
+ * @param[in] set Handle to an event set
+ * @param[out] eventDesc Array receiving the ready sockets and their events
+ * @param[in] size Number of entries in the array
+ * @param[out] count Number of entries that have been filled
+ * @param[in] timeout Maximum time to wait before returning
+ * @return Error code
+ **/
+
+error_t socketEventSetWait(SocketEventSet *set, SocketEventDesc *eventDesc,
+   uint_t size, uint_t *count, systime_t timeout)
+{
+   uint_t i;
+   uint_t j;
+   uint_t n;
+   uint_t pending;
+   systime_t time;
+   systime_t startTime;
+   Socket *socket;
+
+   //Check parameters
+   if(set == NULL || !set->used || eventDesc == NULL || size == 0 ||
+      count == NULL)
+   {
+      return ERROR_INVALID_PARAMETER;
+   }
+
+   //Number of ready sockets
+   n = 0;
+   //Save current time
+   startTime = osGetSystemTime();
+
+   //Wait for at least one socket to become ready
+   while(1)
+   {
+      //Get exclusive access to the ready list
+      osAcquireMutex(&set->mutex);
+
+      //Only the sockets queued so far are examined. Sockets that are queued
+      //again while the list is being processed are reported by the next call.
+      //The ready list is unlocked while it is processed, so this count only
+      //bounds the number of iterations
+      pending = set->readyCount;
+
+      //The event is signaled again as soon as a socket becomes ready
+      if(pending == 0)
+         osResetEvent(&set->event);
+
+      //Release exclusive access to the ready list
+      osReleaseMutex(&set->mutex);
+
+      //Process the ready list
+      for(i = 0; i < pending && n < size; i++)
+      {
+         //Get exclusive access to the ready list
+         osAcquireMutex(&set->mutex);
+
+         //Remove the first socket from the ready list
+         socket = set->readyHead;
+
+         //Any socket left?
+         if(socket != NULL)
+         {
+            set->readyHead = socket->eventSetNext;
+            if(set->readyHead == NULL)
+               set->readyTail = NULL;
+
+            socket->eventSetNext = NULL;
+            socket->eventSetQueued = FALSE;
+            set->readyCount--;
+         }
+
+         //Release exclusive access to the ready list
+         osReleaseMutex(&set->mutex);
+
+         //The ready list may have been shortened in the meantime
+         if(socket == NULL)
+            break;
+
+         //Get exclusive access
+         socketAcquireMutex(socket, FALSE);
+
+         //The socket may have been removed from the set in the meantime
+         if(socket->eventSet == set)
+         {
+            //Evaluate the state of the socket again. The socket is queued
+            //back if it is still ready
+            socketUpdateEvents(socket);
+
+            //Any monitored event in the signaled state?
+            if(socket->eventSetFlags != 0)
+            {
+               //A socket detached and queued again while the ready list was
+               //unlocked may already be part of the batch
+               for(j = 0; j < n; j++)
+               {
+                  if(eventDesc[j].socket == socket)
+                     break;
+               }
+
+               //The socket must not be reported twice in the same batch
+               if(j == n)
+                  n++;
+
+               eventDesc[j].socket = socket;
+               eventDesc[j].eventMask = socket->eventSetMask;
+               eventDesc[j].eventFlags = socket->eventSetFlags;
+            }
+         }
+
+         //Release exclusive access
+         socketReleaseMutex(socket);
+      }
+
+      //Any socket ready?
+      if(n > 0)
+         break;
+
+      //Compute the time left
+      if(timeout == INFINITE_DELAY)
+      {
+         time = INFINITE_DELAY;
+      }
+      else
+      {
+         //Elapsed time since the beginning of the call
+         time = osGetSystemTime() - startTime;
+
+         //Timeout expired?
+         if(time >= timeout)
+            break;
+
+         //Remaining time
+         time = timeout - time;
+      }
+
+      //Block the current task until a socket becomes ready
+      osWaitForEvent(&set->event, time);
+   }
+
+   //Return the number of ready sockets
+   *count = n;
+
+   //Return status code
+   return (n > 0) ? NO_ERROR : ERROR_TIMEOUT;
+}
+
+
+/**
+ * @brief Report the events of a socket to its event set
+ *
+ * This function is called whenever the event flags of a socket are updated.
+ * The caller must hold exclusive access to the socket
+ *
+ * @param[in] socket Handle that identifies a socket
+ * @param[in] eventFlags Logic OR of the events in the signaled state
+ **/
+
+void socketEventSetNotify(Socket *socket, uint_t eventFlags)
+{
+   SocketEventSet *set;
+
+   //Point to the event set the socket belongs to
+   set = socket->eventSet;
+
+   //The socket is not monitored?
+   if(set == NULL)
+      return;
+
+   //Keep track of the monitored events
+   socket->eventSetFlags = eventFlags & socket->eventSetMask;
+
+   //Any monitored event in the signaled state?
+   if(socket->eventSetFlags != 0)
+   {
+      //Get exclusive access to the ready list
+      osAcquireMutex(&set->mutex);
+
+      //Append the socket to the ready list, unless already present
+      if(!socket->eventSetQueued)
+      {
+         socket->eventSetNext = NULL;
+
+         if(set->readyTail != NULL)
+            set->readyTail->eventSetNext = socket;
+         else
+            set->readyHead = socket;
+
+         set->readyTail = socket;
+         set->readyCount++;
+         socket->eventSetQueued = TRUE;
+
+         //Wake up the task waiting on the event set
+         osSetEvent(&set->event);
+      }
+
+      //Release exclusive access to the ready list
+      osReleaseMutex(&set->mutex);
+   }
+}
+
+
+/**
+ * @brief Remove a socket from the event set it belongs to
+ *
+ * The caller must hold exclusive access to the socket
+ *
+ * @param[in] socket Handle that identifies a socket
+ **/
+
+void socketEventSetDetach(Socket *socket)
+{
+   Socket *prev;
+   Socket *entry;
+   SocketEventSet *set;
+
+   //Point to the event set the socket belongs to
+   set = socket->eventSet;
+
+   //The socket is not monitored?
+   if(set == NULL)
+      return;
+
+   //Get exclusive access to the ready list
+   osAcquireMutex(&set->mutex);
+
+   //Unlink the socket from the ready list
+   if(socket->eventSetQueued)
+   {
+      //Point to the first socket in the ready list
+      prev = NULL;
+      entry = set->readyHead;
+
+      //Find the socket in the ready list
+      while(entry != NULL && entry != socket)
+      {
+         prev = entry;
+         entry = entry->eventSetNext;
+      }
+
+      //Socket found?
+      if(entry != NULL)
+      {
+         if(prev != NULL)
+            prev->eventSetNext = socket->eventSetNext;
+         else
+            set->readyHead = socket->eventSetNext;
+
+         if(set->readyTail == socket)
+            set->readyTail = prev;
+
+         set->readyCount--;
+      }
+
+      socket->eventSetNext = NULL;
+      socket->eventSetQueued = FALSE;
+   }
+
+   //Release exclusive access to the ready list
+   osReleaseMutex(&set->mutex);
+
+   //The socket no longer belongs to the event set
+   socket->eventSet = NULL;
+   socket->eventSetMask = 0;
+   socket->eventSetFlags = 0;
+}
+
+#endif
@@ -0,0 +1,87 @@
+/**
+ * @file socket_event_set.h
+ * @brief Persistent socket event sets
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+#ifndef _SOCKET_EVENT_SET_H
+#define _SOCKET_EVENT_SET_H
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Event set
+ **/
+
+typedef struct _SocketEventSet
+{
+   bool_t used;         ///<The event set is in use
+   OsMutex mutex;       ///<Mutex protecting the ready list
+   OsEvent event;       ///<Signaled when the ready list is not empty
+   Socket *readyHead;   ///<First socket in the ready list
+   Socket *readyTail;   ///<Last socket in the ready list
+   uint_t readyCount;   ///<Number of sockets in the ready list
+} SocketEventSet;
+
+
+//Global variables
+extern SocketEventSet socketEventSetTable[SOCKET_EVENT_SET_MAX_COUNT];
+
+//Event set related functions
+void socketEventSetInit(void);
+
+SocketEventSet *socketEventSetCreate(void);
+void socketEventSetDelete(SocketEventSet *set);
+
+error_t socketEventSetAdd(SocketEventSet *set, Socket *socket,
+   uint_t eventMask);
+
+error_t socketEventSetModify(SocketEventSet *set, Socket *socket,
+   uint_t eventMask);
+
+error_t socketEventSetRemove(SocketEventSet *set, Socket *socket);
+
+error_t socketEventSetWait(SocketEventSet *set, SocketEventDesc *eventDesc,
+   uint_t size, uint_t *count, systime_t timeout);
+
+void socketEventSetNotify(Socket *socket, uint_t eventFlags);
+void socketEventSetDetach(Socket *socket);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -35,9 +35,12 @@
 #include <string.h>
 #include "core/net.h"
 #include "core/socket.h"
+#include "core/socket_event_set.h"
 #include "core/tcp.h"
 #include "core/tcp_misc.h"
 #include "core/tcp_timer.h"
+#include "core/tcp_congest.h"
+#include "core/tcp_time_wait.h"
 #include "mibs/mib2_module.h"
 #include "mibs/tcp_mib_module.h"
 #include "debug.h"
@@ -45,9 +48,6 @@
 //Check TCP/IP stack configuration
 #if (TCP_SUPPORT == ENABLED)
 
-//Tick counter to handle periodic operations
-systime_t tcpTickCounter;
-
 //Ephemeral ports are used for dynamic port assignment
 static uint16_t tcpDynamicPort;
 
@@ -62,6 +62,11 @@ error_t tcpInit(void)
    //Reset ephemeral port number
    tcpDynamicPort = 0;
 
+#if (TCP_TIME_WAIT_TABLE_SUPPORT == ENABLED)
+   //Initialize the TIME-WAIT table
+   tcpTimeWaitInit();
+#endif
+
    //Successful initialization
    return NO_ERROR;
 }
@@ -123,6 +128,8 @@ error_t tcpConnect(Socket *socket, const IpAddr *remoteIpAddr, uint16_t remotePo
       //Save port number and IP address of the remote host
       socket->remoteIpAddr = *remoteIpAddr;
       socket->remotePort = remotePort;
+      //Index the socket by its remote endpoint
+      socketUpdateHash(socket);
 
       //Select the source address and the relevant network interface
       //to use when establishing the connection
@@ -177,6 +184,19 @@ error_t tcpConnect(Socket *socket, const IpAddr *remoteIpAddr, uint16_t remotePo
       socket->rcvUser = 0;
       socket->rcvWnd = socket->rxBufferSize;
 
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+      //Scale factor to offer in the SYN segment
+      socket->wndScaleOptionReceived = FALSE;
+      socket->sndWndShift = 0;
+      socket->rcvWndShift = tcpComputeWindowShift(socket->rxBufferSize);
+#endif
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+      //Timestamps are offered in the SYN segment
+      socket->tsOptionReceived = FALSE;
+      socket->tsRecent = 0;
+#endif
+
       //Default retransmission timeout
       socket->rto = TCP_INITIAL_RTO;
 
@@ -186,9 +206,11 @@ error_t tcpConnect(Socket *socket, const IpAddr *remoteIpAddr, uint16_t remotePo
       //Initial congestion window
       socket->cwnd = MIN(TCP_INITIAL_WINDOW * socket->smss, socket->txBufferSize);
       //Slow start threshold should be set arbitrarily high
-      socket->ssthresh = UINT16_MAX;
+      socket->ssthresh = UINT32_MAX;
       //Recover is set to the initial send sequence number
       socket->recover = socket->iss;
+      //Reset the state of the congestion control algorithm
+      tcpSetCongestAlgo(socket, socket->congestAlgo);
 #endif
 
       //Send a SYN segment
@@ -246,6 +268,8 @@ error_t tcpListen(Socket *socket, uint_t backlog)
 
    //Place the socket in the listening state
    tcpChangeState(socket, TCP_STATE_LISTEN);
+   //Listening sockets are indexed by local port only
+   socketUpdateHash(socket);
 
    //Successful processing
    return NO_ERROR;
@@ -263,6 +287,7 @@ error_t tcpListen(Socket *socket, uint_t backlog)
 Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
 {
    error_t error;
+   TcpState state;
    Socket *newSocket;
    TcpSynQueueItem *queueItem;
 
@@ -271,7 +296,7 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
       return NULL;
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(socket, TRUE);
 
    //Wait for an connection attempt
    while(1)
@@ -284,12 +309,8 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
          //Reset the event object
          osResetEvent(&socket->event);
 
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
          //Wait until a SYN message is received from a client
-         osWaitForEvent(&socket->event, socket->timeout);
-         //Get exclusive access
-         osAcquireMutex(&netMutex);
+         socketWaitForEvent(socket, socket->timeout);
       }
 
       //Check whether the queue is still empty
@@ -311,13 +332,14 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
          *clientPort = queueItem->srcPort;
 
       //Release exclusive access
-      osReleaseMutex(&netMutex);
+      socketReleaseMutex(socket);
       //Create a new socket to handle the incoming connection request
       newSocket = socketOpen(SOCKET_TYPE_STREAM, SOCKET_IP_PROTO_TCP);
       //Get exclusive access
-      osAcquireMutex(&netMutex);
+      socketAcquireMutex(socket, TRUE);
 
-      //Socket successfully created?
+      //Socket successfully created? Note that the new socket is not visible
+      //to the application yet, so it is initialized under the netMutex alone
       if(newSocket != NULL)
       {
          //The user owns the socket
@@ -326,6 +348,12 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
          //Inherit settings from the listening socket
          newSocket->txBufferSize = socket->txBufferSize;
          newSocket->rxBufferSize = socket->rxBufferSize;
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+         newSocket->delayedAckEnabled = socket->delayedAckEnabled;
+#endif
+#if (TCP_PACING_SUPPORT == ENABLED)
+         newSocket->pacingRate = socket->pacingRate;
+#endif
 
          //Number of chunks that comprise the TX and the RX buffers
          newSocket->txBuffer.maxChunkCount = arraysize(newSocket->txBuffer.chunk);
@@ -355,6 +383,8 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
             //Save the port number and the IP address of the remote host
             newSocket->remoteIpAddr = queueItem->srcAddr;
             newSocket->remotePort = queueItem->srcPort;
+            //Index the socket by its remote endpoint
+            socketUpdateHash(newSocket);
 
             //The SMSS is the size of the largest segment that the sender
             //can transmit
@@ -367,12 +397,51 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
             //Initialize TCP control block
             newSocket->iss = netGetRand();
             newSocket->irs = queueItem->isn;
+
+#if (TCP_SYN_COOKIES_SUPPORT == ENABLED)
+            //The SYN-ACK carried a SYN cookie
+            if(queueItem->synCookie)
+               newSocket->iss = queueItem->iss;
+#endif
+
             newSocket->sndUna = newSocket->iss;
             newSocket->sndNxt = newSocket->iss + 1;
             newSocket->rcvNxt = newSocket->irs + 1;
             newSocket->rcvUser = 0;
             newSocket->rcvWnd = newSocket->rxBufferSize;
 
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+            //Window scaling is used only if the SYN segment of the peer
+            //carried a Window Scale option
+            if(queueItem->wndScaleOptionReceived)
+            {
+               newSocket->wndScaleOptionReceived = TRUE;
+               newSocket->sndWndShift = queueItem->wndShift;
+               newSocket->rcvWndShift = tcpComputeWindowShift(newSocket->rxBufferSize);
+            }
+#endif
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+            //Timestamps are used only if the SYN segment of the peer
+            //carried a Timestamps option
+            if(queueItem->tsOptionReceived)
+            {
+               newSocket->tsOptionReceived = TRUE;
+               newSocket->tsRecent = queueItem->tsVal;
+               newSocket->tsRecentAge = osGetSystemTime();
+
+               //Leave room for the option in every segment
+               newSocket->smss = MAX(newSocket->smss - TCP_TIMESTAMPS_OPTION_LENGTH,
+                  TCP_MIN_MSS);
+            }
+#endif
+
+#if (TCP_SACK_SUPPORT == ENABLED)
+            //SACK is used only if the SYN segment of the peer carried a
+            //SACK Permitted option
+            newSocket->sackPermitted = queueItem->sackPermitted;
+#endif
+
             //Default retransmission timeout
             newSocket->rto = TCP_INITIAL_RTO;
 
@@ -382,13 +451,40 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
             //Initial congestion window
             newSocket->cwnd = MIN(TCP_INITIAL_WINDOW * newSocket->smss, newSocket->txBufferSize);
             //Slow start threshold should be set arbitrarily high
-            newSocket->ssthresh = UINT16_MAX;
+            newSocket->ssthresh = UINT32_MAX;
             //Recover is set to the initial send sequence number
             newSocket->recover = newSocket->iss;
+            //The connection inherits the algorithm of the listening socket
+            tcpSetCongestAlgo(newSocket, socket->congestAlgo);
+#endif
+#if (TCP_SYN_COOKIES_SUPPORT == ENABLED)
+            //Connection completed with a SYN cookie?
+            if(queueItem->synCookie)
+            {
+               //The SYN has already been acknowledged by the peer
+               newSocket->sndUna = newSocket->sndNxt;
+
+               //Initialize the send window from the ACK that completed the
+               //three-way handshake
+               newSocket->sndWnd = queueItem->wnd;
+               newSocket->sndWl1 = newSocket->rcvNxt;
+               newSocket->sndWl2 = newSocket->sndNxt;
+               newSocket->maxSndWnd = newSocket->sndWnd;
+
+               //The connection is established
+               state = TCP_STATE_ESTABLISHED;
+               error = NO_ERROR;
+            }
+            else
 #endif
-            //Send a SYN ACK control segment
-            error = tcpSendSegment(newSocket, TCP_FLAG_SYN | TCP_FLAG_ACK,
-               newSocket->iss, newSocket->rcvNxt, 0, TRUE);
+            {
+               //The connection state should be changed to SYN-RECEIVED
+               state = TCP_STATE_SYN_RECEIVED;
+
+               //Send a SYN ACK control segment
+               error = tcpSendSegment(newSocket, TCP_FLAG_SYN | TCP_FLAG_ACK,
+                  newSocket->iss, newSocket->rcvNxt, 0, TRUE);
+            }
 
             //TCP segment successfully sent?
             if(!error)
@@ -400,8 +496,8 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
                //Update the state of events
                tcpUpdateEvents(socket);
 
-               //The connection state should be changed to SYN-RECEIVED
-               tcpChangeState(newSocket, TCP_STATE_SYN_RECEIVED);
+               //Update the state of the connection
+               tcpChangeState(newSocket, state);
 
                //Number of times TCP connections have made a direct transition to
                //the SYN-RECEIVED state from the LISTEN state
@@ -429,7 +525,7 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort)
    }
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //Return a handle to the newly created socket
    return newSocket;
@@ -452,6 +548,7 @@ error_t tcpSend(Socket *socket, const uint8_t *data,
    uint_t n;
    uint_t totalLength;
    uint_t event;
+   bool_t netLocked;
 
    //Check whether the socket is in the listening state
    if(socket->state == TCP_STATE_LISTEN)
@@ -533,9 +630,22 @@ error_t tcpSend(Socket *socket, const uint8_t *data,
             tcpTimerStart(&socket->overrideTimer, TCP_OVERRIDE_TIMEOUT);
       }
 
-      //The Nagle algorithm should be implemented to coalesce
-      //short segments (refer to RFC 1122 4.2.3.4)
-      tcpNagleAlgo(socket, flags);
+      //Data is copied to the send buffer without holding the netMutex, but
+      //the latter is required to transmit segments
+      netLocked = socketAcquireNetMutex(socket);
+
+      //The connection may have been closed in the meantime
+      if(socket->state == TCP_STATE_ESTABLISHED ||
+         socket->state == TCP_STATE_CLOSE_WAIT)
+      {
+         //The Nagle algorithm should be implemented to coalesce
+         //short segments (refer to RFC 1122 4.2.3.4)
+         tcpNagleAlgo(socket, flags);
+      }
+
+      //Release the netMutex as soon as possible
+      if(netLocked)
+         socketReleaseNetMutex(socket);
 
       //Send as much data as possible
    } while(totalLength < length);
@@ -561,6 +671,80 @@ error_t tcpSend(Socket *socket, const uint8_t *data,
 }
 
 
+/**
+ * @brief Send the contents of a caller-supplied buffer to a connected socket
+ *
+ * When zero-copy transmission is enabled, the data is not copied to the send
+ * buffer. Segments refer to the caller-supplied buffer until the data has
+ * been acknowledged. Buffers shorter than the MSS are still copied
+ *
+ * @param[in] socket Handle that identifies a connected socket
+ * @param[in] buffer Multi-part buffer containing the data to be transmitted.
+ *   The buffer is always released by the stack, even if an error is returned
+ * @param[in] offset Offset to the first data byte
+ * @param[out] written Actual number of bytes written (optional parameter)
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t tcpSendBuffer(Socket *socket, NetBuffer *buffer, size_t offset,
+   size_t *written, uint_t flags)
+{
+   error_t error;
+   uint_t i;
+   size_t n;
+   size_t totalLength;
+
+#if (TCP_ZERO_COPY_TX_SUPPORT == ENABLED)
+   //Short buffers are copied to the send buffer, so that a segment never
+   //refers to more than a few buffers
+   if((netBufferGetLength(buffer) - offset) >= socket->smss)
+   {
+      //Segments refer to the buffer until its data has been acknowledged
+      return tcpQueueTxRef(socket, buffer, offset, written, flags);
+   }
+#endif
+
+   //Initialize variables
+   error = NO_ERROR;
+   totalLength = 0;
+
+   //The data is copied to the send buffer chunk by chunk
+   for(i = 0; i < buffer->chunkCount && !error; i++)
+   {
+      //Skip the chunks that precede the data
+      if(offset >= buffer->chunk[i].length)
+      {
+         offset -= buffer->chunk[i].length;
+      }
+      else
+      {
+         //No data has been written yet
+         n = 0;
+
+         //Copy the current chunk
+         error = tcpSend(socket, (uint8_t *) buffer->chunk[i].address + offset,
+            buffer->chunk[i].length - offset, &n, flags);
+
+         //Update byte counter
+         totalLength += n;
+         //Process the next chunk from its beginning
+         offset = 0;
+      }
+   }
+
+   //Total number of data that have been written
+   if(written != NULL)
+      *written = totalLength;
+
+   //Release the buffer
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
 /**
  * @brief Receive data from a connected socket
  * @param[in] socket Handle that identifies a connected socket
@@ -589,6 +773,12 @@ error_t tcpReceive(Socket *socket, uint8_t *data,
    if(socket->state == TCP_STATE_LISTEN)
       return ERROR_NOT_CONNECTED;
 
+#if (TCP_ZERO_COPY_RX_SUPPORT == ENABLED)
+   //The loaned data must be released first
+   if(socket->rxLoanLength != 0)
+      return ERROR_WRONG_STATE;
+#endif
+
    //Read as much data as possible
    while(*received < size)
    {
@@ -676,13 +866,8 @@ error_t tcpReceive(Socket *socket, uint8_t *data,
 
       //Total number of data that have been read
       *received += n;
-      //Remaining data still available in the receive buffer
-      socket->rcvUser -= n;
-
-      //Update the receive window
-      tcpUpdateReceiveWindow(socket);
-      //Update RX event state
-      tcpUpdateEvents(socket);
+      //Remove the data from the receive buffer and update the window
+      tcpDiscardRxData(socket, n);
 
       //The SOCKET_FLAG_BREAK_CHAR flag causes the function to stop reading
       //data as soon as the specified break character is encountered
@@ -708,6 +893,150 @@ error_t tcpReceive(Socket *socket, uint8_t *data,
 }
 
 
+#if (TCP_ZERO_COPY_RX_SUPPORT == ENABLED)
+
+/**
+ * @brief Loan the application a read-only view of the receive buffer
+ *
+ * The view covers the longest run of contiguous bytes at the head of the
+ * receive buffer. It remains valid until tcpReleaseLoan is called, even if
+ * the connection is reset in the meantime
+ *
+ * @param[in] socket Handle that identifies a connected socket
+ * @param[out] data Pointer to the first byte of the view
+ * @param[out] length Number of bytes in the view
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t tcpReceiveLoan(Socket *socket, const uint8_t **data, size_t *length,
+   uint_t flags)
+{
+   size_t n;
+   size_t offset;
+   uint_t event;
+   uint32_t seqNum;
+   systime_t timeout;
+
+   //Nothing has been loaned yet
+   *data = NULL;
+   *length = 0;
+
+   //Check whether the socket is in the listening state
+   if(socket->state == TCP_STATE_LISTEN)
+      return ERROR_NOT_CONNECTED;
+
+   //Only one view can be loaned at a time
+   if(socket->rxLoanLength != 0)
+      return ERROR_WRONG_STATE;
+
+   //The SOCKET_FLAG_DONT_WAIT enables non-blocking operation
+   timeout = (flags & SOCKET_FLAG_DONT_WAIT) ? 0 : socket->timeout;
+   //Wait for data to be available for reading
+   event = tcpWaitForEvents(socket, SOCKET_EVENT_RX_READY, timeout);
+
+   //A timeout exception occurred?
+   if(event != SOCKET_EVENT_RX_READY)
+      return ERROR_TIMEOUT;
+
+   //Check current TCP state
+   switch(socket->state)
+   {
+   //ESTABLISHED, FIN-WAIT-1 or FIN-WAIT-2 state?
+   case TCP_STATE_ESTABLISHED:
+   case TCP_STATE_FIN_WAIT_1:
+   case TCP_STATE_FIN_WAIT_2:
+      //Sequence number of the first byte to read
+      seqNum = socket->rcvNxt - socket->rcvUser;
+      break;
+
+   //CLOSE-WAIT, LAST-ACK, CLOSING or TIME-WAIT state?
+   case TCP_STATE_CLOSE_WAIT:
+   case TCP_STATE_LAST_ACK:
+   case TCP_STATE_CLOSING:
+   case TCP_STATE_TIME_WAIT:
+      //The user must be satisfied with data already on hand
+      if(!socket->rcvUser)
+         return ERROR_END_OF_STREAM;
+
+      //Sequence number of the first byte to read
+      seqNum = (socket->rcvNxt - 1) - socket->rcvUser;
+      break;
+
+   //CLOSED state?
+   default:
+      //The connection was reset by remote side?
+      if(socket->resetFlag)
+         return ERROR_CONNECTION_RESET;
+      //The connection has not yet been established?
+      if(!socket->closedFlag)
+         return ERROR_NOT_CONNECTED;
+      //The user must be satisfied with data already on hand
+      if(!socket->rcvUser)
+         return ERROR_END_OF_STREAM;
+
+      //Sequence number of the first byte to read
+      seqNum = (socket->rcvNxt - 1) - socket->rcvUser;
+      break;
+   }
+
+   //Sanity check
+   if(!socket->rcvUser)
+      return ERROR_FAILURE;
+
+   //Offset of the first byte to read in the circular buffer
+   offset = (seqNum - socket->irs - 1) % socket->rxBufferSize;
+
+   //Point to the data at the head of the receive buffer
+   *data = netBufferAtEx((NetBuffer *) &socket->rxBuffer, offset, &n);
+
+   //The view must not cross chunk or buffer boundaries
+   n = MIN(n, socket->rxBufferSize - offset);
+   n = MIN(n, socket->rcvUser);
+
+   //The loaned data cannot be overwritten as long as it is not released
+   socket->rxLoanLength = n;
+   *length = n;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Release data loaned by tcpReceiveLoan
+ *
+ * The released bytes are removed from the receive buffer. Any remaining
+ * loaned bytes can be read again
+ *
+ * @param[in] socket Handle that identifies a connected socket
+ * @param[in] length Number of bytes consumed by the application
+ * @return Error code
+ **/
+
+error_t tcpReleaseLoan(Socket *socket, size_t length)
+{
+   //Only the loaned data can be released
+   if(length > socket->rxLoanLength)
+      return ERROR_INVALID_LENGTH;
+
+   //The receive buffer is no longer loaned
+   socket->rxLoanLength = 0;
+
+   //Any data consumed by the application?
+   if(length > 0)
+   {
+      //Remove the data from the receive buffer and update the window
+      tcpDiscardRxData(socket, length);
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+#endif
+
+
 /**
  * @brief Shutdown gracefully reception, transmission, or both
  *
@@ -892,6 +1221,8 @@ error_t tcpAbort(Socket *socket)
       tcpDeleteControlBlock(socket);
       //Mark the socket as closed
       socket->type = SOCKET_TYPE_UNUSED;
+      //Remove the socket from the hash tables
+      socketUpdateHash(socket);
       //Return status code
       return error;
 
@@ -900,6 +1231,12 @@ error_t tcpAbort(Socket *socket)
 #if (TCP_2MSL_TIMER > 0)
       //The user doe not own the socket anymore...
       socket->ownedFlag = FALSE;
+
+#if (TCP_TIME_WAIT_TABLE_SUPPORT == ENABLED)
+      //The connection is moved to the TIME-WAIT table and the socket is
+      //released immediately
+      tcpTimeWaitTransfer(socket);
+#endif
       //TCB will be deleted and socket will be closed
       //when the 2MSL timer will elapse
       return NO_ERROR;
@@ -910,6 +1247,8 @@ error_t tcpAbort(Socket *socket)
       tcpDeleteControlBlock(socket);
       //Mark the socket as closed
       socket->type = SOCKET_TYPE_UNUSED;
+      //Remove the socket from the hash tables
+      socketUpdateHash(socket);
       //No error to report
       return NO_ERROR;
 #endif
@@ -922,6 +1261,8 @@ error_t tcpAbort(Socket *socket)
       tcpDeleteControlBlock(socket);
       //Mark the socket as closed
       socket->type = SOCKET_TYPE_UNUSED;
+      //Remove the socket from the hash tables
+      socketUpdateHash(socket);
       //No error to report
       return NO_ERROR;
    }
@@ -939,13 +1280,13 @@ TcpState tcpGetState(Socket *socket)
    TcpState state;
 
    //Get exclusive access
-   osAcquireMutex(&netMutex);
+   socketAcquireMutex(socket, FALSE);
 
    //Get TCP FSM current state
    state = socket->state;
 
    //Release exclusive access
-   osReleaseMutex(&netMutex);
+   socketReleaseMutex(socket);
 
    //Return current state
    return state;
@@ -977,6 +1318,12 @@ Socket *tcpKillOldestConnection(void)
       //Point to the current socket descriptor
       socket = &socketTable[i];
 
+#if (TCP_ZERO_COPY_RX_SUPPORT == ENABLED)
+      //A socket whose receive buffer is loaned cannot be recycled
+      if(socket->rxLoanLength != 0)
+         continue;
+#endif
+
       //TCP connection found?
       if(socket->type == SOCKET_TYPE_STREAM)
       {
@@ -1002,12 +1349,27 @@ Socket *tcpKillOldestConnection(void)
    //Any connection in the TIME-WAIT state?
    if(oldestSocket != NULL)
    {
+      //Get exclusive access
+      SOCKET_LOCK(oldestSocket);
+
       //Enter CLOSED state
       tcpChangeState(oldestSocket, TCP_STATE_CLOSED);
       //Delete TCB
       tcpDeleteControlBlock(oldestSocket);
+
+#if (SOCKET_EVENT_SET_SUPPORT == ENABLED)
+      //The socket may not have been closed by the application yet. It must
+      //leave its event set before the descriptor is reused
+      socketEventSetDetach(oldestSocket);
+#endif
+
       //Mark the socket as closed
       oldestSocket->type = SOCKET_TYPE_UNUSED;
+      //Remove the socket from the hash tables
+      socketUpdateHash(oldestSocket);
+
+      //Release exclusive access
+      SOCKET_UNLOCK(oldestSocket);
    }
 
    //The oldest connection in the TIME-WAIT state can be reused
@@ -34,6 +34,7 @@
 //Dependencies
 #include "net_config.h"
 #include "core/ip.h"
+#include "core/net_timer.h"
 
 //TCP support
 #ifndef TCP_SUPPORT
@@ -91,6 +92,34 @@
    #error TCP_MAX_RX_BUFFER_SIZE parameter is not valid
 #endif
 
+//Window scale option support
+#ifndef TCP_WINDOW_SCALE_SUPPORT
+   #define TCP_WINDOW_SCALE_SUPPORT ENABLED
+#elif (TCP_WINDOW_SCALE_SUPPORT != ENABLED && TCP_WINDOW_SCALE_SUPPORT != DISABLED)
+   #error TCP_WINDOW_SCALE_SUPPORT parameter is not valid
+#endif
+
+//Receive buffers larger than 64 KB require the window scale option
+#if (TCP_WINDOW_SCALE_SUPPORT == DISABLED && TCP_MAX_RX_BUFFER_SIZE > 65535)
+   #error TCP_MAX_RX_BUFFER_SIZE parameter is not valid
+#elif (TCP_MAX_RX_BUFFER_SIZE > (65535UL << 14))
+   #error TCP_MAX_RX_BUFFER_SIZE parameter is not valid
+#endif
+
+//Timestamps option support
+#ifndef TCP_TIMESTAMPS_SUPPORT
+   #define TCP_TIMESTAMPS_SUPPORT ENABLED
+#elif (TCP_TIMESTAMPS_SUPPORT != ENABLED && TCP_TIMESTAMPS_SUPPORT != DISABLED)
+   #error TCP_TIMESTAMPS_SUPPORT parameter is not valid
+#endif
+
+//Delayed ACK support
+#ifndef TCP_DELAYED_ACK_SUPPORT
+   #define TCP_DELAYED_ACK_SUPPORT ENABLED
+#elif (TCP_DELAYED_ACK_SUPPORT != ENABLED && TCP_DELAYED_ACK_SUPPORT != DISABLED)
+   #error TCP_DELAYED_ACK_SUPPORT parameter is not valid
+#endif
+
 //Default SYN queue size for listening sockets
 #ifndef TCP_DEFAULT_SYN_QUEUE_SIZE
    #define TCP_DEFAULT_SYN_QUEUE_SIZE 4
@@ -105,6 +134,20 @@
    #error TCP_MAX_SYN_QUEUE_SIZE parameter is not valid
 #endif
 
+//SYN cookies support
+#ifndef TCP_SYN_COOKIES_SUPPORT
+   #define TCP_SYN_COOKIES_SUPPORT DISABLED
+#elif (TCP_SYN_COOKIES_SUPPORT != ENABLED && TCP_SYN_COOKIES_SUPPORT != DISABLED)
+   #error TCP_SYN_COOKIES_SUPPORT parameter is not valid
+#endif
+
+//Lifetime of a SYN cookie, in units of 64 seconds
+#ifndef TCP_SYN_COOKIE_MAX_AGE
+   #define TCP_SYN_COOKIE_MAX_AGE 2
+#elif (TCP_SYN_COOKIE_MAX_AGE < 1 || TCP_SYN_COOKIE_MAX_AGE > 31)
+   #error TCP_SYN_COOKIE_MAX_AGE parameter is not valid
+#endif
+
 //Maximum number of retransmissions
 #ifndef TCP_MAX_RETRIES
    #define TCP_MAX_RETRIES 5
@@ -140,6 +183,26 @@
    #error TCP_CONGEST_CONTROL_SUPPORT parameter is not valid
 #endif
 
+//CUBIC congestion control algorithm
+#ifndef TCP_CUBIC_SUPPORT
+   #define TCP_CUBIC_SUPPORT DISABLED
+#elif (TCP_CUBIC_SUPPORT != ENABLED && TCP_CUBIC_SUPPORT != DISABLED)
+   #error TCP_CUBIC_SUPPORT parameter is not valid
+#endif
+
+//BBR congestion control algorithm
+#ifndef TCP_BBR_SUPPORT
+   #define TCP_BBR_SUPPORT DISABLED
+#elif (TCP_BBR_SUPPORT != ENABLED && TCP_BBR_SUPPORT != DISABLED)
+   #error TCP_BBR_SUPPORT parameter is not valid
+#endif
+
+//Alternative algorithms rely on the congestion control framework
+#if (TCP_CONGEST_CONTROL_SUPPORT == DISABLED && \
+   (TCP_CUBIC_SUPPORT == ENABLED || TCP_BBR_SUPPORT == ENABLED))
+   #error TCP_CONGEST_CONTROL_SUPPORT parameter is not valid
+#endif
+
 //Number of duplicate ACKs that triggers fast retransmit algorithm
 #ifndef TCP_FAST_RETRANSMIT_THRES
    #define TCP_FAST_RETRANSMIT_THRES 3
@@ -182,6 +245,13 @@
    #error TCP_OVERRIDE_TIMEOUT parameter is not valid
 #endif
 
+//Delayed ACK timeout (must be less than 0.5 seconds)
+#ifndef TCP_DELAYED_ACK_TIMEOUT
+   #define TCP_DELAYED_ACK_TIMEOUT 200
+#elif (TCP_DELAYED_ACK_TIMEOUT < 10 || TCP_DELAYED_ACK_TIMEOUT >= 500)
+   #error TCP_DELAYED_ACK_TIMEOUT parameter is not valid
+#endif
+
 //FIN-WAIT-2 timer
 #ifndef TCP_FIN_WAIT_2_TIMER
    #define TCP_FIN_WAIT_2_TIMER 4000
@@ -196,6 +266,20 @@
    #error TCP_2MSL_TIMER parameter is not valid
 #endif
 
+//Compact TIME-WAIT state
+#ifndef TCP_TIME_WAIT_TABLE_SUPPORT
+   #define TCP_TIME_WAIT_TABLE_SUPPORT DISABLED
+#elif (TCP_TIME_WAIT_TABLE_SUPPORT != ENABLED && TCP_TIME_WAIT_TABLE_SUPPORT != DISABLED)
+   #error TCP_TIME_WAIT_TABLE_SUPPORT parameter is not valid
+#endif
+
+//Number of connections that can be held in the compact TIME-WAIT state
+#ifndef TCP_TIME_WAIT_TABLE_SIZE
+   #define TCP_TIME_WAIT_TABLE_SIZE 32
+#elif (TCP_TIME_WAIT_TABLE_SIZE < 1)
+   #error TCP_TIME_WAIT_TABLE_SIZE parameter is not valid
+#endif
+
 //Selective acknowledgment support
 #ifndef TCP_SACK_SUPPORT
    #define TCP_SACK_SUPPORT DISABLED
@@ -210,10 +294,108 @@
    #error TCP_MAX_SACK_BLOCKS parameter is not valid
 #endif
 
+//Compute checksums while copying data to and from the socket buffers
+#ifndef TCP_CHECKSUM_COPY_SUPPORT
+   #define TCP_CHECKSUM_COPY_SUPPORT ENABLED
+#elif (TCP_CHECKSUM_COPY_SUPPORT != ENABLED && TCP_CHECKSUM_COPY_SUPPORT != DISABLED)
+   #error TCP_CHECKSUM_COPY_SUPPORT parameter is not valid
+#endif
+
+//Granularity of the partial sums maintained over the send buffer
+#ifndef TCP_TX_CHECKSUM_BLOCK_SIZE
+   #define TCP_TX_CHECKSUM_BLOCK_SIZE 256
+#elif (TCP_TX_CHECKSUM_BLOCK_SIZE < 16 || (TCP_TX_CHECKSUM_BLOCK_SIZE % 2) != 0)
+   #error TCP_TX_CHECKSUM_BLOCK_SIZE parameter is not valid
+#endif
+
+//Zero-copy transmission of caller-supplied buffers
+#ifndef TCP_ZERO_COPY_TX_SUPPORT
+   #define TCP_ZERO_COPY_TX_SUPPORT DISABLED
+#elif (TCP_ZERO_COPY_TX_SUPPORT != ENABLED && TCP_ZERO_COPY_TX_SUPPORT != DISABLED)
+   #error TCP_ZERO_COPY_TX_SUPPORT parameter is not valid
+#endif
+
+//Zero-copy reception (receive buffer loaned to the application)
+#ifndef TCP_ZERO_COPY_RX_SUPPORT
+   #define TCP_ZERO_COPY_RX_SUPPORT DISABLED
+#elif (TCP_ZERO_COPY_RX_SUPPORT != ENABLED && TCP_ZERO_COPY_RX_SUPPORT != DISABLED)
+   #error TCP_ZERO_COPY_RX_SUPPORT parameter is not valid
+#endif
+
+//Generic segmentation offload
+#ifndef TCP_GSO_SUPPORT
+   #define TCP_GSO_SUPPORT DISABLED
+#elif (TCP_GSO_SUPPORT != ENABLED && TCP_GSO_SUPPORT != DISABLED)
+   #error TCP_GSO_SUPPORT parameter is not valid
+#endif
+
+//Maximum amount of data carried by a TCP super-segment
+#ifndef TCP_GSO_MAX_SIZE
+   #define TCP_GSO_MAX_SIZE 16384
+#elif (TCP_GSO_MAX_SIZE < 536 || TCP_GSO_MAX_SIZE > 65455)
+   #error TCP_GSO_MAX_SIZE parameter is not valid
+#endif
+
+//Generic receive offload
+#ifndef TCP_GRO_SUPPORT
+   #define TCP_GRO_SUPPORT DISABLED
+#elif (TCP_GRO_SUPPORT != ENABLED && TCP_GRO_SUPPORT != DISABLED)
+   #error TCP_GRO_SUPPORT parameter is not valid
+#endif
+
+//Maximum number of segments that can be coalesced
+#ifndef TCP_GRO_MAX_SEGMENTS
+   #define TCP_GRO_MAX_SEGMENTS 16
+#elif (TCP_GRO_MAX_SEGMENTS < 2 || TCP_GRO_MAX_SEGMENTS > 32)
+   #error TCP_GRO_MAX_SEGMENTS parameter is not valid
+#endif
+
+//TCP pacing support
+#ifndef TCP_PACING_SUPPORT
+   #define TCP_PACING_SUPPORT DISABLED
+#elif (TCP_PACING_SUPPORT != ENABLED && TCP_PACING_SUPPORT != DISABLED)
+   #error TCP_PACING_SUPPORT parameter is not valid
+#endif
+
+//Default pacing rate, in bytes per second (0 means that segments are not
+//paced, TCP_PACING_RATE_AUTO derives the rate from cwnd and SRTT)
+#ifndef TCP_DEFAULT_PACING_RATE
+   #define TCP_DEFAULT_PACING_RATE 0
+#endif
+
+//Pacing gain applied during slow start, in percent
+#ifndef TCP_PACING_SS_GAIN
+   #define TCP_PACING_SS_GAIN 200
+#elif (TCP_PACING_SS_GAIN < 100)
+   #error TCP_PACING_SS_GAIN parameter is not valid
+#endif
+
+//Pacing gain applied during congestion avoidance, in percent
+#ifndef TCP_PACING_CA_GAIN
+   #define TCP_PACING_CA_GAIN 120
+#elif (TCP_PACING_CA_GAIN < 100)
+   #error TCP_PACING_CA_GAIN parameter is not valid
+#endif
+
+//Number of partial sums maintained over the send buffer
+#define TCP_TX_CHECKSUM_BLOCK_COUNT ((TCP_MAX_TX_BUFFER_SIZE + \
+   TCP_TX_CHECKSUM_BLOCK_SIZE - 1) / TCP_TX_CHECKSUM_BLOCK_SIZE)
+
 //Maximum TCP header length
 #define TCP_MAX_HEADER_LENGTH 60
+//Maximum window scale shift count (refer to RFC 7323, section 2.3)
+#define TCP_MAX_WINDOW_SHIFT 14
+//Length of the Timestamps option, including padding
+#define TCP_TIMESTAMPS_OPTION_LENGTH 12
+//TS.Recent is no longer valid after 24 days of idle time (refer to
+//RFC 7323, section 5.5)
+#define TCP_PAWS_IDLE_TIMEOUT 2073600000
 //Default maximum segment size
 #define TCP_DEFAULT_MSS 536
+//The pacing rate is derived from the congestion window and the RTT
+#define TCP_PACING_RATE_AUTO 0xFFFFFFFF
+//Length of the BBR bottleneck bandwidth filter, in round trips
+#define TCP_BBR_BW_FILTER_LEN 10
 
 //Sequence number comparison macro
 #define TCP_CMP_SEQ(a, b) ((int32_t) ((a) - (b)))
@@ -256,6 +438,31 @@ typedef enum
 } TcpCongestState;
 
 
+/**
+ * @brief Congestion control algorithms
+ **/
+
+typedef enum
+{
+   TCP_CONGEST_ALGO_RENO  = 0,
+   TCP_CONGEST_ALGO_CUBIC = 1,
+   TCP_CONGEST_ALGO_BBR   = 2
+} TcpCongestAlgo;
+
+
+/**
+ * @brief BBR operating modes
+ **/
+
+typedef enum
+{
+   TCP_BBR_MODE_STARTUP   = 0,
+   TCP_BBR_MODE_DRAIN     = 1,
+   TCP_BBR_MODE_PROBE_BW  = 2,
+   TCP_BBR_MODE_PROBE_RTT = 3
+} TcpBbrMode;
+
+
 /**
  * @brief TCP control flags
  **/
@@ -348,6 +555,7 @@ typedef struct
    bool_t running;
    systime_t startTime;
    systime_t interval;
+   NetTimer entry;
 } TcpTimer;
 
 
@@ -360,11 +568,29 @@ typedef struct _TcpQueueItem
    struct _TcpQueueItem *next;
    uint_t length;
    uint_t sacked;
+   bool_t lost;
+   bool_t retransmitted;
    IpPseudoHeader pseudoHeader;
    uint8_t header[TCP_MAX_HEADER_LENGTH];
 } TcpQueueItem;
 
 
+/**
+ * @brief Data held in a caller-supplied buffer
+ **/
+
+typedef struct _TcpTxRef
+{
+   struct _TcpTxRef *next;
+   NetBuffer *buffer;
+   size_t offset;
+   uint32_t seqNum;
+   size_t length;
+   bool_t busy;
+   bool_t linked;
+} TcpTxRef;
+
+
 /**
  * @brief SYN queue item
  **/
@@ -378,6 +604,22 @@ typedef struct _TcpSynQueueItem
    IpAddr destAddr;
    uint32_t isn;
    uint16_t mss;
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+   bool_t wndScaleOptionReceived;
+   uint8_t wndShift;
+#endif
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   bool_t tsOptionReceived;
+   uint32_t tsVal;
+#endif
+#if (TCP_SACK_SUPPORT == ENABLED)
+   bool_t sackPermitted;
+#endif
+#if (TCP_SYN_COOKIES_SUPPORT == ENABLED)
+   bool_t synCookie;
+   uint32_t iss;
+   uint16_t wnd;
+#endif
 } TcpSynQueueItem;
 
 
@@ -392,6 +634,42 @@ typedef struct
 } TcpSackBlock;
 
 
+/**
+ * @brief CUBIC context
+ **/
+
+typedef struct
+{
+   bool_t epochValid;
+   systime_t epochStart;
+   systime_t k;
+   uint32_t wMax;
+   uint32_t originPoint;
+   uint32_t wEst;
+} TcpCubicContext;
+
+
+/**
+ * @brief BBR context
+ **/
+
+typedef struct
+{
+   TcpBbrMode mode;
+   uint32_t btlBw;
+   uint32_t bwSamples[TCP_BBR_BW_FILTER_LEN];
+   uint_t roundCount;
+   systime_t rtProp;
+   systime_t rtPropStamp;
+   uint32_t fullBw;
+   uint_t fullBwCount;
+   bool_t fullPipe;
+   uint_t cycleIndex;
+   systime_t probeRttDone;
+   uint32_t pacingRate;
+} TcpBbrContext;
+
+
 /**
  * @brief Transmit buffer
  **/
@@ -416,9 +694,6 @@ typedef struct
 } TcpRxBuffer;
 
 
-//Tick counter to handle periodic operations
-extern systime_t tcpTickCounter;
-
 //TCP related functions
 error_t tcpInit(void);
 uint16_t tcpGetDynamicPort(void);
@@ -430,9 +705,17 @@ Socket *tcpAccept(Socket *socket, IpAddr *clientIpAddr, uint16_t *clientPort);
 error_t tcpSend(Socket *socket, const uint8_t *data,
    size_t length, size_t *written, uint_t flags);
 
+error_t tcpSendBuffer(Socket *socket, NetBuffer *buffer, size_t offset,
+   size_t *written, uint_t flags);
+
 error_t tcpReceive(Socket *socket, uint8_t *data,
    size_t size, size_t *received, uint_t flags);
 
+error_t tcpReceiveLoan(Socket *socket, const uint8_t **data, size_t *length,
+   uint_t flags);
+
+error_t tcpReleaseLoan(Socket *socket, size_t length);
+
 error_t tcpShutdown(Socket *socket, uint_t how);
 error_t tcpAbort(Socket *socket);
 
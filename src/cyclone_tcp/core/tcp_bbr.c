@@ -0,0 +1,382 @@
+/**
+ * @file tcp_bbr.c
+ * @brief BBR congestion control algorithm
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ *
+ * @section Description
+ *
+ * BBR builds an explicit model of the path from the delivery rate and the
+ * round-trip time, rather than reacting to packet losses. The bottleneck
+ * bandwidth (BtlBw) is a windowed maximum of the delivery rate measured over
+ * the last round trips, and the round-trip propagation time (RTprop) is a
+ * windowed minimum of the RTT samples. The congestion window is sized after
+ * the estimated bandwidth-delay product, and the pacing rate is derived from
+ * BtlBw
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_congest.h"
+#include "core/tcp_bbr.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_BBR_SUPPORT == ENABLED)
+
+//BBR congestion control algorithm
+const TcpCongestControl tcpBbrCongestControl =
+{
+   "bbr",
+   tcpBbrAck,
+   tcpBbrLoss,
+   tcpBbrRttSample,
+   tcpBbrPacingRate
+};
+
+//Pacing gain cycle used in PROBE_BW state, in percent
+static const uint_t tcpBbrPacingGainCycle[TCP_BBR_GAIN_CYCLE_LEN] =
+{
+   125, 75, 100, 100, 100, 100, 100, 100
+};
+
+
+/**
+ * @brief BBR congestion window update
+ * @param[in] socket Handle referencing the socket
+ * @param[in] n Number of bytes acknowledged by the incoming ACK
+ * @param[in] roundFlag A round-trip has been completed
+ **/
+
+void tcpBbrAck(Socket *socket, uint_t n, bool_t roundFlag)
+{
+   uint_t pacingGain;
+   uint_t cwndGain;
+   uint32_t target;
+   uint32_t minCwnd;
+   TcpBbrContext *context;
+
+   //Point to the BBR context
+   context = &socket->bbrContext;
+
+   //The delivery rate is sampled once per round trip
+   if(roundFlag)
+   {
+      //Update the bottleneck bandwidth estimate
+      tcpBbrUpdateBtlBw(socket);
+   }
+
+   //Update the state machine
+   tcpBbrUpdateMode(socket);
+
+   //Select the gains that apply to the current state
+   if(context->mode == TCP_BBR_MODE_STARTUP)
+   {
+      pacingGain = TCP_BBR_HIGH_GAIN;
+      cwndGain = TCP_BBR_HIGH_GAIN;
+   }
+   else if(context->mode == TCP_BBR_MODE_DRAIN)
+   {
+      //The window is also capped at the BDP, so that the queue drains even
+      //when segments are not paced
+      pacingGain = TCP_BBR_DRAIN_GAIN;
+      cwndGain = 100;
+   }
+   else if(context->mode == TCP_BBR_MODE_PROBE_BW)
+   {
+      pacingGain = tcpBbrPacingGainCycle[context->cycleIndex];
+      cwndGain = TCP_BBR_CWND_GAIN;
+   }
+   else
+   {
+      pacingGain = 100;
+      cwndGain = 100;
+   }
+
+   //Derive the pacing rate from the bottleneck bandwidth
+   if(context->btlBw > 0)
+   {
+      context->pacingRate = (uint32_t) ((uint64_t) context->btlBw *
+         pacingGain / 100);
+   }
+   else if(socket->srtt > 0)
+   {
+      //No delivery rate sample is available yet
+      context->pacingRate = (uint32_t) ((uint64_t) socket->cwnd *
+         TCP_BBR_HIGH_GAIN * 10 / socket->srtt);
+   }
+   else
+   {
+      //Do not pace segments
+      context->pacingRate = 0;
+   }
+
+   //Target congestion window (the BDP plus some headroom for delayed and
+   //stretched ACKs)
+   target = tcpBbrGetBdp(socket);
+
+   if(target > 0)
+   {
+      target = (uint32_t) ((uint64_t) target * cwndGain / 100) +
+         3 * socket->smss;
+   }
+
+   //Once the pipe is full, the window tracks the target
+   if(context->fullPipe && target > 0)
+   {
+      socket->cwnd = MIN(socket->cwnd + n, target);
+   }
+   else if(target == 0 || socket->cwnd < target)
+   {
+      //Grow the window as long as the model is being built
+      socket->cwnd += n;
+   }
+
+   //Minimum congestion window
+   minCwnd = TCP_BBR_MIN_CWND * socket->smss;
+
+   //The window must not fall below the minimum value
+   socket->cwnd = MAX(socket->cwnd, minCwnd);
+
+   //The amount of data in flight is reduced while probing RTprop
+   if(context->mode == TCP_BBR_MODE_PROBE_RTT)
+      socket->cwnd = MIN(socket->cwnd, minCwnd);
+}
+
+
+/**
+ * @brief BBR slow start threshold computation
+ * @param[in] socket Handle referencing the socket
+ * @return New value of the slow start threshold
+ **/
+
+uint32_t tcpBbrLoss(Socket *socket)
+{
+   uint_t flightSize;
+
+   //Amount of data that has been sent but not yet acknowledged
+   flightSize = socket->sndNxt - socket->sndUna;
+
+   //BBR does not use losses as a congestion signal. Packet conservation
+   //applies during recovery
+   return MAX(flightSize, 2 * socket->smss);
+}
+
+
+/**
+ * @brief Process a new RTT sample
+ * @param[in] socket Handle referencing the socket
+ * @param[in] r Round-trip time measurement
+ **/
+
+void tcpBbrRttSample(Socket *socket, systime_t r)
+{
+   bool_t expired;
+   systime_t time;
+   TcpBbrContext *context;
+
+   //Point to the BBR context
+   context = &socket->bbrContext;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //A null RTT cannot be distinguished from a missing estimate
+   r = MAX(r, 1);
+
+   //Check whether the RTprop estimate is outdated
+   expired = (context->rtProp != 0 &&
+      timeCompare(time, context->rtPropStamp + TCP_BBR_RTPROP_FILTER_LEN) > 0);
+
+   //Windowed minimum filter
+   if(context->rtProp == 0 || r <= context->rtProp || expired)
+   {
+      context->rtProp = r;
+      context->rtPropStamp = time;
+   }
+
+   //RTprop has not been refreshed for a while?
+   if(expired && context->mode != TCP_BBR_MODE_PROBE_RTT)
+   {
+      //Drain the queue so that the propagation delay can be measured
+      context->mode = TCP_BBR_MODE_PROBE_RTT;
+      context->probeRttDone = time + TCP_BBR_PROBE_RTT_DURATION;
+   }
+}
+
+
+/**
+ * @brief Retrieve the pacing rate
+ * @param[in] socket Handle referencing the socket
+ * @return Pacing rate, in bytes per second
+ **/
+
+uint32_t tcpBbrPacingRate(Socket *socket)
+{
+   //Return the pacing rate computed from the model
+   return socket->bbrContext.pacingRate;
+}
+
+
+/**
+ * @brief Update the bottleneck bandwidth estimate
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpBbrUpdateBtlBw(Socket *socket)
+{
+   uint_t i;
+   systime_t interval;
+   uint32_t bw;
+   TcpBbrContext *context;
+
+   //Point to the BBR context
+   context = &socket->bbrContext;
+
+   //Time elapsed since the timed segment was sent
+   interval = osGetSystemTime() - socket->rttStartTime;
+
+   //Delivery rate over the last round trip, in bytes per second
+   if(interval > 0)
+      bw = (uint32_t) MIN((uint64_t) socket->n * 1000 / interval, UINT32_MAX);
+   else
+      bw = 0;
+
+   //Save the sample
+   context->bwSamples[context->roundCount % TCP_BBR_BW_FILTER_LEN] = bw;
+   context->roundCount++;
+
+   //Windowed maximum filter
+   for(context->btlBw = 0, i = 0; i < TCP_BBR_BW_FILTER_LEN; i++)
+   {
+      context->btlBw = MAX(context->btlBw, context->bwSamples[i]);
+   }
+
+   //Check whether the bottleneck bandwidth is still growing
+   if(!context->fullPipe)
+   {
+      if((uint64_t) context->btlBw * 4 >= (uint64_t) context->fullBw * 5)
+      {
+         //The bandwidth grew by at least 25%
+         context->fullBw = context->btlBw;
+         context->fullBwCount = 0;
+      }
+      else
+      {
+         //The pipe is full after several rounds without significant growth
+         if(++context->fullBwCount >= TCP_BBR_FULL_BW_COUNT)
+            context->fullPipe = TRUE;
+      }
+   }
+
+   //Advance the pacing gain cycle once per round trip
+   if(context->mode == TCP_BBR_MODE_PROBE_BW)
+   {
+      context->cycleIndex = (context->cycleIndex + 1) % TCP_BBR_GAIN_CYCLE_LEN;
+   }
+}
+
+
+/**
+ * @brief Update BBR state machine
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpBbrUpdateMode(Socket *socket)
+{
+   uint_t flightSize;
+   TcpBbrContext *context;
+
+   //Point to the BBR context
+   context = &socket->bbrContext;
+
+   //Amount of data that has been sent but not yet acknowledged
+   flightSize = socket->sndNxt - socket->sndUna;
+
+   //Check current state
+   if(context->mode == TCP_BBR_MODE_STARTUP)
+   {
+      //Drain the queue created during startup once the pipe is full
+      if(context->fullPipe)
+         context->mode = TCP_BBR_MODE_DRAIN;
+   }
+   else if(context->mode == TCP_BBR_MODE_DRAIN)
+   {
+      //Enter steady state once the amount of data in flight matches the BDP
+      if(flightSize <= tcpBbrGetBdp(socket))
+      {
+         context->mode = TCP_BBR_MODE_PROBE_BW;
+         //Skip the draining phase of the gain cycle
+         context->cycleIndex = 2;
+      }
+   }
+   else if(context->mode == TCP_BBR_MODE_PROBE_RTT)
+   {
+      //PROBE_RTT lasts for a fixed amount of time
+      if(timeCompare(osGetSystemTime(), context->probeRttDone) >= 0)
+      {
+         //Resume probing for bandwidth
+         if(context->fullPipe)
+            context->mode = TCP_BBR_MODE_PROBE_BW;
+         else
+            context->mode = TCP_BBR_MODE_STARTUP;
+
+         //The RTprop estimate is now up to date
+         context->rtPropStamp = osGetSystemTime();
+      }
+   }
+   else
+   {
+      //Nothing to do
+   }
+}
+
+
+/**
+ * @brief Estimate the bandwidth-delay product
+ * @param[in] socket Handle referencing the socket
+ * @return BDP, in bytes (0 if the model is not available yet)
+ **/
+
+uint32_t tcpBbrGetBdp(Socket *socket)
+{
+   TcpBbrContext *context;
+
+   //Point to the BBR context
+   context = &socket->bbrContext;
+
+   //BDP = BtlBw * RTprop
+   return (uint32_t) MIN((uint64_t) context->btlBw * context->rtProp / 1000,
+      UINT32_MAX);
+}
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * @file tcp_bbr.h
+ * @brief BBR congestion control algorithm
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+#ifndef _TCP_BBR_H
+#define _TCP_BBR_H
+
+//Dependencies
+#include "core/tcp.h"
+#include "core/tcp_congest.h"
+
+//Pacing and cwnd gain used during startup, in percent (2 / ln(2))
+#define TCP_BBR_HIGH_GAIN 289
+//Pacing gain used to drain the queue built during startup, in percent
+#define TCP_BBR_DRAIN_GAIN 35
+//Cwnd gain used in steady state, in percent
+#define TCP_BBR_CWND_GAIN 200
+//Number of phases of the pacing gain cycle
+#define TCP_BBR_GAIN_CYCLE_LEN 8
+//Number of rounds without bandwidth growth before the pipe is deemed full
+#define TCP_BBR_FULL_BW_COUNT 3
+//Validity of the RTprop estimate, in milliseconds
+#define TCP_BBR_RTPROP_FILTER_LEN 10000
+//Duration of the PROBE_RTT state, in milliseconds
+#define TCP_BBR_PROBE_RTT_DURATION 200
+//Minimum congestion window, in segments
+#define TCP_BBR_MIN_CWND 4
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//BBR congestion control algorithm
+extern const TcpCongestControl tcpBbrCongestControl;
+
+//BBR related functions
+void tcpBbrAck(Socket *socket, uint_t n, bool_t roundFlag);
+uint32_t tcpBbrLoss(Socket *socket);
+void tcpBbrRttSample(Socket *socket, systime_t r);
+uint32_t tcpBbrPacingRate(Socket *socket);
+
+void tcpBbrUpdateBtlBw(Socket *socket);
+void tcpBbrUpdateMode(Socket *socket);
+uint32_t tcpBbrGetBdp(Socket *socket);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,308 @@
+/**
+ * @file tcp_congest.c
+ * @brief TCP congestion control framework
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * The congestion control algorithm used by a TCP connection is selected on
+ * a per-socket basis. The core of the stack takes care of loss detection
+ * and recovery (refer to RFC 5681, RFC 6582 and RFC 6675), and invokes the
+ * algorithm whenever new data is acknowledged, a loss is detected or a RTT
+ * sample is taken. Reno is used by default
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_congest.h"
+#include "core/tcp_cubic.h"
+#include "core/tcp_bbr.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+
+//Reno congestion control algorithm
+const TcpCongestControl tcpRenoCongestControl =
+{
+   "reno",
+   tcpRenoAck,
+   tcpRenoLoss,
+   NULL,
+   NULL
+};
+
+
+/**
+ * @brief Retrieve the callbacks of a given congestion control algorithm
+ * @param[in] algo Congestion control algorithm
+ * @return Pointer to the algorithm, or NULL if it is not supported
+ **/
+
+const TcpCongestControl *tcpGetCongestControl(TcpCongestAlgo algo)
+{
+   const TcpCongestControl *congestControl;
+
+   //Check algorithm
+   if(algo == TCP_CONGEST_ALGO_RENO)
+   {
+      //Reno is always available
+      congestControl = &tcpRenoCongestControl;
+   }
+#if (TCP_CUBIC_SUPPORT == ENABLED)
+   else if(algo == TCP_CONGEST_ALGO_CUBIC)
+   {
+      //CUBIC algorithm
+      congestControl = &tcpCubicCongestControl;
+   }
+#endif
+#if (TCP_BBR_SUPPORT == ENABLED)
+   else if(algo == TCP_CONGEST_ALGO_BBR)
+   {
+      //BBR algorithm
+      congestControl = &tcpBbrCongestControl;
+   }
+#endif
+   else
+   {
+      //Unknown algorithm
+      congestControl = NULL;
+   }
+
+   //Return a pointer to the algorithm
+   return congestControl;
+}
+
+
+/**
+ * @brief Select the congestion control algorithm of a socket
+ * @param[in] socket Handle referencing the socket
+ * @param[in] algo Congestion control algorithm
+ * @return Error code
+ **/
+
+error_t tcpSetCongestAlgo(Socket *socket, TcpCongestAlgo algo)
+{
+   //Make sure the algorithm is supported
+   if(tcpGetCongestControl(algo) == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Save the algorithm to be used
+   socket->congestAlgo = algo;
+
+#if (TCP_CUBIC_SUPPORT == ENABLED)
+   //Reset CUBIC context
+   osMemset(&socket->cubicContext, 0, sizeof(TcpCubicContext));
+#endif
+
+#if (TCP_BBR_SUPPORT == ENABLED)
+   //Reset BBR context
+   osMemset(&socket->bbrContext, 0, sizeof(TcpBbrContext));
+#endif
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Look up a congestion control algorithm by name
+ * @param[in] name Name of the algorithm (not necessarily NULL-terminated)
+ * @param[in] length Maximum length of the name
+ * @param[out] algo Congestion control algorithm
+ * @return Error code
+ **/
+
+error_t tcpGetCongestAlgoByName(const char_t *name, size_t length,
+   TcpCongestAlgo *algo)
+{
+   uint_t i;
+   size_t n;
+   const TcpCongestControl *congestControl;
+
+   //The name may or may not be terminated by a NULL character
+   n = 0;
+   while(n < length && name[n] != '\0')
+      n++;
+
+   //Loop through the supported algorithms
+   for(i = TCP_CONGEST_ALGO_RENO; i <= TCP_CONGEST_ALGO_BBR; i++)
+   {
+      //Point to the current algorithm
+      congestControl = tcpGetCongestControl((TcpCongestAlgo) i);
+
+      //Matching name?
+      if(congestControl != NULL && osStrlen(congestControl->name) == n &&
+         !osStrncmp(congestControl->name, name, n))
+      {
+         //Return the corresponding algorithm
+         *algo = (TcpCongestAlgo) i;
+         //Successful processing
+         return NO_ERROR;
+      }
+   }
+
+   //The algorithm is not supported
+   return ERROR_NOT_FOUND;
+}
+
+
+/**
+ * @brief Update the congestion window when new data is acknowledged
+ * @param[in] socket Handle referencing the socket
+ * @param[in] n Number of bytes acknowledged by the incoming ACK
+ * @param[in] roundFlag A round-trip has been completed
+ **/
+
+void tcpCongestOnAck(Socket *socket, uint_t n, bool_t roundFlag)
+{
+   const TcpCongestControl *congestControl;
+
+   //Point to the congestion control algorithm
+   congestControl = tcpGetCongestControl(socket->congestAlgo);
+
+   //Invoke the relevant callback
+   if(congestControl != NULL)
+      congestControl->ack(socket, n, roundFlag);
+}
+
+
+/**
+ * @brief Compute the slow start threshold after a loss has been detected
+ * @param[in] socket Handle referencing the socket
+ * @return New value of the slow start threshold
+ **/
+
+uint32_t tcpCongestOnLoss(Socket *socket)
+{
+   const TcpCongestControl *congestControl;
+
+   //Point to the congestion control algorithm
+   congestControl = tcpGetCongestControl(socket->congestAlgo);
+
+   //Invoke the relevant callback
+   if(congestControl != NULL)
+      return congestControl->loss(socket);
+   else
+      return tcpRenoLoss(socket);
+}
+
+
+/**
+ * @brief Report a new RTT sample to the congestion control algorithm
+ * @param[in] socket Handle referencing the socket
+ * @param[in] r Round-trip time measurement
+ **/
+
+void tcpCongestOnRttSample(Socket *socket, systime_t r)
+{
+   const TcpCongestControl *congestControl;
+
+   //Point to the congestion control algorithm
+   congestControl = tcpGetCongestControl(socket->congestAlgo);
+
+   //The callback is optional
+   if(congestControl != NULL && congestControl->rttSample != NULL)
+      congestControl->rttSample(socket, r);
+}
+
+
+/**
+ * @brief Retrieve the pacing rate requested by the congestion control algorithm
+ * @param[in] socket Handle referencing the socket
+ * @return Pacing rate, in bytes per second (0 means that segments are not
+ *   paced)
+ **/
+
+uint32_t tcpCongestGetPacingRate(Socket *socket)
+{
+   const TcpCongestControl *congestControl;
+
+   //Point to the congestion control algorithm
+   congestControl = tcpGetCongestControl(socket->congestAlgo);
+
+   //The callback is optional
+   if(congestControl != NULL && congestControl->pacingRate != NULL)
+      return congestControl->pacingRate(socket);
+   else
+      return 0;
+}
+
+
+/**
+ * @brief Reno congestion window update
+ * @param[in] socket Handle referencing the socket
+ * @param[in] n Number of bytes acknowledged by the incoming ACK
+ * @param[in] roundFlag A round-trip has been completed
+ **/
+
+void tcpRenoAck(Socket *socket, uint_t n, bool_t roundFlag)
+{
+   //Slow start algorithm is used when cwnd is lower than ssthresh
+   if(socket->cwnd < socket->ssthresh)
+   {
+      //During slow start, TCP increments cwnd by at most SMSS bytes
+      //for each ACK received that cumulatively acknowledges new data
+      socket->cwnd += MIN(n, socket->smss);
+   }
+   //Congestion avoidance algorithm is used when cwnd exceeds ssthres
+   else
+   {
+      //Congestion window is updated once per RTT
+      if(roundFlag)
+      {
+         //TCP must not increment cwnd by more than SMSS bytes
+         socket->cwnd += MIN(socket->n, socket->smss);
+      }
+   }
+}
+
+
+/**
+ * @brief Reno slow start threshold computation
+ * @param[in] socket Handle referencing the socket
+ * @return New value of the slow start threshold
+ **/
+
+uint32_t tcpRenoLoss(Socket *socket)
+{
+   uint_t flightSize;
+
+   //Amount of data that has been sent but not yet acknowledged
+   flightSize = socket->sndNxt - socket->sndUna;
+
+   //When a loss is detected, ssthresh must be set to no more than half the
+   //flight size (refer to RFC 5681, section 3.1)
+   return MAX(flightSize / 2, 2 * socket->smss);
+}
+
+#endif
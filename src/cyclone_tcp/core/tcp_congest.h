@@ -0,0 +1,86 @@
+/**
+ * @file tcp_congest.h
+ * @brief TCP congestion control framework
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+#ifndef _TCP_CONGEST_H
+#define _TCP_CONGEST_H
+
+//Dependencies
+#include "core/tcp.h"
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Congestion control callbacks
+ **/
+
+typedef void (*TcpCongestAck)(Socket *socket, uint_t n, bool_t roundFlag);
+typedef uint32_t (*TcpCongestLoss)(Socket *socket);
+typedef void (*TcpCongestRttSample)(Socket *socket, systime_t r);
+typedef uint32_t (*TcpCongestPacingRate)(Socket *socket);
+
+
+/**
+ * @brief Congestion control algorithm
+ **/
+
+typedef struct
+{
+   const char_t *name;
+   TcpCongestAck ack;
+   TcpCongestLoss loss;
+   TcpCongestRttSample rttSample;
+   TcpCongestPacingRate pacingRate;
+} TcpCongestControl;
+
+
+//Congestion control related functions
+const TcpCongestControl *tcpGetCongestControl(TcpCongestAlgo algo);
+error_t tcpSetCongestAlgo(Socket *socket, TcpCongestAlgo algo);
+error_t tcpGetCongestAlgoByName(const char_t *name, size_t length,
+   TcpCongestAlgo *algo);
+
+void tcpCongestOnAck(Socket *socket, uint_t n, bool_t roundFlag);
+uint32_t tcpCongestOnLoss(Socket *socket);
+void tcpCongestOnRttSample(Socket *socket, systime_t r);
+uint32_t tcpCongestGetPacingRate(Socket *socket);
+
+void tcpRenoAck(Socket *socket, uint_t n, bool_t roundFlag);
+uint32_t tcpRenoLoss(Socket *socket);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
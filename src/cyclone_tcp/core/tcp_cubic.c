@@ -0,0 +1,233 @@
+/**
+ * @file tcp_cubic.c
+ * @brief CUBIC congestion control algorithm
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * CUBIC grows the congestion window as a cubic function of the time elapsed
+ * since the last congestion event, which makes it far less dependent on the
+ * RTT than Reno on long fat networks. Refer to RFC 9438 for more details
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_congest.h"
+#include "core/tcp_cubic.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_CUBIC_SUPPORT == ENABLED)
+
+//CUBIC congestion control algorithm
+const TcpCongestControl tcpCubicCongestControl =
+{
+   "cubic",
+   tcpCubicAck,
+   tcpCubicLoss,
+   NULL,
+   NULL
+};
+
+
+/**
+ * @brief CUBIC congestion window update
+ * @param[in] socket Handle referencing the socket
+ * @param[in] n Number of bytes acknowledged by the incoming ACK
+ * @param[in] roundFlag A round-trip has been completed
+ **/
+
+void tcpCubicAck(Socket *socket, uint_t n, bool_t roundFlag)
+{
+   int64_t d;
+   int64_t delta;
+   uint32_t target;
+   TcpCubicContext *context;
+
+   //Point to the CUBIC context
+   context = &socket->cubicContext;
+
+   //Slow start algorithm is used when cwnd is lower than ssthresh
+   if(socket->cwnd < socket->ssthresh)
+   {
+      //During slow start, TCP increments cwnd by at most SMSS bytes
+      //for each ACK received that cumulatively acknowledges new data
+      socket->cwnd += MIN(n, socket->smss);
+   }
+   else
+   {
+      //Beginning of a new congestion avoidance stage?
+      if(!context->epochValid)
+      {
+         //Record the start time of the current stage
+         context->epochStart = osGetSystemTime();
+         context->epochValid = TRUE;
+
+         //Check whether the window is below the one reached before the last
+         //congestion event
+         if(socket->cwnd < context->wMax)
+         {
+            //Time period that the cubic function takes to increase the
+            //window back to W_max (with C = 0.4)
+            context->k = tcpCubicRoot((uint64_t) (context->wMax - socket->cwnd) *
+               2500000000ULL / socket->smss);
+
+            //The plateau of the cubic function is W_max
+            context->originPoint = context->wMax;
+         }
+         else
+         {
+            //The window grows immediately
+            context->k = 0;
+            context->originPoint = socket->cwnd;
+         }
+
+         //Initialize the Reno-friendly estimate
+         context->wEst = socket->cwnd;
+      }
+
+      //Distance to the plateau, one RTT ahead
+      d = (int64_t) (osGetSystemTime() - context->epochStart + socket->srtt) -
+         (int64_t) context->k;
+
+      //Bound the distance so that the cube does not overflow
+      d = MIN(d, TCP_CUBIC_MAX_DELTA);
+      d = MAX(d, -TCP_CUBIC_MAX_DELTA);
+
+      //Evaluate C * (t - K)^3, with C = 0.4 segments per second cubed
+      delta = ((d * d * d) / 1000000) * 4 * socket->smss / 10000;
+
+      //Compute the target window
+      if(delta < 0 && (uint32_t) -delta >= context->originPoint)
+         target = socket->cwnd;
+      else
+         target = (uint32_t) MIN(context->originPoint + delta, UINT32_MAX);
+
+      //The target must lie between cwnd and 1.5 * cwnd
+      target = MAX(target, socket->cwnd);
+      target = MIN(target, socket->cwnd + socket->cwnd / 2);
+
+      //Update the window that Reno would have reached, using the additive
+      //increase factor 3 * (1 - beta) / (1 + beta) = 9 / 17
+      context->wEst += (uint32_t) ((uint64_t) 9 * n * socket->smss /
+         (17 * (uint64_t) socket->cwnd));
+
+      //Reno-friendly region?
+      if(target < context->wEst)
+      {
+         //The window must not be lower than the one of Reno
+         socket->cwnd = context->wEst;
+      }
+      else
+      {
+         //Grow the window toward the target, by (target - cwnd) / cwnd
+         //segments for each segment acknowledged
+         socket->cwnd += (uint32_t) ((uint64_t) (target - socket->cwnd) * n /
+            socket->cwnd);
+      }
+   }
+}
+
+
+/**
+ * @brief CUBIC slow start threshold computation
+ * @param[in] socket Handle referencing the socket
+ * @return New value of the slow start threshold
+ **/
+
+uint32_t tcpCubicLoss(Socket *socket)
+{
+   TcpCubicContext *context;
+
+   //Point to the CUBIC context
+   context = &socket->cubicContext;
+
+   //A new congestion avoidance stage will begin after recovery
+   context->epochValid = FALSE;
+
+   //With fast convergence, a flow that did not reach its previous plateau
+   //releases some bandwidth to new flows (refer to RFC 9438, section 4.7)
+   if(socket->cwnd < context->wMax)
+   {
+      context->wMax = (uint32_t) ((uint64_t) socket->cwnd *
+         (TCP_CUBIC_BETA_DEN + TCP_CUBIC_BETA_NUM) / (2 * TCP_CUBIC_BETA_DEN));
+   }
+   else
+   {
+      context->wMax = socket->cwnd;
+   }
+
+   //Multiplicative decrease
+   return MAX((uint32_t) ((uint64_t) socket->cwnd * TCP_CUBIC_BETA_NUM /
+      TCP_CUBIC_BETA_DEN), 2 * socket->smss);
+}
+
+
+/**
+ * @brief Integer cube root
+ * @param[in] x Input value
+ * @return Largest integer whose cube does not exceed x
+ **/
+
+uint32_t tcpCubicRoot(uint64_t x)
+{
+   int_t i;
+   uint64_t y;
+   uint64_t b;
+   uint32_t r;
+
+   //Initialize result
+   r = 0;
+
+   //Compute the root one bit at a time, starting with the most significant
+   //bit (the cube root of a 64-bit value fits in 22 bits)
+   for(i = 21; i >= 0; i--)
+   {
+      //Candidate value
+      y = r | (1UL << i);
+
+      //The cube of any value greater than 2642245 does not fit in 64 bits
+      if(y <= 2642245)
+      {
+         //Keep the bit if the cube does not exceed the input value
+         b = y * y * y;
+
+         if(b <= x)
+            r = (uint32_t) y;
+      }
+   }
+
+   //Return the cube root
+   return r;
+}
+
+#endif
@@ -50,6 +50,8 @@
 #include "core/tcp_fsm.h"
 #include "core/tcp_misc.h"
 #include "core/tcp_timer.h"
+#include "core/tcp_time_wait.h"
+#include "core/tcp_syn_cookie.h"
 #include "ipv4/ipv4.h"
 #include "ipv4/ipv4_misc.h"
 #include "ipv6/ipv6.h"
@@ -75,10 +77,8 @@
 void tcpProcessSegment(NetInterface *interface, IpPseudoHeader *pseudoHeader,
    const NetBuffer *buffer, size_t offset, NetAncillaryData *ancillary)
 {
-   uint_t i;
    size_t length;
    Socket *socket;
-   Socket *passiveSocket;
    TcpHeader *segment;
 
    //Total number of segments received, including those received in error
@@ -152,9 +152,24 @@ void tcpProcessSegment(NetInterface *interface, IpPseudoHeader *pseudoHeader,
       return;
    }
 
-   //Verify TCP checksum
-   if(ipCalcUpperLayerChecksumEx(pseudoHeader->data,
-      pseudoHeader->length, buffer, offset, length) != 0x0000)
+   //Search the hash tables for a matching connection
+   socket = socketLookup(SOCKET_TYPE_STREAM, interface, pseudoHeader,
+      ntohs(segment->destPort), ntohs(segment->srcPort));
+
+   //If no matching socket has been found then try to
+   //use the first matching socket in the LISTEN state
+   if(socket == NULL)
+      socket = socketLookupListener(interface, pseudoHeader, ntohs(segment->destPort));
+
+   //Get exclusive access to the matching socket
+   if(socket != NULL)
+   {
+      SOCKET_LOCK(socket);
+   }
+
+   //Verify TCP checksum (the payload of in-order segments is copied to the
+   //receive buffer at the same time)
+   if(tcpVerifyChecksum(socket, pseudoHeader, buffer, offset, length))
    {
       //Debug message
       TRACE_WARNING("Wrong TCP header checksum!\r\n");
@@ -163,108 +178,16 @@ void tcpProcessSegment(NetInterface *interface, IpPseudoHeader *pseudoHeader,
       MIB2_INC_COUNTER32(tcpGroup.tcpInErrs, 1);
       TCP_MIB_INC_COUNTER32(tcpInErrs, 1);
 
-      //Exit immediately
-      return;
-   }
-
-   //No matching socket in the LISTEN state for the moment
-   passiveSocket = NULL;
-
-   //Look through opened sockets
-   for(i = 0; i < SOCKET_MAX_COUNT; i++)
-   {
-      //Point to the current socket
-      socket = socketTable + i;
-
-      //TCP socket found?
-      if(socket->type != SOCKET_TYPE_STREAM)
-         continue;
-      //Check whether the socket is bound to a particular interface
-      if(socket->interface && socket->interface != interface)
-         continue;
-      //Check destination port number
-      if(socket->localPort == 0 || socket->localPort != ntohs(segment->destPort))
-         continue;
-
-#if (IPV4_SUPPORT == ENABLED)
-      //IPv4 packet received?
-      if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
-      {
-         //Destination IP address filtering
-         if(socket->localIpAddr.length != 0)
-         {
-            //An IPv4 address is expected
-            if(socket->localIpAddr.length != sizeof(Ipv4Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(socket->localIpAddr.ipv4Addr != pseudoHeader->ipv4Data.destAddr)
-               continue;
-         }
-
-         //Source IP address filtering
-         if(socket->remoteIpAddr.length != 0)
-         {
-            //An IPv4 address is expected
-            if(socket->remoteIpAddr.length != sizeof(Ipv4Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(socket->remoteIpAddr.ipv4Addr != pseudoHeader->ipv4Data.srcAddr)
-               continue;
-         }
-      }
-      else
-#endif
-#if (IPV6_SUPPORT == ENABLED)
-      //IPv6 packet received?
-      if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
-      {
-         //Destination IP address filtering
-         if(socket->localIpAddr.length != 0)
-         {
-            //An IPv6 address is expected
-            if(socket->localIpAddr.length != sizeof(Ipv6Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(!ipv6CompAddr(&socket->localIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.destAddr))
-               continue;
-         }
-
-         //Source IP address filtering
-         if(socket->remoteIpAddr.length != 0)
-         {
-            //An IPv6 address is expected
-            if(socket->remoteIpAddr.length != sizeof(Ipv6Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(!ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.srcAddr))
-               continue;
-         }
-      }
-      else
-#endif
-      //Invalid packet received?
+      //Release exclusive access
+      if(socket != NULL)
       {
-         //This should never occur...
-         continue;
+         SOCKET_UNLOCK(socket);
       }
 
-      //Keep track of the first matching socket in the LISTEN state
-      if(socket->state == TCP_STATE_LISTEN && passiveSocket == NULL)
-         passiveSocket = socket;
-
-      //Source port filtering
-      if(socket->remotePort != ntohs(segment->srcPort))
-         continue;
-
-      //A matching socket has been found
-      break;
+      //Exit immediately
+      return;
    }
 
-   //If no matching socket has been found then try to
-   //use the first matching socket in the LISTEN state
-   if(i >= SOCKET_MAX_COUNT)
-      socket = passiveSocket;
-
    //Offset to the first data byte
    offset += segment->dataOffset * 4;
    //Calculate the length of the data
@@ -288,6 +211,25 @@ void tcpProcessSegment(NetInterface *interface, IpPseudoHeader *pseudoHeader,
    segment->window = ntohs(segment->window);
    segment->urgentPointer = ntohs(segment->urgentPointer);
 
+#if (TCP_TIME_WAIT_TABLE_SUPPORT == ENABLED)
+   //Connections in the TIME-WAIT table are not held by any socket
+   if(socket == NULL || socket->state == TCP_STATE_LISTEN)
+   {
+      //Check whether the segment belongs to such a connection
+      if(tcpTimeWaitProcessSegment(interface, pseudoHeader, segment, length))
+      {
+         //Release exclusive access
+         if(socket != NULL)
+         {
+            SOCKET_UNLOCK(socket);
+         }
+
+         //Exit immediately
+         return;
+      }
+   }
+#endif
+
    //Specified port is unreachable?
    if(socket == NULL)
    {
@@ -379,6 +321,21 @@ void tcpProcessSegment(NetInterface *interface, IpPseudoHeader *pseudoHeader,
       //Silently discard incoming packet
       break;
    }
+
+#if (TCP_TIME_WAIT_TABLE_SUPPORT == ENABLED)
+   //A connection that enters the TIME-WAIT state once the user has closed
+   //the socket does not need to hold the socket anymore
+   if(socket->state == TCP_STATE_TIME_WAIT && !socket->ownedFlag)
+      tcpTimeWaitTransfer(socket);
+#endif
+
+#if (TCP_CHECKSUM_COPY_SUPPORT == ENABLED)
+   //Data copied ahead of time is only relevant to the current segment
+   socket->rxDataCopied = FALSE;
+#endif
+
+   //Release exclusive access
+   SOCKET_UNLOCK(socket);
 }
 
 
@@ -426,6 +383,9 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
    uint_t i;
    TcpOption *option;
    TcpSynQueueItem *queueItem;
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   uint32_t tsEcr;
+#endif
 
    //Debug message
    TRACE_DEBUG("TCP FSM: LISTEN state\r\n");
@@ -438,6 +398,11 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
    //still in the LISTEN state
    if(segment->flags & TCP_FLAG_ACK)
    {
+#if (TCP_SYN_COOKIES_SUPPORT == ENABLED)
+      //The segment may complete a handshake answered with a SYN cookie
+      if(!tcpSynCookieProcessAck(socket, interface, pseudoHeader, segment, length))
+         return;
+#endif
       //A reset segment should be formed for any arriving ACK-bearing segment
       tcpSendResetSegment(interface, pseudoHeader, segment, length);
       //Return immediately
@@ -470,7 +435,14 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
 
          //Make sure the SYN queue is not full
          if(i >= socket->synQueueSize)
+         {
+#if (TCP_SYN_COOKIES_SUPPORT == ENABLED)
+            //Answer the SYN without keeping any state
+            tcpSynCookieSendSynAck(socket, interface, pseudoHeader, segment);
+#endif
+            //Return immediately
             return;
+         }
 
          //Allocate memory to save incoming data
          queueItem->next = memPoolAlloc(sizeof(TcpSynQueueItem));
@@ -480,7 +452,14 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
 
       //Failed to allocate memory?
       if(queueItem == NULL)
+      {
+#if (TCP_SYN_COOKIES_SUPPORT == ENABLED)
+         //Answer the SYN without keeping any state
+         tcpSynCookieSendSynAck(socket, interface, pseudoHeader, segment);
+#endif
+         //Return immediately
          return;
+      }
 
 #if (IPV4_SUPPORT == ENABLED)
       //IPv4 is currently used?
@@ -544,6 +523,44 @@ void tcpStateListen(Socket *socket, NetInterface *interface,
          queueItem->mss = MAX(queueItem->mss, TCP_MIN_MSS);
       }
 
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+      //Get the window scale factor
+      option = tcpGetOption(segment, TCP_OPTION_WINDOW_SCALE_FACTOR);
+
+      //Specified option found?
+      if(option != NULL && option->length == 3)
+      {
+         //Shift counts greater than 14 must be treated as 14 (refer to
+         //RFC 7323, section 2.3)
+         queueItem->wndScaleOptionReceived = TRUE;
+         queueItem->wndShift = MIN(option->value[0], TCP_MAX_WINDOW_SHIFT);
+      }
+      else
+      {
+         //The connection will not use window scaling
+         queueItem->wndScaleOptionReceived = FALSE;
+         queueItem->wndShift = 0;
+      }
+#endif
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+      //Check whether the SYN segment carries a Timestamps option
+      queueItem->tsOptionReceived = tcpGetTimestampOption(segment,
+         &queueItem->tsVal, &tsEcr);
+#endif
+
+#if (TCP_SACK_SUPPORT == ENABLED)
+      //Get the SACK Permitted option
+      option = tcpGetOption(segment, TCP_OPTION_SACK_PERMITTED);
+      //Check whether the peer is able to process SACK options
+      queueItem->sackPermitted = (option != NULL && option->length == 2);
+#endif
+
+#if (TCP_SYN_COOKIES_SUPPORT == ENABLED)
+      //The SYN-ACK will be sent when the connection is accepted
+      queueItem->synCookie = FALSE;
+#endif
+
       //Notify user that a connection request is pending
       tcpUpdateEvents(socket);
 
@@ -643,6 +660,13 @@ void tcpStateSynSent(Socket *socket, TcpHeader *segment, size_t length)
          socket->smss = MAX(socket->smss, TCP_MIN_MSS);
       }
 
+      //Check whether the peer supports window scaling
+      tcpParseWindowScaleOption(socket, segment);
+      //Check whether the peer agreed to use timestamps
+      tcpParseTimestampOption(socket, segment);
+      //Check whether the peer agreed to use selective acknowledgments
+      tcpParseSackPermittedOption(socket, segment);
+
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
       //Initial congestion window
       socket->cwnd = MIN(TCP_INITIAL_WINDOW * socket->smss, socket->txBufferSize);
@@ -735,12 +759,12 @@ void tcpStateSynReceived(Socket *socket, TcpHeader *segment,
 
    //Update the send window before entering ESTABLISHED state (refer to
    //RFC 1122, section 4.2.2.20)
-   socket->sndWnd = segment->window;
+   socket->sndWnd = tcpGetSegmentWindow(socket, segment);
    socket->sndWl1 = segment->seqNum;
    socket->sndWl2 = segment->ackNum;
 
    //Maximum send window it has seen so far on the connection
-   socket->maxSndWnd = segment->window;
+   socket->maxSndWnd = socket->sndWnd;
 
    //Enter ESTABLISHED state
    tcpChangeState(socket, TCP_STATE_ESTABLISHED);
@@ -1165,6 +1189,8 @@ void tcpStateTimeWait(Socket *socket, TcpHeader *segment, size_t length)
          tcpDeleteControlBlock(socket);
          //Mark the socket as closed
          socket->type = SOCKET_TYPE_UNUSED;
+         //Remove the socket from the hash tables
+         socketUpdateHash(socket);
       }
 
       //Return immediately
@@ -0,0 +1,397 @@
+/**
+ * @file tcp_gro.c
+ * @brief TCP generic receive offload
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * While a burst of frames is being processed, consecutive in-order data
+ * segments of the same connection are chained together and handed over to
+ * TCP as a single segment, so that the socket lookup, the sequence number
+ * and acknowledgment checks and the event notification take place once per
+ * burst rather than once per segment. The payloads are linked by reference
+ * and stay in the frame buffers of the NIC driver until the end of the burst
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/ip.h"
+#include "core/tcp.h"
+#include "core/tcp_fsm.h"
+#include "core/tcp_gro.h"
+#include "ipv4/ipv4.h"
+#include "ipv6/ipv6.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_GRO_SUPPORT == ENABLED)
+
+//Segments are only coalesced while a burst is being processed
+static bool_t tcpGroEnabled = FALSE;
+//Segment being held
+static TcpGroContext tcpGroContext;
+
+
+/**
+ * @brief Enable or disable segment coalescing
+ *
+ * Coalescing is enabled for the duration of a receive burst. Disabling it
+ * delivers the segment being held, if any
+ *
+ * @param[in] enable Enable or disable coalescing
+ **/
+
+void tcpGroSetEnabled(bool_t enable)
+{
+   //Deliver pending data before the frame buffers are recycled
+   if(!enable)
+      tcpGroFlush();
+
+   //Save the new state
+   tcpGroEnabled = enable;
+}
+
+
+/**
+ * @brief Pass an incoming TCP segment through the coalescing stage
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] buffer Multi-part buffer that holds the incoming TCP segment
+ * @param[in] offset Offset to the first byte of the TCP header
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ **/
+
+void tcpGroProcessSegment(NetInterface *interface,
+   IpPseudoHeader *pseudoHeader, const NetBuffer *buffer, size_t offset,
+   NetAncillaryData *ancillary)
+{
+   size_t length;
+   TcpHeader *segment;
+
+   //Retrieve the length of the TCP segment
+   length = netBufferGetLength(buffer) - offset;
+   //Point to the TCP header
+   segment = netBufferAt(buffer, offset);
+
+   //Only segments that lie in the frame buffer of the NIC driver can be held
+   //until the end of the burst (reassembled datagrams are released as soon
+   //as they have been processed). Besides, only data segments that carry
+   //nothing but the ACK flag and, optionally, the PSH flag are coalesced
+   if(tcpGroEnabled && buffer->maxChunkCount == 1 && segment != NULL &&
+      length >= sizeof(TcpHeader) && segment->dataOffset >= 5 &&
+      ((size_t) segment->dataOffset * 4) < length &&
+      (segment->flags & ~TCP_FLAG_PSH) == TCP_FLAG_ACK)
+   {
+      //Try to append the segment to the one being held
+      if(tcpGroMergeSegment(interface, pseudoHeader, segment, length))
+      {
+         //The PSH flag ends the coalesced segment
+         if((segment->flags & TCP_FLAG_PSH) != 0 ||
+            tcpGroContext.buffer.chunkCount >= TCP_GRO_MAX_SEGMENTS)
+         {
+            tcpGroFlush();
+         }
+      }
+      else
+      {
+         //Deliver the segment being held
+         tcpGroFlush();
+
+         //The PSH flag requests the data to be delivered without delay
+         if((segment->flags & TCP_FLAG_PSH) != 0)
+         {
+            //Process incoming TCP segment
+            tcpProcessSegment(interface, pseudoHeader, buffer, offset,
+               ancillary);
+         }
+         else
+         {
+            //Subsequent segments may be appended to this one
+            tcpGroHoldSegment(interface, pseudoHeader, segment, length,
+               ancillary);
+         }
+      }
+   }
+   else
+   {
+      //The segment being held must be delivered first, so that the order
+      //of the segments is preserved
+      tcpGroFlush();
+
+      //Process incoming TCP segment
+      tcpProcessSegment(interface, pseudoHeader, buffer, offset, ancillary);
+   }
+}
+
+
+/**
+ * @brief Append a segment to the one being held
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] segment Incoming TCP segment
+ * @param[in] length Length of the TCP segment, including the header
+ * @return TRUE if the segment has been coalesced, else FALSE
+ **/
+
+bool_t tcpGroMergeSegment(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, TcpHeader *segment, size_t length)
+{
+   size_t n;
+   size_t headerLen;
+   uint64_t sum;
+   TcpHeader *header;
+   TcpGroContext *context;
+
+   //Point to the GRO context
+   context = &tcpGroContext;
+
+   //No segment is being held?
+   if(context->interface == NULL)
+      return FALSE;
+
+   //The segments must be received on the same interface
+   if(context->interface != interface)
+      return FALSE;
+
+   //Check the address family
+   if(context->pseudoHeader.length != pseudoHeader->length)
+      return FALSE;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 segment?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Compare source and destination addresses
+      if(context->pseudoHeader.ipv4Data.srcAddr != pseudoHeader->ipv4Data.srcAddr ||
+         context->pseudoHeader.ipv4Data.destAddr != pseudoHeader->ipv4Data.destAddr)
+      {
+         return FALSE;
+      }
+   }
+#endif
+
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 segment?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Compare source and destination addresses
+      if(!ipv6CompAddr(&context->pseudoHeader.ipv6Data.srcAddr,
+         &pseudoHeader->ipv6Data.srcAddr) ||
+         !ipv6CompAddr(&context->pseudoHeader.ipv6Data.destAddr,
+         &pseudoHeader->ipv6Data.destAddr))
+      {
+         return FALSE;
+      }
+   }
+#endif
+
+   //Point to the TCP header of the first segment
+   header = context->header;
+
+   //Compare port numbers
+   if(segment->srcPort != header->srcPort ||
+      segment->destPort != header->destPort)
+   {
+      return FALSE;
+   }
+
+   //The data must immediately follow the data being held
+   if(ntohl(segment->seqNum) != context->nextSeqNum)
+      return FALSE;
+
+   //The segments must carry the same acknowledgment and window
+   if(segment->ackNum != header->ackNum || segment->window != header->window)
+      return FALSE;
+
+   //Retrieve the length of the TCP header
+   headerLen = segment->dataOffset * 4;
+
+   //The segments must carry the same options
+   if(headerLen != context->headerLen || osMemcmp(segment + 1, header + 1,
+      headerLen - sizeof(TcpHeader)) != 0)
+   {
+      return FALSE;
+   }
+
+   //Length of the segment data
+   n = length - headerLen;
+
+   //All segments but the last one must be full-sized. An even size keeps
+   //the payloads aligned on 16-bit boundaries
+   if(n > context->segmentLen || (context->segmentLen % 2) != 0 ||
+      context->dataLen != (context->buffer.chunkCount * context->segmentLen))
+   {
+      return FALSE;
+   }
+
+   //Make sure there is room for one more segment
+   if(context->buffer.chunkCount >= TCP_GRO_MAX_SEGMENTS ||
+      (headerLen + context->dataLen + n) > UINT16_MAX)
+   {
+      return FALSE;
+   }
+
+   //If the segment is not corrupted, its payload sums to the complement of
+   //its pseudo header and header. The checksum of the coalesced segment is
+   //therefore valid if and only if every segment was valid
+   sum = ipCalcChecksumPartial(pseudoHeader->data, pseudoHeader->length);
+   sum += ipCalcChecksumPartial(segment, headerLen);
+   context->sum += ipFoldChecksum(sum) ^ 0xFFFF;
+
+   //Link the payload by reference
+   context->buffer.chunk[context->buffer.chunkCount].address =
+      (uint8_t *) segment + headerLen;
+   context->buffer.chunk[context->buffer.chunkCount].length = (uint16_t) n;
+   context->buffer.chunk[context->buffer.chunkCount].size = 0;
+   context->buffer.chunkCount++;
+
+   //The PSH flag of the last segment applies to the coalesced segment
+   header->flags |= segment->flags & TCP_FLAG_PSH;
+
+   //Update the amount of data being held
+   context->dataLen += n;
+   context->nextSeqNum += n;
+
+   //The segment has been coalesced
+   return TRUE;
+}
+
+
+/**
+ * @brief Hold a segment until the end of the burst
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] segment Incoming TCP segment
+ * @param[in] length Length of the TCP segment, including the header
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ **/
+
+void tcpGroHoldSegment(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, TcpHeader *segment, size_t length,
+   const NetAncillaryData *ancillary)
+{
+   uint64_t sum;
+   TcpGroContext *context;
+
+   //Point to the GRO context
+   context = &tcpGroContext;
+
+   //Save the parameters of the segment
+   context->interface = interface;
+   context->pseudoHeader = *pseudoHeader;
+   context->ancillary = *ancillary;
+   context->header = segment;
+   context->headerLen = segment->dataOffset * 4;
+   context->segmentLen = length - context->headerLen;
+   context->dataLen = context->segmentLen;
+   context->nextSeqNum = ntohl(segment->seqNum) + context->segmentLen;
+
+   //The payload is accounted for by the complement of the pseudo header and
+   //header sums
+   sum = ipCalcChecksumPartial(pseudoHeader->data, pseudoHeader->length);
+   sum += ipCalcChecksumPartial(segment, context->headerLen);
+   context->sum = ipFoldChecksum(sum) ^ 0xFFFF;
+
+   //The first chunk holds the whole segment
+   context->buffer.chunkCount = 1;
+   context->buffer.maxChunkCount = TCP_GRO_MAX_SEGMENTS;
+   context->buffer.chunk[0].address = segment;
+   context->buffer.chunk[0].length = (uint16_t) length;
+   context->buffer.chunk[0].size = 0;
+}
+
+
+/**
+ * @brief Deliver the segment being held to TCP
+ **/
+
+void tcpGroFlush(void)
+{
+   uint64_t sum;
+   NetInterface *interface;
+   TcpGroContext *context;
+
+   //Point to the GRO context
+   context = &tcpGroContext;
+
+   //No segment is being held?
+   if(context->interface == NULL)
+      return;
+
+   //Release the context
+   interface = context->interface;
+   context->interface = NULL;
+
+   //Several segments have been coalesced?
+   if(context->buffer.chunkCount > 1)
+   {
+#if (IPV4_SUPPORT == ENABLED)
+      //IPv4 segment?
+      if(context->pseudoHeader.length == sizeof(Ipv4PseudoHeader))
+      {
+         //Adjust the length field of the pseudo header
+         context->pseudoHeader.ipv4Data.length = htons(context->headerLen +
+            context->dataLen);
+      }
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+      //IPv6 segment?
+      if(context->pseudoHeader.length == sizeof(Ipv6PseudoHeader))
+      {
+         //Adjust the length field of the pseudo header
+         context->pseudoHeader.ipv6Data.length = htonl(context->headerLen +
+            context->dataLen);
+      }
+#endif
+
+      //Process pseudo header and TCP header
+      context->header->checksum = 0;
+      sum = ipCalcChecksumPartial(context->pseudoHeader.data,
+         context->pseudoHeader.length);
+      sum += ipCalcChecksumPartial(context->header, context->headerLen);
+      //Account for the payloads
+      sum += context->sum;
+
+      //Calculate TCP header checksum
+      context->header->checksum = ipFoldChecksum(sum) ^ 0xFFFF;
+
+      //Debug message
+      TRACE_DEBUG("%u TCP segments coalesced (%" PRIuSIZE " data bytes)\r\n",
+         context->buffer.chunkCount, context->dataLen);
+   }
+
+   //Process the coalesced segment
+   tcpProcessSegment(interface, &context->pseudoHeader,
+      (NetBuffer *) &context->buffer, 0, &context->ancillary);
+}
+
+#endif
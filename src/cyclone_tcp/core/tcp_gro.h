@@ -0,0 +1,95 @@
+/**
+ * @file tcp_gro.h
+ * @brief TCP generic receive offload
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+#ifndef _TCP_GRO_H
+#define _TCP_GRO_H
+
+//Dependencies
+#include "core/tcp.h"
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Multi-part buffer holding a coalesced segment
+ **/
+
+typedef struct
+{
+   uint_t chunkCount;
+   uint_t maxChunkCount;
+   ChunkDesc chunk[TCP_GRO_MAX_SEGMENTS];
+} TcpGroBuffer;
+
+
+/**
+ * @brief Coalesced segment
+ **/
+
+typedef struct
+{
+   NetInterface *interface;          ///<Interface the segments were received on
+   IpPseudoHeader pseudoHeader;      ///<Pseudo header of the connection
+   NetAncillaryData ancillary;       ///<Options attached to the first segment
+   TcpHeader *header;                ///<TCP header of the first segment
+   size_t headerLen;                 ///<Length of the TCP header
+   size_t segmentLen;                ///<Amount of data carried by the first segment
+   size_t dataLen;                   ///<Total amount of data
+   uint32_t nextSeqNum;              ///<Sequence number expected next
+   uint64_t sum;                     ///<Partial sum standing for the payloads
+   TcpGroBuffer buffer;              ///<Header and payloads of the segments
+} TcpGroContext;
+
+
+//GRO related functions
+void tcpGroSetEnabled(bool_t enable);
+
+void tcpGroProcessSegment(NetInterface *interface,
+   IpPseudoHeader *pseudoHeader, const NetBuffer *buffer, size_t offset,
+   NetAncillaryData *ancillary);
+
+bool_t tcpGroMergeSegment(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, TcpHeader *segment, size_t length);
+
+void tcpGroHoldSegment(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, TcpHeader *segment, size_t length,
+   const NetAncillaryData *ancillary);
+
+void tcpGroFlush(void);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
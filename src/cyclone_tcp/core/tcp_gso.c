@@ -0,0 +1,573 @@
+/**
+ * @file tcp_gso.c
+ * @brief TCP generic segmentation offload
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * When a connection has several full-sized segments worth of data to send,
+ * TCP builds a single super-segment that goes through the IP layer as one
+ * datagram. The super-segment is split into MSS-sized frames right before
+ * it reaches the NIC driver, or handed over as is to hardware that is able
+ * to perform the segmentation by itself. Each segment is still tracked on
+ * its own by the retransmission queue
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_misc.h"
+#include "core/tcp_timer.h"
+#include "core/tcp_gso.h"
+#include "ipv4/ipv4.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv6/ipv6.h"
+#include "ipv6/ipv6_misc.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_GSO_SUPPORT == ENABLED)
+
+
+/**
+ * @brief Check whether super-segments can be used on a given connection
+ * @param[in] socket Handle referencing the socket
+ * @return TRUE if super-segments can be sent, else FALSE
+ **/
+
+bool_t tcpGsoIsAllowed(Socket *socket)
+{
+#if (ETH_SUPPORT == ENABLED)
+   NetInterface *physicalInterface;
+
+   //Make sure the underlying interface is known
+   if(socket->interface == NULL)
+      return FALSE;
+
+   //Point to the physical interface
+   physicalInterface = nicGetPhysicalInterface(socket->interface);
+
+   //Super-segments are split by the Ethernet layer
+   if(physicalInterface->nicDriver == NULL ||
+      physicalInterface->nicDriver->type != NIC_TYPE_ETHERNET)
+   {
+      return FALSE;
+   }
+
+#if (IPV4_SUPPORT == ENABLED)
+   //Packets sent to the loopback address do not go through Ethernet
+   if(socket->remoteIpAddr.length == sizeof(Ipv4Addr) &&
+      ipv4IsLocalHostAddr(socket->remoteIpAddr.ipv4Addr))
+   {
+      return FALSE;
+   }
+#endif
+
+#if (IPV6_SUPPORT == ENABLED)
+   //Packets sent to the loopback address do not go through Ethernet
+   if(socket->remoteIpAddr.length == sizeof(Ipv6Addr) &&
+      ipv6IsLocalHostAddr(&socket->remoteIpAddr.ipv6Addr))
+   {
+      return FALSE;
+   }
+#endif
+
+   //Super-segments can be used
+   return TRUE;
+#else
+   //Ethernet is not supported
+   return FALSE;
+#endif
+}
+
+
+/**
+ * @brief Determine how many bytes can be sent in a single pass
+ * @param[in] socket Handle referencing the socket
+ * @param[in] length Number of bytes that are ready to be sent
+ * @return Amount of data to be carried by the next (super-)segment
+ **/
+
+uint_t tcpGsoAdjustLength(Socket *socket, uint_t length)
+{
+   //Several full-sized segments worth of data?
+   if(length >= (2 * socket->smss) && tcpGsoIsAllowed(socket))
+   {
+      //Limit the size of the super-segment
+      length = MIN(length, TCP_GSO_MAX_SIZE);
+      //Only full-sized segments are aggregated, so that the behavior of the
+      //Nagle algorithm is not altered
+      length -= length % socket->smss;
+   }
+   else
+   {
+      //Regular segment
+      length = MIN(length, socket->smss);
+   }
+
+   //Return the number of bytes to send
+   return length;
+}
+
+
+/**
+ * @brief Append the payload of a super-segment to a multi-part buffer
+ *
+ * The payload is linked by reference whenever possible. When it spans more
+ * chunks than a single buffer can describe, it is copied instead
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] seqNum Sequence number of the first data byte
+ * @param[in] buffer Multi-part buffer holding the TCP header
+ * @param[in] length Number of data bytes
+ * @return Error code
+ **/
+
+error_t tcpGsoReadTxBuffer(Socket *socket, uint32_t seqNum,
+   NetBuffer *buffer, size_t length)
+{
+   error_t error;
+   size_t n;
+   size_t pos;
+   size_t offset;
+   size_t headerLen;
+#if (TCP_ZERO_COPY_TX_SUPPORT == ENABLED)
+   TcpTxRef *ref;
+#endif
+
+   //Length of the data that precedes the payload
+   headerLen = netBufferGetLength(buffer);
+
+   //Link the payload by reference
+   error = tcpReadTxBuffer(socket, seqNum, buffer, length);
+
+   //Too many chunks?
+   if(error)
+   {
+      //Drop the chunks that have already been linked
+      error = netBufferSetLength(buffer, headerLen);
+
+      //Allocate memory to hold a copy of the payload
+      if(!error)
+         error = netBufferSetLength(buffer, headerLen + length);
+
+      //The data may span several buffers
+      for(pos = 0; pos < length && !error; pos += n)
+      {
+         //Number of bytes to process in a single pass
+         n = length - pos;
+
+#if (TCP_ZERO_COPY_TX_SUPPORT == ENABLED)
+         //Check whether the data is held in a caller-supplied buffer
+         ref = tcpGetTxRef(socket, seqNum + pos, &n);
+
+         //Caller-supplied buffer?
+         if(ref != NULL)
+         {
+            //Copy the payload
+            error = netBufferCopy(buffer, headerLen + pos, ref->buffer,
+               ref->offset + (seqNum + pos - ref->seqNum), n);
+         }
+         else
+#endif
+         {
+            //Offset of the first byte to read in the circular buffer
+            offset = (seqNum + pos - socket->iss - 1) % socket->txBufferSize;
+            //Wrap around to the beginning of the circular buffer if necessary
+            n = MIN(n, socket->txBufferSize - offset);
+
+            //Copy the payload
+            error = netBufferCopy(buffer, headerLen + pos,
+               (NetBuffer *) &socket->txBuffer, offset, n);
+         }
+      }
+   }
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Add the segments of a super-segment to the retransmission queue
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment TCP header of the super-segment
+ * @param[in] pseudoHeader Pseudo header of the super-segment
+ * @param[in] length Length of the super-segment data
+ * @return Error code
+ **/
+
+error_t tcpGsoQueueSegments(Socket *socket, const TcpHeader *segment,
+   const IpPseudoHeader *pseudoHeader, size_t length)
+{
+   size_t n;
+   size_t pos;
+   size_t headerLen;
+   uint32_t seqNum;
+   uint64_t sum;
+   TcpHeader *header;
+   TcpQueueItem *queueItem;
+   TcpQueueItem *firstItem;
+   TcpQueueItem *lastItem;
+
+   //Length of the TCP header
+   headerLen = segment->dataOffset * 4;
+
+   //Initialize the list of new items
+   firstItem = NULL;
+   lastItem = NULL;
+
+   //Each MSS-sized slice of data is retransmitted on its own
+   for(pos = 0; pos < length; pos += n)
+   {
+      //Length of the current segment
+      n = MIN(length - pos, socket->smss);
+      //Sequence number of the first data byte
+      seqNum = ntohl(segment->seqNum) + pos;
+
+      //Create a new item
+      queueItem = memPoolAlloc(sizeof(TcpQueueItem));
+      //Failed to allocate memory?
+      if(queueItem == NULL)
+         break;
+
+      //Retransmission mechanism requires additional information
+      queueItem->next = NULL;
+      queueItem->length = n;
+      queueItem->sacked = FALSE;
+      queueItem->lost = FALSE;
+      queueItem->retransmitted = FALSE;
+
+      //Save TCP header
+      osMemcpy(queueItem->header, segment, headerLen);
+      //Save pseudo header
+      queueItem->pseudoHeader = *pseudoHeader;
+
+      //Point to the TCP header of the segment
+      header = (TcpHeader *) queueItem->header;
+      //Adjust the sequence number
+      header->seqNum = htonl(seqNum);
+
+      //The PSH and FIN flags only apply to the last segment
+      if((pos + n) < length)
+         header->flags &= ~(TCP_FLAG_PSH | TCP_FLAG_FIN);
+
+#if (IPV4_SUPPORT == ENABLED)
+      //IPv4 pseudo header?
+      if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+      {
+         //Adjust the length field
+         queueItem->pseudoHeader.ipv4Data.length = htons(headerLen + n);
+      }
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+      //IPv6 pseudo header?
+      if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+      {
+         //Adjust the length field
+         queueItem->pseudoHeader.ipv6Data.length = htonl(headerLen + n);
+      }
+#endif
+
+      //Process pseudo header and TCP header
+      header->checksum = 0;
+      sum = ipCalcChecksumPartial(queueItem->pseudoHeader.data,
+         queueItem->pseudoHeader.length);
+      sum += ipCalcChecksumPartial(header, headerLen);
+      //Process the data held in the send buffer
+      sum += tcpCalcTxBufferChecksum(socket, seqNum, n);
+
+      //Calculate TCP header checksum
+      header->checksum = ipFoldChecksum(sum) ^ 0xFFFF;
+
+      //Append the item to the list
+      if(lastItem != NULL)
+         lastItem->next = queueItem;
+      else
+         firstItem = queueItem;
+
+      //Point to the last item
+      lastItem = queueItem;
+   }
+
+   //Failed to allocate memory?
+   if(pos < length)
+   {
+      //Release the items that have been created
+      while(firstItem != NULL)
+      {
+         queueItem = firstItem;
+         firstItem = firstItem->next;
+         memPoolFree(queueItem);
+      }
+
+      //Report an error
+      return ERROR_OUT_OF_MEMORY;
+   }
+
+   //Empty retransmission queue?
+   if(socket->retransmitQueue == NULL)
+   {
+      //Add the newly created items to the queue
+      socket->retransmitQueue = firstItem;
+   }
+   else
+   {
+      //Point to the very first item
+      queueItem = socket->retransmitQueue;
+      //Reach the last item of the retransmission queue
+      while(queueItem->next) queueItem = queueItem->next;
+      //Append the newly created items
+      queueItem->next = firstItem;
+   }
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Split a TCP super-segment into MSS-sized Ethernet frames
+ * @param[in] interface Underlying network interface
+ * @param[in] destAddr MAC address of the destination host
+ * @param[in] type Ethernet type (IPv4 or IPv6)
+ * @param[in] buffer Multi-part buffer containing the super-segment
+ * @param[in] offset Offset to the first byte of the IP header
+ * @param[in] ancillary Additional options passed to the stack along with
+ *   the packet
+ * @return Error code
+ **/
+
+error_t tcpGsoSplitFrame(NetInterface *interface, const MacAddr *destAddr,
+   uint16_t type, const NetBuffer *buffer, size_t offset,
+   const NetAncillaryData *ancillary)
+{
+   error_t error;
+   uint_t i;
+   size_t n;
+   size_t pos;
+   size_t length;
+   size_t ipHeaderLen;
+   size_t tcpHeaderLen;
+   size_t segmentOffset;
+   uint8_t flags;
+   uint32_t seqNum;
+   uint64_t sum;
+   NetBuffer *segmentBuffer;
+   TcpHeader *tcpHeader;
+   IpPseudoHeader pseudoHeader;
+   NetAncillaryData ancillary2;
+   uint8_t header[IPV4_MAX_HEADER_LENGTH + TCP_MAX_HEADER_LENGTH];
+#if (IPV4_SUPPORT == ENABLED)
+   Ipv4Header *ipv4Header;
+   uint16_t id;
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   Ipv6Header *ipv6Header;
+#endif
+
+   //Retrieve the length of the IP datagram
+   length = netBufferGetLength(buffer) - offset;
+   //Copy the IP and TCP headers
+   netBufferRead(header, buffer, offset, MIN(length, sizeof(header)));
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 datagram?
+   if(type == ETH_TYPE_IPV4)
+   {
+      //Point to the IPv4 header
+      ipv4Header = (Ipv4Header *) header;
+      //Retrieve the length of the IPv4 header
+      ipHeaderLen = ipv4Header->headerLength * 4;
+
+      //Only TCP segments can be split
+      if(ipv4Header->protocol != IPV4_PROTOCOL_TCP)
+         return ERROR_INVALID_PROTOCOL;
+
+      //Identification value of the first segment
+      id = ntohs(ipv4Header->identification);
+
+      //Format IPv4 pseudo header
+      pseudoHeader.length = sizeof(Ipv4PseudoHeader);
+      pseudoHeader.ipv4Data.srcAddr = ipv4Header->srcAddr;
+      pseudoHeader.ipv4Data.destAddr = ipv4Header->destAddr;
+      pseudoHeader.ipv4Data.reserved = 0;
+      pseudoHeader.ipv4Data.protocol = IPV4_PROTOCOL_TCP;
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 datagram?
+   if(type == ETH_TYPE_IPV6)
+   {
+      //Point to the IPv6 header
+      ipv6Header = (Ipv6Header *) header;
+      //Length of the IPv6 header
+      ipHeaderLen = sizeof(Ipv6Header);
+
+      //Extension headers are not supported
+      if(ipv6Header->nextHeader != IPV6_TCP_HEADER)
+         return ERROR_INVALID_PROTOCOL;
+
+      //Format IPv6 pseudo header
+      pseudoHeader.length = sizeof(Ipv6PseudoHeader);
+      pseudoHeader.ipv6Data.srcAddr = ipv6Header->srcAddr;
+      pseudoHeader.ipv6Data.destAddr = ipv6Header->destAddr;
+      pseudoHeader.ipv6Data.reserved = 0;
+      pseudoHeader.ipv6Data.nextHeader = IPV6_TCP_HEADER;
+   }
+   else
+#endif
+   //Unknown protocol?
+   {
+      //Report an error
+      return ERROR_INVALID_PROTOCOL;
+   }
+
+   //Malformed IP header?
+   if(length < (ipHeaderLen + sizeof(TcpHeader)))
+      return ERROR_INVALID_LENGTH;
+
+   //Point to the TCP header
+   tcpHeader = (TcpHeader *) (header + ipHeaderLen);
+   //Retrieve the length of the TCP header
+   tcpHeaderLen = tcpHeader->dataOffset * 4;
+
+   //Malformed TCP header?
+   if(length < (ipHeaderLen + tcpHeaderLen))
+      return ERROR_INVALID_LENGTH;
+
+   //Sequence number of the first data byte
+   seqNum = ntohl(tcpHeader->seqNum);
+   //Flags of the super-segment
+   flags = tcpHeader->flags;
+
+   //The resulting frames are regular frames
+   ancillary2 = *ancillary;
+   ancillary2.gsoSize = 0;
+
+   //Initialize status code
+   error = NO_ERROR;
+
+   //Skip the headers
+   length -= ipHeaderLen + tcpHeaderLen;
+
+   //Split the payload into MSS-sized segments
+   for(i = 0, pos = 0; pos < length && !error; i++, pos += n)
+   {
+      //Length of the current segment
+      n = MIN(length - pos, ancillary->gsoSize);
+
+#if (IPV4_SUPPORT == ENABLED)
+      //IPv4 datagram?
+      if(type == ETH_TYPE_IPV4)
+      {
+         //Each segment is given its own identification value
+         ipv4Header->totalLength = htons(ipHeaderLen + tcpHeaderLen + n);
+         ipv4Header->identification = htons(id + i);
+
+         //Recalculate IP header checksum
+         ipv4Header->headerChecksum = 0;
+         ipv4Header->headerChecksum = ipCalcChecksum(ipv4Header, ipHeaderLen);
+
+         //Adjust the length field of the pseudo header
+         pseudoHeader.ipv4Data.length = htons(tcpHeaderLen + n);
+      }
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+      //IPv6 datagram?
+      if(type == ETH_TYPE_IPV6)
+      {
+         //Adjust the length of the payload
+         ipv6Header->payloadLen = htons(tcpHeaderLen + n);
+         //Adjust the length field of the pseudo header
+         pseudoHeader.ipv6Data.length = htonl(tcpHeaderLen + n);
+      }
+#endif
+
+      //Adjust the sequence number
+      tcpHeader->seqNum = htonl(seqNum + pos);
+
+      //The PSH and FIN flags only apply to the last segment
+      if((pos + n) < length)
+         tcpHeader->flags = flags & ~(TCP_FLAG_PSH | TCP_FLAG_FIN);
+      else
+         tcpHeader->flags = flags;
+
+      //Process pseudo header and TCP header
+      tcpHeader->checksum = 0;
+      sum = ipCalcChecksumPartial(pseudoHeader.data, pseudoHeader.length);
+      sum += ipCalcChecksumPartial(tcpHeader, tcpHeaderLen);
+      //Process the data (the TCP header length is always even)
+      sum += ipCalcChecksumPartialEx(buffer, offset + ipHeaderLen +
+         tcpHeaderLen + pos, n);
+
+      //Calculate TCP header checksum
+      tcpHeader->checksum = ipFoldChecksum(sum) ^ 0xFFFF;
+
+      //Allocate a memory buffer to hold the headers
+      segmentBuffer = ethAllocBuffer(ipHeaderLen + tcpHeaderLen,
+         &segmentOffset);
+
+      //Successful memory allocation?
+      if(segmentBuffer != NULL)
+      {
+         //Copy the headers
+         netBufferWrite(segmentBuffer, segmentOffset, header,
+            ipHeaderLen + tcpHeaderLen);
+
+         //Link the payload by reference
+         error = netBufferConcat(segmentBuffer, buffer, offset + ipHeaderLen +
+            tcpHeaderLen + pos, n);
+
+         //Check status code
+         if(!error)
+         {
+            //Send Ethernet frame
+            error = ethSendFrame(interface, destAddr, type, segmentBuffer,
+               segmentOffset, &ancillary2);
+         }
+
+         //Free previously allocated memory
+         netBufferFree(segmentBuffer);
+      }
+      else
+      {
+         //Failed to allocate memory
+         error = ERROR_OUT_OF_MEMORY;
+      }
+   }
+
+   //Return status code
+   return error;
+}
+
+#endif
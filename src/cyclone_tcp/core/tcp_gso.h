@@ -0,0 +1,61 @@
+/**
+ * @file tcp_gso.h
+ * @brief TCP generic segmentation offload
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+#ifndef _TCP_GSO_H
+#define _TCP_GSO_H
+
+//Dependencies
+#include "core/tcp.h"
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//GSO related functions
+bool_t tcpGsoIsAllowed(Socket *socket);
+uint_t tcpGsoAdjustLength(Socket *socket, uint_t length);
+
+error_t tcpGsoReadTxBuffer(Socket *socket, uint32_t seqNum,
+   NetBuffer *buffer, size_t length);
+
+error_t tcpGsoQueueSegments(Socket *socket, const TcpHeader *segment,
+   const IpPseudoHeader *pseudoHeader, size_t length);
+
+error_t tcpGsoSplitFrame(NetInterface *interface, const MacAddr *destAddr,
+   uint16_t type, const NetBuffer *buffer, size_t offset,
+   const NetAncillaryData *ancillary);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
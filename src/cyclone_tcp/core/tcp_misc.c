@@ -36,9 +36,13 @@
 #include <string.h>
 #include "core/net.h"
 #include "core/socket.h"
+#include "core/socket_event_set.h"
 #include "core/tcp.h"
 #include "core/tcp_misc.h"
 #include "core/tcp_timer.h"
+#include "core/tcp_congest.h"
+#include "core/tcp_gso.h"
+#include "core/tcp_pacing.h"
 #include "core/ip.h"
 #include "ipv4/ipv4.h"
 #include "ipv6/ipv6.h"
@@ -73,6 +77,9 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    TcpQueueItem *queueItem;
    IpPseudoHeader pseudoHeader;
    NetAncillaryData ancillary;
+#if (TCP_CHECKSUM_COPY_SUPPORT == ENABLED)
+   uint64_t sum;
+#endif
 
    //Maximum segment size
    uint16_t mss = HTONS(socket->rmss);
@@ -95,21 +102,74 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    segment->dataOffset = 5;
    segment->flags = flags;
    segment->reserved2 = 0;
-   segment->window = htons(socket->rcvWnd);
    segment->checksum = 0;
    segment->urgentPointer = 0;
 
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+   //The window field in a SYN segment is never scaled (refer to RFC 7323,
+   //section 2.2)
+   if(flags & TCP_FLAG_SYN)
+      segment->window = htons(MIN(socket->rcvWnd, UINT16_MAX));
+   else
+      segment->window = htons(MIN(socket->rcvWnd >> socket->rcvWndShift, UINT16_MAX));
+#else
+   //Advertise the receive window
+   segment->window = htons(socket->rcvWnd);
+#endif
+
    //SYN flag set?
    if(flags & TCP_FLAG_SYN)
    {
       //Append MSS option
       tcpAddOption(segment, TCP_OPTION_MAX_SEGMENT_SIZE, &mss, sizeof(mss));
 
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+      //A SYN-ACK may only carry a Window Scale option if the SYN received
+      //from the peer did so
+      if(!(flags & TCP_FLAG_ACK) || socket->wndScaleOptionReceived)
+      {
+         //Append Window Scale option
+         tcpAddOption(segment, TCP_OPTION_WINDOW_SCALE_FACTOR,
+            &socket->rcvWndShift, sizeof(uint8_t));
+      }
+#endif
+
 #if (TCP_SACK_SUPPORT == ENABLED)
-      //Append SACK Permitted option
-      tcpAddOption(segment, TCP_OPTION_SACK_PERMITTED, NULL, 0);
+      //A SYN-ACK may only carry a SACK Permitted option if the SYN received
+      //from the peer did so
+      if(!(flags & TCP_FLAG_ACK) || socket->sackPermitted)
+      {
+         //Append SACK Permitted option
+         tcpAddOption(segment, TCP_OPTION_SACK_PERMITTED, NULL, 0);
+      }
+#endif
+   }
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //The Timestamps option is offered in the initial SYN, and then carried by
+   //every segment once both sides have sent it (refer to RFC 7323, section 3.2)
+   if(socket->tsOptionReceived ||
+      (flags & (TCP_FLAG_SYN | TCP_FLAG_ACK)) == TCP_FLAG_SYN)
+   {
+      //Append Timestamps option
+      tcpAddTimestampOption(socket, segment);
+   }
+
+   //Keep track of the last acknowledgment number sent
+   if(flags & TCP_FLAG_ACK)
+      socket->lastAckSent = ackNum;
 #endif
+
+#if (TCP_SACK_SUPPORT == ENABLED)
+   //Report the non-contiguous blocks of data that have been received and
+   //queued (refer to RFC 2018, section 4)
+   if((flags & (TCP_FLAG_SYN | TCP_FLAG_ACK)) == TCP_FLAG_ACK &&
+      socket->sackPermitted)
+   {
+      //Append SACK option
+      tcpAddSackOption(socket, segment);
    }
+#endif
 
    //Adjust the length of the multi-part buffer
    netBufferSetLength(buffer, offset + segment->dataOffset * 4);
@@ -117,8 +177,20 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    //Any data to send?
    if(length > 0)
    {
-      //Copy data
-      error = tcpReadTxBuffer(socket, seqNum, buffer, length);
+#if (TCP_GSO_SUPPORT == ENABLED)
+      //Super-segment?
+      if(length > socket->smss)
+      {
+         //The payload may have to be copied if it spans too many chunks
+         error = tcpGsoReadTxBuffer(socket, seqNum, buffer, length);
+      }
+      else
+#endif
+      {
+         //Copy data
+         error = tcpReadTxBuffer(socket, seqNum, buffer, length);
+      }
+
       //Any error to report?
       if(error)
       {
@@ -143,10 +215,6 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
       pseudoHeader.ipv4Data.reserved = 0;
       pseudoHeader.ipv4Data.protocol = IPV4_PROTOCOL_TCP;
       pseudoHeader.ipv4Data.length = htons(totalLength);
-
-      //Calculate TCP header checksum
-      segment->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv4Data,
-         sizeof(Ipv4PseudoHeader), buffer, offset, totalLength);
    }
    else
 #endif
@@ -161,10 +229,6 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
       pseudoHeader.ipv6Data.length = htonl(totalLength);
       pseudoHeader.ipv6Data.reserved = 0;
       pseudoHeader.ipv6Data.nextHeader = IPV6_TCP_HEADER;
-
-      //Calculate TCP header checksum
-      segment->checksum = ipCalcUpperLayerChecksumEx(&pseudoHeader.ipv6Data,
-         sizeof(Ipv6PseudoHeader), buffer, offset, totalLength);
    }
    else
 #endif
@@ -176,46 +240,96 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
       return ERROR_INVALID_ADDRESS;
    }
 
+#if (TCP_GSO_SUPPORT == ENABLED)
+   //The checksum of each segment is calculated once the super-segment has
+   //been split, either by the Ethernet layer or by the hardware
+   if(length > socket->smss)
+   {
+      segment->checksum = 0;
+   }
+   else
+#endif
+   {
+#if (TCP_CHECKSUM_COPY_SUPPORT == ENABLED)
+      //Process pseudo header and TCP header
+      sum = ipCalcChecksumPartial(pseudoHeader.data, pseudoHeader.length);
+      sum += ipCalcChecksumPartial(segment, segment->dataOffset * 4);
+
+      //The partial sums of the payload were computed when the data was copied
+      //to the send buffer (the TCP header length is always even)
+      if(length > 0)
+         sum += tcpCalcTxBufferChecksum(socket, seqNum, length);
+
+      //Calculate TCP header checksum
+      segment->checksum = ipFoldChecksum(sum) ^ 0xFFFF;
+#else
+      //Calculate TCP header checksum
+      segment->checksum = ipCalcUpperLayerChecksumEx(pseudoHeader.data,
+         pseudoHeader.length, buffer, offset, totalLength);
+#endif
+   }
+
    //Add current segment to retransmission queue?
    if(addToQueue)
    {
-      //Empty retransmission queue?
-      if(!socket->retransmitQueue)
+#if (TCP_GSO_SUPPORT == ENABLED)
+      //Super-segment?
+      if(length > socket->smss)
       {
-         //Create a new item
-         queueItem = memPoolAlloc(sizeof(TcpQueueItem));
-         //Add the newly created item to the queue
-         socket->retransmitQueue = queueItem;
+         //Each segment is retransmitted on its own
+         error = tcpGsoQueueSegments(socket, segment, &pseudoHeader, length);
+         //Any error to report?
+         if(error)
+         {
+            //Free previously allocated memory
+            netBufferFree(buffer);
+            //Return status
+            return error;
+         }
       }
       else
+#endif
       {
-         //Point to the very first item
-         queueItem = socket->retransmitQueue;
-         //Reach the last item of the retransmission queue
-         while(queueItem->next) queueItem = queueItem->next;
-         //Create a new item
-         queueItem->next = memPoolAlloc(sizeof(TcpQueueItem));
-         //Point to the newly created item
-         queueItem = queueItem->next;
-      }
+         //Empty retransmission queue?
+         if(!socket->retransmitQueue)
+         {
+            //Create a new item
+            queueItem = memPoolAlloc(sizeof(TcpQueueItem));
+            //Add the newly created item to the queue
+            socket->retransmitQueue = queueItem;
+         }
+         else
+         {
+            //Point to the very first item
+            queueItem = socket->retransmitQueue;
+            //Reach the last item of the retransmission queue
+            while(queueItem->next) queueItem = queueItem->next;
+            //Create a new item
+            queueItem->next = memPoolAlloc(sizeof(TcpQueueItem));
+            //Point to the newly created item
+            queueItem = queueItem->next;
+         }
 
-      //Failed to allocate memory?
-      if(queueItem == NULL)
-      {
-         //Free previously allocated memory
-         netBufferFree(buffer);
-         //Return status
-         return ERROR_OUT_OF_MEMORY;
-      }
+         //Failed to allocate memory?
+         if(queueItem == NULL)
+         {
+            //Free previously allocated memory
+            netBufferFree(buffer);
+            //Return status
+            return ERROR_OUT_OF_MEMORY;
+         }
 
-      //Retransmission mechanism requires additional information
-      queueItem->next = NULL;
-      queueItem->length = length;
-      queueItem->sacked = FALSE;
-      //Save TCP header
-      osMemcpy(queueItem->header, segment, segment->dataOffset * 4);
-      //Save pseudo header
-      queueItem->pseudoHeader = pseudoHeader;
+         //Retransmission mechanism requires additional information
+         queueItem->next = NULL;
+         queueItem->length = length;
+         queueItem->sacked = FALSE;
+         queueItem->lost = FALSE;
+         queueItem->retransmitted = FALSE;
+         //Save TCP header
+         osMemcpy(queueItem->header, segment, segment->dataOffset * 4);
+         //Save pseudo header
+         queueItem->pseudoHeader = pseudoHeader;
+      }
 
       //Take one RTT measurement at a time
       if(!socket->rttBusy)
@@ -281,10 +395,25 @@ error_t tcpSendSegment(Socket *socket, uint8_t flags, uint32_t seqNum,
    ancillary.vmanDei = socket->vmanDei;
 #endif
 
+#if (TCP_GSO_SUPPORT == ENABLED)
+   //The super-segment must be split into MSS-sized segments
+   if(length > socket->smss)
+      ancillary.gsoSize = socket->smss;
+#endif
+
    //Send TCP segment
    error = ipSendDatagram(socket->interface, &pseudoHeader, buffer, offset,
       &ancillary);
 
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   //Any pending acknowledgment has been carried by this segment
+   if(!error && (flags & TCP_FLAG_ACK))
+   {
+      socket->delayedAckBytes = 0;
+      tcpTimerStop(&socket->delayedAckTimer);
+   }
+#endif
+
    //Free previously allocated memory
    netBufferFree(buffer);
 
@@ -536,6 +665,125 @@ TcpOption *tcpGetOption(TcpHeader *segment, uint8_t kind)
 }
 
 
+/**
+ * @brief Verify the checksum of an incoming segment
+ *
+ * In-order data is copied to the receive buffer while the checksum is being
+ * computed, so that the payload does not need to be walked twice
+ *
+ * @param[in] socket Handle referencing the socket the segment belongs to
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] buffer Multi-part buffer that holds the incoming TCP segment
+ * @param[in] offset Offset to the first byte of the TCP header
+ * @param[in] length Length of the TCP segment, including the header
+ * @return NO_ERROR if the checksum is correct, ERROR_WRONG_CHECKSUM otherwise
+ **/
+
+error_t tcpVerifyChecksum(Socket *socket, IpPseudoHeader *pseudoHeader,
+   const NetBuffer *buffer, size_t offset, size_t length)
+{
+#if (TCP_CHECKSUM_COPY_SUPPORT == ENABLED)
+   error_t error;
+   size_t n;
+   size_t headerLen;
+   size_t rxOffset;
+   bool_t copied;
+   uint64_t sum;
+   uint64_t dataSum;
+   uint64_t partial;
+   TcpHeader *segment;
+
+   //Point to the TCP header
+   segment = netBufferAt(buffer, offset);
+   //Retrieve the length of the TCP header
+   headerLen = segment->dataOffset * 4;
+
+   //Process pseudo header and TCP header
+   sum = ipCalcChecksumPartial(pseudoHeader->data, pseudoHeader->length);
+   sum += ipCalcChecksumPartialEx(buffer, offset, headerLen);
+
+   //Point to the segment data
+   offset += headerLen;
+   length -= headerLen;
+
+   //The data has not been copied yet
+   copied = FALSE;
+
+   //The payload of an in-order segment that fits in the receive window can
+   //be copied right away. If the segment turns out to be corrupted, the
+   //copied bytes lie beyond RCV.NXT and will be overwritten later on
+   if(socket != NULL && length > 0 && length <= socket->rcvWnd &&
+      socket->sackBlockCount == 0 && ntohl(segment->seqNum) == socket->rcvNxt &&
+      !(segment->flags & (TCP_FLAG_SYN | TCP_FLAG_RST)))
+   {
+      //Only synchronized states process the segment text
+      if(socket->state == TCP_STATE_ESTABLISHED ||
+         socket->state == TCP_STATE_FIN_WAIT_1 ||
+         socket->state == TCP_STATE_FIN_WAIT_2)
+      {
+         //Offset of the first byte to write in the circular buffer
+         rxOffset = (socket->rcvNxt - socket->irs - 1) % socket->rxBufferSize;
+         //Number of bytes that can be written before wrapping around
+         n = MIN(length, socket->rxBufferSize - rxOffset);
+
+         //Copy the first part of the payload
+         error = netBufferCopyWithChecksum((NetBuffer *) &socket->rxBuffer,
+            rxOffset, buffer, offset, n, &dataSum);
+
+         //Check whether the specified data crosses buffer boundaries
+         if(!error && n < length)
+         {
+            //Wrap around to the beginning of the circular buffer
+            error = netBufferCopyWithChecksum((NetBuffer *) &socket->rxBuffer,
+               0, buffer, offset + n, length - n, &partial);
+
+            //Take care of alignment issues
+            if((n & 1) != 0)
+               partial = IP_CHECKSUM_SWAP((uint32_t) ipFoldChecksum(partial));
+
+            //Add the partial sum of the second part
+            dataSum += partial;
+         }
+
+         //Check status code
+         if(!error)
+         {
+            //Process segment data
+            sum += dataSum;
+            //The data has been copied to the receive buffer
+            copied = TRUE;
+         }
+      }
+   }
+
+   //Data not copied?
+   if(!copied)
+   {
+      //Process segment data
+      sum += ipCalcChecksumPartialEx(buffer, offset, length);
+   }
+
+   //Verify TCP checksum
+   if(ipFoldChecksum(sum) != 0xFFFF)
+      return ERROR_WRONG_CHECKSUM;
+
+   //Do not copy the data a second time when processing the segment text
+   if(socket != NULL)
+      socket->rxDataCopied = copied;
+#else
+   //Verify TCP checksum
+   if(ipCalcUpperLayerChecksumEx(pseudoHeader->data,
+      pseudoHeader->length, buffer, offset, length) != 0x0000)
+   {
+      return ERROR_WRONG_CHECKSUM;
+   }
+#endif
+
+   //The checksum is correct
+   return NO_ERROR;
+}
+
+
 /**
  * @brief Test the sequence number of an incoming segment
  * @param[in] socket Handle referencing the current socket
@@ -546,9 +794,44 @@ TcpOption *tcpGetOption(TcpHeader *segment, uint8_t kind)
 
 error_t tcpCheckSequenceNumber(Socket *socket, TcpHeader *segment, size_t length)
 {
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   bool_t tsFound;
+   bool_t tsValid;
+   uint32_t tsVal;
+   uint32_t tsEcr;
+#endif
+
    //Acceptability test for an incoming segment
    bool_t acceptable = FALSE;
 
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //Timestamps are only processed once both sides have agreed to use them
+   if(socket->tsOptionReceived)
+      tsFound = tcpGetTimestampOption(segment, &tsVal, &tsEcr);
+   else
+      tsFound = FALSE;
+
+   //TS.Recent becomes invalid when the connection has been idle for too long
+   tsValid = (osGetSystemTime() - socket->tsRecentAge) < TCP_PAWS_IDLE_TIMEOUT;
+
+   //PAWS check (refer to RFC 7323, section 5.3)
+   if(tsFound && tsValid && !(segment->flags & TCP_FLAG_RST))
+   {
+      //A segment whose timestamp is older than TS.Recent is an old duplicate
+      if(TCP_CMP_SEQ(tsVal, socket->tsRecent) < 0)
+      {
+         //Debug message
+         TRACE_WARNING("PAWS check failed!\r\n");
+
+         //Send an acknowledgment in reply and drop the segment
+         tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0, FALSE);
+
+         //Return status code
+         return ERROR_FAILURE;
+      }
+   }
+#endif
+
    //Case where both segment length and receive window are zero
    if(!length && !socket->rcvWnd)
    {
@@ -600,6 +883,20 @@ error_t tcpCheckSequenceNumber(Socket *socket, TcpHeader *segment, size_t length
       return ERROR_FAILURE;
    }
 
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //Record the timestamp to be echoed, unless the segment lies beyond the
+   //last acknowledgment sent (refer to RFC 7323, section 4.3)
+   if(tsFound && TCP_CMP_SEQ(segment->seqNum, socket->lastAckSent) <= 0)
+   {
+      //TS.Recent is never moved backwards
+      if(TCP_CMP_SEQ(tsVal, socket->tsRecent) >= 0 || !tsValid)
+      {
+         socket->tsRecent = tsVal;
+         socket->tsRecentAge = osGetSystemTime();
+      }
+   }
+#endif
+
    //Sequence number is acceptable
    return NO_ERROR;
 }
@@ -676,6 +973,10 @@ error_t tcpCheckAck(Socket *socket, TcpHeader *segment, size_t length)
       return ERROR_FAILURE;
    }
 
+   //Update the sender scoreboard with the SACK information carried by the
+   //incoming ACK
+   tcpUpdateScoreboard(socket, segment);
+
    //Check whether the ACK is a duplicate
    duplicateFlag = tcpIsDuplicateAck(socket, segment, length);
 
@@ -699,6 +1000,8 @@ error_t tcpCheckAck(Socket *socket, TcpHeader *segment, size_t length)
       //Update SND.UNA pointer
       socket->sndUna = segment->ackNum;
 
+      //Take an RTT sample from the timestamp echoed by the peer
+      tcpMeasureRtt(socket, segment);
       //Compute retransmission timeout
       updateFlag = tcpComputeRto(socket);
 
@@ -725,23 +1028,8 @@ error_t tcpCheckAck(Socket *socket, TcpHeader *segment, size_t length)
             tcpFastLossRecovery(socket, segment);
          }
 
-         //Slow start algorithm is used when cwnd is lower than ssthresh
-         if(socket->cwnd < socket->ssthresh)
-         {
-            //During slow start, TCP increments cwnd by at most SMSS bytes
-            //for each ACK received that cumulatively acknowledges new data
-            socket->cwnd += MIN(n, socket->smss);
-         }
-         //Congestion avoidance algorithm is used when cwnd exceeds ssthres
-         else
-         {
-            //Congestion window is updated once per RTT
-            if(updateFlag)
-            {
-               //TCP must not increment cwnd by more than SMSS bytes
-               socket->cwnd += MIN(socket->n, socket->smss);
-            }
-         }
+         //Let the congestion control algorithm update the congestion window
+         tcpCongestOnAck(socket, n, updateFlag);
       }
 
       //Limit the size of the congestion window
@@ -787,6 +1075,16 @@ error_t tcpCheckAck(Socket *socket, TcpHeader *segment, size_t length)
                thresh = 2;
          }
 
+#if (TCP_SACK_SUPPORT == ENABLED)
+         //With SACK, a single duplicate ACK is enough when the first
+         //unacknowledged segment is deemed lost (refer to RFC 6675, section 5)
+         if(duplicateFlag && socket->sackPermitted &&
+            socket->retransmitQueue->lost)
+         {
+            thresh = 1;
+         }
+#endif
+
          //Check the number of duplicate ACKs that have been received
          if(socket->dupAckCount >= thresh)
          {
@@ -806,6 +1104,17 @@ error_t tcpCheckAck(Socket *socket, TcpHeader *segment, size_t length)
       }
       else if(socket->congestState == TCP_CONGEST_STATE_RECOVERY)
       {
+#if (TCP_SACK_SUPPORT == ENABLED)
+         //SACK-based loss recovery does not inflate the congestion window.
+         //Instead, the holes are retransmitted as the estimated number of
+         //bytes in flight decreases (refer to RFC 6675, section 5)
+         if(socket->sackPermitted)
+         {
+            //Retransmit the segments deemed lost
+            tcpSackRetransmit(socket);
+         }
+         else
+#endif
          //Duplicate ACK received?
          if(duplicateFlag)
          {
@@ -936,7 +1245,7 @@ bool_t tcpIsDuplicateAck(Socket *socket, TcpHeader *segment, size_t length)
             {
                //The advertised window in the incoming acknowledgment equals
                //the advertised window in the last incoming acknowledgment
-               if(segment->window == socket->sndWnd)
+               if(tcpGetSegmentWindow(socket, segment) == socket->sndWnd)
                {
                   //Duplicate ACK
                   flag = TRUE;
@@ -959,12 +1268,12 @@ bool_t tcpIsDuplicateAck(Socket *socket, TcpHeader *segment, size_t length)
 void tcpFastRetransmit(Socket *socket)
 {
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
-   uint_t flightSize;
+#if (TCP_SACK_SUPPORT == ENABLED)
+   TcpQueueItem *queueItem;
+#endif
 
-   //Amount of data that has been sent but not yet acknowledged
-   flightSize = socket->sndNxt - socket->sndUna;
    //After receiving 3 duplicate ACKs, ssthresh must be adjusted
-   socket->ssthresh = MAX(flightSize / 2, 2 * socket->smss);
+   socket->ssthresh = tcpCongestOnLoss(socket);
 
    //The value of recover is incremented to the value of the highest
    //sequence number transmitted by the TCP so far
@@ -973,14 +1282,43 @@ void tcpFastRetransmit(Socket *socket)
    //Debug message
    TRACE_INFO("TCP fast retransmit...\r\n");
 
-   //TCP performs a retransmission of what appears to be the missing segment,
-   //without waiting for the retransmission timer to expire
-   tcpRetransmitSegment(socket);
+#if (TCP_SACK_SUPPORT == ENABLED)
+   //SACK-based loss recovery?
+   if(socket->sackPermitted)
+   {
+      //Start a new recovery episode
+      for(queueItem = socket->retransmitQueue; queueItem != NULL;
+         queueItem = queueItem->next)
+      {
+         queueItem->retransmitted = FALSE;
+      }
+
+      //The congestion window is not inflated (refer to RFC 6675, section 5)
+      socket->cwnd = socket->ssthresh;
+
+      //The first unacknowledged segment is presumed dropped
+      queueItem = socket->retransmitQueue;
+      queueItem->lost = TRUE;
+
+      //Retransmit it without waiting for the retransmission timer to expire
+      if(!tcpRetransmitQueueItem(socket, queueItem))
+         queueItem->retransmitted = TRUE;
+
+      //Retransmit the other holes, as allowed by the congestion window
+      tcpSackRetransmit(socket);
+   }
+   else
+#endif
+   {
+      //TCP performs a retransmission of what appears to be the missing
+      //segment, without waiting for the retransmission timer to expire
+      tcpRetransmitSegment(socket);
 
-   //cwnd must set to ssthresh plus 3*SMSS. This artificially inflates the
-   //congestion window by the number of segments (three) that have left the
-   //network and which the receiver has buffered
-   socket->cwnd = socket->ssthresh + TCP_FAST_RETRANSMIT_THRES * socket->smss;
+      //cwnd must set to ssthresh plus 3*SMSS. This artificially inflates the
+      //congestion window by the number of segments (three) that have left
+      //the network and which the receiver has buffered
+      socket->cwnd = socket->ssthresh + TCP_FAST_RETRANSMIT_THRES * socket->smss;
+   }
 
    //Enter the fast recovery procedure
    socket->congestState = TCP_CONGEST_STATE_RECOVERY;
@@ -1016,20 +1354,31 @@ void tcpFastRecovery(Socket *socket, TcpHeader *segment, uint_t n)
       //recover, then this is a partial ACK
       TRACE_INFO("TCP partial acknowledgment\r\n");
 
-      //Retransmit the first unacknowledged segment
-      tcpRetransmitSegment(socket);
-
-      //Deflate the congestion window by the amount of new data acknowledged
-      //by the cumulative acknowledgment field
-      if(socket->cwnd > n)
-         socket->cwnd -= n;
-
-      //If the partial ACK acknowledges at least one SMSS of new data, then
-      //add back SMSS bytes to the congestion window. This artificially
-      //inflates the congestion window in order to reflect the additional
-      //segment that has left the network
-      if(n >= socket->smss)
-         socket->cwnd += socket->smss;
+#if (TCP_SACK_SUPPORT == ENABLED)
+      //SACK-based loss recovery?
+      if(socket->sackPermitted)
+      {
+         //Only the holes reported by the scoreboard are retransmitted
+         tcpSackRetransmit(socket);
+      }
+      else
+#endif
+      {
+         //Retransmit the first unacknowledged segment
+         tcpRetransmitSegment(socket);
+
+         //Deflate the congestion window by the amount of new data
+         //acknowledged by the cumulative acknowledgment field
+         if(socket->cwnd > n)
+            socket->cwnd -= n;
+
+         //If the partial ACK acknowledges at least one SMSS of new data, then
+         //add back SMSS bytes to the congestion window. This artificially
+         //inflates the congestion window in order to reflect the additional
+         //segment that has left the network
+         if(n >= socket->smss)
+            socket->cwnd += socket->smss;
+      }
 
       //Do not exit the fast recovery procedure...
       socket->congestState = TCP_CONGEST_STATE_RECOVERY;
@@ -1074,78 +1423,318 @@ void tcpFastLossRecovery(Socket *socket, TcpHeader *segment)
 
 
 /**
- * @brief Process the segment text
+ * @brief Update the sender scoreboard with the SACK option of an incoming ACK
  * @param[in] socket Handle referencing the current socket
- * @param[in] segment Pointer to the TCP header
- * @param[in] buffer Multi-part buffer containing the incoming TCP segment
- * @param[in] offset Offset to the first data byte
- * @param[in] length Length of the segment data
+ * @param[in] segment Pointer to the incoming TCP segment
  **/
 
-void tcpProcessSegmentData(Socket *socket, TcpHeader *segment,
-   const NetBuffer *buffer, size_t offset, size_t length)
+void tcpUpdateScoreboard(Socket *socket, TcpHeader *segment)
 {
+#if (TCP_SACK_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t n;
+   uint_t sackedCount;
+   uint_t sackedBytes;
+   uint32_t seqNum;
    uint32_t leftEdge;
    uint32_t rightEdge;
+   TcpOption *option;
+   TcpQueueItem *queueItem;
 
-   //First sequence number occupied by the incoming segment
-   leftEdge = segment->seqNum;
-   //Sequence number immediately following the incoming segment
-   rightEdge = segment->seqNum + length;
+   //SACK must have been negotiated during connection establishment
+   if(!socket->sackPermitted)
+      return;
 
-   //Check whether some data falls outside the receive window
-   if(TCP_CMP_SEQ(leftEdge, socket->rcvNxt) < 0)
-   {
-      //Position of the first byte to be read
-      offset += socket->rcvNxt - leftEdge;
-      //Ignore the data that falls outside the receive window
-      leftEdge = socket->rcvNxt;
-   }
-   if(TCP_CMP_SEQ(rightEdge, socket->rcvNxt + socket->rcvWnd) > 0)
-   {
-      //Ignore the data that falls outside the receive window
-      rightEdge = socket->rcvNxt + socket->rcvWnd;
-   }
+   //Search the segment for a SACK option
+   option = tcpGetOption(segment, TCP_OPTION_SACK);
 
-   //Copy the incoming data to the receive buffer
-   tcpWriteRxBuffer(socket, leftEdge, buffer, offset, rightEdge - leftEdge);
+   //Malformed or missing option?
+   if(option == NULL || option->length < 10 || ((option->length - 2) % 8) != 0)
+      return;
 
-   //Update the list of non-contiguous blocks of data that
-   //have been received and queued
-   tcpUpdateSackBlocks(socket, &leftEdge, &rightEdge);
+   //Retrieve the number of blocks
+   n = (option->length - 2) / 8;
 
-   //Check whether the segment was received out of order
-   if(TCP_CMP_SEQ(leftEdge, socket->rcvNxt) > 0)
+   //Loop through the blocks
+   for(i = 0; i < n; i++)
    {
-      //Out of order data segments should be acknowledged immediately, in
-      //order to accelerate loss recovery
-      tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0,
-         FALSE);
+      //Retrieve the edges of the current block
+      leftEdge = LOAD32BE(option->value + i * 8);
+      rightEdge = LOAD32BE(option->value + i * 8 + 4);
+
+      //Ignore the blocks that do not lie within the outstanding data
+      if(TCP_CMP_SEQ(leftEdge, rightEdge) >= 0 ||
+         TCP_CMP_SEQ(leftEdge, socket->sndUna) < 0 ||
+         TCP_CMP_SEQ(rightEdge, socket->sndNxt) > 0)
+      {
+         continue;
+      }
+
+      //Mark the segments entirely covered by the block
+      for(queueItem = socket->retransmitQueue; queueItem != NULL;
+         queueItem = queueItem->next)
+      {
+         //Sequence number of the first data byte
+         seqNum = ntohl(((TcpHeader *) queueItem->header)->seqNum);
+
+         //Check whether the segment has been selectively acknowledged
+         if(queueItem->length > 0 && TCP_CMP_SEQ(seqNum, leftEdge) >= 0 &&
+            TCP_CMP_SEQ(seqNum + queueItem->length, rightEdge) <= 0)
+         {
+            queueItem->sacked = TRUE;
+         }
+      }
    }
-   else
-   {
-      //Number of contiguous bytes that have been received
-      length = rightEdge - leftEdge;
 
-      //Next sequence number expected on incoming segments
-      socket->rcvNxt += length;
-      //Number of data available in the receive buffer
-      socket->rcvUser += length;
-      //Update the receive window
-      socket->rcvWnd -= length;
+   //Total amount of data that has been selectively acknowledged
+   sackedCount = 0;
+   sackedBytes = 0;
 
-      //Acknowledge the received data (delayed ACK not supported)
-      tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0,
-         FALSE);
+   for(queueItem = socket->retransmitQueue; queueItem != NULL;
+      queueItem = queueItem->next)
+   {
+      if(queueItem->sacked)
+      {
+         sackedCount++;
+         sackedBytes += queueItem->length;
+      }
+   }
 
-      //Notify user task that data is available
-      tcpUpdateEvents(socket);
+   //A segment is deemed lost when either DupThresh segments or more than
+   //(DupThresh - 1) * SMSS bytes above it have been selectively acknowledged
+   //(refer to RFC 6675, section 4)
+   for(queueItem = socket->retransmitQueue; queueItem != NULL;
+      queueItem = queueItem->next)
+   {
+      if(queueItem->sacked)
+      {
+         //Amount of SACKed data above the next segment
+         sackedCount--;
+         sackedBytes -= queueItem->length;
+      }
+      else if(sackedCount >= TCP_FAST_RETRANSMIT_THRES ||
+         sackedBytes > (TCP_FAST_RETRANSMIT_THRES - 1) * socket->smss)
+      {
+         queueItem->lost = TRUE;
+      }
    }
+#endif
 }
 
 
 /**
- * @brief Delete TCB structure
+ * @brief Discard the information held by the sender scoreboard
+ * @param[in] socket Handle referencing the current socket
+ **/
+
+void tcpResetScoreboard(Socket *socket)
+{
+   TcpQueueItem *queueItem;
+
+   //Loop through the retransmission queue
+   for(queueItem = socket->retransmitQueue; queueItem != NULL;
+      queueItem = queueItem->next)
+   {
+      queueItem->sacked = FALSE;
+      queueItem->lost = FALSE;
+      queueItem->retransmitted = FALSE;
+   }
+}
+
+
+/**
+ * @brief Estimate the number of bytes outstanding in the network
+ * @param[in] socket Handle referencing the current socket
+ * @return Value of the pipe variable (refer to RFC 6675, section 4)
+ **/
+
+uint_t tcpComputePipe(Socket *socket)
+{
+   uint_t pipe;
+   TcpQueueItem *queueItem;
+
+   //Initialize the estimate
+   pipe = 0;
+
+   //Loop through the retransmission queue
+   for(queueItem = socket->retransmitQueue; queueItem != NULL;
+      queueItem = queueItem->next)
+   {
+      //Selectively acknowledged segments have left the network
+      if(!queueItem->sacked)
+      {
+         //The original transmission is assumed to be in flight, unless the
+         //segment is deemed lost
+         if(!queueItem->lost)
+            pipe += queueItem->length;
+
+         //So is the retransmission, if any
+         if(queueItem->retransmitted)
+            pipe += queueItem->length;
+      }
+   }
+
+   //Return the number of bytes in flight
+   return pipe;
+}
+
+
+/**
+ * @brief Retransmit the holes reported by the sender scoreboard
+ * @param[in] socket Handle referencing the current socket
+ **/
+
+void tcpSackRetransmit(Socket *socket)
+{
+#if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED && TCP_SACK_SUPPORT == ENABLED)
+   uint_t pipe;
+   TcpQueueItem *queueItem;
+
+   //Estimate the number of bytes in flight
+   pipe = tcpComputePipe(socket);
+
+   //Loop through the retransmission queue
+   for(queueItem = socket->retransmitQueue; queueItem != NULL;
+      queueItem = queueItem->next)
+   {
+      //A segment may only be sent if cwnd - pipe >= SMSS
+      if(socket->cwnd < (pipe + socket->smss))
+         break;
+
+      //Retransmit the segments deemed lost that have not already been
+      //retransmitted (refer to RFC 6675, section 4, NextSeg rule 1)
+      if(queueItem->lost && !queueItem->sacked && !queueItem->retransmitted)
+      {
+         //Retransmit the current segment
+         if(tcpRetransmitQueueItem(socket, queueItem))
+            break;
+
+         //The retransmission is now in flight
+         queueItem->retransmitted = TRUE;
+         pipe += queueItem->length;
+      }
+   }
+#endif
+}
+
+
+/**
+ * @brief Process the segment text
+ * @param[in] socket Handle referencing the current socket
+ * @param[in] segment Pointer to the TCP header
+ * @param[in] buffer Multi-part buffer containing the incoming TCP segment
+ * @param[in] offset Offset to the first data byte
+ * @param[in] length Length of the segment data
+ **/
+
+void tcpProcessSegmentData(Socket *socket, TcpHeader *segment,
+   const NetBuffer *buffer, size_t offset, size_t length)
+{
+   uint32_t leftEdge;
+   uint32_t rightEdge;
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   bool_t gapFlag;
+#endif
+
+   //First sequence number occupied by the incoming segment
+   leftEdge = segment->seqNum;
+   //Sequence number immediately following the incoming segment
+   rightEdge = segment->seqNum + length;
+
+   //Check whether some data falls outside the receive window
+   if(TCP_CMP_SEQ(leftEdge, socket->rcvNxt) < 0)
+   {
+      //Position of the first byte to be read
+      offset += socket->rcvNxt - leftEdge;
+      //Ignore the data that falls outside the receive window
+      leftEdge = socket->rcvNxt;
+   }
+   if(TCP_CMP_SEQ(rightEdge, socket->rcvNxt + socket->rcvWnd) > 0)
+   {
+      //Ignore the data that falls outside the receive window
+      rightEdge = socket->rcvNxt + socket->rcvWnd;
+   }
+
+#if (TCP_CHECKSUM_COPY_SUPPORT == ENABLED)
+   //The data may have been copied while verifying the checksum
+   if(socket->rxDataCopied)
+   {
+      //The payload already resides in the receive buffer
+      socket->rxDataCopied = FALSE;
+   }
+   else
+#endif
+   {
+      //Copy the incoming data to the receive buffer
+      tcpWriteRxBuffer(socket, leftEdge, buffer, offset, rightEdge - leftEdge);
+   }
+
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   //Check whether out-of-order data is already queued
+   gapFlag = (socket->sackBlockCount > 0) ? TRUE : FALSE;
+#endif
+
+   //Update the list of non-contiguous blocks of data that
+   //have been received and queued
+   tcpUpdateSackBlocks(socket, &leftEdge, &rightEdge);
+
+   //Check whether the segment was received out of order
+   if(TCP_CMP_SEQ(leftEdge, socket->rcvNxt) > 0)
+   {
+      //Out of order data segments should be acknowledged immediately, in
+      //order to accelerate loss recovery
+      tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0,
+         FALSE);
+   }
+   else
+   {
+      //Number of contiguous bytes that have been received
+      length = rightEdge - leftEdge;
+
+      //Next sequence number expected on incoming segments
+      socket->rcvNxt += length;
+      //Number of data available in the receive buffer
+      socket->rcvUser += length;
+      //Update the receive window
+      socket->rcvWnd -= length;
+
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+      //Keep track of the data that has not been acknowledged yet
+      socket->delayedAckBytes += length;
+
+      //An ACK should be generated for at least every second full-sized
+      //segment, and immediately when a segment fills in all or part of a
+      //gap (refer to RFC 1122, section 4.2.3.2 and RFC 5681, section 4.2).
+      //A short segment with PSH set usually ends a request the peer is
+      //waiting an answer for
+      if(!socket->delayedAckEnabled || gapFlag ||
+         socket->delayedAckBytes >= (2 * socket->rmss) ||
+         ((segment->flags & TCP_FLAG_PSH) && length < socket->rmss))
+      {
+         //Acknowledge the received data immediately
+         tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt,
+            0, FALSE);
+      }
+      else if(!tcpTimerRunning(&socket->delayedAckTimer))
+      {
+         //The ACK is delayed so that it can be combined with a response or
+         //with the ACK of the next segment
+         tcpTimerStart(&socket->delayedAckTimer, TCP_DELAYED_ACK_TIMEOUT);
+      }
+#else
+      //Acknowledge the received data
+      tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0,
+         FALSE);
+#endif
+
+      //Notify user task that data is available
+      tcpUpdateEvents(socket);
+   }
+}
+
+
+/**
+ * @brief Delete TCB structure
  * @param[in] socket Handle referencing the socket
  **/
 
@@ -1154,14 +1743,41 @@ void tcpDeleteControlBlock(Socket *socket)
    //Delete retransmission queue
    tcpFlushRetransmitQueue(socket);
 
+#if (TCP_ZERO_COPY_TX_SUPPORT == ENABLED)
+   //Release the caller-supplied buffers
+   tcpFlushTxRefQueue(socket);
+#endif
+
    //Delete SYN queue
    tcpFlushSynQueue(socket);
 
+   //Cancel the timers so that no deadline refers to the socket anymore
+   tcpTimerStop(&socket->retransmitTimer);
+   tcpTimerStop(&socket->persistTimer);
+   tcpTimerStop(&socket->overrideTimer);
+   tcpTimerStop(&socket->finWait2Timer);
+   tcpTimerStop(&socket->timeWaitTimer);
+
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   tcpTimerStop(&socket->delayedAckTimer);
+#endif
+
+#if (TCP_PACING_SUPPORT == ENABLED)
+   tcpTimerStop(&socket->pacingTimer);
+#endif
+
    //Release transmit buffer
    netBufferSetLength((NetBuffer *) &socket->txBuffer, 0);
 
-   //Release receive buffer
-   netBufferSetLength((NetBuffer *) &socket->rxBuffer, 0);
+#if (TCP_ZERO_COPY_RX_SUPPORT == ENABLED)
+   //Data loaned to the application must remain valid until it is released.
+   //The receive buffer is then reclaimed when the socket is closed
+   if(socket->rxLoanLength == 0)
+#endif
+   {
+      //Release receive buffer
+      netBufferSetLength((NetBuffer *) &socket->rxBuffer, 0);
+   }
 }
 
 
@@ -1238,6 +1854,12 @@ void tcpUpdateRetransmitQueue(Socket *socket)
    //turn off the retransmission timer
    if(socket->retransmitQueue == NULL)
       tcpTimerStop(&socket->retransmitTimer);
+
+#if (TCP_ZERO_COPY_TX_SUPPORT == ENABLED)
+   //Caller-supplied buffers can be released as soon as their data has been
+   //acknowledged
+   tcpUpdateTxRefQueue(socket);
+#endif
 }
 
 
@@ -1270,175 +1892,881 @@ void tcpFlushRetransmitQueue(Socket *socket)
 }
 
 
+#if (TCP_ZERO_COPY_TX_SUPPORT == ENABLED)
+
 /**
- * @brief Flush SYN queue
+ * @brief Release the caller-supplied buffers whose data has been acknowledged
  * @param[in] socket Handle referencing the socket
  **/
 
-void tcpFlushSynQueue(Socket *socket)
+void tcpUpdateTxRefQueue(Socket *socket)
 {
-   //Point to the first item in the SYN queue
-   TcpSynQueueItem *queueItem = socket->synQueue;
+   TcpTxRef *ref;
 
-   //Loop through SYN queue
-   while(queueItem != NULL)
+   //Buffers are sorted by sequence number
+   while(socket->txRefQueue != NULL)
    {
-      //Keep track of the next item in the queue
-      TcpSynQueueItem *nextQueueItem = queueItem->next;
-      //Free previously allocated memory
-      memPoolFree(queueItem);
-      //Point to the next item
-      queueItem = nextQueueItem;
-   }
+      //Point to the first buffer
+      ref = socket->txRefQueue;
 
-   //SYN queue was successfully flushed
-   socket->synQueue = NULL;
+      //The buffer that tcpSendBuffer is still filling is released by the
+      //latter. Any other buffer is kept until its data is acknowledged
+      if(ref->busy || TCP_CMP_SEQ(socket->sndUna, ref->seqNum + ref->length) < 0)
+         break;
+
+      //Remove the buffer from the queue
+      socket->txRefQueue = ref->next;
+
+      //The data is no longer needed for retransmission
+      netBufferFree(ref->buffer);
+      memPoolFree(ref);
+   }
 }
 
 
 /**
- * @brief Update the list of non-contiguous blocks that have been received
+ * @brief Release all the caller-supplied buffers
  * @param[in] socket Handle referencing the socket
- * @param[in,out] leftEdge First sequence number occupied by the incoming data
- * @param[in,out] rightEdge Sequence number immediately following the incoming data
  **/
 
-void tcpUpdateSackBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge)
+void tcpFlushTxRefQueue(Socket *socket)
 {
-   uint_t i = 0;
+   TcpTxRef *ref;
+   TcpTxRef *nextRef;
 
-   //Loop through the blocks
-   while(i < socket->sackBlockCount)
+   //Loop through the buffers
+   for(ref = socket->txRefQueue; ref != NULL; ref = nextRef)
    {
-      //Find each block that overlaps the specified one
-      if(TCP_CMP_SEQ(*rightEdge, socket->sackBlock[i].leftEdge) >= 0 &&
-         TCP_CMP_SEQ(*leftEdge, socket->sackBlock[i].rightEdge) <= 0)
+      //Keep track of the next buffer in the queue
+      nextRef = ref->next;
+
+      //Check whether tcpSendBuffer is still filling the buffer
+      if(ref->busy)
       {
-         //Merge blocks to form a contiguous one
-         *leftEdge = MIN(*leftEdge, socket->sackBlock[i].leftEdge);
-         *rightEdge = MAX(*rightEdge, socket->sackBlock[i].rightEdge);
+         //Let tcpSendBuffer know that the buffer has been unlinked
+         ref->linked = FALSE;
+      }
+      else
+      {
+         //Free previously allocated memory
+         netBufferFree(ref->buffer);
+         memPoolFree(ref);
+      }
+   }
 
-         //Delete current block
-         osMemmove(socket->sackBlock + i, socket->sackBlock + i + 1,
-            (TCP_MAX_SACK_BLOCKS - i - 1) * sizeof(TcpSackBlock));
+   //The queue is now empty
+   socket->txRefQueue = NULL;
+}
 
-         //Decrement the number of non-contiguous blocks
-         socket->sackBlockCount--;
+
+/**
+ * @brief Find the caller-supplied buffer holding a given sequence number
+ * @param[in] socket Handle referencing the socket
+ * @param[in] seqNum Sequence number of the first data byte
+ * @param[in,out] length Number of data bytes to process. On return, number
+ *   of contiguous bytes that lie in the same buffer
+ * @return Buffer holding the data, or NULL if the data lies in the send buffer
+ **/
+
+TcpTxRef *tcpGetTxRef(Socket *socket, uint32_t seqNum, size_t *length)
+{
+   TcpTxRef *ref;
+
+   //Buffers are sorted by sequence number
+   for(ref = socket->txRefQueue; ref != NULL; ref = ref->next)
+   {
+      //The data starts before the current buffer?
+      if(TCP_CMP_SEQ(seqNum, ref->seqNum) < 0)
+      {
+         //The leading bytes lie in the send buffer
+         *length = MIN(*length, ref->seqNum - seqNum);
+         ref = NULL;
+         break;
       }
-      else
+      //The data starts within the current buffer?
+      else if(TCP_CMP_SEQ(seqNum, ref->seqNum + ref->length) < 0)
       {
-         //Point to the next block
-         i++;
+         //Do not read past the end of the buffer
+         *length = MIN(*length, ref->seqNum + ref->length - seqNum);
+         break;
       }
    }
 
-   //Check whether the incoming segment was received out of order
-   if(TCP_CMP_SEQ(*leftEdge, socket->rcvNxt) > 0)
+   //Return the buffer holding the data, if any
+   return ref;
+}
+
+
+/**
+ * @brief Queue a caller-supplied buffer without copying its contents
+ * @param[in] socket Handle that identifies a connected socket
+ * @param[in] buffer Multi-part buffer containing the data to be transmitted.
+ *   The buffer is always released by the stack, even if an error is returned
+ * @param[in] offset Offset to the first data byte
+ * @param[out] written Actual number of bytes written (optional parameter)
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t tcpQueueTxRef(Socket *socket, NetBuffer *buffer, size_t offset,
+   size_t *written, uint_t flags)
+{
+   error_t error;
+   uint_t n;
+   uint_t event;
+   size_t length;
+   size_t totalLength;
+   bool_t netLocked;
+   TcpTxRef *ref;
+   TcpTxRef *lastRef;
+
+   //Check whether the socket is in the listening state
+   if(socket->state == TCP_STATE_LISTEN)
    {
-      //Make room for the new non-contiguous block
-      osMemmove(socket->sackBlock + 1, socket->sackBlock,
-         (TCP_MAX_SACK_BLOCKS - 1) * sizeof(TcpSackBlock));
+      //Release the buffer
+      netBufferFree(buffer);
+      //Report an error
+      return ERROR_NOT_CONNECTED;
+   }
 
-      //Insert the element in the list
-      socket->sackBlock[0].leftEdge = *leftEdge;
-      socket->sackBlock[0].rightEdge = *rightEdge;
+   //Allocate a descriptor that refers to the buffer
+   ref = memPoolAlloc(sizeof(TcpTxRef));
+
+   //Failed to allocate memory?
+   if(ref == NULL)
+   {
+      //Release the buffer
+      netBufferFree(buffer);
+      //Report an error
+      return ERROR_OUT_OF_MEMORY;
+   }
+
+   //The data extends from the specified offset to the end of the buffer
+   length = netBufferGetLength(buffer) - offset;
+
+   //Initialize the descriptor
+   ref->next = NULL;
+   ref->buffer = buffer;
+   ref->offset = offset;
+   ref->seqNum = 0;
+   ref->length = 0;
+
+   //The descriptor is not yet linked to the queue, and cannot be released
+   //by the stack as long as the buffer is being filled
+   ref->busy = TRUE;
+   ref->linked = FALSE;
+
+   //Initialize variables
+   error = NO_ERROR;
+   totalLength = 0;
+
+   //Send as much data as possible
+   while(totalLength < length)
+   {
+      //Wait until there is more room in the send buffer
+      event = tcpWaitForEvents(socket, SOCKET_EVENT_TX_READY, socket->timeout);
+
+      //A timeout exception occurred?
+      if(event != SOCKET_EVENT_TX_READY)
+      {
+         error = ERROR_TIMEOUT;
+         break;
+      }
+
+      //Check current TCP state
+      switch(socket->state)
+      {
+      //ESTABLISHED or CLOSE-WAIT state?
+      case TCP_STATE_ESTABLISHED:
+      case TCP_STATE_CLOSE_WAIT:
+         //The send buffer is now available for writing
+         break;
+
+      //LAST-ACK, FIN-WAIT-1, FIN-WAIT-2, CLOSING or TIME-WAIT state?
+      case TCP_STATE_LAST_ACK:
+      case TCP_STATE_FIN_WAIT_1:
+      case TCP_STATE_FIN_WAIT_2:
+      case TCP_STATE_CLOSING:
+      case TCP_STATE_TIME_WAIT:
+         //The connection is being closed
+         error = ERROR_CONNECTION_CLOSING;
+         break;
+
+      //CLOSED state?
+      default:
+         //The connection was reset by remote side?
+         error = (socket->resetFlag) ? ERROR_CONNECTION_RESET : ERROR_NOT_CONNECTED;
+         break;
+      }
+
+      //Any error to report?
+      if(error)
+         break;
+
+      //Determine the actual number of bytes in the send buffer
+      n = socket->sndUser + socket->sndNxt - socket->sndUna;
+
+      //Exit immediately if the transmission buffer is full (sanity check)
+      if(n >= socket->txBufferSize)
+      {
+         error = ERROR_FAILURE;
+         break;
+      }
+
+      //Referenced data occupies room in the send buffer, so that sequence
+      //numbers and buffer offsets remain consistent
+      n = socket->txBufferSize - n;
+      n = MIN(n, length - totalLength);
+
+      //Any data to queue?
+      if(n > 0)
+      {
+         //First pass?
+         if(totalLength == 0)
+         {
+            //The data follows the data that is already buffered
+            ref->seqNum = socket->sndNxt + socket->sndUser;
+
+            //Append the descriptor to the queue
+            if(socket->txRefQueue == NULL)
+            {
+               socket->txRefQueue = ref;
+            }
+            else
+            {
+               //Point to the last descriptor of the queue
+               for(lastRef = socket->txRefQueue; lastRef->next != NULL;
+                  lastRef = lastRef->next)
+               {
+               }
+
+               //Link the new descriptor
+               lastRef->next = ref;
+            }
+
+            //The descriptor is now linked to the queue
+            ref->linked = TRUE;
+         }
+         else if(!ref->linked ||
+            (ref->seqNum + ref->length) != (socket->sndNxt + socket->sndUser))
+         {
+            //Another task wrote to the socket in the meantime
+            error = ERROR_FAILURE;
+            break;
+         }
+
+         //Update the number of data buffered but not yet sent
+         ref->length += n;
+         socket->sndUser += n;
+         //Update byte counter
+         totalLength += n;
+
+         //Total number of data that have been written
+         if(written != NULL)
+            *written = totalLength;
+
+         //Update TX events
+         tcpUpdateEvents(socket);
+
+         //To avoid a deadlock, it is necessary to have a timeout to force
+         //transmission of data, overriding the SWS avoidance algorithm
+         if(socket->sndUser == n)
+            tcpTimerStart(&socket->overrideTimer, TCP_OVERRIDE_TIMEOUT);
+      }
+
+      //The netMutex is required to transmit segments
+      netLocked = socketAcquireNetMutex(socket);
+
+      //The connection may have been closed in the meantime
+      if(socket->state == TCP_STATE_ESTABLISHED ||
+         socket->state == TCP_STATE_CLOSE_WAIT)
+      {
+         //The Nagle algorithm should be implemented to coalesce
+         //short segments (refer to RFC 1122 4.2.3.4)
+         tcpNagleAlgo(socket, flags);
+      }
+
+      //Release the netMutex as soon as possible
+      if(netLocked)
+         socketReleaseNetMutex(socket);
+   }
+
+   //The stack is now in charge of the buffer
+   ref->busy = FALSE;
+
+   //Check whether the descriptor is still linked to the queue
+   if(ref->linked)
+   {
+      //The data may have been acknowledged already
+      tcpUpdateTxRefQueue(socket);
+   }
+   else
+   {
+      //No data was queued, or the connection has been aborted
+      netBufferFree(buffer);
+      memPoolFree(ref);
+   }
+
+   //The SOCKET_FLAG_WAIT_ACK flag causes the function to
+   //wait for acknowledgment from the remote side
+   if(!error && (flags & SOCKET_FLAG_WAIT_ACK) != 0)
+   {
+      //Wait for the data to be acknowledged
+      event = tcpWaitForEvents(socket, SOCKET_EVENT_TX_ACKED, socket->timeout);
+
+      //A timeout exception occurred?
+      if(event != SOCKET_EVENT_TX_ACKED)
+         error = ERROR_TIMEOUT;
+      //The connection was closed before an acknowledgment was received?
+      else if(socket->state != TCP_STATE_ESTABLISHED && socket->state != TCP_STATE_CLOSE_WAIT)
+         error = ERROR_NOT_CONNECTED;
+   }
+
+   //Return status code
+   return error;
+}
+
+#endif
+
+
+/**
+ * @brief Flush SYN queue
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpFlushSynQueue(Socket *socket)
+{
+   //Point to the first item in the SYN queue
+   TcpSynQueueItem *queueItem = socket->synQueue;
+
+   //Loop through SYN queue
+   while(queueItem != NULL)
+   {
+      //Keep track of the next item in the queue
+      TcpSynQueueItem *nextQueueItem = queueItem->next;
+      //Free previously allocated memory
+      memPoolFree(queueItem);
+      //Point to the next item
+      queueItem = nextQueueItem;
+   }
+
+   //SYN queue was successfully flushed
+   socket->synQueue = NULL;
+}
+
+
+/**
+ * @brief Update the list of non-contiguous blocks that have been received
+ * @param[in] socket Handle referencing the socket
+ * @param[in,out] leftEdge First sequence number occupied by the incoming data
+ * @param[in,out] rightEdge Sequence number immediately following the incoming data
+ **/
+
+void tcpUpdateSackBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge)
+{
+   uint_t i = 0;
+
+   //Loop through the blocks
+   while(i < socket->sackBlockCount)
+   {
+      //Find each block that overlaps the specified one
+      if(TCP_CMP_SEQ(*rightEdge, socket->sackBlock[i].leftEdge) >= 0 &&
+         TCP_CMP_SEQ(*leftEdge, socket->sackBlock[i].rightEdge) <= 0)
+      {
+         //Merge blocks to form a contiguous one
+         *leftEdge = MIN(*leftEdge, socket->sackBlock[i].leftEdge);
+         *rightEdge = MAX(*rightEdge, socket->sackBlock[i].rightEdge);
+
+         //Delete current block
+         osMemmove(socket->sackBlock + i, socket->sackBlock + i + 1,
+            (TCP_MAX_SACK_BLOCKS - i - 1) * sizeof(TcpSackBlock));
+
+         //Decrement the number of non-contiguous blocks
+         socket->sackBlockCount--;
+      }
+      else
+      {
+         //Point to the next block
+         i++;
+      }
+   }
+
+   //Check whether the incoming segment was received out of order
+   if(TCP_CMP_SEQ(*leftEdge, socket->rcvNxt) > 0)
+   {
+      //Make room for the new non-contiguous block
+      osMemmove(socket->sackBlock + 1, socket->sackBlock,
+         (TCP_MAX_SACK_BLOCKS - 1) * sizeof(TcpSackBlock));
+
+      //Insert the element in the list
+      socket->sackBlock[0].leftEdge = *leftEdge;
+      socket->sackBlock[0].rightEdge = *rightEdge;
+
+      //Increment the number of non-contiguous blocks
+      if(socket->sackBlockCount < TCP_MAX_SACK_BLOCKS)
+         socket->sackBlockCount++;
+   }
+}
+
+
+/**
+ * @brief Update send window
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Pointer to the incoming TCP segment
+ **/
+
+void tcpUpdateSendWindow(Socket *socket, TcpHeader *segment)
+{
+   uint32_t window;
+
+   //Retrieve the window advertised by the peer
+   window = tcpGetSegmentWindow(socket, segment);
+
+   //Case where neither the sequence nor the acknowledgment number is increased
+   if(segment->seqNum == socket->sndWl1 && segment->ackNum == socket->sndWl2)
+   {
+      //TCP may ignore a window update with a smaller window than previously
+      //offered if neither the sequence number nor the acknowledgment number
+      //is increased (refer to RFC 1122, section 4.2.2.16)
+      if(window > socket->sndWnd)
+      {
+         //Update the send window and record the sequence number and the
+         //acknowledgment number used to update SND.WND
+         socket->sndWnd = window;
+         socket->sndWl1 = segment->seqNum;
+         socket->sndWl2 = segment->ackNum;
+
+         //Maximum send window it has seen so far on the connection
+         socket->maxSndWnd = MAX(socket->maxSndWnd, window);
+      }
+   }
+   //Case where the sequence or the acknowledgment number is increased
+   else if(TCP_CMP_SEQ(segment->seqNum, socket->sndWl1) >= 0 &&
+      TCP_CMP_SEQ(segment->ackNum, socket->sndWl2) >= 0)
+   {
+      //The remote host advertises a zero window?
+      if(!window && socket->sndWnd)
+      {
+         //Start the persist timer
+         socket->wndProbeCount = 0;
+         socket->wndProbeInterval = TCP_DEFAULT_PROBE_INTERVAL;
+         tcpTimerStart(&socket->persistTimer, socket->wndProbeInterval);
+      }
+
+      //Update the send window and record the sequence number and the
+      //acknowledgment number used to update SND.WND
+      socket->sndWnd = window;
+      socket->sndWl1 = segment->seqNum;
+      socket->sndWl2 = segment->ackNum;
+
+      //Maximum send window it has seen so far on the connection
+      socket->maxSndWnd = MAX(socket->maxSndWnd, window);
+   }
+}
+
+
+/**
+ * @brief Update receive window so as to avoid Silly Window Syndrome
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpUpdateReceiveWindow(Socket *socket)
+{
+   uint32_t reduction;
+
+   //Space available but not yet advertised
+   reduction = socket->rxBufferSize - socket->rcvUser - socket->rcvWnd;
+
+   //To avoid SWS, the receiver should not advertise small windows
+   if((socket->rcvWnd + reduction) >= MIN(socket->rmss, socket->rxBufferSize / 2))
+   {
+      //Check whether a window update should be sent
+      if(socket->rcvWnd < MIN(socket->rmss, socket->rxBufferSize / 2))
+      {
+         //Debug message
+         TRACE_INFO("%s: TCP sending window update...\r\n",
+            formatSystemTime(osGetSystemTime(), NULL));
+
+         //Update the receive window
+         socket->rcvWnd += reduction;
+         //Send an ACK segment to advertise the new window size
+         tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0, FALSE);
+      }
+      else
+      {
+         //The receive window can be updated
+         socket->rcvWnd += reduction;
+      }
+   }
+}
+
+
+/**
+ * @brief Retrieve the window advertised in an incoming segment
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Pointer to the incoming TCP segment
+ * @return Size of the window, in bytes
+ **/
+
+uint32_t tcpGetSegmentWindow(Socket *socket, const TcpHeader *segment)
+{
+   uint32_t window;
+
+   //Window field of the TCP header
+   window = segment->window;
+
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+   //The window field in a SYN segment is never scaled (refer to RFC 7323,
+   //section 2.2)
+   if(!(segment->flags & TCP_FLAG_SYN))
+      window <<= socket->sndWndShift;
+#endif
+
+   //Return the size of the window
+   return window;
+}
+
+
+/**
+ * @brief Select the window scale factor to offer to the peer
+ * @param[in] rxBufferSize Size of the receive buffer
+ * @return Smallest shift count that allows the whole receive buffer to be
+ *   advertised
+ **/
+
+uint8_t tcpComputeWindowShift(size_t rxBufferSize)
+{
+   uint8_t shift;
+
+   //Find the smallest suitable shift count
+   for(shift = 0; shift < TCP_MAX_WINDOW_SHIFT; shift++)
+   {
+      //The scaled window must fit in the 16-bit window field
+      if((rxBufferSize >> shift) <= UINT16_MAX)
+         break;
+   }
+
+   //Return the shift count
+   return shift;
+}
+
+
+/**
+ * @brief Parse the Window Scale option of an incoming SYN segment
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Pointer to the incoming SYN segment
+ **/
+
+void tcpParseWindowScaleOption(Socket *socket, TcpHeader *segment)
+{
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+   TcpOption *option;
+
+   //Search the SYN segment for a Window Scale option
+   option = tcpGetOption(segment, TCP_OPTION_WINDOW_SCALE_FACTOR);
+
+   //Specified option found?
+   if(option != NULL && option->length == 3)
+   {
+      //The option has been received
+      socket->wndScaleOptionReceived = TRUE;
+
+      //Shift counts greater than 14 must be treated as 14 (refer to
+      //RFC 7323, section 2.3)
+      socket->sndWndShift = MIN(option->value[0], TCP_MAX_WINDOW_SHIFT);
+
+      //Debug message
+      TRACE_DEBUG("Remote host window shift = %" PRIu8 "\r\n", socket->sndWndShift);
+   }
+   else
+   {
+      //Window scaling is only enabled when both sides have sent the option
+      socket->wndScaleOptionReceived = FALSE;
+      socket->sndWndShift = 0;
+      socket->rcvWndShift = 0;
+   }
+#endif
+}
+
+
+/**
+ * @brief Append a Timestamps option to an outgoing segment
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Pointer to the TCP header
+ **/
+
+void tcpAddTimestampOption(Socket *socket, TcpHeader *segment)
+{
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   uint8_t value[8];
+
+   //TSval field carries the current value of the timestamp clock
+   STORE32BE((uint32_t) osGetSystemTime(), value);
+
+   //TSecr field is only valid when the ACK bit is set (refer to RFC 7323,
+   //section 3.2)
+   if(segment->flags & TCP_FLAG_ACK)
+      STORE32BE(socket->tsRecent, value + 4);
+   else
+      STORE32BE(0, value + 4);
+
+   //Append Timestamps option
+   tcpAddOption(segment, TCP_OPTION_TIMESTAMP, value, sizeof(value));
+#endif
+}
+
+
+/**
+ * @brief Refresh the Timestamps option of a segment about to be retransmitted
+ *
+ * The TCP checksum is adjusted incrementally (refer to RFC 1624), so that
+ * the payload does not need to be walked again
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Pointer to the TCP header
+ **/
+
+void tcpRefreshTimestampOption(Socket *socket, TcpHeader *segment)
+{
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   uint64_t sum;
+   TcpOption *option;
+
+   //Search the segment for a Timestamps option
+   option = tcpGetOption(segment, TCP_OPTION_TIMESTAMP);
+
+   //Specified option found?
+   if(option != NULL && option->length == 10)
+   {
+      //Remove the old option value from the checksum
+      sum = (uint16_t) ~segment->checksum;
+      sum += ipFoldChecksum(ipCalcChecksumPartial(option->value, 8)) ^ 0xFFFF;
+
+      //Update TSval field
+      STORE32BE((uint32_t) osGetSystemTime(), option->value);
+
+      //Update TSecr field
+      if(segment->flags & TCP_FLAG_ACK)
+         STORE32BE(socket->tsRecent, option->value + 4);
+
+      //Add the new option value to the checksum
+      sum += ipCalcChecksumPartial(option->value, 8);
+      segment->checksum = ipFoldChecksum(sum) ^ 0xFFFF;
+   }
+#endif
+}
+
+
+/**
+ * @brief Extract the Timestamps option of an incoming segment
+ * @param[in] segment Pointer to the TCP header
+ * @param[out] tsVal Timestamp value
+ * @param[out] tsEcr Timestamp echo reply
+ * @return TRUE if the segment carries a valid Timestamps option, else FALSE
+ **/
+
+bool_t tcpGetTimestampOption(TcpHeader *segment, uint32_t *tsVal,
+   uint32_t *tsEcr)
+{
+   TcpOption *option;
+
+   //Search the segment for a Timestamps option
+   option = tcpGetOption(segment, TCP_OPTION_TIMESTAMP);
+
+   //Malformed or missing option?
+   if(option == NULL || option->length != 10)
+      return FALSE;
+
+   //Retrieve TSval and TSecr fields
+   *tsVal = LOAD32BE(option->value);
+   *tsEcr = LOAD32BE(option->value + 4);
+
+   //The option is valid
+   return TRUE;
+}
+
+
+/**
+ * @brief Append a SACK option to an outgoing ACK segment
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Pointer to the TCP header
+ **/
+
+void tcpAddSackOption(Socket *socket, TcpHeader *segment)
+{
+#if (TCP_SACK_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t n;
+   uint8_t value[TCP_MAX_SACK_BLOCKS * 8];
+
+   //Number of blocks that fit in the remaining option space, taking into
+   //account the kind and length fields as well as the padding
+   n = (TCP_MAX_HEADER_LENGTH - segment->dataOffset * 4 - 4) / 8;
+   //The most recently received block is reported first
+   n = MIN(n, socket->sackBlockCount);
+
+   //Format the blocks
+   for(i = 0; i < n; i++)
+   {
+      STORE32BE(socket->sackBlock[i].leftEdge, value + i * 8);
+      STORE32BE(socket->sackBlock[i].rightEdge, value + i * 8 + 4);
+   }
+
+   //Any block to report?
+   if(n > 0)
+   {
+      //Append SACK option
+      tcpAddOption(segment, TCP_OPTION_SACK, value, n * 8);
+   }
+#endif
+}
+
+
+/**
+ * @brief Parse the SACK Permitted option of an incoming SYN segment
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Pointer to the incoming SYN segment
+ **/
+
+void tcpParseSackPermittedOption(Socket *socket, TcpHeader *segment)
+{
+#if (TCP_SACK_SUPPORT == ENABLED)
+   TcpOption *option;
+
+   //Search the SYN segment for a SACK Permitted option
+   option = tcpGetOption(segment, TCP_OPTION_SACK_PERMITTED);
+
+   //SACK is only used when both sides have sent the option
+   if(option != NULL && option->length == 2)
+      socket->sackPermitted = TRUE;
+   else
+      socket->sackPermitted = FALSE;
+#endif
+}
+
+
+/**
+ * @brief Parse the Timestamps option of an incoming SYN segment
+ * @param[in] socket Handle referencing the socket
+ * @param[in] segment Pointer to the incoming SYN segment
+ **/
+
+void tcpParseTimestampOption(Socket *socket, TcpHeader *segment)
+{
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   uint32_t tsVal;
+   uint32_t tsEcr;
 
-      //Increment the number of non-contiguous blocks
-      if(socket->sackBlockCount < TCP_MAX_SACK_BLOCKS)
-         socket->sackBlockCount++;
+   //Timestamps are only used when both sides have sent the option
+   socket->tsOptionReceived = tcpGetTimestampOption(segment, &tsVal, &tsEcr);
+
+   //Specified option found?
+   if(socket->tsOptionReceived)
+   {
+      //Save the timestamp to be echoed to the peer
+      socket->tsRecent = tsVal;
+      socket->tsRecentAge = osGetSystemTime();
+
+      //Every subsequent segment carries the option, which reduces the
+      //amount of data that fits in a segment
+      socket->smss = MAX(socket->smss - TCP_TIMESTAMPS_OPTION_LENGTH,
+         TCP_MIN_MSS);
    }
+#endif
 }
 
 
 /**
- * @brief Update send window
+ * @brief Take an RTT sample from the timestamp echoed in an incoming ACK
  * @param[in] socket Handle referencing the socket
- * @param[in] segment Pointer to the incoming TCP segment
+ * @param[in] segment Pointer to the incoming ACK segment
  **/
 
-void tcpUpdateSendWindow(Socket *socket, TcpHeader *segment)
+void tcpMeasureRtt(Socket *socket, TcpHeader *segment)
 {
-   //Case where neither the sequence nor the acknowledgment number is increased
-   if(segment->seqNum == socket->sndWl1 && segment->ackNum == socket->sndWl2)
-   {
-      //TCP may ignore a window update with a smaller window than previously
-      //offered if neither the sequence number nor the acknowledgment number
-      //is increased (refer to RFC 1122, section 4.2.2.16)
-      if(segment->window > socket->sndWnd)
-      {
-         //Update the send window and record the sequence number and the
-         //acknowledgment number used to update SND.WND
-         socket->sndWnd = segment->window;
-         socket->sndWl1 = segment->seqNum;
-         socket->sndWl2 = segment->ackNum;
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   uint32_t time;
+   uint32_t tsVal;
+   uint32_t tsEcr;
 
-         //Maximum send window it has seen so far on the connection
-         socket->maxSndWnd = MAX(socket->maxSndWnd, segment->window);
-      }
-   }
-   //Case where the sequence or the acknowledgment number is increased
-   else if(TCP_CMP_SEQ(segment->seqNum, socket->sndWl1) >= 0 &&
-      TCP_CMP_SEQ(segment->ackNum, socket->sndWl2) >= 0)
+   //Timestamps in use on this connection?
+   if(socket->tsOptionReceived)
    {
-      //The remote host advertises a zero window?
-      if(!segment->window && socket->sndWnd)
+      //Check whether the ACK echoes one of our timestamps
+      if(tcpGetTimestampOption(segment, &tsVal, &tsEcr) && tsEcr != 0)
       {
-         //Start the persist timer
-         socket->wndProbeCount = 0;
-         socket->wndProbeInterval = TCP_DEFAULT_PROBE_INTERVAL;
-         tcpTimerStart(&socket->persistTimer, socket->wndProbeInterval);
-      }
-
-      //Update the send window and record the sequence number and the
-      //acknowledgment number used to update SND.WND
-      socket->sndWnd = segment->window;
-      socket->sndWl1 = segment->seqNum;
-      socket->sndWl2 = segment->ackNum;
+         //Get current time
+         time = (uint32_t) osGetSystemTime();
 
-      //Maximum send window it has seen so far on the connection
-      socket->maxSndWnd = MAX(socket->maxSndWnd, segment->window);
+         //Discard echoed values that lie in the future
+         if(TCP_CMP_SEQ(time, tsEcr) >= 0)
+         {
+            //Every ACK that acknowledges new data provides a valid RTT
+            //sample (refer to RFC 7323, section 4.1)
+            tcpUpdateRto(socket, time - tsEcr);
+         }
+      }
    }
+#endif
 }
 
 
 /**
- * @brief Update receive window so as to avoid Silly Window Syndrome
+ * @brief Update the RTT estimators with a new sample
  * @param[in] socket Handle referencing the socket
+ * @param[in] r Round-trip time measurement
  **/
 
-void tcpUpdateReceiveWindow(Socket *socket)
+void tcpUpdateRto(Socket *socket, systime_t r)
 {
-   uint16_t reduction;
-
-   //Space available but not yet advertised
-   reduction = socket->rxBufferSize - socket->rcvUser - socket->rcvWnd;
+   systime_t delta;
 
-   //To avoid SWS, the receiver should not advertise small windows
-   if((socket->rcvWnd + reduction) >= MIN(socket->rmss, socket->rxBufferSize / 2))
+   //First RTT measurement?
+   if(!socket->srtt && !socket->rttvar)
    {
-      //Check whether a window update should be sent
-      if(socket->rcvWnd < MIN(socket->rmss, socket->rxBufferSize / 2))
-      {
-         //Debug message
-         TRACE_INFO("%s: TCP sending window update...\r\n",
-            formatSystemTime(osGetSystemTime(), NULL));
+      //Initialize RTO calculation algorithm
+      socket->srtt = r;
+      socket->rttvar = r / 2;
+   }
+   else
+   {
+      //Calculate the difference between the measured value and the
+      //current RTT estimator
+      delta = (r > socket->srtt) ? (r - socket->srtt) : (socket->srtt - r);
 
-         //Update the receive window
-         socket->rcvWnd += reduction;
-         //Send an ACK segment to advertise the new window size
-         tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt, 0, FALSE);
-      }
-      else
-      {
-         //The receive window can be updated
-         socket->rcvWnd += reduction;
-      }
+      //Implement Van Jacobson's algorithm (as specified in RFC 6298 2.3)
+      socket->rttvar = (3 * socket->rttvar + delta) / 4;
+      socket->srtt = (7 * socket->srtt + r) / 8;
    }
+
+   //Calculate the next retransmission timeout
+   socket->rto = socket->srtt + 4 * socket->rttvar;
+
+   //Whenever RTO is computed, if it is less than 1 second, then the RTO
+   //should be rounded up to 1 second
+   socket->rto = MAX(socket->rto, TCP_MIN_RTO);
+
+   //A maximum value may be placed on RTO provided it is at least 60
+   //seconds
+   socket->rto = MIN(socket->rto, TCP_MAX_RTO);
+
+#if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+   //Report the RTT sample to the congestion control algorithm
+   tcpCongestOnRttSample(socket, r);
+#endif
+
+   //Debug message
+   TRACE_DEBUG("R=%" PRIu32 ", SRTT=%" PRIu32 ", RTTVAR=%" PRIu32 ", RTO=%" PRIu32 "\r\n",
+      r, socket->srtt, socket->rttvar, socket->rto);
 }
 
 
 /**
  * @brief Compute retransmission timeout
+ *
+ * When timestamps are in use, RTT samples are taken from every ACK by
+ * tcpMeasureRtt and the timed segment only marks round-trip boundaries
+ *
  * @param[in] socket Handle referencing the socket
  * @return TRUE if the RTT measurement is complete, else FALSE
  **/
@@ -1446,8 +2774,6 @@ void tcpUpdateReceiveWindow(Socket *socket)
 bool_t tcpComputeRto(Socket *socket)
 {
    bool_t flag;
-   systime_t r;
-   systime_t delta;
 
    //Clear flag
    flag = FALSE;
@@ -1458,42 +2784,15 @@ bool_t tcpComputeRto(Socket *socket)
       //Ensure the incoming ACK number covers the expected sequence number
       if(TCP_CMP_SEQ(socket->sndUna, socket->rttSeqNum) > 0)
       {
-         //Calculate round-time trip
-         r = osGetSystemTime() - socket->rttStartTime;
-
-         //First RTT measurement?
-         if(!socket->srtt && !socket->rttvar)
-         {
-            //Initialize RTO calculation algorithm
-            socket->srtt = r;
-            socket->rttvar = r / 2;
-         }
-         else
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+         //Timestamps provide more accurate samples
+         if(!socket->tsOptionReceived)
+#endif
          {
-            //Calculate the difference between the measured value and the
-            //current RTT estimator
-            delta = (r > socket->srtt) ? (r - socket->srtt) : (socket->srtt - r);
-
-            //Implement Van Jacobson's algorithm (as specified in RFC 6298 2.3)
-            socket->rttvar = (3 * socket->rttvar + delta) / 4;
-            socket->srtt = (7 * socket->srtt + r) / 8;
+            //Calculate round-time trip and update RTO
+            tcpUpdateRto(socket, osGetSystemTime() - socket->rttStartTime);
          }
 
-         //Calculate the next retransmission timeout
-         socket->rto = socket->srtt + 4 * socket->rttvar;
-
-         //Whenever RTO is computed, if it is less than 1 second, then the RTO
-         //should be rounded up to 1 second
-         socket->rto = MAX(socket->rto, TCP_MIN_RTO);
-
-         //A maximum value may be placed on RTO provided it is at least 60
-         //seconds
-         socket->rto = MIN(socket->rto, TCP_MAX_RTO);
-
-         //Debug message
-         TRACE_DEBUG("R=%" PRIu32 ", SRTT=%" PRIu32 ", RTTVAR=%" PRIu32 ", RTO=%" PRIu32 "\r\n",
-            r, socket->srtt, socket->rttvar, socket->rto);
-
          //RTT measurement is complete
          socket->rttBusy = FALSE;
          //Set flag
@@ -1515,12 +2814,8 @@ bool_t tcpComputeRto(Socket *socket)
 error_t tcpRetransmitSegment(Socket *socket)
 {
    error_t error;
-   size_t offset;
    size_t length;
-   NetBuffer *buffer;
    TcpQueueItem *queueItem;
-   TcpHeader *header;
-   NetAncillaryData ancillary;
 
    //Initialize error code
    error = NO_ERROR;
@@ -1545,80 +2840,103 @@ error_t tcpRetransmitSegment(Socket *socket)
          break;
       }
 
-      //Point to the TCP header
-      header = (TcpHeader *) queueItem->header;
+      //Retransmit the current segment
+      error = tcpRetransmitQueueItem(socket, queueItem);
 
-      //Allocate a memory buffer to hold the TCP segment
-      buffer = ipAllocBuffer(0, &offset);
-      //Failed to allocate memory?
-      if(buffer == NULL)
+      //Any error to report?
+      if(error)
       {
-         //Report an error
-         error = ERROR_OUT_OF_MEMORY;
          //Exit immediately
          break;
       }
 
-      //Start of exception handling block
-      do
-      {
-         //Copy TCP header
-         error = netBufferAppend(buffer, header, header->dataOffset * 4);
-         //Any error to report?
-         if(error)
-            break;
+      //Point to the next segment in the queue
+      queueItem = queueItem->next;
+   }
 
-         //Copy data from send buffer
-         error = tcpReadTxBuffer(socket, ntohl(header->seqNum), buffer,
-            queueItem->length);
-         //Any error to report?
-         if(error)
-            break;
+   //Return status code
+   return error;
+}
 
-         //Total number of segments retransmitted
-         MIB2_INC_COUNTER32(tcpGroup.tcpRetransSegs, 1);
-         TCP_MIB_INC_COUNTER32(tcpRetransSegs, 1);
 
-         //Dump TCP header contents for debugging purpose
-         tcpDumpHeader(header, queueItem->length, socket->iss, socket->irs);
+/**
+ * @brief Retransmit a given segment of the retransmission queue
+ * @param[in] socket Handle referencing the socket
+ * @param[in] queueItem Segment to be retransmitted
+ * @return Error code
+ **/
 
-         //Additional options can be passed to the stack along with the packet
-         ancillary = NET_DEFAULT_ANCILLARY_DATA;
-         //Set the TTL value to be used
-         ancillary.ttl = socket->ttl;
+error_t tcpRetransmitQueueItem(Socket *socket, TcpQueueItem *queueItem)
+{
+   error_t error;
+   size_t offset;
+   NetBuffer *buffer;
+   TcpHeader *header;
+   NetAncillaryData ancillary;
 
-#if (ETH_VLAN_SUPPORT == ENABLED)
-         //Set VLAN PCP and DEI fields
-         ancillary.vlanPcp = socket->vlanPcp;
-         ancillary.vlanDei = socket->vlanDei;
-#endif
+   //Point to the TCP header
+   header = (TcpHeader *) queueItem->header;
 
-#if (ETH_VMAN_SUPPORT == ENABLED)
-         //Set VMAN PCP and DEI fields
-         ancillary.vmanPcp = socket->vmanPcp;
-         ancillary.vmanDei = socket->vmanDei;
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //The retransmitted segment carries the current time
+   tcpRefreshTimestampOption(socket, header);
 #endif
-         //Retransmit the lost segment without waiting for the retransmission
-         //timer to expire
-         error = ipSendDatagram(socket->interface, &queueItem->pseudoHeader,
-            buffer, offset, &ancillary);
 
-         //End of exception handling block
-      } while(0);
+   //Allocate a memory buffer to hold the TCP segment
+   buffer = ipAllocBuffer(0, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
 
-      //Free previously allocated memory
-      netBufferFree(buffer);
+   //Start of exception handling block
+   do
+   {
+      //Copy TCP header
+      error = netBufferAppend(buffer, header, header->dataOffset * 4);
+      //Any error to report?
+      if(error)
+         break;
 
+      //Copy data from send buffer
+      error = tcpReadTxBuffer(socket, ntohl(header->seqNum), buffer,
+         queueItem->length);
       //Any error to report?
       if(error)
-      {
-         //Exit immediately
          break;
-      }
 
-      //Point to the next segment in the queue
-      queueItem = queueItem->next;
-   }
+      //Total number of segments retransmitted
+      MIB2_INC_COUNTER32(tcpGroup.tcpRetransSegs, 1);
+      TCP_MIB_INC_COUNTER32(tcpRetransSegs, 1);
+
+      //Dump TCP header contents for debugging purpose
+      tcpDumpHeader(header, queueItem->length, socket->iss, socket->irs);
+
+      //Additional options can be passed to the stack along with the packet
+      ancillary = NET_DEFAULT_ANCILLARY_DATA;
+      //Set the TTL value to be used
+      ancillary.ttl = socket->ttl;
+
+#if (ETH_VLAN_SUPPORT == ENABLED)
+      //Set VLAN PCP and DEI fields
+      ancillary.vlanPcp = socket->vlanPcp;
+      ancillary.vlanDei = socket->vlanDei;
+#endif
+
+#if (ETH_VMAN_SUPPORT == ENABLED)
+      //Set VMAN PCP and DEI fields
+      ancillary.vmanPcp = socket->vmanPcp;
+      ancillary.vmanDei = socket->vmanDei;
+#endif
+      //Retransmit the lost segment without waiting for the retransmission
+      //timer to expire
+      error = ipSendDatagram(socket->interface, &queueItem->pseudoHeader,
+         buffer, offset, &ancillary);
+
+      //End of exception handling block
+   } while(0);
+
+   //Free previously allocated memory
+   netBufferFree(buffer);
 
    //Return status code
    return error;
@@ -1650,6 +2968,26 @@ error_t tcpNagleAlgo(Socket *socket, uint_t flags)
    //Retrieve the size of the usable window
    u = n - (socket->sndNxt - socket->sndUna);
 
+#if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED && TCP_SACK_SUPPORT == ENABLED)
+   //During SACK-based loss recovery, the congestion window is compared with
+   //the estimated number of bytes in flight (refer to RFC 6675, section 5)
+   if(socket->sackPermitted && socket->congestState == TCP_CONGEST_STATE_RECOVERY)
+   {
+      //Retrieve the size of the usable window
+      n = MIN(socket->sndWnd, socket->txBufferSize);
+      u = n - (socket->sndNxt - socket->sndUna);
+
+      //The congestion window does not account for the data that has left
+      //the network
+      n = tcpComputePipe(socket);
+      n = (socket->cwnd > n) ? socket->cwnd - n : 0;
+
+      //Limit the usable window
+      if((int_t) u > 0)
+         u = MIN(u, n);
+   }
+#endif
+
    //The Nagle algorithm discourages sending tiny segments when
    //the data to be sent increases in small increments
    while(socket->sndUser > 0)
@@ -1659,9 +2997,26 @@ error_t tcpNagleAlgo(Socket *socket, uint_t flags)
       if((int_t) u <= 0)
          break;
 
+#if (TCP_PACING_SUPPORT == ENABLED)
+      //The remaining data is sent later if the pacing rate has been reached
+      if(tcpPacingDelaySegment(socket, flags))
+         break;
+#endif
+
       //Calculate the number of bytes to send at a time
       n = MIN(u, socket->sndUser);
+
+#if (TCP_GSO_SUPPORT == ENABLED)
+      //Several full-sized segments may be sent at once
+      n = tcpGsoAdjustLength(socket, n);
+#else
       n = MIN(n, socket->smss);
+#endif
+
+#if (TCP_PACING_SUPPORT == ENABLED)
+      //Super-segments must not exceed the pacing burst
+      n = tcpPacingAdjustLength(socket, n);
+#endif
 
       //Disable Nagle algorithm?
       if(flags & SOCKET_FLAG_NO_DELAY)
@@ -1745,6 +3100,11 @@ error_t tcpNagleAlgo(Socket *socket, uint_t flags)
       socket->sndUser -= n;
       //Update the size of the usable window
       u -= n;
+
+#if (TCP_PACING_SUPPORT == ENABLED)
+      //Consume the pacing credit
+      tcpPacingConsume(socket, n);
+#endif
    }
 
    //Check whether the transmitter can accept more data
@@ -1897,6 +3257,11 @@ void tcpUpdateEvents(Socket *socket)
          socket->eventFlags |= SOCKET_EVENT_LINK_DOWN;
    }
 
+#if (SOCKET_EVENT_SET_SUPPORT == ENABLED)
+   //Report the events monitored through an event set
+   socketEventSetNotify(socket, socket->eventFlags);
+#endif
+
    //Mask unused events
    socket->eventFlags &= socket->eventMask;
 
@@ -1938,12 +3303,8 @@ uint_t tcpWaitForEvents(Socket *socket, uint_t eventMask, systime_t timeout)
       //Reset the event object
       osResetEvent(&socket->event);
 
-      //Release exclusive access
-      osReleaseMutex(&netMutex);
       //Wait until an event is triggered
-      osWaitForEvent(&socket->event, timeout);
-      //Get exclusive access
-      osAcquireMutex(&netMutex);
+      socketWaitForEvent(socket, timeout);
    }
 
    //Return the list of TCP events that satisfied the wait
@@ -1962,6 +3323,56 @@ uint_t tcpWaitForEvents(Socket *socket, uint_t eventMask, systime_t timeout)
 void tcpWriteTxBuffer(Socket *socket, uint32_t seqNum,
    const uint8_t *data, size_t length)
 {
+#if (TCP_CHECKSUM_COPY_SUPPORT == ENABLED)
+   uint_t i;
+   uint_t pos;
+   size_t n;
+   uint64_t sum;
+   uint32_t partial;
+
+   //Offset of the first byte to write in the circular buffer
+   size_t offset = (seqNum - socket->iss - 1) % socket->txBufferSize;
+
+   //The data is written block by block, so that the partial sum of each
+   //block of the send buffer can be updated as the data is copied
+   while(length > 0)
+   {
+      //Index of the block the current byte belongs to
+      i = offset / TCP_TX_CHECKSUM_BLOCK_SIZE;
+      //Position of the current byte within the block
+      pos = offset % TCP_TX_CHECKSUM_BLOCK_SIZE;
+
+      //Do not cross block or buffer boundaries
+      n = MIN(length, TCP_TX_CHECKSUM_BLOCK_SIZE - pos);
+      n = MIN(n, socket->txBufferSize - offset);
+
+      //Copy the payload and compute its partial sum
+      netBufferWriteWithChecksum((NetBuffer *) &socket->txBuffer,
+         offset, data, n, &sum);
+
+      //Data is always appended to the send buffer, hence the first byte of
+      //a block starts a new partial sum
+      if(pos == 0)
+         socket->txChecksum[i] = 0;
+
+      //Take care of alignment issues
+      partial = ipFoldChecksum(sum);
+      if((pos & 1) != 0)
+         partial = IP_CHECKSUM_SWAP(partial);
+
+      //Update the partial sum of the current block
+      socket->txChecksum[i] = ipFoldChecksum(socket->txChecksum[i] + partial);
+
+      //Advance data pointer
+      data += n;
+      length -= n;
+
+      //Wrap around to the beginning of the circular buffer if necessary
+      offset += n;
+      if(offset >= socket->txBufferSize)
+         offset = 0;
+   }
+#else
    //Offset of the first byte to write in the circular buffer
    size_t offset = (seqNum - socket->iss - 1) % socket->txBufferSize;
 
@@ -1981,6 +3392,7 @@ void tcpWriteTxBuffer(Socket *socket, uint32_t seqNum,
       netBufferWrite((NetBuffer *) &socket->txBuffer,
          0, data + socket->txBufferSize - offset, length - socket->txBufferSize + offset);
    }
+#endif
 }
 
 
@@ -1997,30 +3409,48 @@ error_t tcpReadTxBuffer(Socket *socket, uint32_t seqNum,
    NetBuffer *buffer, size_t length)
 {
    error_t error;
+   size_t n;
+   size_t offset;
+#if (TCP_ZERO_COPY_TX_SUPPORT == ENABLED)
+   TcpTxRef *ref;
+#endif
 
-   //Offset of the first byte to read in the circular buffer
-   size_t offset = (seqNum - socket->iss - 1) % socket->txBufferSize;
+   //Initialize status code
+   error = NO_ERROR;
 
-   //Check whether the specified data crosses buffer boundaries
-   if((offset + length) <= socket->txBufferSize)
+   //The data may span several buffers
+   while(length > 0 && !error)
    {
-      //Copy the payload
-      error = netBufferConcat(buffer, (NetBuffer *) &socket->txBuffer,
-         offset, length);
-   }
-   else
-   {
-      //Copy the first part of the payload
-      error = netBufferConcat(buffer, (NetBuffer *) &socket->txBuffer,
-         offset, socket->txBufferSize - offset);
+      //Number of bytes to process in a single pass
+      n = length;
 
-      //Check status code
-      if(!error)
+#if (TCP_ZERO_COPY_TX_SUPPORT == ENABLED)
+      //Check whether the data is held in a caller-supplied buffer
+      ref = tcpGetTxRef(socket, seqNum, &n);
+
+      //Caller-supplied buffer?
+      if(ref != NULL)
+      {
+         //Link the payload by reference
+         error = netBufferConcat(buffer, ref->buffer,
+            ref->offset + (seqNum - ref->seqNum), n);
+      }
+      else
+#endif
       {
-         //Wrap around to the beginning of the circular buffer
+         //Offset of the first byte to read in the circular buffer
+         offset = (seqNum - socket->iss - 1) % socket->txBufferSize;
+         //Wrap around to the beginning of the circular buffer if necessary
+         n = MIN(n, socket->txBufferSize - offset);
+
+         //Copy the payload
          error = netBufferConcat(buffer, (NetBuffer *) &socket->txBuffer,
-            0, length - socket->txBufferSize + offset);
+            offset, n);
       }
+
+      //Next data to read
+      seqNum += n;
+      length -= n;
    }
 
    //Return status code
@@ -2028,6 +3458,91 @@ error_t tcpReadTxBuffer(Socket *socket, uint32_t seqNum,
 }
 
 
+/**
+ * @brief Compute the partial sum of the data held in the send buffer
+ * @param[in] socket Handle referencing the socket
+ * @param[in] seqNum Sequence number of the first data byte
+ * @param[in] length Number of data bytes to process
+ * @return 64-bit partial sum
+ **/
+
+uint64_t tcpCalcTxBufferChecksum(Socket *socket, uint32_t seqNum,
+   size_t length)
+{
+   uint_t i;
+   size_t n;
+   size_t pos;
+   size_t offset;
+   size_t blockLen;
+   uint32_t partial;
+   uint64_t sum;
+#if (TCP_ZERO_COPY_TX_SUPPORT == ENABLED)
+   TcpTxRef *ref;
+#endif
+
+   //Checksum preset value
+   sum = 0;
+
+   //Loop through the blocks of the send buffer
+   for(pos = 0; pos < length; pos += n)
+   {
+      //Number of bytes to process in a single pass
+      n = length - pos;
+
+#if (TCP_ZERO_COPY_TX_SUPPORT == ENABLED)
+      //Check whether the data is held in a caller-supplied buffer
+      ref = tcpGetTxRef(socket, seqNum + pos, &n);
+
+      //Caller-supplied buffer?
+      if(ref != NULL)
+      {
+         //The data was not summed ahead of time
+         partial = ipFoldChecksum(ipCalcChecksumPartialEx(ref->buffer,
+            ref->offset + (seqNum + pos - ref->seqNum), n));
+      }
+      else
+#endif
+      {
+         //Offset of the current byte in the circular buffer
+         offset = (seqNum + pos - socket->iss - 1) % socket->txBufferSize;
+
+         //Index of the block the current byte belongs to
+         i = offset / TCP_TX_CHECKSUM_BLOCK_SIZE;
+         //Length of the block (the last block may be shorter)
+         blockLen = MIN(TCP_TX_CHECKSUM_BLOCK_SIZE,
+            socket->txBufferSize - i * TCP_TX_CHECKSUM_BLOCK_SIZE);
+
+         //Do not cross block boundaries
+         n = MIN(n, blockLen - (offset % TCP_TX_CHECKSUM_BLOCK_SIZE));
+
+#if (TCP_CHECKSUM_COPY_SUPPORT == ENABLED)
+         //Whole blocks were summed when the data was written to the buffer
+         if(n == blockLen)
+         {
+            partial = socket->txChecksum[i];
+         }
+         else
+#endif
+         {
+            //Sum the data directly from the send buffer
+            partial = ipFoldChecksum(ipCalcChecksumPartialEx(
+               (NetBuffer *) &socket->txBuffer, offset, n));
+         }
+      }
+
+      //Take care of alignment issues
+      if((pos & 1) != 0)
+         partial = IP_CHECKSUM_SWAP(partial);
+
+      //Partial sums are accumulated without intermediate folding
+      sum += partial;
+   }
+
+   //Return partial sum
+   return sum;
+}
+
+
 /**
  * @brief Copy incoming data to the receive buffer
  * @param[in] socket Handle referencing the socket
@@ -2095,6 +3610,47 @@ void tcpReadRxBuffer(Socket *socket, uint32_t seqNum, uint8_t *data,
 }
 
 
+/**
+ * @brief Remove data consumed by the application from the receive buffer
+ * @param[in] socket Handle referencing the socket
+ * @param[in] length Number of bytes consumed
+ **/
+
+void tcpDiscardRxData(Socket *socket, size_t length)
+{
+   bool_t netLocked;
+
+   //Remaining data still available in the receive buffer
+   socket->rcvUser -= length;
+
+   //Sending a window update requires the netMutex
+   if(socket->rcvWnd < MIN(socket->rmss, socket->rxBufferSize / 2))
+   {
+      //Get exclusive access to the packet path
+      netLocked = socketAcquireNetMutex(socket);
+
+      //The connection may have been closed in the meantime
+      if(socket->state != TCP_STATE_CLOSED)
+      {
+         //Update the receive window
+         tcpUpdateReceiveWindow(socket);
+      }
+
+      //Release the netMutex as soon as possible
+      if(netLocked)
+         socketReleaseNetMutex(socket);
+   }
+   else
+   {
+      //Update the receive window
+      tcpUpdateReceiveWindow(socket);
+   }
+
+   //Update RX event state
+   tcpUpdateEvents(socket);
+}
+
+
 /**
  * @brief Dump TCP header for debugging purpose
  * @param[in] segment Pointer to the TCP header
@@ -51,6 +51,9 @@ error_t tcpAddOption(TcpHeader *segment, uint8_t kind, const void *value,
 
 TcpOption *tcpGetOption(TcpHeader *segment, uint8_t kind);
 
+error_t tcpVerifyChecksum(Socket *socket, IpPseudoHeader *pseudoHeader,
+   const NetBuffer *buffer, size_t offset, size_t length);
+
 error_t tcpCheckSequenceNumber(Socket *socket, TcpHeader *segment, size_t length);
 error_t tcpCheckSyn(Socket *socket, TcpHeader *segment, size_t length);
 error_t tcpCheckAck(Socket *socket, TcpHeader *segment, size_t length);
@@ -64,6 +67,11 @@ void tcpFastRetransmit(Socket *socket);
 void tcpFastRecovery(Socket *socket, TcpHeader *segment, uint_t n);
 void tcpFastLossRecovery(Socket *socket, TcpHeader *segment);
 
+void tcpUpdateScoreboard(Socket *socket, TcpHeader *segment);
+void tcpResetScoreboard(Socket *socket);
+uint_t tcpComputePipe(Socket *socket);
+void tcpSackRetransmit(Socket *socket);
+
 void tcpProcessSegmentData(Socket *socket, TcpHeader *segment,
    const NetBuffer *buffer, size_t offset, size_t length);
 
@@ -72,14 +80,39 @@ void tcpDeleteControlBlock(Socket *socket);
 void tcpUpdateRetransmitQueue(Socket *socket);
 void tcpFlushRetransmitQueue(Socket *socket);
 
+void tcpUpdateTxRefQueue(Socket *socket);
+void tcpFlushTxRefQueue(Socket *socket);
+TcpTxRef *tcpGetTxRef(Socket *socket, uint32_t seqNum, size_t *length);
+
+error_t tcpQueueTxRef(Socket *socket, NetBuffer *buffer, size_t offset,
+   size_t *written, uint_t flags);
+
 void tcpFlushSynQueue(Socket *socket);
 
 void tcpUpdateSackBlocks(Socket *socket, uint32_t *leftEdge, uint32_t *rightEdge);
 void tcpUpdateSendWindow(Socket *socket, TcpHeader *segment);
 void tcpUpdateReceiveWindow(Socket *socket);
 
+uint32_t tcpGetSegmentWindow(Socket *socket, const TcpHeader *segment);
+uint8_t tcpComputeWindowShift(size_t rxBufferSize);
+void tcpParseWindowScaleOption(Socket *socket, TcpHeader *segment);
+
+void tcpAddTimestampOption(Socket *socket, TcpHeader *segment);
+void tcpRefreshTimestampOption(Socket *socket, TcpHeader *segment);
+
+bool_t tcpGetTimestampOption(TcpHeader *segment, uint32_t *tsVal,
+   uint32_t *tsEcr);
+
+void tcpParseTimestampOption(Socket *socket, TcpHeader *segment);
+void tcpMeasureRtt(Socket *socket, TcpHeader *segment);
+void tcpUpdateRto(Socket *socket, systime_t r);
+
+void tcpAddSackOption(Socket *socket, TcpHeader *segment);
+void tcpParseSackPermittedOption(Socket *socket, TcpHeader *segment);
+
 bool_t tcpComputeRto(Socket *socket);
 error_t tcpRetransmitSegment(Socket *socket);
+error_t tcpRetransmitQueueItem(Socket *socket, TcpQueueItem *queueItem);
 error_t tcpNagleAlgo(Socket *socket, uint_t flags);
 
 void tcpChangeState(Socket *socket, TcpState newState);
@@ -93,12 +126,17 @@ void tcpWriteTxBuffer(Socket *socket, uint32_t seqNum,
 error_t tcpReadTxBuffer(Socket *socket, uint32_t seqNum,
    NetBuffer *buffer, size_t length);
 
+uint64_t tcpCalcTxBufferChecksum(Socket *socket, uint32_t seqNum,
+   size_t length);
+
 void tcpWriteRxBuffer(Socket *socket, uint32_t seqNum,
    const NetBuffer *data, size_t dataOffset, size_t length);
 
 void tcpReadRxBuffer(Socket *socket, uint32_t seqNum, uint8_t *data,
    size_t length);
 
+void tcpDiscardRxData(Socket *socket, size_t length);
+
 void tcpDumpHeader(const TcpHeader *segment, size_t length, uint32_t iss,
    uint32_t irs);
 
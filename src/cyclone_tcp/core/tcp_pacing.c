@@ -0,0 +1,271 @@
+/**
+ * @file tcp_pacing.c
+ * @brief TCP pacing
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Without pacing, the segments permitted by the congestion window and the
+ * peer window are sent back-to-back. Pacing spreads them over the round-trip
+ * time using a token bucket: credit is earned at the pacing rate and each
+ * segment consumes its length. When the credit is exhausted, the pending
+ * data is held back and the pacing timer releases it from the timer path of
+ * the TCP/IP stack. The bucket depth is one timer period worth of data, so
+ * that the segments leave at even intervals
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_misc.h"
+#include "core/tcp_timer.h"
+#include "core/tcp_congest.h"
+#include "core/tcp_pacing.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_PACING_SUPPORT == ENABLED)
+
+
+/**
+ * @brief Retrieve the pacing rate of a connection
+ * @param[in] socket Handle referencing the socket
+ * @return Pacing rate, in bytes per second (0 means that segments are not
+ *   paced)
+ **/
+
+uint32_t tcpPacingGetRate(Socket *socket)
+{
+   uint32_t rate;
+#if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+   uint64_t value;
+   uint_t gain;
+#endif
+
+   //Rate requested by the user
+   rate = socket->pacingRate;
+
+   //The rate is derived from the state of the connection?
+   if(rate == TCP_PACING_RATE_AUTO)
+   {
+#if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
+      //Congestion control algorithms that model the path provide their own
+      //pacing rate
+      rate = tcpCongestGetPacingRate(socket);
+
+      //Otherwise, a window worth of data is spread over the smoothed RTT
+      if(rate == 0 && socket->srtt > 0)
+      {
+         //The rate is increased during slow start so that the congestion
+         //window can keep growing
+         if(socket->cwnd < socket->ssthresh)
+            gain = TCP_PACING_SS_GAIN;
+         else
+            gain = TCP_PACING_CA_GAIN;
+
+         //The SRTT is expressed in milliseconds
+         value = (uint64_t) socket->cwnd * gain * 10 / socket->srtt;
+         rate = (uint32_t) MIN(value, UINT32_MAX - 1);
+      }
+#else
+      //No estimate is available
+      rate = 0;
+#endif
+   }
+
+   //Return the pacing rate
+   return rate;
+}
+
+
+/**
+ * @brief Retrieve the depth of the token bucket
+ * @param[in] socket Handle referencing the socket
+ * @param[in] rate Pacing rate, in bytes per second
+ * @return Number of bytes that can be sent back-to-back
+ **/
+
+size_t tcpPacingGetBurst(Socket *socket, uint32_t rate)
+{
+   size_t n;
+
+   //Amount of data that is earned during one period of the timer wheel
+   n = (size_t) ((uint64_t) rate * NET_TIMER_RESOLUTION / 1000);
+
+   //A full-sized segment can always be sent
+   return MAX(n, socket->smss);
+}
+
+
+/**
+ * @brief Limit the size of a super-segment to the pacing burst
+ * @param[in] socket Handle referencing the socket
+ * @param[in] length Number of bytes the caller is about to send
+ * @return Number of bytes that may be sent at once
+ **/
+
+size_t tcpPacingAdjustLength(Socket *socket, size_t length)
+{
+   size_t n;
+   uint32_t rate;
+
+   //Segments that do not exceed the SMSS are left untouched
+   if(length <= socket->smss)
+      return length;
+
+   //Retrieve the pacing rate
+   rate = tcpPacingGetRate(socket);
+   //Pacing is not used on this connection?
+   if(rate == 0)
+      return length;
+
+   //Round the burst down to a whole number of full-sized segments
+   n = tcpPacingGetBurst(socket, rate);
+   n -= n % socket->smss;
+
+   //Return the number of bytes that may be sent at once
+   return MIN(length, n);
+}
+
+
+/**
+ * @brief Check whether the next segment must be held back
+ *
+ * When the credit is exhausted, the pacing timer is started so that the
+ * transmission resumes once enough credit has been earned
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[in] flags Flags of the current transmission
+ * @return TRUE if the segment must be held back, else FALSE
+ **/
+
+bool_t tcpPacingDelaySegment(Socket *socket, uint_t flags)
+{
+   uint32_t rate;
+   systime_t delay;
+
+   //Retrieve the pacing rate
+   rate = tcpPacingGetRate(socket);
+   //Pacing is not used on this connection?
+   if(rate == 0)
+      return FALSE;
+
+   //Credit earned since the last transmission
+   tcpPacingRefill(socket, rate);
+
+   //The segment can be sent immediately if some credit is left
+   if(socket->pacingCredit > 0)
+      return FALSE;
+
+   //Time needed to earn back a positive credit
+   delay = (systime_t) (((uint64_t) (1 - socket->pacingCredit) * 1000 +
+      rate - 1) / rate);
+
+   //Save the flags of the transmission
+   socket->pacingFlags = flags;
+
+   //Schedule the transmission of the pending data
+   if(!tcpTimerRunning(&socket->pacingTimer))
+      tcpTimerStart(&socket->pacingTimer, delay);
+
+   //The segment is held back
+   return TRUE;
+}
+
+
+/**
+ * @brief Account for a segment that has been sent
+ * @param[in] socket Handle referencing the socket
+ * @param[in] length Number of data bytes sent
+ **/
+
+void tcpPacingConsume(Socket *socket, size_t length)
+{
+   //Unpaced segments do not consume any credit
+   if(tcpPacingGetRate(socket) != 0)
+      socket->pacingCredit -= (int32_t) length;
+}
+
+
+/**
+ * @brief Resume a transmission that has been held back
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpPacingResume(Socket *socket)
+{
+   //Stop the pacing timer
+   tcpTimerStop(&socket->pacingTimer);
+
+   //Data can only be sent in ESTABLISHED or CLOSE-WAIT state
+   if(socket->state == TCP_STATE_ESTABLISHED ||
+      socket->state == TCP_STATE_CLOSE_WAIT)
+   {
+      //Send the pending data
+      tcpNagleAlgo(socket, socket->pacingFlags);
+   }
+}
+
+
+/**
+ * @brief Add the credit earned since the last update
+ * @param[in] socket Handle referencing the socket
+ * @param[in] rate Pacing rate, in bytes per second
+ **/
+
+void tcpPacingRefill(Socket *socket, uint32_t rate)
+{
+   int64_t credit;
+   systime_t time;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Credit earned since the last update
+   credit = (int64_t) rate * (time - socket->pacingTime) / 1000;
+
+   //Fractions of a byte are carried over to the next update
+   if(credit > 0)
+   {
+      //Only the time converted into whole bytes of credit is consumed
+      //(rounded to the nearest millisecond, so that errors cancel out)
+      socket->pacingTime += (systime_t) ((credit * 1000 + rate / 2) / rate);
+
+      //The bucket depth limits the size of the bursts
+      credit = MIN(socket->pacingCredit + credit,
+         (int64_t) tcpPacingGetBurst(socket, rate));
+
+      //Update the credit
+      socket->pacingCredit = (int32_t) credit;
+   }
+}
+
+#endif
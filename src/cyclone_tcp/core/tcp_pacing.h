@@ -0,0 +1,57 @@
+/**
+ * @file tcp_pacing.h
+ * @brief TCP pacing
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+#ifndef _TCP_PACING_H
+#define _TCP_PACING_H
+
+//Dependencies
+#include "core/tcp.h"
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//TCP pacing related functions
+uint32_t tcpPacingGetRate(Socket *socket);
+size_t tcpPacingGetBurst(Socket *socket, uint32_t rate);
+size_t tcpPacingAdjustLength(Socket *socket, size_t length);
+bool_t tcpPacingDelaySegment(Socket *socket, uint_t flags);
+void tcpPacingConsume(Socket *socket, size_t length);
+void tcpPacingResume(Socket *socket);
+void tcpPacingRefill(Socket *socket, uint32_t rate);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
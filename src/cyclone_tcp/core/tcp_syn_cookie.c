@@ -0,0 +1,511 @@
+/**
+ * @file tcp_syn_cookie.c
+ * @brief SYN cookies
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * When the SYN queue of a listening socket is full, incoming SYNs are
+ * answered statelessly. The connection state is encoded in the initial
+ * sequence number of the SYN-ACK (refer to RFC 4987, section 3.6):
+ *
+ * - Bits 31-27: counter incremented every 64 seconds
+ * - Bits 26-24: index of the MSS value in a table of common values
+ * - Bits 23-0: keyed hash of the connection 4-tuple, the initial sequence
+ *   number of the peer and the counter
+ *
+ * The connection is rebuilt from the ACK that completes the three-way
+ * handshake. Window scaling, timestamps and selective acknowledgments are
+ * not offered in such a SYN-ACK since they cannot be encoded in the cookie
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/ip.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_misc.h"
+#include "core/tcp_syn_cookie.h"
+#include "ipv4/ipv4.h"
+#include "ipv6/ipv6.h"
+#include "mibs/mib2_module.h"
+#include "mibs/tcp_mib_module.h"
+#include "date_time.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_SYN_COOKIES_SUPPORT == ENABLED)
+
+//MSS values that can be encoded in a SYN cookie
+static const uint16_t tcpSynCookieMssTable[8] =
+{
+   64, 536, 1024, 1220, 1360, 1440, 1460, 8960
+};
+
+//Secret key used to compute SYN cookies
+static uint32_t tcpSynCookieSecret[4];
+static bool_t tcpSynCookieSecretValid = FALSE;
+
+
+/**
+ * @brief Generate a SYN cookie
+ * @param[in] pseudoHeader TCP pseudo header describing the incoming SYN
+ * @param[in] segment Incoming SYN segment
+ * @param[in] mss Maximum segment size advertised by the peer
+ * @return Initial sequence number to be used in the SYN-ACK
+ **/
+
+uint32_t tcpSynCookieGenerate(IpPseudoHeader *pseudoHeader,
+   TcpHeader *segment, uint16_t mss)
+{
+   uint_t i;
+   uint32_t counter;
+
+   //The secret key is generated the first time a cookie is needed, once the
+   //application has seeded the PRNG
+   if(!tcpSynCookieSecretValid)
+   {
+      for(i = 0; i < arraysize(tcpSynCookieSecret); i++)
+         tcpSynCookieSecret[i] = netGetRand();
+
+      tcpSynCookieSecretValid = TRUE;
+   }
+
+   //Select the largest MSS value that does not exceed the MSS of the peer
+   for(i = arraysize(tcpSynCookieMssTable) - 1; i > 0; i--)
+   {
+      if(tcpSynCookieMssTable[i] <= mss)
+         break;
+   }
+
+   //Current value of the counter
+   counter = osGetSystemTime() / TCP_SYN_COOKIE_PERIOD;
+
+   //Format the SYN cookie
+   return ((counter & 0x1F) << 27) | ((uint32_t) i << 24) |
+      (tcpSynCookieHash(pseudoHeader, segment, segment->seqNum, counter) & 0x00FFFFFF);
+}
+
+
+/**
+ * @brief Check the SYN cookie acknowledged by an incoming segment
+ * @param[in] pseudoHeader TCP pseudo header describing the incoming segment
+ * @param[in] segment Incoming ACK segment
+ * @param[out] mss Maximum segment size encoded in the cookie
+ * @return Error code
+ **/
+
+error_t tcpSynCookieCheck(IpPseudoHeader *pseudoHeader, TcpHeader *segment,
+   uint16_t *mss)
+{
+   uint32_t age;
+   uint32_t isn;
+   uint32_t cookie;
+   uint32_t counter;
+
+   //No cookie has been sent so far?
+   if(!tcpSynCookieSecretValid)
+      return ERROR_WRONG_COOKIE;
+
+   //The ACK acknowledges the SYN of the SYN-ACK
+   cookie = segment->ackNum - 1;
+   //The ACK is the segment that immediately follows the SYN of the peer
+   isn = segment->seqNum - 1;
+
+   //Current value of the counter
+   counter = osGetSystemTime() / TCP_SYN_COOKIE_PERIOD;
+   //Retrieve the age of the cookie
+   age = (counter - (cookie >> 27)) & 0x1F;
+
+   //Expired cookie?
+   if(age > TCP_SYN_COOKIE_MAX_AGE)
+      return ERROR_WRONG_COOKIE;
+
+   //Recover the full value of the counter at the time the cookie was issued
+   counter -= age;
+
+   //Verify the hash
+   if(((tcpSynCookieHash(pseudoHeader, segment, isn, counter) ^ cookie) &
+      0x00FFFFFF) != 0)
+   {
+      return ERROR_WRONG_COOKIE;
+   }
+
+   //Retrieve the MSS value
+   *mss = tcpSynCookieMssTable[(cookie >> 24) & 0x07];
+
+   //The cookie is valid
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Answer a SYN with a SYN cookie
+ * @param[in] socket Handle referencing the listening socket
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header describing the incoming SYN
+ * @param[in] segment Incoming SYN segment
+ * @return Error code
+ **/
+
+error_t tcpSynCookieSendSynAck(Socket *socket, NetInterface *interface,
+   IpPseudoHeader *pseudoHeader, TcpHeader *segment)
+{
+   error_t error;
+   size_t offset;
+   size_t length;
+   uint16_t mss;
+   NetBuffer *buffer;
+   TcpOption *option;
+   TcpHeader *segment2;
+   IpPseudoHeader pseudoHeader2;
+
+   //Default MSS value
+   mss = MIN(TCP_DEFAULT_MSS, TCP_MAX_MSS);
+
+   //Get the maximum segment size
+   option = tcpGetOption(segment, TCP_OPTION_MAX_SEGMENT_SIZE);
+
+   //Specified option found?
+   if(option != NULL && option->length == 4)
+   {
+      //Retrieve MSS value
+      mss = LOAD16BE(option->value);
+
+      //Make sure that the MSS advertised by the peer is acceptable
+      mss = MIN(mss, TCP_MAX_MSS);
+      mss = MAX(mss, TCP_MIN_MSS);
+   }
+
+   //Allocate a memory buffer to hold the SYN-ACK
+   buffer = ipAllocBuffer(TCP_MAX_HEADER_LENGTH, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the beginning of the TCP segment
+   segment2 = netBufferAt(buffer, offset);
+
+   //Format TCP header
+   segment2->srcPort = htons(segment->destPort);
+   segment2->destPort = htons(segment->srcPort);
+   segment2->seqNum = htonl(tcpSynCookieGenerate(pseudoHeader, segment, mss));
+   segment2->ackNum = htonl(segment->seqNum + 1);
+   segment2->reserved1 = 0;
+   segment2->dataOffset = 5;
+   segment2->flags = TCP_FLAG_SYN | TCP_FLAG_ACK;
+   segment2->reserved2 = 0;
+   segment2->window = htons(MIN(socket->rxBufferSize, UINT16_MAX));
+   segment2->checksum = 0;
+   segment2->urgentPointer = 0;
+
+   //The RMSS is the size of the largest segment the receiver is willing
+   //to accept
+   mss = HTONS(MIN(socket->rxBufferSize, TCP_MAX_MSS));
+   //Append MSS option
+   tcpAddOption(segment2, TCP_OPTION_MAX_SEGMENT_SIZE, &mss, sizeof(mss));
+
+   //Calculate the length of the TCP header
+   length = segment2->dataOffset * 4;
+   //Adjust the length of the multi-part buffer
+   netBufferSetLength(buffer, offset + length);
+
+#if (IPV4_SUPPORT == ENABLED)
+   //Destination address is an IPv4 address?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Format IPv4 pseudo header
+      pseudoHeader2.length = sizeof(Ipv4PseudoHeader);
+      pseudoHeader2.ipv4Data.srcAddr = pseudoHeader->ipv4Data.destAddr;
+      pseudoHeader2.ipv4Data.destAddr = pseudoHeader->ipv4Data.srcAddr;
+      pseudoHeader2.ipv4Data.reserved = 0;
+      pseudoHeader2.ipv4Data.protocol = IPV4_PROTOCOL_TCP;
+      pseudoHeader2.ipv4Data.length = htons(length);
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //Destination address is an IPv6 address?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Format IPv6 pseudo header
+      pseudoHeader2.length = sizeof(Ipv6PseudoHeader);
+      pseudoHeader2.ipv6Data.srcAddr = pseudoHeader->ipv6Data.destAddr;
+      pseudoHeader2.ipv6Data.destAddr = pseudoHeader->ipv6Data.srcAddr;
+      pseudoHeader2.ipv6Data.length = htonl(length);
+      pseudoHeader2.ipv6Data.reserved = 0;
+      pseudoHeader2.ipv6Data.nextHeader = IPV6_TCP_HEADER;
+   }
+   else
+#endif
+   //Destination address is not valid?
+   {
+      //Free previously allocated memory
+      netBufferFree(buffer);
+      //This should never occur...
+      return ERROR_INVALID_ADDRESS;
+   }
+
+   //Calculate TCP header checksum
+   segment2->checksum = ipCalcUpperLayerChecksumEx(pseudoHeader2.data,
+      pseudoHeader2.length, buffer, offset, length);
+
+   //Total number of segments sent
+   MIB2_INC_COUNTER32(tcpGroup.tcpOutSegs, 1);
+   TCP_MIB_INC_COUNTER32(tcpOutSegs, 1);
+   TCP_MIB_INC_COUNTER64(tcpHCOutSegs, 1);
+
+   //Debug message
+   TRACE_DEBUG("%s: Sending TCP SYN cookie...\r\n",
+      formatSystemTime(osGetSystemTime(), NULL));
+   //Dump TCP header contents for debugging purpose
+   tcpDumpHeader(segment2, 0, 0, 0);
+
+   //Send TCP segment
+   error = ipSendDatagram(interface, &pseudoHeader2, buffer, offset,
+      &NET_DEFAULT_ANCILLARY_DATA);
+
+   //Free previously allocated memory
+   netBufferFree(buffer);
+
+   //Return error code
+   return error;
+}
+
+
+/**
+ * @brief Process an ACK that may complete a handshake answered with a cookie
+ *
+ * A valid ACK is added to the SYN queue of the listening socket. The
+ * connection is then created in the ESTABLISHED state by tcpAccept
+ *
+ * @param[in] socket Handle referencing the listening socket
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header describing the incoming segment
+ * @param[in] segment Incoming ACK segment
+ * @param[in] length Length of the segment data
+ * @return NO_ERROR if the ACK acknowledges a valid cookie or belongs to a
+ *   connection already queued, an error code if a reset must be sent in
+ *   response
+ **/
+
+error_t tcpSynCookieProcessAck(Socket *socket, NetInterface *interface,
+   IpPseudoHeader *pseudoHeader, TcpHeader *segment, size_t length)
+{
+   error_t error;
+   uint_t i;
+   uint16_t mss;
+   TcpSynQueueItem *queueItem;
+   TcpSynQueueItem *lastItem;
+
+   //A SYN cookie can only be acknowledged by a segment without SYN
+   if(segment->flags & (TCP_FLAG_SYN | TCP_FLAG_RST))
+      return ERROR_WRONG_COOKIE;
+
+   //The peer considers a queued connection as established and keeps sending.
+   //Its segments are silently dropped until the connection has been accepted
+   //(the peer retransmits them). The cookie cannot be checked here since the
+   //sequence number no longer matches the initial one
+   if(tcpIsDuplicateSyn(socket, pseudoHeader, segment))
+      return NO_ERROR;
+
+   //Check the cookie
+   error = tcpSynCookieCheck(pseudoHeader, segment, &mss);
+   //Invalid cookie?
+   if(error)
+      return error;
+
+   //Debug message
+   TRACE_INFO("TCP connection completed with a SYN cookie\r\n");
+
+   //Point to the very first item
+   lastItem = socket->synQueue;
+
+   //Reach the last item in the SYN queue
+   for(i = (lastItem != NULL) ? 1 : 0; i > 0 && lastItem->next != NULL; i++)
+      lastItem = lastItem->next;
+
+   //Connections completed with a cookie may exceed the SYN queue size by
+   //as many entries. Beyond that limit, the ACK is silently dropped
+   if(i >= (2 * socket->synQueueSize))
+      return NO_ERROR;
+
+   //Allocate memory to save the connection
+   queueItem = memPoolAlloc(sizeof(TcpSynQueueItem));
+   //Failed to allocate memory?
+   if(queueItem == NULL)
+      return NO_ERROR;
+
+#if (IPV4_SUPPORT == ENABLED)
+   //IPv4 is currently used?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Save the source IPv4 address
+      queueItem->srcAddr.length = sizeof(Ipv4Addr);
+      queueItem->srcAddr.ipv4Addr = pseudoHeader->ipv4Data.srcAddr;
+      //Save the destination IPv4 address
+      queueItem->destAddr.length = sizeof(Ipv4Addr);
+      queueItem->destAddr.ipv4Addr = pseudoHeader->ipv4Data.destAddr;
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //IPv6 is currently used?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Save the source IPv6 address
+      queueItem->srcAddr.length = sizeof(Ipv6Addr);
+      queueItem->srcAddr.ipv6Addr = pseudoHeader->ipv6Data.srcAddr;
+      //Save the destination IPv6 address
+      queueItem->destAddr.length = sizeof(Ipv6Addr);
+      queueItem->destAddr.ipv6Addr = pseudoHeader->ipv6Data.destAddr;
+   }
+   else
+#endif
+   //Invalid pseudo header?
+   {
+      //Free previously allocated memory
+      memPoolFree(queueItem);
+      //This should never occur...
+      return NO_ERROR;
+   }
+
+   //Initialize next field
+   queueItem->next = NULL;
+   //Underlying network interface
+   queueItem->interface = interface;
+   //Save the port number of the client
+   queueItem->srcPort = segment->srcPort;
+   //Save the initial sequence number of the peer
+   queueItem->isn = segment->seqNum - 1;
+
+   //Make sure that the MSS encoded in the cookie is acceptable
+   queueItem->mss = MIN(mss, TCP_MAX_MSS);
+   queueItem->mss = MAX(queueItem->mss, TCP_MIN_MSS);
+
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+   //Window scaling was not offered in the SYN-ACK
+   queueItem->wndScaleOptionReceived = FALSE;
+   queueItem->wndShift = 0;
+#endif
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //Timestamps were not offered in the SYN-ACK
+   queueItem->tsOptionReceived = FALSE;
+   queueItem->tsVal = 0;
+#endif
+
+#if (TCP_SACK_SUPPORT == ENABLED)
+   //SACK was not offered in the SYN-ACK
+   queueItem->sackPermitted = FALSE;
+#endif
+
+   //The three-way handshake has been completed
+   queueItem->synCookie = TRUE;
+   queueItem->iss = segment->ackNum - 1;
+   queueItem->wnd = segment->window;
+
+   //Append the item to the SYN queue
+   if(lastItem == NULL)
+      socket->synQueue = queueItem;
+   else
+      lastItem->next = queueItem;
+
+   //Notify user that a connection request is pending
+   tcpUpdateEvents(socket);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Keyed hash of a connection
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] segment TCP segment sent by the peer
+ * @param[in] isn Initial sequence number of the peer
+ * @param[in] counter Value of the counter
+ * @return Hash value
+ **/
+
+uint32_t tcpSynCookieHash(IpPseudoHeader *pseudoHeader, TcpHeader *segment,
+   uint32_t isn, uint32_t counter)
+{
+   size_t i;
+   size_t n;
+   uint32_t h;
+   uint32_t value[4];
+   const uint8_t *p;
+
+   //Only the source and destination addresses of the pseudo header are
+   //relevant
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+      n = 2 * sizeof(Ipv6Addr);
+   else
+      n = 2 * sizeof(Ipv4Addr);
+
+   //Point to the source and destination addresses
+   p = pseudoHeader->data;
+
+   //Initialize the hash with the secret key
+   h = tcpSynCookieSecret[0];
+
+   //Mix the IP addresses (FNV-1a)
+   for(i = 0; i < n; i++)
+   {
+      h ^= p[i];
+      h *= 0x01000193;
+   }
+
+   //Port numbers, initial sequence number of the peer and counter
+   value[0] = ((uint32_t) segment->srcPort << 16) | segment->destPort;
+   value[1] = isn;
+   value[2] = counter;
+   value[3] = tcpSynCookieSecret[1];
+
+   //Mix the remaining fields
+   for(i = 0; i < arraysize(value); i++)
+   {
+      h ^= value[i] + tcpSynCookieSecret[2];
+      h *= 0x9E3779B1;
+      h ^= h >> 15;
+      h += tcpSynCookieSecret[3];
+   }
+
+   //Final avalanche
+   h ^= h >> 16;
+   h *= 0x85EBCA6B;
+   h ^= h >> 13;
+
+   //Return the hash value
+   return h;
+}
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ * @file tcp_syn_cookie.h
+ * @brief SYN cookies
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+#ifndef _TCP_SYN_COOKIE_H
+#define _TCP_SYN_COOKIE_H
+
+//Dependencies
+#include "core/tcp.h"
+
+//Period of the counter encoded in SYN cookies
+#define TCP_SYN_COOKIE_PERIOD 64000
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+//SYN cookie related functions
+uint32_t tcpSynCookieGenerate(IpPseudoHeader *pseudoHeader,
+   TcpHeader *segment, uint16_t mss);
+
+error_t tcpSynCookieCheck(IpPseudoHeader *pseudoHeader, TcpHeader *segment,
+   uint16_t *mss);
+
+error_t tcpSynCookieSendSynAck(Socket *socket, NetInterface *interface,
+   IpPseudoHeader *pseudoHeader, TcpHeader *segment);
+
+error_t tcpSynCookieProcessAck(Socket *socket, NetInterface *interface,
+   IpPseudoHeader *pseudoHeader, TcpHeader *segment, size_t length);
+
+uint32_t tcpSynCookieHash(IpPseudoHeader *pseudoHeader, TcpHeader *segment,
+   uint32_t isn, uint32_t counter);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,573 @@
+/**
+ * @file tcp_time_wait.c
+ * @brief Compact TIME-WAIT state
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @section Description
+ *
+ * Once the user has closed a connection that has entered the TIME-WAIT
+ * state, the only information that is still needed is the connection
+ * 4-tuple and the sequence numbers that allow retransmitted FINs to be
+ * acknowledged. This state is moved into a small dedicated table so that
+ * the socket, along with its TCB and its buffers, is released immediately
+ * rather than 2MSL later
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL TCP_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/ip.h"
+#include "core/socket.h"
+#include "core/tcp.h"
+#include "core/tcp_misc.h"
+#include "core/tcp_timer.h"
+#include "core/tcp_time_wait.h"
+#include "ipv4/ipv4.h"
+#include "ipv6/ipv6.h"
+#include "mibs/mib2_module.h"
+#include "mibs/tcp_mib_module.h"
+#include "date_time.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (TCP_SUPPORT == ENABLED && TCP_TIME_WAIT_TABLE_SUPPORT == ENABLED)
+
+//Connections in the TIME-WAIT state
+static TcpTimeWaitEntry tcpTimeWaitTable[TCP_TIME_WAIT_TABLE_SIZE];
+
+
+/**
+ * @brief Initialize the TIME-WAIT table
+ **/
+
+void tcpTimeWaitInit(void)
+{
+   //Clear the TIME-WAIT table
+   osMemset(tcpTimeWaitTable, 0, sizeof(tcpTimeWaitTable));
+}
+
+
+/**
+ * @brief Move a connection to the TIME-WAIT table
+ *
+ * The socket must be in the TIME-WAIT state and must not be owned by the
+ * user anymore. It is released on return
+ *
+ * @param[in] socket Handle referencing the socket
+ **/
+
+void tcpTimeWaitTransfer(Socket *socket)
+{
+   uint_t i;
+   systime_t time;
+   systime_t delay;
+   TcpTimeWaitEntry *entry;
+   TcpTimeWaitEntry *oldestEntry;
+
+   //Get current time
+   time = osGetSystemTime();
+
+   //Compute the remaining part of the 2MSL period
+   if(tcpTimerRunning(&socket->timeWaitTimer) &&
+      !tcpTimerElapsed(&socket->timeWaitTimer))
+   {
+      delay = socket->timeWaitTimer.startTime +
+         socket->timeWaitTimer.interval - time;
+   }
+   else
+   {
+      delay = 0;
+   }
+
+   //Keep track of the oldest entry
+   oldestEntry = &tcpTimeWaitTable[0];
+
+   //Loop through the TIME-WAIT table
+   for(i = 0; i < TCP_TIME_WAIT_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &tcpTimeWaitTable[i];
+
+      //Check whether the entry is available
+      if(!entry->used)
+      {
+         oldestEntry = entry;
+         break;
+      }
+
+      //Keep track of the oldest entry
+      if((time - entry->timestamp) > (time - oldestEntry->timestamp))
+         oldestEntry = entry;
+   }
+
+   //Point to the chosen entry
+   entry = oldestEntry;
+
+   //The oldest connection is dropped when the table runs full
+   if(entry->used)
+   {
+      //Debug message
+      TRACE_WARNING("TIME-WAIT table full, dropping oldest entry...\r\n");
+      //Cancel the 2MSL timer
+      netStopTimer(&entry->timer);
+   }
+
+   //Save the connection 4-tuple
+   entry->used = TRUE;
+   entry->interface = socket->interface;
+   entry->localIpAddr = socket->localIpAddr;
+   entry->localPort = socket->localPort;
+   entry->remoteIpAddr = socket->remoteIpAddr;
+   entry->remotePort = socket->remotePort;
+
+   //Save the sequence numbers
+   entry->sndNxt = socket->sndNxt;
+   entry->rcvNxt = socket->rcvNxt;
+   entry->rcvWnd = socket->rcvWnd;
+
+#if (TCP_WINDOW_SCALE_SUPPORT == ENABLED)
+   //The window field of the acknowledgments is scaled
+   entry->window = MIN(socket->rcvWnd >> socket->rcvWndShift, UINT16_MAX);
+#else
+   //Advertise the receive window
+   entry->window = socket->rcvWnd;
+#endif
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //Acknowledgments carry the Timestamps option if it has been negotiated
+   entry->tsOptionReceived = socket->tsOptionReceived;
+   entry->tsRecent = socket->tsRecent;
+#endif
+
+   //Save the time at which the connection entered the TIME-WAIT state
+   entry->timestamp = time + delay - TCP_2MSL_TIMER;
+
+   //Start the 2MSL timer for the remaining period
+   netStartTimer(&entry->timer, delay, tcpTimeWaitTimerCallback, entry);
+
+   //Debug message
+   TRACE_INFO("TCP socket %u moved to the TIME-WAIT table\r\n",
+      socket->descriptor);
+
+   //Enter CLOSED state
+   tcpChangeState(socket, TCP_STATE_CLOSED);
+   //Delete the TCB
+   tcpDeleteControlBlock(socket);
+   //Mark the socket as closed
+   socket->type = SOCKET_TYPE_UNUSED;
+   //Remove the socket from the hash tables
+   socketUpdateHash(socket);
+}
+
+
+/**
+ * @brief Search the TIME-WAIT table for a matching connection
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header describing the incoming segment
+ * @param[in] localPort Destination port of the incoming segment
+ * @param[in] remotePort Source port of the incoming segment
+ * @return Matching entry, if any
+ **/
+
+TcpTimeWaitEntry *tcpTimeWaitLookup(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, uint16_t localPort, uint16_t remotePort)
+{
+   uint_t i;
+   TcpTimeWaitEntry *entry;
+
+   //Loop through the TIME-WAIT table
+   for(i = 0; i < TCP_TIME_WAIT_TABLE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &tcpTimeWaitTable[i];
+
+      //Skip unused entries
+      if(!entry->used)
+         continue;
+      //Check port numbers
+      if(entry->localPort != localPort || entry->remotePort != remotePort)
+         continue;
+      //Check whether the connection was bound to a particular interface
+      if(entry->interface != NULL && entry->interface != interface)
+         continue;
+
+#if (IPV4_SUPPORT == ENABLED)
+      //IPv4 connection?
+      if(pseudoHeader->length == sizeof(Ipv4PseudoHeader) &&
+         entry->remoteIpAddr.length == sizeof(Ipv4Addr))
+      {
+         //Check IP addresses
+         if(entry->remoteIpAddr.ipv4Addr == pseudoHeader->ipv4Data.srcAddr &&
+            entry->localIpAddr.ipv4Addr == pseudoHeader->ipv4Data.destAddr)
+         {
+            return entry;
+         }
+      }
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+      //IPv6 connection?
+      if(pseudoHeader->length == sizeof(Ipv6PseudoHeader) &&
+         entry->remoteIpAddr.length == sizeof(Ipv6Addr))
+      {
+         //Check IP addresses
+         if(ipv6CompAddr(&entry->remoteIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.srcAddr) &&
+            ipv6CompAddr(&entry->localIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.destAddr))
+         {
+            return entry;
+         }
+      }
+#endif
+   }
+
+   //No matching connection
+   return NULL;
+}
+
+
+/**
+ * @brief Process a segment that may belong to a connection in TIME-WAIT
+ *
+ * The segment is processed the same way as tcpStateTimeWait does for a
+ * connection that is still held by a socket
+ *
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header
+ * @param[in] segment Incoming TCP segment (header fields in host byte order)
+ * @param[in] length Length of the segment data
+ * @return TRUE if the segment has been consumed, FALSE if it must be
+ *   processed by a listening socket or answered with a reset
+ **/
+
+bool_t tcpTimeWaitProcessSegment(NetInterface *interface,
+   IpPseudoHeader *pseudoHeader, TcpHeader *segment, size_t length)
+{
+   bool_t acceptable;
+   TcpTimeWaitEntry *entry;
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   uint32_t tsVal;
+   uint32_t tsEcr;
+#endif
+
+   //Search the TIME-WAIT table for a matching connection
+   entry = tcpTimeWaitLookup(interface, pseudoHeader, segment->destPort,
+      segment->srcPort);
+   //No matching connection?
+   if(entry == NULL)
+      return FALSE;
+
+   //A new SYN whose sequence number is beyond the end of the previous
+   //incarnation may reopen the connection (refer to RFC 1122, section
+   //4.2.2.13)
+   if((segment->flags & (TCP_FLAG_SYN | TCP_FLAG_ACK | TCP_FLAG_RST)) == TCP_FLAG_SYN &&
+      TCP_CMP_SEQ(segment->seqNum, entry->rcvNxt) > 0)
+   {
+      //Debug message
+      TRACE_INFO("TCP connection reopened from TIME-WAIT state\r\n");
+
+      //Delete the TIME-WAIT entry
+      tcpTimeWaitRemove(entry);
+      //The SYN is handed over to the listening socket
+      return FALSE;
+   }
+
+   //Acceptability test for the incoming segment
+   acceptable = FALSE;
+
+   //Case where both segment length and receive window are zero
+   if(!length && !entry->rcvWnd)
+   {
+      //Make sure that SEG.SEQ = RCV.NXT
+      if(segment->seqNum == entry->rcvNxt)
+         acceptable = TRUE;
+   }
+   //Case where segment length is zero and receive window is non zero
+   else if(!length && entry->rcvWnd)
+   {
+      //Make sure that RCV.NXT <= SEG.SEQ < RCV.NXT+RCV.WND
+      if(TCP_CMP_SEQ(segment->seqNum, entry->rcvNxt) >= 0 &&
+         TCP_CMP_SEQ(segment->seqNum, entry->rcvNxt + entry->rcvWnd) < 0)
+      {
+         acceptable = TRUE;
+      }
+   }
+   //Case where both segment length and receive window are non zero
+   else if(length && entry->rcvWnd)
+   {
+      //Check whether RCV.NXT <= SEG.SEQ < RCV.NXT+RCV.WND
+      if(TCP_CMP_SEQ(segment->seqNum, entry->rcvNxt) >= 0 &&
+         TCP_CMP_SEQ(segment->seqNum, entry->rcvNxt + entry->rcvWnd) < 0)
+      {
+         acceptable = TRUE;
+      }
+      //or RCV.NXT <= SEG.SEQ+SEG.LEN-1 < RCV.NXT+RCV.WND
+      else if(TCP_CMP_SEQ(segment->seqNum + length - 1, entry->rcvNxt) >= 0 &&
+         TCP_CMP_SEQ(segment->seqNum + length - 1, entry->rcvNxt + entry->rcvWnd) < 0)
+      {
+         acceptable = TRUE;
+      }
+   }
+
+   //Non acceptable sequence number?
+   if(!acceptable)
+   {
+      //If an incoming segment is not acceptable, an acknowledgment
+      //should be sent in reply (unless the RST bit is set)
+      if(!(segment->flags & TCP_FLAG_RST))
+      {
+         //A retransmitted FIN falls outside the window since it has already
+         //been acknowledged. The 2MSL timeout must then be restarted
+         if(segment->flags & TCP_FLAG_FIN)
+         {
+            netStartTimer(&entry->timer, TCP_2MSL_TIMER,
+               tcpTimeWaitTimerCallback, entry);
+         }
+
+         //Send an acknowledgment in reply
+         tcpTimeWaitSendAck(entry, interface, pseudoHeader);
+      }
+
+      //Drop the segment
+      return TRUE;
+   }
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //Record the most recent timestamp to be echoed to the peer
+   if(entry->tsOptionReceived && TCP_CMP_SEQ(segment->seqNum, entry->rcvNxt) <= 0)
+   {
+      //Timestamps option found?
+      if(tcpGetTimestampOption(segment, &tsVal, &tsEcr))
+      {
+         //TS.Recent must never go backward
+         if(TCP_CMP_SEQ(tsVal, entry->tsRecent) > 0)
+            entry->tsRecent = tsVal;
+      }
+   }
+#endif
+
+   //Check the RST bit
+   if(segment->flags & TCP_FLAG_RST)
+   {
+      //Delete the TIME-WAIT entry
+      tcpTimeWaitRemove(entry);
+      //Return immediately
+      return TRUE;
+   }
+
+   //Check the SYN bit
+   if(segment->flags & TCP_FLAG_SYN)
+   {
+      //A SYN in the window is an error and a reset shall be sent in response
+      tcpSendResetSegment(interface, pseudoHeader, segment, length);
+
+      //Delete the TIME-WAIT entry
+      tcpTimeWaitRemove(entry);
+      //Return immediately
+      return TRUE;
+   }
+
+   //If the ACK bit is off drop the segment
+   if(!(segment->flags & TCP_FLAG_ACK))
+      return TRUE;
+
+   //Check the FIN bit
+   if(segment->flags & TCP_FLAG_FIN)
+   {
+      //Acknowledge the retransmitted FIN
+      tcpTimeWaitSendAck(entry, interface, pseudoHeader);
+
+      //Restart the 2MSL timeout
+      netStartTimer(&entry->timer, TCP_2MSL_TIMER, tcpTimeWaitTimerCallback,
+         entry);
+   }
+
+   //The segment has been consumed
+   return TRUE;
+}
+
+
+/**
+ * @brief Send an acknowledgment on behalf of a connection in TIME-WAIT
+ * @param[in] entry Pointer to the TIME-WAIT entry
+ * @param[in] interface Underlying network interface
+ * @param[in] pseudoHeader TCP pseudo header describing the incoming segment
+ * @return Error code
+ **/
+
+error_t tcpTimeWaitSendAck(TcpTimeWaitEntry *entry, NetInterface *interface,
+   IpPseudoHeader *pseudoHeader)
+{
+   error_t error;
+   size_t offset;
+   size_t length;
+   NetBuffer *buffer;
+   TcpHeader *segment;
+   IpPseudoHeader pseudoHeader2;
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   uint8_t value[8];
+#endif
+
+   //Allocate a memory buffer to hold the acknowledgment
+   buffer = ipAllocBuffer(TCP_MAX_HEADER_LENGTH, &offset);
+   //Failed to allocate memory?
+   if(buffer == NULL)
+      return ERROR_OUT_OF_MEMORY;
+
+   //Point to the beginning of the TCP segment
+   segment = netBufferAt(buffer, offset);
+
+   //Format TCP header
+   segment->srcPort = htons(entry->localPort);
+   segment->destPort = htons(entry->remotePort);
+   segment->seqNum = htonl(entry->sndNxt);
+   segment->ackNum = htonl(entry->rcvNxt);
+   segment->reserved1 = 0;
+   segment->dataOffset = 5;
+   segment->flags = TCP_FLAG_ACK;
+   segment->reserved2 = 0;
+   segment->window = htons(entry->window);
+   segment->checksum = 0;
+   segment->urgentPointer = 0;
+
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   //Every segment carries the Timestamps option once both sides have sent
+   //it (refer to RFC 7323, section 3.2)
+   if(entry->tsOptionReceived)
+   {
+      //TSval field carries the current value of the timestamp clock
+      STORE32BE((uint32_t) osGetSystemTime(), value);
+      //TSecr field echoes the most recent timestamp received
+      STORE32BE(entry->tsRecent, value + 4);
+
+      //Append Timestamps option
+      tcpAddOption(segment, TCP_OPTION_TIMESTAMP, value, sizeof(value));
+   }
+#endif
+
+   //Calculate the length of the TCP header
+   length = segment->dataOffset * 4;
+   //Adjust the length of the multi-part buffer
+   netBufferSetLength(buffer, offset + length);
+
+#if (IPV4_SUPPORT == ENABLED)
+   //Destination address is an IPv4 address?
+   if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
+   {
+      //Format IPv4 pseudo header
+      pseudoHeader2.length = sizeof(Ipv4PseudoHeader);
+      pseudoHeader2.ipv4Data.srcAddr = pseudoHeader->ipv4Data.destAddr;
+      pseudoHeader2.ipv4Data.destAddr = pseudoHeader->ipv4Data.srcAddr;
+      pseudoHeader2.ipv4Data.reserved = 0;
+      pseudoHeader2.ipv4Data.protocol = IPV4_PROTOCOL_TCP;
+      pseudoHeader2.ipv4Data.length = htons(length);
+   }
+   else
+#endif
+#if (IPV6_SUPPORT == ENABLED)
+   //Destination address is an IPv6 address?
+   if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
+   {
+      //Format IPv6 pseudo header
+      pseudoHeader2.length = sizeof(Ipv6PseudoHeader);
+      pseudoHeader2.ipv6Data.srcAddr = pseudoHeader->ipv6Data.destAddr;
+      pseudoHeader2.ipv6Data.destAddr = pseudoHeader->ipv6Data.srcAddr;
+      pseudoHeader2.ipv6Data.length = htonl(length);
+      pseudoHeader2.ipv6Data.reserved = 0;
+      pseudoHeader2.ipv6Data.nextHeader = IPV6_TCP_HEADER;
+   }
+   else
+#endif
+   //Destination address is not valid?
+   {
+      //Free previously allocated memory
+      netBufferFree(buffer);
+      //This should never occur...
+      return ERROR_INVALID_ADDRESS;
+   }
+
+   //Calculate TCP header checksum
+   segment->checksum = ipCalcUpperLayerChecksumEx(pseudoHeader2.data,
+      pseudoHeader2.length, buffer, offset, length);
+
+   //Total number of segments sent
+   MIB2_INC_COUNTER32(tcpGroup.tcpOutSegs, 1);
+   TCP_MIB_INC_COUNTER32(tcpOutSegs, 1);
+   TCP_MIB_INC_COUNTER64(tcpHCOutSegs, 1);
+
+   //Debug message
+   TRACE_DEBUG("%s: Sending TCP acknowledgment (TIME-WAIT)...\r\n",
+      formatSystemTime(osGetSystemTime(), NULL));
+   //Dump TCP header contents for debugging purpose
+   tcpDumpHeader(segment, 0, 0, 0);
+
+   //Send TCP segment
+   error = ipSendDatagram(interface, &pseudoHeader2, buffer, offset,
+      &NET_DEFAULT_ANCILLARY_DATA);
+
+   //Free previously allocated memory
+   netBufferFree(buffer);
+
+   //Return error code
+   return error;
+}
+
+
+/**
+ * @brief Delete an entry from the TIME-WAIT table
+ * @param[in] entry Pointer to the TIME-WAIT entry
+ **/
+
+void tcpTimeWaitRemove(TcpTimeWaitEntry *entry)
+{
+   //Cancel the 2MSL timer
+   netStopTimer(&entry->timer);
+   //Release the entry
+   entry->used = FALSE;
+}
+
+
+/**
+ * @brief 2MSL timer expiration callback
+ * @param[in] param Pointer to the TIME-WAIT entry
+ **/
+
+void tcpTimeWaitTimerCallback(void *param)
+{
+   TcpTimeWaitEntry *entry;
+
+   //Point to the TIME-WAIT entry
+   entry = (TcpTimeWaitEntry *) param;
+
+   //Debug message
+   TRACE_DEBUG("TCP 2MSL timer elapsed (TIME-WAIT table)...\r\n");
+
+   //The connection is now fully closed
+   entry->used = FALSE;
+}
+
+#endif
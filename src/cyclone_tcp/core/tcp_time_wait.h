@@ -0,0 +1,89 @@
+/**
+ * @file tcp_time_wait.h
+ * @brief Compact TIME-WAIT state
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+#ifndef _TCP_TIME_WAIT_H
+#define _TCP_TIME_WAIT_H
+
+//Dependencies
+#include "core/tcp.h"
+
+//C++ guard
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/**
+ * @brief Connection in the TIME-WAIT state
+ **/
+
+typedef struct
+{
+   bool_t used;               ///<The entry is in use
+   NetInterface *interface;   ///<Underlying network interface
+   IpAddr localIpAddr;        ///<Local IP address
+   uint16_t localPort;        ///<Local port number
+   IpAddr remoteIpAddr;       ///<Remote IP address
+   uint16_t remotePort;       ///<Remote port number
+   uint32_t sndNxt;           ///<Sequence number of our FIN, plus one
+   uint32_t rcvNxt;           ///<Sequence number of the remote FIN, plus one
+   uint32_t rcvWnd;           ///<Receive window
+   uint16_t window;           ///<Window field of the acknowledgments
+#if (TCP_TIMESTAMPS_SUPPORT == ENABLED)
+   bool_t tsOptionReceived;   ///<Timestamps option received
+   uint32_t tsRecent;         ///<Timestamp value to be echoed to the peer
+#endif
+   systime_t timestamp;       ///<Time at which the connection entered TIME-WAIT
+   NetTimer timer;            ///<2MSL timer
+} TcpTimeWaitEntry;
+
+
+//TIME-WAIT related functions
+void tcpTimeWaitInit(void);
+void tcpTimeWaitTransfer(Socket *socket);
+
+TcpTimeWaitEntry *tcpTimeWaitLookup(NetInterface *interface,
+   const IpPseudoHeader *pseudoHeader, uint16_t localPort, uint16_t remotePort);
+
+bool_t tcpTimeWaitProcessSegment(NetInterface *interface,
+   IpPseudoHeader *pseudoHeader, TcpHeader *segment, size_t length);
+
+error_t tcpTimeWaitSendAck(TcpTimeWaitEntry *entry, NetInterface *interface,
+   IpPseudoHeader *pseudoHeader);
+
+void tcpTimeWaitRemove(TcpTimeWaitEntry *entry);
+void tcpTimeWaitTimerCallback(void *param);
+
+//C++ guard
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -37,6 +37,8 @@
 #include "core/tcp.h"
 #include "core/tcp_misc.h"
 #include "core/tcp_timer.h"
+#include "core/tcp_congest.h"
+#include "core/tcp_pacing.h"
 #include "ipv4/ipv4.h"
 #include "ipv6/ipv6.h"
 #include "date_time.h"
@@ -49,223 +51,281 @@
 /**
  * @brief TCP timer handler
  *
- * This routine must be periodically called by the TCP/IP stack to
- * handle retransmissions and TCP related timers (persist timer,
- * FIN-WAIT-2 timer and TIME-WAIT timer)
+ * This routine is invoked by the TCP/IP stack whenever one of the timers
+ * of the socket expires, to handle retransmissions and TCP related timers
+ * (persist timer, FIN-WAIT-2 timer and TIME-WAIT timer)
  *
+ * @param[in] socket Handle referencing the socket
  **/
 
-void tcpTick(void)
+void tcpTick(Socket *socket)
 {
    error_t error;
-   uint_t i;
    uint_t n;
    uint_t u;
 
-   //Loop through opened sockets
-   for(i = 0; i < SOCKET_MAX_COUNT; i++)
+   //Check socket type
+   if(socket->type != SOCKET_TYPE_STREAM)
+      return;
+   //Check the current state of the TCP state machine
+   if(socket->state == TCP_STATE_CLOSED)
+      return;
+
+#if (TCP_DELAYED_ACK_SUPPORT == ENABLED)
+   //The delayed ACK timer has elapsed?
+   if(tcpTimerElapsed(&socket->delayedAckTimer))
    {
-      //Shortcut to the current socket
-      Socket *socket = socketTable + i;
-      //Check socket type
-      if(socket->type != SOCKET_TYPE_STREAM)
-         continue;
-      //Check the current state of the TCP state machine
-      if(socket->state == TCP_STATE_CLOSED)
-         continue;
-
-      //Is there any packet in the retransmission queue?
-      if(socket->retransmitQueue != NULL)
+      //Acknowledge the data received so far
+      tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt, socket->rcvNxt,
+         0, FALSE);
+      //Do not retry if the segment could not be sent
+      tcpTimerStop(&socket->delayedAckTimer);
+   }
+#endif
+
+#if (TCP_PACING_SUPPORT == ENABLED)
+   //Data held back by the pacing scheduler can be sent?
+   if(tcpTimerElapsed(&socket->pacingTimer))
+   {
+      //Release the next segments
+      tcpPacingResume(socket);
+   }
+#endif
+
+   //Is there any packet in the retransmission queue?
+   if(socket->retransmitQueue != NULL)
+   {
+      //Retransmission timeout?
+      if(tcpTimerElapsed(&socket->retransmitTimer))
       {
-         //Retransmission timeout?
-         if(tcpTimerElapsed(&socket->retransmitTimer))
-         {
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
-            //When a TCP sender detects segment loss using the retransmission
-            //timer and the given segment has not yet been resent by way of
-            //the retransmission timer, the value of ssthresh must be updated
-            if(!socket->retransmitCount)
-            {
-               //Amount of data that has been sent but not yet acknowledged
-               uint_t flightSize = socket->sndNxt - socket->sndUna;
-               //Adjust ssthresh value
-               socket->ssthresh = MAX(flightSize / 2, 2 * socket->smss);
-            }
-
-            //Furthermore, upon a timeout cwnd must be set to no more than
-            //the loss window, LW, which equals 1 full-sized segment
-            socket->cwnd = MIN(TCP_LOSS_WINDOW * socket->smss, socket->txBufferSize);
-
-            //After a retransmit timeout, record the highest sequence number
-            //transmitted in the variable recover
-            socket->recover = socket->sndNxt - 1;
-
-            //Enter the fast loss recovery procedure
-            socket->congestState = TCP_CONGEST_STATE_LOSS_RECOVERY;
+         //When a TCP sender detects segment loss using the retransmission
+         //timer and the given segment has not yet been resent by way of
+         //the retransmission timer, the value of ssthresh must be updated
+         if(!socket->retransmitCount)
+         {
+            //Adjust ssthresh value
+            socket->ssthresh = tcpCongestOnLoss(socket);
+         }
+
+         //Furthermore, upon a timeout cwnd must be set to no more than
+         //the loss window, LW, which equals 1 full-sized segment
+         socket->cwnd = MIN(TCP_LOSS_WINDOW * socket->smss, socket->txBufferSize);
+
+         //After a retransmit timeout, record the highest sequence number
+         //transmitted in the variable recover
+         socket->recover = socket->sndNxt - 1;
+
+         //Enter the fast loss recovery procedure
+         socket->congestState = TCP_CONGEST_STATE_LOSS_RECOVERY;
+#endif
+
+#if (TCP_SACK_SUPPORT == ENABLED)
+         //After a retransmission timeout, the SACK information gathered
+         //so far must be ignored (refer to RFC 2018, section 8)
+         tcpResetScoreboard(socket);
 #endif
-            //Make sure the maximum number of retransmissions has not been reached
-            if(socket->retransmitCount < TCP_MAX_RETRIES)
-            {
-               //Debug message
-               TRACE_INFO("%s: TCP segment retransmission #%u (%u data bytes)...\r\n",
-                  formatSystemTime(osGetSystemTime(), NULL), socket->retransmitCount + 1,
-                  socket->retransmitQueue->length);
-
-               //Retransmit the earliest segment that has not been
-               //acknowledged by the TCP receiver
-               tcpRetransmitSegment(socket);
-
-               //Use exponential back-off algorithm to calculate the new RTO
-               socket->rto = MIN(socket->rto * 2, TCP_MAX_RTO);
-               //Restart retransmission timer
-               tcpTimerStart(&socket->retransmitTimer, socket->rto);
-               //Increment retransmission counter
-               socket->retransmitCount++;
-            }
-            else
-            {
-               //The maximum number of retransmissions has been exceeded
-               tcpChangeState(socket, TCP_STATE_CLOSED);
-               //Turn off the retransmission timer
-               tcpTimerStop(&socket->retransmitTimer);
-            }
-
-            //TCP must use Karn's algorithm for taking RTT samples. That is, RTT
-            //samples must not be made using segments that were retransmitted
-            socket->rttBusy = FALSE;
+         //Make sure the maximum number of retransmissions has not been reached
+         if(socket->retransmitCount < TCP_MAX_RETRIES)
+         {
+            //Debug message
+            TRACE_INFO("%s: TCP segment retransmission #%u (%u data bytes)...\r\n",
+               formatSystemTime(osGetSystemTime(), NULL), socket->retransmitCount + 1,
+               socket->retransmitQueue->length);
+
+            //Retransmit the earliest segment that has not been
+            //acknowledged by the TCP receiver
+            tcpRetransmitSegment(socket);
+
+            //Use exponential back-off algorithm to calculate the new RTO
+            socket->rto = MIN(socket->rto * 2, TCP_MAX_RTO);
+            //Restart retransmission timer
+            tcpTimerStart(&socket->retransmitTimer, socket->rto);
+            //Increment retransmission counter
+            socket->retransmitCount++;
          }
+         else
+         {
+            //The maximum number of retransmissions has been exceeded
+            tcpChangeState(socket, TCP_STATE_CLOSED);
+            //Turn off the retransmission timer
+            tcpTimerStop(&socket->retransmitTimer);
+         }
+
+         //TCP must use Karn's algorithm for taking RTT samples. That is, RTT
+         //samples must not be made using segments that were retransmitted
+         socket->rttBusy = FALSE;
       }
+   }
 
-      //Check the current state of the TCP state machine
-      if(socket->state == TCP_STATE_CLOSED)
-         continue;
+   //Check the current state of the TCP state machine
+   if(socket->state == TCP_STATE_CLOSED)
+      return;
 
-      //The persist timer is used when the remote host advertises
-      //a window size of zero
-      if(!socket->sndWnd && socket->wndProbeInterval)
+   //The persist timer is used when the remote host advertises
+   //a window size of zero
+   if(!socket->sndWnd && socket->wndProbeInterval)
+   {
+      //Time to send a new probe?
+      if(tcpTimerElapsed(&socket->persistTimer))
       {
-         //Time to send a new probe?
-         if(tcpTimerElapsed(&socket->persistTimer))
+         //Make sure the maximum number of retransmissions has not been reached
+         if(socket->wndProbeCount < TCP_MAX_RETRIES)
          {
-            //Make sure the maximum number of retransmissions has not been reached
-            if(socket->wndProbeCount < TCP_MAX_RETRIES)
-            {
-               //Debug message
-               TRACE_INFO("%s: TCP zero window probe #%u...\r\n",
-                  formatSystemTime(osGetSystemTime(), NULL), socket->wndProbeCount + 1);
-
-               //Zero window probes usually have the sequence number one less than expected
-               tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt - 1, socket->rcvNxt, 0, FALSE);
-               //The interval between successive probes should be increased exponentially
-               socket->wndProbeInterval = MIN(socket->wndProbeInterval * 2, TCP_MAX_PROBE_INTERVAL);
-               //Restart the persist timer
-               tcpTimerStart(&socket->persistTimer, socket->wndProbeInterval);
-               //Increment window probe counter
-               socket->wndProbeCount++;
-            }
-            else
-            {
-               //Enter CLOSED state
-               tcpChangeState(socket, TCP_STATE_CLOSED);
-            }
+            //Debug message
+            TRACE_INFO("%s: TCP zero window probe #%u...\r\n",
+               formatSystemTime(osGetSystemTime(), NULL), socket->wndProbeCount + 1);
+
+            //Zero window probes usually have the sequence number one less than expected
+            tcpSendSegment(socket, TCP_FLAG_ACK, socket->sndNxt - 1, socket->rcvNxt, 0, FALSE);
+            //The interval between successive probes should be increased exponentially
+            socket->wndProbeInterval = MIN(socket->wndProbeInterval * 2, TCP_MAX_PROBE_INTERVAL);
+            //Restart the persist timer
+            tcpTimerStart(&socket->persistTimer, socket->wndProbeInterval);
+            //Increment window probe counter
+            socket->wndProbeCount++;
+         }
+         else
+         {
+            //Enter CLOSED state
+            tcpChangeState(socket, TCP_STATE_CLOSED);
          }
       }
+   }
 
-      //To avoid a deadlock, it is necessary to have a timeout to force
-      //transmission of data, overriding the SWS avoidance algorithm. In
-      //practice, this timeout should seldom occur (refer to RFC 1122,
-      //section 4.2.3.4)
-      if(socket->state == TCP_STATE_ESTABLISHED || socket->state == TCP_STATE_CLOSE_WAIT)
+   //To avoid a deadlock, it is necessary to have a timeout to force
+   //transmission of data, overriding the SWS avoidance algorithm. In
+   //practice, this timeout should seldom occur (refer to RFC 1122,
+   //section 4.2.3.4)
+   if(socket->state == TCP_STATE_ESTABLISHED || socket->state == TCP_STATE_CLOSE_WAIT)
+   {
+      //The override timeout occurred?
+      if(socket->sndUser && tcpTimerElapsed(&socket->overrideTimer))
       {
-         //The override timeout occurred?
-         if(socket->sndUser && tcpTimerElapsed(&socket->overrideTimer))
-         {
-            //The amount of data that can be sent at any given time is
-            //limited by the receiver window and the congestion window
-            n = MIN(socket->sndWnd, socket->txBufferSize);
+         //The amount of data that can be sent at any given time is
+         //limited by the receiver window and the congestion window
+         n = MIN(socket->sndWnd, socket->txBufferSize);
 
 #if (TCP_CONGEST_CONTROL_SUPPORT == ENABLED)
-            //Check the congestion window
-            n = MIN(n, socket->cwnd);
+         //Check the congestion window
+         n = MIN(n, socket->cwnd);
+#endif
+         //Retrieve the size of the usable window
+         u = n - (socket->sndNxt - socket->sndUna);
+
+         //Send as much data as possible
+         while(socket->sndUser > 0)
+         {
+            //The usable window size may become zero or negative,
+            //preventing packet transmission
+            if((int_t) u <= 0)
+               break;
+
+#if (TCP_PACING_SUPPORT == ENABLED)
+            //The override timeout does not bypass the pacing rate
+            if(tcpPacingDelaySegment(socket, SOCKET_FLAG_NO_DELAY))
+               break;
+#endif
+
+            //Calculate the number of bytes to send at a time
+            n = MIN(u, socket->sndUser);
+            n = MIN(n, socket->smss);
+
+            //Send TCP segment
+            error = tcpSendSegment(socket, TCP_FLAG_PSH | TCP_FLAG_ACK,
+               socket->sndNxt, socket->rcvNxt, n, TRUE);
+            //Failed to send TCP segment?
+            if(error)
+               break;
+
+            //Advance SND.NXT pointer
+            socket->sndNxt += n;
+            //Adjust the number of bytes buffered but not yet sent
+            socket->sndUser -= n;
+            //Update the size of the usable window
+            u -= n;
+
+#if (TCP_PACING_SUPPORT == ENABLED)
+            //Consume the pacing credit
+            tcpPacingConsume(socket, n);
 #endif
-            //Retrieve the size of the usable window
-            u = n - (socket->sndNxt - socket->sndUna);
-
-            //Send as much data as possible
-            while(socket->sndUser > 0)
-            {
-               //The usable window size may become zero or negative,
-               //preventing packet transmission
-               if((int_t) u <= 0)
-                  break;
-
-               //Calculate the number of bytes to send at a time
-               n = MIN(u, socket->sndUser);
-               n = MIN(n, socket->smss);
-
-               //Send TCP segment
-               error = tcpSendSegment(socket, TCP_FLAG_PSH | TCP_FLAG_ACK,
-                  socket->sndNxt, socket->rcvNxt, n, TRUE);
-               //Failed to send TCP segment?
-               if(error)
-                  break;
-
-               //Advance SND.NXT pointer
-               socket->sndNxt += n;
-               //Adjust the number of bytes buffered but not yet sent
-               socket->sndUser -= n;
-               //Update the size of the usable window
-               u -= n;
-            }
-
-            //Check whether the transmitter can accept more data
-            tcpUpdateEvents(socket);
-
-            //Restart override timer if necessary
-            if(socket->sndUser > 0)
-               tcpTimerStart(&socket->overrideTimer, TCP_OVERRIDE_TIMEOUT);
          }
+
+         //Check whether the transmitter can accept more data
+         tcpUpdateEvents(socket);
+
+         //Restart override timer if necessary
+         if(socket->sndUser > 0)
+            tcpTimerStart(&socket->overrideTimer, TCP_OVERRIDE_TIMEOUT);
       }
+   }
 
-      //The FIN-WAIT-2 timer prevents the connection
-      //from staying in the FIN-WAIT-2 state forever
-      if(socket->state == TCP_STATE_FIN_WAIT_2)
+   //The FIN-WAIT-2 timer prevents the connection
+   //from staying in the FIN-WAIT-2 state forever
+   if(socket->state == TCP_STATE_FIN_WAIT_2)
+   {
+      //Maximum FIN-WAIT-2 time has elapsed?
+      if(tcpTimerElapsed(&socket->finWait2Timer))
       {
-         //Maximum FIN-WAIT-2 time has elapsed?
-         if(tcpTimerElapsed(&socket->finWait2Timer))
-         {
-            //Debug message
-            TRACE_WARNING("TCP FIN-WAIT-2 timer elapsed...\r\n");
-            //Enter CLOSED state
-            tcpChangeState(socket, TCP_STATE_CLOSED);
-         }
+         //Debug message
+         TRACE_WARNING("TCP FIN-WAIT-2 timer elapsed...\r\n");
+         //Enter CLOSED state
+         tcpChangeState(socket, TCP_STATE_CLOSED);
       }
+   }
 
-      //TIME-WAIT timer
-      if(socket->state == TCP_STATE_TIME_WAIT)
+   //TIME-WAIT timer
+   if(socket->state == TCP_STATE_TIME_WAIT)
+   {
+      //2MSL time has elapsed?
+      if(tcpTimerElapsed(&socket->timeWaitTimer))
       {
-         //2MSL time has elapsed?
-         if(tcpTimerElapsed(&socket->timeWaitTimer))
+         //Debug message
+         TRACE_WARNING("TCP 2MSL timer elapsed (socket %u)...\r\n",
+            socket->descriptor);
+         //Enter CLOSED state
+         tcpChangeState(socket, TCP_STATE_CLOSED);
+
+         //Dispose the socket if the user does not have the ownership anymore
+         if(!socket->ownedFlag)
          {
-            //Debug message
-            TRACE_WARNING("TCP 2MSL timer elapsed (socket %u)...\r\n", i);
-            //Enter CLOSED state
-            tcpChangeState(socket, TCP_STATE_CLOSED);
-
-            //Dispose the socket if the user does not have the ownership anymore
-            if(!socket->ownedFlag)
-            {
-               //Delete the TCB
-               tcpDeleteControlBlock(socket);
-               //Mark the socket as closed
-               socket->type = SOCKET_TYPE_UNUSED;
-            }
+            //Delete the TCB
+            tcpDeleteControlBlock(socket);
+            //Mark the socket as closed
+            socket->type = SOCKET_TYPE_UNUSED;
+            //Remove the socket from the hash tables
+            socketUpdateHash(socket);
          }
       }
    }
 }
 
 
+/**
+ * @brief TCP timer expiration callback
+ * @param[in] param Pointer to the timer that has expired
+ **/
+
+void tcpTimerCallback(void *param)
+{
+   uint_t i;
+
+   //TCP timers are embedded in the entries of the socket table
+   i = ((uint8_t *) param - (uint8_t *) socketTable) / sizeof(Socket);
+
+   //Sanity check
+   if(i < SOCKET_MAX_COUNT)
+   {
+      //Get exclusive access
+      SOCKET_LOCK(socketTable + i);
+      //Process the timers of the corresponding socket
+      tcpTick(socketTable + i);
+      //Release exclusive access
+      SOCKET_UNLOCK(socketTable + i);
+   }
+}
+
+
 /**
  * @brief Start TCP timer
  * @param[in] timer Pointer to the timer structure
@@ -280,6 +340,9 @@ void tcpTimerStart(TcpTimer *timer, systime_t delay)
 
    //The timer is now running...
    timer->running = TRUE;
+
+   //Register the deadline with the timer wheel
+   netStartTimer(&timer->entry, delay, tcpTimerCallback, timer);
 }
 
 
@@ -292,6 +355,9 @@ void tcpTimerStop(TcpTimer *timer)
 {
    //Stop timer
    timer->running = FALSE;
+
+   //Cancel the pending deadline, if any
+   netStopTimer(&timer->entry);
 }
 
 
@@ -37,7 +37,8 @@ extern "C" {
 #endif
 
 //TCP timer related functions
-void tcpTick(void);
+void tcpTick(Socket *socket);
+void tcpTimerCallback(void *param);
 
 void tcpTimerStart(TcpTimer *timer, systime_t delay);
 void tcpTimerStop(TcpTimer *timer);
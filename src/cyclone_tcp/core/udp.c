@@ -37,6 +37,7 @@
 #include "core/ip.h"
 #include "core/udp.h"
 #include "core/socket.h"
+#include "core/socket_event_set.h"
 #include "ipv4/ipv4.h"
 #include "ipv4/ipv4_misc.h"
 #include "ipv6/ipv6.h"
@@ -138,6 +139,7 @@ error_t udpProcessDatagram(NetInterface *interface, IpPseudoHeader *pseudoHeader
    UdpHeader *header;
    Socket *socket;
    SocketQueueItem *queueItem;
+   SocketQueueItem *lastItem;
    NetBuffer *p;
 
    //Retrieve the length of the UDP datagram
@@ -186,97 +188,16 @@ error_t udpProcessDatagram(NetInterface *interface, IpPseudoHeader *pseudoHeader
       }
    }
 
-   //Loop through opened sockets
-   for(i = 0; i < SOCKET_MAX_COUNT; i++)
-   {
-      //Point to the current socket
-      socket = socketTable + i;
-
-      //UDP socket found?
-      if(socket->type != SOCKET_TYPE_DGRAM)
-         continue;
-      //Check whether the socket is bound to a particular interface
-      if(socket->interface && socket->interface != interface)
-         continue;
-      //Check destination port number
-      if(socket->localPort == 0 || socket->localPort != ntohs(header->destPort))
-         continue;
-      //Source port number filtering
-      if(socket->remotePort != 0 && socket->remotePort != ntohs(header->srcPort))
-         continue;
-
-#if (IPV4_SUPPORT == ENABLED)
-      //IPv4 packet received?
-      if(pseudoHeader->length == sizeof(Ipv4PseudoHeader))
-      {
-         //Destination IP address filtering
-         if(socket->localIpAddr.length != 0)
-         {
-            //An IPv4 address is expected
-            if(socket->localIpAddr.length != sizeof(Ipv4Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(socket->localIpAddr.ipv4Addr != pseudoHeader->ipv4Data.destAddr)
-               continue;
-         }
-
-         //Source IP address filtering
-         if(socket->remoteIpAddr.length != 0)
-         {
-            //An IPv4 address is expected
-            if(socket->remoteIpAddr.length != sizeof(Ipv4Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(socket->remoteIpAddr.ipv4Addr != pseudoHeader->ipv4Data.srcAddr)
-               continue;
-         }
-      }
-      else
-#endif
-#if (IPV6_SUPPORT == ENABLED)
-      //IPv6 packet received?
-      if(pseudoHeader->length == sizeof(Ipv6PseudoHeader))
-      {
-         //Destination IP address filtering
-         if(socket->localIpAddr.length != 0)
-         {
-            //An IPv6 address is expected
-            if(socket->localIpAddr.length != sizeof(Ipv6Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(!ipv6CompAddr(&socket->localIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.destAddr))
-               continue;
-         }
-
-         //Source IP address filtering
-         if(socket->remoteIpAddr.length != 0)
-         {
-            //An IPv6 address is expected
-            if(socket->remoteIpAddr.length != sizeof(Ipv6Addr))
-               continue;
-            //Filter out non-matching addresses
-            if(!ipv6CompAddr(&socket->remoteIpAddr.ipv6Addr, &pseudoHeader->ipv6Data.srcAddr))
-               continue;
-         }
-      }
-      else
-#endif
-      //Invalid packet received?
-      {
-         //This should never occur...
-         continue;
-      }
-
-      //The current socket meets all the criteria
-      break;
-   }
+   //Search the hash tables for a matching socket
+   socket = socketLookup(SOCKET_TYPE_DGRAM, interface, pseudoHeader,
+      ntohs(header->destPort), ntohs(header->srcPort));
 
    //Point to the payload
    offset += sizeof(UdpHeader);
    length -= sizeof(UdpHeader);
 
    //No matching socket found?
-   if(i >= SOCKET_MAX_COUNT)
+   if(socket == NULL)
    {
       //Invoke user callback, if any
       error = udpInvokeRxCallback(interface, pseudoHeader, header, buffer,
@@ -285,65 +206,34 @@ error_t udpProcessDatagram(NetInterface *interface, IpPseudoHeader *pseudoHeader
       return error;
    }
 
-   //Empty receive queue?
-   if(!socket->receiveQueue)
-   {
-      //Allocate a memory buffer to hold the data and the associated descriptor
-      p = netBufferAlloc(sizeof(SocketQueueItem) + length);
+   //Get exclusive access to the socket
+   SOCKET_LOCK(socket);
 
-      //Successful memory allocation?
-      if(p != NULL)
-      {
-         //Point to the newly created item
-         queueItem = netBufferAt(p, 0);
-         queueItem->buffer = p;
-         //Add the newly created item to the queue
-         socket->receiveQueue = queueItem;
-      }
-      else
-      {
-         //Memory allocation failed
-         queueItem = NULL;
-      }
-   }
-   else
+   //Count the items in the receive queue
+   for(i = 0, lastItem = socket->receiveQueue; lastItem != NULL; i++)
    {
-      //Point to the very first item
-      queueItem = socket->receiveQueue;
-
-      //Reach the last item in the receive queue
-      for(i = 1; queueItem->next; i++)
-      {
-         queueItem = queueItem->next;
-      }
-
-      //Make sure the receive queue is not full
-      if(i >= UDP_RX_QUEUE_SIZE)
-         return ERROR_RECEIVE_QUEUE_FULL;
+      lastItem = lastItem->next;
+   }
 
-      //Allocate a memory buffer to hold the data and the associated descriptor
-      p = netBufferAlloc(sizeof(SocketQueueItem) + length);
+   //Release exclusive access
+   SOCKET_UNLOCK(socket);
 
-      //Successful memory allocation?
-      if(p != NULL)
-      {
-         //Add the newly created item to the queue
-         queueItem->next = netBufferAt(p, 0);
-         //Point to the newly created item
-         queueItem = queueItem->next;
-         queueItem->buffer = p;
-      }
-      else
-      {
-         //Memory allocation failed
-         queueItem = NULL;
-      }
-   }
+   //Make sure the receive queue is not full before the payload is copied.
+   //The queue cannot grow in the meantime since incoming datagrams are
+   //processed under netMutex
+   if(i >= UDP_RX_QUEUE_SIZE)
+      return ERROR_RECEIVE_QUEUE_FULL;
 
+   //Allocate a memory buffer to hold the data and the associated descriptor
+   p = netBufferAlloc(sizeof(SocketQueueItem) + length);
    //Failed to allocate memory?
-   if(queueItem == NULL)
+   if(p == NULL)
       return ERROR_OUT_OF_MEMORY;
 
+   //Point to the newly created item
+   queueItem = netBufferAt(p, 0);
+   queueItem->buffer = p;
+
    //Initialize next field
    queueItem->next = NULL;
    //Record the source port number
@@ -382,9 +272,37 @@ error_t udpProcessDatagram(NetInterface *interface, IpPseudoHeader *pseudoHeader
    //Additional options can be passed to the stack along with the packet
    queueItem->ancillary = *ancillary;
 
+   //Get exclusive access to the socket (the payload has been copied
+   //beforehand so as to keep the critical section short)
+   SOCKET_LOCK(socket);
+
+   //Empty receive queue?
+   if(!socket->receiveQueue)
+   {
+      //Add the newly created item to the queue
+      socket->receiveQueue = queueItem;
+   }
+   else
+   {
+      //Point to the very first item
+      lastItem = socket->receiveQueue;
+
+      //Reach the last item in the receive queue
+      while(lastItem->next)
+      {
+         lastItem = lastItem->next;
+      }
+
+      //Add the newly created item to the queue
+      lastItem->next = queueItem;
+   }
+
    //Notify user that data is available
    udpUpdateEvents(socket);
 
+   //Release exclusive access
+   SOCKET_UNLOCK(socket);
+
    //Total number of UDP datagrams delivered to UDP users
    MIB2_INC_COUNTER32(udpGroup.udpInDatagrams, 1);
    UDP_MIB_INC_COUNTER32(udpInDatagrams, 1);
@@ -414,7 +332,6 @@ error_t udpSendDatagram(Socket *socket, const IpAddr *destIpAddr,
    error_t error;
    size_t offset;
    NetBuffer *buffer;
-   NetAncillaryData ancillary;
 
    //Allocate a memory buffer to hold the UDP datagram
    buffer = udpAllocBuffer(0, &offset);
@@ -428,34 +345,9 @@ error_t udpSendDatagram(Socket *socket, const IpAddr *destIpAddr,
    //Successful processing?
    if(!error)
    {
-      //Additional options can be passed to the stack along with the packet
-      ancillary = NET_DEFAULT_ANCILLARY_DATA;
-
-      //Set the TTL value to be used
-      if(ipIsMulticastAddr(destIpAddr))
-         ancillary.ttl = socket->multicastTtl;
-      else
-         ancillary.ttl = socket->ttl;
-
-      //This flag tells the stack that the destination is on a locally attached
-      //network and not to perform a lookup of the routing table
-      ancillary.dontRoute = (flags & SOCKET_FLAG_DONT_ROUTE) ? TRUE : FALSE;
-
-#if (ETH_VLAN_SUPPORT == ENABLED)
-      //Set VLAN PCP and DEI fields
-      ancillary.vlanPcp = socket->vlanPcp;
-      ancillary.vlanDei = socket->vlanDei;
-#endif
-
-#if (ETH_VMAN_SUPPORT == ENABLED)
-      //Set VMAN PCP and DEI fields
-      ancillary.vmanPcp = socket->vmanPcp;
-      ancillary.vmanDei = socket->vmanDei;
-#endif
-
       //Send UDP datagram
-      error = udpSendDatagramEx(socket->interface, NULL, socket->localPort,
-         destIpAddr, destPort, buffer, offset, &ancillary);
+      error = udpSendBuffer(socket, destIpAddr, destPort, buffer, offset,
+         flags);
    }
 
    //Successful processing?
@@ -473,6 +365,54 @@ error_t udpSendDatagram(Socket *socket, const IpAddr *destIpAddr,
 }
 
 
+/**
+ * @brief Send a UDP datagram whose payload is held in a multi-part buffer
+ * @param[in] socket Handle referencing the socket
+ * @param[in] destIpAddr IP address of the target host
+ * @param[in] destPort Target port number
+ * @param[in] buffer Multi-part buffer containing the payload. Room must be
+ *   reserved for the headers (refer to udpAllocBuffer)
+ * @param[in] offset Offset to the first payload byte
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t udpSendBuffer(Socket *socket, const IpAddr *destIpAddr,
+   uint16_t destPort, NetBuffer *buffer, size_t offset, uint_t flags)
+{
+   NetAncillaryData ancillary;
+
+   //Additional options can be passed to the stack along with the packet
+   ancillary = NET_DEFAULT_ANCILLARY_DATA;
+
+   //Set the TTL value to be used
+   if(ipIsMulticastAddr(destIpAddr))
+      ancillary.ttl = socket->multicastTtl;
+   else
+      ancillary.ttl = socket->ttl;
+
+   //This flag tells the stack that the destination is on a locally attached
+   //network and not to perform a lookup of the routing table
+   ancillary.dontRoute = (flags & SOCKET_FLAG_DONT_ROUTE) ? TRUE : FALSE;
+
+#if (ETH_VLAN_SUPPORT == ENABLED)
+   //Set VLAN PCP and DEI fields
+   ancillary.vlanPcp = socket->vlanPcp;
+   ancillary.vlanDei = socket->vlanDei;
+#endif
+
+#if (ETH_VMAN_SUPPORT == ENABLED)
+   //Set VMAN PCP and DEI fields
+   ancillary.vmanPcp = socket->vmanPcp;
+   ancillary.vmanDei = socket->vmanDei;
+#endif
+
+   //Send UDP datagram
+   return udpSendDatagramEx(socket->interface, NULL, socket->localPort,
+      destIpAddr, destPort, buffer, offset, &ancillary);
+}
+
+
 /**
  * @brief Send a UDP datagram (raw interface)
  * @param[in] interface Underlying network interface
@@ -652,6 +592,17 @@ error_t udpReceiveDatagram(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
 {
    SocketQueueItem *queueItem;
 
+#if (UDP_ZERO_COPY_RX_SUPPORT == ENABLED)
+   //The loaned datagram must be released first
+   if(socket->rxLoanDatagram)
+   {
+      //No data can be read
+      *received = 0;
+      //Report an error
+      return ERROR_WRONG_STATE;
+   }
+#endif
+
    //The SOCKET_FLAG_DONT_WAIT enables non-blocking operation
    if(!(flags & SOCKET_FLAG_DONT_WAIT))
    {
@@ -663,12 +614,8 @@ error_t udpReceiveDatagram(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
          //Reset the event object
          osResetEvent(&socket->event);
 
-         //Release exclusive access
-         osReleaseMutex(&netMutex);
          //Wait until an event is triggered
-         osWaitForEvent(&socket->event, socket->timeout);
-         //Get exclusive access
-         osAcquireMutex(&netMutex);
+         socketWaitForEvent(socket, socket->timeout);
       }
    }
 
@@ -716,6 +663,136 @@ error_t udpReceiveDatagram(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
 }
 
 
+#if (UDP_ZERO_COPY_RX_SUPPORT == ENABLED)
+
+/**
+ * @brief Loan the application a read-only view of the next datagram
+ *
+ * The view covers the whole payload. A datagram that does not fit in a single
+ * chunk cannot be loaned and must be read with udpReceiveDatagram instead. The
+ * view remains valid until udpReleaseLoan is called
+ *
+ * @param[in] socket Handle referencing the socket
+ * @param[out] srcIpAddr Source IP address (optional)
+ * @param[out] srcPort Source port number (optional)
+ * @param[out] data Pointer to the first byte of the view
+ * @param[out] length Number of bytes in the view
+ * @param[in] flags Set of flags that influences the behavior of this function
+ * @return Error code
+ **/
+
+error_t udpReceiveLoan(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
+   const uint8_t **data, size_t *length, uint_t flags)
+{
+   size_t n;
+   SocketQueueItem *queueItem;
+
+   //Nothing is loaned until the view has been checked
+   *data = NULL;
+   *length = 0;
+
+   //Only one datagram can be loaned at a time
+   if(socket->rxLoanDatagram)
+      return ERROR_WRONG_STATE;
+
+   //The SOCKET_FLAG_DONT_WAIT enables non-blocking operation
+   if(!(flags & SOCKET_FLAG_DONT_WAIT))
+   {
+      //The receive queue is empty?
+      if(!socket->receiveQueue)
+      {
+         //Set the events the application is interested in
+         socket->eventMask = SOCKET_EVENT_RX_READY;
+         //Reset the event object
+         osResetEvent(&socket->event);
+
+         //Wait until an event is triggered
+         socketWaitForEvent(socket, socket->timeout);
+      }
+   }
+
+   //Check whether the read operation timed out
+   if(!socket->receiveQueue)
+   {
+      //Nothing can be loaned
+      *data = NULL;
+      *length = 0;
+      //Report a timeout error
+      return ERROR_TIMEOUT;
+   }
+
+   //Point to the first item in the receive queue
+   queueItem = socket->receiveQueue;
+   //Retrieve the length of the payload
+   n = netBufferGetLength(queueItem->buffer) - queueItem->offset;
+
+   //Point to the first byte of the payload
+   *data = netBufferAtEx(queueItem->buffer, queueItem->offset, length);
+
+   //The payload must be contiguous, otherwise its tail would be lost when
+   //the view is released
+   if(*length < n)
+   {
+      //The datagram remains in the queue for the copying path
+      *data = NULL;
+      *length = 0;
+      //Report an error
+      return ERROR_INVALID_LENGTH;
+   }
+
+   //The view ends with the payload
+   *length = n;
+   //The datagram stays in the queue until the view is released
+   socket->rxLoanDatagram = TRUE;
+
+   //Save the source IP address
+   if(srcIpAddr != NULL)
+      *srcIpAddr = queueItem->srcIpAddr;
+
+   //Save the source port number
+   if(srcPort != NULL)
+      *srcPort = queueItem->srcPort;
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Release the datagram loaned by udpReceiveLoan
+ * @param[in] socket Handle referencing the socket
+ * @return Error code
+ **/
+
+error_t udpReleaseLoan(Socket *socket)
+{
+   SocketQueueItem *queueItem;
+
+   //Make sure a datagram has been loaned
+   if(!socket->rxLoanDatagram || !socket->receiveQueue)
+      return ERROR_WRONG_STATE;
+
+   //The datagram is no longer loaned
+   socket->rxLoanDatagram = FALSE;
+
+   //Point to the first item in the receive queue
+   queueItem = socket->receiveQueue;
+
+   //Remove the item from the receive queue
+   socket->receiveQueue = queueItem->next;
+   //Deallocate memory buffer
+   netBufferFree(queueItem->buffer);
+
+   //Update the state of events
+   udpUpdateEvents(socket);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+#endif
+
+
 /**
  * @brief Allocate a buffer to hold a UDP packet
  * @param[in] length Desired payload length
@@ -766,6 +843,11 @@ void udpUpdateEvents(Socket *socket)
          socket->eventFlags |= SOCKET_EVENT_LINK_DOWN;
    }
 
+#if (SOCKET_EVENT_SET_SUPPORT == ENABLED)
+   //Report the events monitored through an event set
+   socketEventSetNotify(socket, socket->eventFlags);
+#endif
+
    //Mask unused events
    socket->eventFlags &= socket->eventMask;
 
@@ -57,6 +57,13 @@
    #error UDP_RX_QUEUE_SIZE parameter is not valid
 #endif
 
+//Zero-copy reception (queued datagram loaned to the application)
+#ifndef UDP_ZERO_COPY_RX_SUPPORT
+   #define UDP_ZERO_COPY_RX_SUPPORT DISABLED
+#elif (UDP_ZERO_COPY_RX_SUPPORT != ENABLED && UDP_ZERO_COPY_RX_SUPPORT != DISABLED)
+   #error UDP_ZERO_COPY_RX_SUPPORT parameter is not valid
+#endif
+
 //C++ guard
 #ifdef __cplusplus
 extern "C" {
@@ -127,6 +134,9 @@ error_t udpSendDatagram(Socket *socket, const IpAddr *destIpAddr,
    uint16_t destPort, const void *data, size_t length, size_t *written,
    uint_t flags);
 
+error_t udpSendBuffer(Socket *socket, const IpAddr *destIpAddr,
+   uint16_t destPort, NetBuffer *buffer, size_t offset, uint_t flags);
+
 error_t udpSendDatagramEx(NetInterface *interface, const IpAddr *srcIpAddr,
    uint16_t srcPort, const IpAddr *destIpAddr, uint16_t destPort,
    NetBuffer *buffer, size_t offset, const NetAncillaryData *ancillary);
@@ -134,6 +144,15 @@ error_t udpSendDatagramEx(NetInterface *interface, const IpAddr *srcIpAddr,
 error_t udpReceiveDatagram(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
    IpAddr *destIpAddr, void *data, size_t size, size_t *received, uint_t flags);
 
+#if (UDP_ZERO_COPY_RX_SUPPORT == ENABLED)
+
+error_t udpReceiveLoan(Socket *socket, IpAddr *srcIpAddr, uint16_t *srcPort,
+   const uint8_t **data, size_t *length, uint_t flags);
+
+error_t udpReleaseLoan(Socket *socket);
+
+#endif
+
 NetBuffer *udpAllocBuffer(size_t length, size_t *offset);
 
 void udpUpdateEvents(Socket *socket);
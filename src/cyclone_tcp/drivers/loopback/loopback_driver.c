@@ -42,6 +42,7 @@ static LoopbackDriverQueueEntry queue[LOOPBACK_DRIVER_QUEUE_SIZE];
 static uint_t queueLength;
 static uint_t queueTxIndex;
 static uint_t queueRxIndex;
+static uint_t queuePending;
 
 
 /**
@@ -65,7 +66,8 @@ const NicDriver loopbackDriver =
    FALSE,
    FALSE,
    FALSE,
-   FALSE
+   FALSE,
+   loopbackDriverReceiveBurst
 };
 
 
@@ -84,6 +86,7 @@ error_t loopbackDriverInit(NetInterface *interface)
    queueLength = 0;
    queueTxIndex = 0;
    queueRxIndex = 0;
+   queuePending = 0;
 
    //Force the TCP/IP stack to poll the link state at startup
    interface->nicEvent = TRUE;
@@ -150,17 +153,7 @@ void loopbackDriverEventHandler(NetInterface *interface)
       nicNotifyLinkChange(interface);
    }
 
-   //Read incoming packet
-   loopbackDriverReceivePacket(interface);
-
-   //Check whether another packet is pending in the queue
-   if(queueLength > 0)
-   {
-      //Set event flag
-      interface->nicEvent = TRUE;
-      //Notify the TCP/IP stack of the event
-      osSetEvent(&netEvent);
-   }
+   //Incoming packets are retrieved by loopbackDriverReceiveBurst
 }
 
 
@@ -262,6 +255,47 @@ error_t loopbackDriverReceivePacket(NetInterface *interface)
 }
 
 
+/**
+ * @brief Receive a burst of packets
+ *
+ * The packets are left in the queue until the next call, so that the
+ * TCP/IP stack can process them without copying
+ *
+ * @param[in] interface Underlying network interface
+ * @param[out] desc Descriptors of the received packets
+ * @param[in] count Maximum number of packets to retrieve
+ * @return Number of packets received
+ **/
+
+uint_t loopbackDriverReceiveBurst(NetInterface *interface, NicRxDesc *desc,
+   uint_t count)
+{
+   uint_t i;
+   uint_t n;
+
+   //Release the packets returned by the previous call
+   queueRxIndex = (queueRxIndex + queuePending) % LOOPBACK_DRIVER_QUEUE_SIZE;
+   queueLength -= queuePending;
+
+   //Number of packets pending in the queue
+   n = MIN(queueLength, count);
+
+   //Loop through the pending packets
+   for(i = 0; i < n; i++)
+   {
+      //Point to the current packet
+      desc[i].data = queue[(queueRxIndex + i) % LOOPBACK_DRIVER_QUEUE_SIZE].data;
+      desc[i].length = queue[(queueRxIndex + i) % LOOPBACK_DRIVER_QUEUE_SIZE].length;
+   }
+
+   //These packets will be released on the next call
+   queuePending = n;
+
+   //Return the number of packets received
+   return n;
+}
+
+
 /**
  * @brief Configure MAC address filtering
  * @param[in] interface Underlying network interface
@@ -70,6 +70,9 @@ error_t loopbackDriverSendPacket(NetInterface *interface,
 
 error_t loopbackDriverReceivePacket(NetInterface *interface);
 
+uint_t loopbackDriverReceiveBurst(NetInterface *interface, NicRxDesc *desc,
+   uint_t count);
+
 error_t loopbackDriverUpdateMacAddrFilter(NetInterface *interface);
 
 #endif
@@ -71,6 +71,7 @@ typedef struct
    pcap_t *handle;
    uint_t writeIndex;
    uint_t readIndex;
+   uint_t pendingCount;
    PcapDriverPacket queue[PCAP_DRIVER_QUEUE_SIZE];
 } PcapDriverContext;
 
@@ -96,7 +97,8 @@ const NicDriver pcapDriver =
    TRUE,
    TRUE,
    TRUE,
-   TRUE
+   TRUE,
+   pcapDriverReceiveBurst
 };
 
 
@@ -354,19 +356,35 @@ void pcapDriverDisableIrq(NetInterface *interface)
 
 void pcapDriverEventHandler(NetInterface *interface)
 {
+   //Incoming packets are retrieved by pcapDriverReceiveBurst
+}
+
+
+/**
+ * @brief Receive a burst of packets
+ *
+ * The packets are left in the receive queue until the next call, so that
+ * the TCP/IP stack can process them without copying
+ *
+ * @param[in] interface Underlying network interface
+ * @param[out] desc Descriptors of the received packets
+ * @param[in] count Maximum number of packets to retrieve
+ * @return Number of packets received
+ **/
+
+uint_t pcapDriverReceiveBurst(NetInterface *interface, NicRxDesc *desc,
+   uint_t count)
+{
+   uint_t i;
    uint_t n;
    PcapDriverContext *context;
 
    //Point to the PCAP driver context
    context = *((PcapDriverContext **) interface->nicContext);
 
-   //Process all pending packets
-   while(context->queue[context->readIndex].length > 0)
+   //Release the packets returned by the previous call
+   for(i = 0; i < context->pendingCount; i++)
    {
-      //Pass the packet to the upper layer
-      nicProcessPacket(interface, context->queue[context->readIndex].data,
-         context->queue[context->readIndex].length);
-
       //Compute the index of the next packet descriptor
       n = (context->readIndex + 1) % PCAP_DRIVER_QUEUE_SIZE;
 
@@ -375,6 +393,27 @@ void pcapDriverEventHandler(NetInterface *interface)
       //Point to the next packet descriptor
       context->readIndex = n;
    }
+
+   //Retrieve the packets written by the receive task
+   for(i = 0, n = context->readIndex; i < count; i++)
+   {
+      //No more packets in the queue?
+      if(context->queue[n].length == 0)
+         break;
+
+      //Point to the current packet
+      desc[i].data = context->queue[n].data;
+      desc[i].length = context->queue[n].length;
+
+      //Compute the index of the next packet descriptor
+      n = (n + 1) % PCAP_DRIVER_QUEUE_SIZE;
+   }
+
+   //These packets will be released on the next call
+   context->pendingCount = i;
+
+   //Return the number of packets received
+   return i;
 }
 
 
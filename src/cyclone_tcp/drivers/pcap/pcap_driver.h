@@ -73,6 +73,9 @@ void pcapDriverDisableIrq(NetInterface *interface);
 
 void pcapDriverEventHandler(NetInterface *interface);
 
+uint_t pcapDriverReceiveBurst(NetInterface *interface, NicRxDesc *desc,
+   uint_t count);
+
 error_t pcapDriverSendPacket(NetInterface *interface,
    const NetBuffer *buffer, size_t offset);
 
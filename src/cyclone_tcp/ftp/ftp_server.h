@@ -392,6 +392,7 @@ struct _FtpClientConnection
    FtpServerChannel controlChannel;                 ///<Control channel
    FtpServerChannel dataChannel;                    ///<Data channel
    FsFile *file;                                    ///<File pointer
+   uint32_t fileOffset;                             ///<Position of the next byte to send
    FsDir *dir;                                      ///<Directory pointer
    bool_t passiveMode;                              ///<Passive data transfer
    IpAddr remoteIpAddr;                             ///<Remote IP address
@@ -2042,6 +2042,8 @@ void ftpServerProcessRetr(FtpClientConnection *connection, char_t *param)
 
    //Open specified file for reading
    connection->file = fsOpenFile(connection->path, FS_FILE_MODE_READ);
+   //Start from the beginning of the file
+   connection->fileOffset = 0;
 
    //Failed to open the file?
    if(!connection->file)
@@ -508,9 +508,63 @@ void ftpServerWriteDataChannel(FtpClientConnection *connection)
       //File transfer in progress?
       if(connection->controlChannel.state == FTP_CHANNEL_STATE_RETR)
       {
+#if (SOCKET_SEND_FILE_SUPPORT == ENABLED)
+#if (FTP_SERVER_TLS_SUPPORT == ENABLED)
+         //TLS-secured connection?
+         if(connection->dataChannel.tlsContext != NULL)
+         {
+            //Read more data
+            error = fsReadFile(connection->file,
+               connection->buffer, FTP_SERVER_BUFFER_SIZE, &n);
+         }
+         else
+#endif
+         {
+            //Send the rest of the file without copying it to the buffer.
+            //The data socket operates in non-blocking mode, so the function
+            //returns as soon as the send buffer is full
+            error = socketSendFile(connection->dataChannel.socket,
+               connection->file, connection->fileOffset,
+               UINT32_MAX - connection->fileOffset, &n, 0);
+
+            //Advance file pointer
+            connection->fileOffset += n;
+
+            //More data remains to be sent?
+            if(error == NO_ERROR || error == ERROR_TIMEOUT)
+               return;
+
+            //Failed to send data?
+            if(error != ERROR_END_OF_FILE)
+            {
+               //Close the data connection
+               ftpServerCloseDataChannel(connection);
+
+               //Release previously allocated resources
+               fsCloseFile(connection->file);
+               connection->file = NULL;
+
+               //Back to idle state
+               connection->controlChannel.state = FTP_CHANNEL_STATE_IDLE;
+
+               //Transfer status
+               osStrcpy(connection->response, "451 Transfer aborted\r\n");
+               //Debug message
+               TRACE_DEBUG("FTP server: %s", connection->response);
+
+               //Number of bytes in the response buffer
+               connection->responseLen = osStrlen(connection->response);
+               connection->responsePos = 0;
+
+               //Exit immediately
+               return;
+            }
+         }
+#else
          //Read more data
          error = fsReadFile(connection->file,
             connection->buffer, FTP_SERVER_BUFFER_SIZE, &n);
+#endif
 
          //End of stream?
          if(error)
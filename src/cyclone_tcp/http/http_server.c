@@ -822,6 +822,148 @@ error_t httpWriteStream(HttpConnection *connection,
 }
 
 
+/**
+ * @brief Write the contents of a multi-part buffer to the client
+ *
+ * On plain connections, the buffer is handed over to the TCP layer so that
+ * the body is never copied. The buffer is typically obtained by calling
+ * socketAllocTxBuffer and filled in place by the application
+ *
+ * @param[in] connection Structure representing an HTTP connection
+ * @param[in] buffer Multi-part buffer containing the data to be transmitted.
+ *   The buffer is always released, even if an error is returned
+ * @param[in] offset Offset to the first data byte
+ * @return Error code
+ **/
+
+error_t httpWriteBuffer(HttpConnection *connection, NetBuffer *buffer,
+   size_t offset)
+{
+   error_t error;
+   uint_t i;
+   uint_t n;
+   size_t length;
+
+   //Check parameters
+   if(buffer == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Number of data bytes held in the buffer
+   length = netBufferGetLength(buffer);
+   length = (offset < length) ? (length - offset) : 0;
+
+#if (NET_RTOS_SUPPORT == ENABLED)
+#if (HTTP_SERVER_TLS_SUPPORT == ENABLED)
+   //TLS records cannot refer to the plaintext
+   if(connection->tlsContext == NULL)
+#endif
+   {
+      //Use chunked encoding transfer?
+      if(connection->response.chunkedEncoding)
+      {
+         //Any data to send?
+         if(length > 0)
+         {
+            char_t s[8];
+
+            //The chunk-size field is a string of hex digits
+            //indicating the size of the chunk
+            n = osSprintf(s, "%X\r\n", (uint_t) length);
+
+            //Send the chunk-size field
+            error = httpSend(connection, s, n, HTTP_FLAG_DELAY);
+
+            //Check status code
+            if(!error)
+            {
+               //Send the chunk-data without copying it
+               error = socketSendBuffer(connection->socket, buffer, offset,
+                  NULL, HTTP_FLAG_DELAY);
+            }
+            else
+            {
+               //Release the buffer
+               netBufferFree(buffer);
+            }
+
+            //Check status code
+            if(!error)
+            {
+               //Terminate the chunk-data by CRLF
+               error = httpSend(connection, "\r\n", 2, HTTP_FLAG_DELAY);
+            }
+         }
+         else
+         {
+            //Any chunk whose size is zero may terminate the data
+            //transfer and must be discarded
+            netBufferFree(buffer);
+            error = NO_ERROR;
+         }
+      }
+      //Default encoding?
+      else
+      {
+         //The length of the body shall not exceed the value
+         //specified in the Content-Length field
+         length = MIN(length, connection->response.byteCount);
+
+         //Discard the excess data
+         error = netBufferSetLength(buffer, offset + length);
+
+         //Check status code
+         if(!error)
+         {
+            //Send user data without copying it
+            error = socketSendBuffer(connection->socket, buffer, offset,
+               NULL, HTTP_FLAG_DELAY);
+         }
+         else
+         {
+            //Release the buffer
+            netBufferFree(buffer);
+         }
+
+         //Decrement the count of remaining bytes to be transferred
+         connection->response.byteCount -= length;
+      }
+
+      //Return status code
+      return error;
+   }
+#endif
+
+   //Initialize status code
+   error = NO_ERROR;
+
+   //Otherwise the data is written chunk by chunk
+   for(i = 0; i < buffer->chunkCount && !error; i++)
+   {
+      //Skip the chunks that precede the data
+      if(offset >= buffer->chunk[i].length)
+      {
+         offset -= buffer->chunk[i].length;
+      }
+      else
+      {
+         //Write the current chunk
+         error = httpWriteStream(connection,
+            (uint8_t *) buffer->chunk[i].address + offset,
+            buffer->chunk[i].length - offset);
+
+         //Process the next chunk from its beginning
+         offset = 0;
+      }
+   }
+
+   //Release the buffer
+   netBufferFree(buffer);
+
+   //Return status code
+   return error;
+}
+
+
 /**
  * @brief Close output stream
  * @param[in] connection Structure representing an HTTP connection
@@ -1003,8 +1145,25 @@ error_t httpSendResponse(HttpConnection *connection, const char_t *uri)
    }
 
 #if (HTTP_SERVER_FS_SUPPORT == ENABLED)
+#if (NET_RTOS_SUPPORT == ENABLED && SOCKET_SEND_FILE_SUPPORT == ENABLED)
+#if (HTTP_SERVER_TLS_SUPPORT == ENABLED)
+   //TLS records cannot refer to the plaintext
+   if(connection->tlsContext == NULL)
+#endif
+   {
+      //Read the file straight into transmit buffers rather than bouncing
+      //through the connection buffer
+      error = socketSendFile(connection->socket, file, 0, length, &n,
+         HTTP_FLAG_DELAY);
+
+      //Decrement the count of remaining bytes to be transferred
+      length -= n;
+      connection->response.byteCount -= n;
+   }
+#endif
+
    //Send response body
-   while(length > 0)
+   while(length > 0 && !error)
    {
       //Limit the number of bytes to read at a time
       n = MIN(length, HTTP_SERVER_BUFFER_SIZE);
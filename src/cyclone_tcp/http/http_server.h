@@ -646,6 +646,9 @@ error_t httpReadStream(HttpConnection *connection,
 error_t httpWriteStream(HttpConnection *connection,
    const void *data, size_t length);
 
+error_t httpWriteBuffer(HttpConnection *connection, NetBuffer *buffer,
+   size_t offset);
+
 error_t httpCloseStream(HttpConnection *connection);
 
 error_t httpSendResponse(HttpConnection *connection, const char_t *uri);
@@ -47,8 +47,11 @@
 //Check TCP/IP stack configuration
 #if (IPV4_SUPPORT == ENABLED && ETH_SUPPORT == ENABLED)
 
-//Tick counter to handle periodic operations
-systime_t arpTickCounter;
+//Forward declaration of functions
+static uint_t arpComputeHash(Ipv4Addr ipAddr);
+static void arpStartTimer(ArpCacheEntry *entry, systime_t timeout);
+static void arpUpdateLru(NetInterface *interface, ArpCacheEntry *entry,
+   bool_t recent);
 
 
 /**
@@ -59,8 +62,43 @@ systime_t arpTickCounter;
 
 error_t arpInit(NetInterface *interface)
 {
+   uint_t i;
+   ArpCacheEntry *entry;
+
+   //Cancel the timers of the entries before they are cleared
+   for(i = 0; i < ARP_CACHE_SIZE; i++)
+   {
+      netStopTimer(&interface->arpCache[i].timer);
+   }
+
    //Initialize the ARP cache
    osMemset(interface->arpCache, 0, sizeof(interface->arpCache));
+   osMemset(interface->arpHashTable, 0, sizeof(interface->arpHashTable));
+
+   //The LRU list is initially empty
+   interface->arpLruHead = NULL;
+   interface->arpLruTail = NULL;
+
+   //Loop through ARP cache entries
+   for(i = 0; i < ARP_CACHE_SIZE; i++)
+   {
+      //Point to the current entry
+      entry = &interface->arpCache[i];
+      //Attach the entry to the interface
+      entry->interface = interface;
+
+      //Unused entries are kept at the tail of the LRU list, so that they
+      //are reused before any valid entry is evicted
+      entry->lruPrev = interface->arpLruTail;
+
+      //Append the entry to the LRU list
+      if(interface->arpLruTail != NULL)
+         interface->arpLruTail->lruNext = entry;
+      else
+         interface->arpLruHead = entry;
+
+      interface->arpLruTail = entry;
+   }
 
    //Successful initialization
    return NO_ERROR;
@@ -83,10 +121,9 @@ void arpFlushCache(NetInterface *interface)
       //Point to the current entry
       entry = &interface->arpCache[i];
 
-      //Drop packets that are waiting for address resolution
-      arpFlushQueuedPackets(interface, entry);
       //Release ARP entry
-      entry->state = ARP_STATE_NONE;
+      if(entry->state != ARP_STATE_NONE)
+         arpDeleteEntry(interface, entry);
    }
 }
 
@@ -94,50 +131,41 @@ void arpFlushCache(NetInterface *interface)
 /**
  * @brief Create a new entry in the ARP cache
  * @param[in] interface Underlying network interface
+ * @param[in] ipAddr IPv4 address
  * @return Pointer to the newly created entry
  **/
 
-ArpCacheEntry *arpCreateEntry(NetInterface *interface)
+ArpCacheEntry *arpCreateEntry(NetInterface *interface, Ipv4Addr ipAddr)
 {
    uint_t i;
-   systime_t time;
    ArpCacheEntry *entry;
-   ArpCacheEntry *oldestEntry;
 
-   //Get current time
-   time = osGetSystemTime();
+   //Unused entries are kept at the tail of the LRU list. Otherwise, the least
+   //recently used entry is removed whenever the table runs out of space
+   entry = interface->arpLruTail;
 
-   //Keep track of the oldest entry
-   oldestEntry = &interface->arpCache[0];
+   //Evict the entry if necessary
+   if(entry->state != ARP_STATE_NONE)
+      arpDeleteEntry(interface, entry);
 
-   //Loop through ARP cache entries
-   for(i = 0; i < ARP_CACHE_SIZE; i++)
-   {
-      //Point to the current entry
-      entry = &interface->arpCache[i];
+   //Erase contents
+   entry->ipAddr = ipAddr;
+   entry->macAddr = MAC_UNSPECIFIED_ADDR;
+   entry->timestamp = 0;
+   entry->timeout = 0;
+   entry->retransmitCount = 0;
+   entry->queueSize = 0;
 
-      //Check whether the entry is currently in used or not
-      if(entry->state == ARP_STATE_NONE)
-      {
-         //Erase contents
-         osMemset(entry, 0, sizeof(ArpCacheEntry));
-         //Return a pointer to the ARP entry
-         return entry;
-      }
+   //Insert the entry in the relevant bucket
+   i = arpComputeHash(ipAddr);
+   entry->hashNext = interface->arpHashTable[i];
+   interface->arpHashTable[i] = entry;
 
-      //Keep track of the oldest entry in the table
-      if((time - entry->timestamp) > (time - oldestEntry->timestamp))
-      {
-         oldestEntry = entry;
-      }
-   }
+   //The new entry is the most recently used one
+   arpUpdateLru(interface, entry, TRUE);
 
-   //Drop any pending packets
-   arpFlushQueuedPackets(interface, oldestEntry);
-   //The oldest entry is removed whenever the table runs out of space
-   osMemset(oldestEntry, 0, sizeof(ArpCacheEntry));
    //Return a pointer to the ARP entry
-   return oldestEntry;
+   return entry;
 }
 
 
@@ -151,22 +179,20 @@ ArpCacheEntry *arpCreateEntry(NetInterface *interface)
 
 ArpCacheEntry *arpFindEntry(NetInterface *interface, Ipv4Addr ipAddr)
 {
-   uint_t i;
    ArpCacheEntry *entry;
 
-   //Loop through ARP cache entries
-   for(i = 0; i < ARP_CACHE_SIZE; i++)
+   //Only the entries of the relevant bucket need to be checked
+   entry = interface->arpHashTable[arpComputeHash(ipAddr)];
+
+   //Loop through the entries of the bucket
+   while(entry != NULL)
    {
-      //Point to the current entry
-      entry = &interface->arpCache[i];
+      //Current entry matches the specified address?
+      if(entry->ipAddr == ipAddr)
+         return entry;
 
-      //Check whether the entry is currently in used
-      if(entry->state != ARP_STATE_NONE)
-      {
-         //Current entry matches the specified address?
-         if(entry->ipAddr == ipAddr)
-            return entry;
-      }
+      //Next entry in the bucket
+      entry = entry->hashNext;
    }
 
    //No matching entry in ARP cache...
@@ -174,6 +200,42 @@ ArpCacheEntry *arpFindEntry(NetInterface *interface, Ipv4Addr ipAddr)
 }
 
 
+/**
+ * @brief Remove an entry from the ARP cache
+ * @param[in] interface Underlying network interface
+ * @param[in] entry Pointer to a ARP cache entry
+ **/
+
+void arpDeleteEntry(NetInterface *interface, ArpCacheEntry *entry)
+{
+   ArpCacheEntry **p;
+
+   //Drop packets that are waiting for address resolution
+   arpFlushQueuedPackets(interface, entry);
+   //Cancel the timer of the entry
+   netStopTimer(&entry->timer);
+
+   //Remove the entry from its bucket
+   for(p = &interface->arpHashTable[arpComputeHash(entry->ipAddr)];
+      *p != NULL; p = &(*p)->hashNext)
+   {
+      //Matching entry?
+      if(*p == entry)
+      {
+         *p = entry->hashNext;
+         break;
+      }
+   }
+
+   //Release ARP entry
+   entry->hashNext = NULL;
+   entry->state = ARP_STATE_NONE;
+
+   //The entry can be reused immediately
+   arpUpdateLru(interface, entry, FALSE);
+}
+
+
 /**
  * @brief Send packets that are waiting for address resolution
  * @param[in] interface Underlying network interface
@@ -259,6 +321,9 @@ error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
    //Check whether a matching entry has been found
    if(entry != NULL)
    {
+      //The entry is now the most recently used one
+      arpUpdateLru(interface, entry, TRUE);
+
       //Check the state of the ARP entry
       if(entry->state == ARP_STATE_INCOMPLETE)
       {
@@ -270,10 +335,8 @@ error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
          //Copy the MAC address associated with the specified IPv4 address
          *macAddr = entry->macAddr;
 
-         //Start delay timer
-         entry->timestamp = osGetSystemTime();
          //Delay before sending the first probe
-         entry->timeout = ARP_DELAY_FIRST_PROBE_TIME;
+         arpStartTimer(entry, ARP_DELAY_FIRST_PROBE_TIME);
          //Switch to the DELAY state
          entry->state = ARP_STATE_DELAY;
 
@@ -292,14 +355,11 @@ error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
    else
    {
       //If no entry exists, then create a new one
-      entry = arpCreateEntry(interface);
+      entry = arpCreateEntry(interface, ipAddr);
 
       //ARP cache entry successfully created?
       if(entry != NULL)
       {
-         //Record the IPv4 address whose MAC address is unknown
-         entry->ipAddr = ipAddr;
-
          //Reset retransmission counter
          entry->retransmitCount = 0;
          //No packet are pending in the transmit queue
@@ -308,10 +368,8 @@ error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr)
          //Send an ARP request
          arpSendRequest(interface, entry->ipAddr, &MAC_BROADCAST_ADDR);
 
-         //Save the time at which the packet was sent
-         entry->timestamp = osGetSystemTime();
-         //Set timeout value
-         entry->timeout = ARP_REQUEST_TIMEOUT;
+         //Start the retransmission timer
+         arpStartTimer(entry, ARP_REQUEST_TIMEOUT);
          //Enter INCOMPLETE state
          entry->state = ARP_STATE_INCOMPLETE;
 
@@ -423,112 +481,168 @@ error_t arpEnqueuePacket(NetInterface *interface, Ipv4Addr ipAddr,
 /**
  * @brief ARP timer handler
  *
- * This routine must be periodically called by the TCP/IP stack to
- * manage ARP cache
+ * This routine is invoked by the timer wheel of the TCP/IP stack when the
+ * timeout of an ARP cache entry elapses
  *
- * @param[in] interface Underlying network interface
+ * @param[in] param Pointer to the ARP cache entry
  **/
 
-void arpTick(NetInterface *interface)
+void arpTimerCallback(void *param)
 {
-   uint_t i;
-   systime_t time;
+   NetInterface *interface;
    ArpCacheEntry *entry;
 
-   //Get current time
-   time = osGetSystemTime();
+   //Point to the ARP cache entry
+   entry = (ArpCacheEntry *) param;
+   //Point to the underlying network interface
+   interface = entry->interface;
 
-   //Go through ARP cache
-   for(i = 0; i < ARP_CACHE_SIZE; i++)
+   //INCOMPLETE state?
+   if(entry->state == ARP_STATE_INCOMPLETE)
    {
-      //Point to the current entry
-      entry = &interface->arpCache[i];
+      //Increment retransmission counter
+      entry->retransmitCount++;
 
-      //INCOMPLETE state?
-      if(entry->state == ARP_STATE_INCOMPLETE)
+      //Check whether the maximum number of retransmissions has been exceeded
+      if(entry->retransmitCount < ARP_MAX_REQUESTS)
       {
-         //The request timed out?
-         if(timeCompare(time, entry->timestamp + entry->timeout) >= 0)
-         {
-            //Increment retransmission counter
-            entry->retransmitCount++;
-
-            //Check whether the maximum number of retransmissions has been exceeded
-            if(entry->retransmitCount < ARP_MAX_REQUESTS)
-            {
-               //Retransmit ARP request
-               arpSendRequest(interface, entry->ipAddr, &MAC_BROADCAST_ADDR);
-
-               //Save the time at which the packet was sent
-               entry->timestamp = time;
-               //Set timeout value
-               entry->timeout = ARP_REQUEST_TIMEOUT;
-            }
-            else
-            {
-               //Drop packets that are waiting for address resolution
-               arpFlushQueuedPackets(interface, entry);
-               //The entry should be deleted since address resolution has failed
-               entry->state = ARP_STATE_NONE;
-            }
-         }
+         //Retransmit ARP request
+         arpSendRequest(interface, entry->ipAddr, &MAC_BROADCAST_ADDR);
+         //Restart the retransmission timer
+         arpStartTimer(entry, ARP_REQUEST_TIMEOUT);
       }
-      //REACHABLE state?
-      else if(entry->state == ARP_STATE_REACHABLE)
+      else
       {
-         //Periodically time out ARP cache entries
-         if(timeCompare(time, entry->timestamp + entry->timeout) >= 0)
-         {
-            //Save current time
-            entry->timestamp = osGetSystemTime();
-            //Enter STALE state
-            entry->state = ARP_STATE_STALE;
-         }
+         //The entry should be deleted since address resolution has failed
+         arpDeleteEntry(interface, entry);
       }
-      //DELAY state?
-      else if(entry->state == ARP_STATE_DELAY)
+   }
+   //REACHABLE state?
+   else if(entry->state == ARP_STATE_REACHABLE)
+   {
+      //Save current time
+      entry->timestamp = osGetSystemTime();
+      //Enter STALE state
+      entry->state = ARP_STATE_STALE;
+   }
+   //DELAY state?
+   else if(entry->state == ARP_STATE_DELAY)
+   {
+      //Send a point-to-point ARP request to the host
+      arpSendRequest(interface, entry->ipAddr, &entry->macAddr);
+
+      //Start the retransmission timer
+      arpStartTimer(entry, ARP_PROBE_TIMEOUT);
+      //Switch to the PROBE state
+      entry->state = ARP_STATE_PROBE;
+   }
+   //PROBE state?
+   else if(entry->state == ARP_STATE_PROBE)
+   {
+      //Increment retransmission counter
+      entry->retransmitCount++;
+
+      //Check whether the maximum number of retransmissions has been exceeded
+      if(entry->retransmitCount < ARP_MAX_PROBES)
       {
-         //Wait for the specified delay before sending the first probe
-         if(timeCompare(time, entry->timestamp + entry->timeout) >= 0)
-         {
-            //Send a point-to-point ARP request to the host
-            arpSendRequest(interface, entry->ipAddr, &entry->macAddr);
-
-            //Save the time at which the packet was sent
-            entry->timestamp = time;
-            //Set timeout value
-            entry->timeout = ARP_PROBE_TIMEOUT;
-            //Switch to the PROBE state
-            entry->state = ARP_STATE_PROBE;
-         }
+         //Send a point-to-point ARP request to the host
+         arpSendRequest(interface, entry->ipAddr, &entry->macAddr);
+         //Restart the retransmission timer
+         arpStartTimer(entry, ARP_PROBE_TIMEOUT);
       }
-      //PROBE state?
-      else if(entry->state == ARP_STATE_PROBE)
+      else
       {
-         //The request timed out?
-         if(timeCompare(time, entry->timestamp + entry->timeout) >= 0)
-         {
-            //Increment retransmission counter
-            entry->retransmitCount++;
+         //The entry should be deleted since the host is not reachable anymore
+         arpDeleteEntry(interface, entry);
+      }
+   }
+}
 
-            //Check whether the maximum number of retransmissions has been exceeded
-            if(entry->retransmitCount < ARP_MAX_PROBES)
-            {
-               //Send a point-to-point ARP request to the host
-               arpSendRequest(interface, entry->ipAddr, &entry->macAddr);
 
-               //Save the time at which the packet was sent
-               entry->timestamp = time;
-               //Set timeout value
-               entry->timeout = ARP_PROBE_TIMEOUT;
-            }
-            else
-            {
-               //The entry should be deleted since the host is not reachable anymore
-               entry->state = ARP_STATE_NONE;
-            }
-         }
-      }
+/**
+ * @brief Compute the index of the hash bucket for a given IPv4 address
+ * @param[in] ipAddr IPv4 address
+ * @return Index of the relevant bucket
+ **/
+
+static uint_t arpComputeHash(Ipv4Addr ipAddr)
+{
+   uint32_t h;
+
+   //Hosts on the same segment only differ in their last bits, so that
+   //these bits must be spread over the whole value
+   h = ntohl(ipAddr);
+   h ^= h >> 16;
+   h *= 0x9E3779B1;
+   h ^= h >> 15;
+
+   //Return the index of the bucket
+   return h & (ARP_HASH_TABLE_SIZE - 1);
+}
+
+
+/**
+ * @brief Start the timer of an ARP cache entry
+ * @param[in] entry Pointer to a ARP cache entry
+ * @param[in] timeout Timeout value
+ **/
+
+static void arpStartTimer(ArpCacheEntry *entry, systime_t timeout)
+{
+   //Save current time
+   entry->timestamp = osGetSystemTime();
+   //Set timeout value
+   entry->timeout = timeout;
+
+   //The state of the entry will be updated when the timeout elapses
+   netStartTimer(&entry->timer, timeout, arpTimerCallback, entry);
+}
+
+
+/**
+ * @brief Move an ARP cache entry to either end of the LRU list
+ * @param[in] interface Underlying network interface
+ * @param[in] entry Pointer to a ARP cache entry
+ * @param[in] recent Move the entry to the head of the list (most recently
+ *   used) if TRUE, or to its tail (first candidate for reuse) if FALSE
+ **/
+
+static void arpUpdateLru(NetInterface *interface, ArpCacheEntry *entry,
+   bool_t recent)
+{
+   //Nothing to do if the entry is already at the right place
+   if(recent && entry == interface->arpLruHead)
+      return;
+   if(!recent && entry == interface->arpLruTail)
+      return;
+
+   //Unlink the entry
+   if(entry->lruPrev != NULL)
+      entry->lruPrev->lruNext = entry->lruNext;
+   else
+      interface->arpLruHead = entry->lruNext;
+
+   if(entry->lruNext != NULL)
+      entry->lruNext->lruPrev = entry->lruPrev;
+   else
+      interface->arpLruTail = entry->lruPrev;
+
+   //Check where the entry must be inserted
+   if(recent)
+   {
+      //Insert the entry at the head of the list
+      entry->lruPrev = NULL;
+      entry->lruNext = interface->arpLruHead;
+      interface->arpLruHead->lruPrev = entry;
+      interface->arpLruHead = entry;
+   }
+   else
+   {
+      //Insert the entry at the tail of the list
+      entry->lruNext = NULL;
+      entry->lruPrev = interface->arpLruTail;
+      interface->arpLruTail->lruNext = entry;
+      interface->arpLruTail = entry;
    }
 }
 
@@ -769,10 +883,8 @@ void arpProcessReply(NetInterface *interface, ArpPacket *arpReply)
          //Send all the packets that are pending for transmission
          arpSendQueuedPackets(interface, entry);
 
-         //Save current time
-         entry->timestamp = osGetSystemTime();
          //The validity of the ARP entry is limited in time
-         entry->timeout = ARP_REACHABLE_TIME;
+         arpStartTimer(entry, ARP_REACHABLE_TIME);
          //Switch to the REACHABLE state
          entry->state = ARP_STATE_REACHABLE;
       }
@@ -781,6 +893,8 @@ void arpProcessReply(NetInterface *interface, ArpPacket *arpReply)
          //Different link-layer address than cached?
          if(!macCompAddr(&arpReply->sha, &entry->macAddr))
          {
+            //Stale entries do not expire
+            netStopTimer(&entry->timer);
             //Enter STALE state
             entry->state = ARP_STATE_STALE;
          }
@@ -791,10 +905,8 @@ void arpProcessReply(NetInterface *interface, ArpPacket *arpReply)
          entry->ipAddr = arpReply->spa;
          entry->macAddr = arpReply->sha;
 
-         //Save current time
-         entry->timestamp = osGetSystemTime();
          //The validity of the ARP entry is limited in time
-         entry->timeout = ARP_REACHABLE_TIME;
+         arpStartTimer(entry, ARP_REACHABLE_TIME);
          //Switch to the REACHABLE state
          entry->state = ARP_STATE_REACHABLE;
       }
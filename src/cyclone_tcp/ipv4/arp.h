@@ -33,13 +33,7 @@
 
 //Dependencies
 #include "core/net.h"
-
-//ARP tick interval
-#ifndef ARP_TICK_INTERVAL
-   #define ARP_TICK_INTERVAL 200
-#elif (ARP_TICK_INTERVAL < 10)
-   #error ARP_TICK_INTERVAL parameter is not valid
-#endif
+#include "core/net_timer.h"
 
 //Size of ARP cache
 #ifndef ARP_CACHE_SIZE
@@ -48,6 +42,13 @@
    #error ARP_CACHE_SIZE parameter is not valid
 #endif
 
+//Number of buckets in the hash table used to search the ARP cache
+#ifndef ARP_HASH_TABLE_SIZE
+   #define ARP_HASH_TABLE_SIZE 16
+#elif (ARP_HASH_TABLE_SIZE < 1 || (ARP_HASH_TABLE_SIZE & (ARP_HASH_TABLE_SIZE - 1)) != 0)
+   #error ARP_HASH_TABLE_SIZE parameter is not valid
+#endif
+
 //Maximum number of packets waiting for address resolution to complete
 #ifndef ARP_MAX_PENDING_PACKETS
    #define ARP_MAX_PENDING_PACKETS 2
@@ -181,7 +182,7 @@ typedef struct
  * @brief ARP cache entry
  **/
 
-typedef struct
+typedef struct _ArpCacheEntry
 {
    ArpState state;                              ///<Reachability state
    Ipv4Addr ipAddr;                             ///<Unicast IPv4 address
@@ -191,18 +192,21 @@ typedef struct
    uint_t retransmitCount;                      ///<Retransmission counter
    ArpQueueItem queue[ARP_MAX_PENDING_PACKETS]; ///<Packets waiting for address resolution to complete
    uint_t queueSize;                            ///<Number of queued packets
+   NetInterface *interface;                     ///<Underlying network interface
+   NetTimer timer;                              ///<Timer that drives the state transitions of the entry
+   struct _ArpCacheEntry *hashNext;             ///<Next entry in the same hash bucket
+   struct _ArpCacheEntry *lruPrev;              ///<More recently used entry
+   struct _ArpCacheEntry *lruNext;              ///<Less recently used entry
 } ArpCacheEntry;
 
 
-//Tick counter to handle periodic operations
-extern systime_t arpTickCounter;
-
 //ARP related functions
 error_t arpInit(NetInterface *interface);
 void arpFlushCache(NetInterface *interface);
 
-ArpCacheEntry *arpCreateEntry(NetInterface *interface);
+ArpCacheEntry *arpCreateEntry(NetInterface *interface, Ipv4Addr ipAddr);
 ArpCacheEntry *arpFindEntry(NetInterface *interface, Ipv4Addr ipAddr);
+void arpDeleteEntry(NetInterface *interface, ArpCacheEntry *entry);
 
 void arpSendQueuedPackets(NetInterface *interface, ArpCacheEntry *entry);
 void arpFlushQueuedPackets(NetInterface *interface, ArpCacheEntry *entry);
@@ -212,7 +216,7 @@ error_t arpResolve(NetInterface *interface, Ipv4Addr ipAddr, MacAddr *macAddr);
 error_t arpEnqueuePacket(NetInterface *interface, Ipv4Addr ipAddr,
    NetBuffer *buffer, size_t offset, const NetAncillaryData *ancillary);
 
-void arpTick(NetInterface *interface);
+void arpTimerCallback(void *param);
 
 void arpProcessPacket(NetInterface *interface, ArpPacket *arpPacket,
    size_t length);
@@ -45,6 +45,7 @@
 #include "core/ip.h"
 #include "core/udp.h"
 #include "core/tcp_fsm.h"
+#include "core/tcp_gro.h"
 #include "core/raw_socket.h"
 #include "ipv4/arp.h"
 #include "ipv4/ipv4.h"
@@ -816,8 +817,13 @@ void ipv4ProcessDatagram(NetInterface *interface, const NetBuffer *buffer,
 #if (TCP_SUPPORT == ENABLED)
    //TCP protocol?
    case IPV4_PROTOCOL_TCP:
+#if (TCP_GRO_SUPPORT == ENABLED)
+      //Coalesce consecutive segments of the same connection
+      tcpGroProcessSegment(interface, &pseudoHeader, buffer, offset, ancillary);
+#else
       //Process incoming TCP segment
       tcpProcessSegment(interface, &pseudoHeader, buffer, offset, ancillary);
+#endif
       //No error to report
       error = NO_ERROR;
       //Continue processing
@@ -912,6 +918,21 @@ error_t ipv4SendDatagram(NetInterface *interface, Ipv4PseudoHeader *pseudoHeader
    //original IP datagram
    id = interface->ipv4Context.identification++;
 
+#if (TCP_SUPPORT == ENABLED && TCP_GSO_SUPPORT == ENABLED)
+   //TCP super-segments are split by the Ethernet layer or by the hardware
+   //and must not be fragmented
+   if(ancillary->gsoSize != 0)
+   {
+      //Each segment consumes its own identification value
+      interface->ipv4Context.identification += (length +
+         ancillary->gsoSize - 1) / ancillary->gsoSize - 1;
+
+      //Send data as is
+      error = ipv4SendPacket(interface, pseudoHeader, id, 0, buffer, offset,
+         ancillary);
+   }
+   else
+#endif
    //If the payload length is smaller than the network interface MTU then no
    //fragmentation is needed
    if((length + sizeof(Ipv4Header)) <= interface->ipv4Context.linkMtu)
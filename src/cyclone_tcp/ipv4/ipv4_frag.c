@@ -571,10 +571,25 @@ Ipv4FragDesc *ipv4SearchFragQueue(NetInterface *interface,
          //Number of chunks that comprise the reassembly buffer
          frag->buffer.maxChunkCount = arraysize(frag->buffer.chunk);
 
-         //Allocate sufficient memory to hold the IPv4 header and
-         //the first hole descriptor
+         //The first chunk holds the IPv4 header only and must not be
+         //extended when the buffer grows
          error = netBufferSetLength((NetBuffer *) &frag->buffer,
-            NET_MEM_POOL_BUFFER_SIZE + sizeof(Ipv4HoleDesc));
+            NET_MEM_POOL_BUFFER_SIZE);
+
+         //The block may come from a larger size class. Use it up entirely so
+         //that the first hole descriptor is placed in a separate chunk
+         if(!error)
+         {
+            error = netBufferSetLength((NetBuffer *) &frag->buffer,
+               frag->buffer.chunk[0].size);
+         }
+
+         //Allocate sufficient memory to hold the first hole descriptor
+         if(!error)
+         {
+            error = netBufferSetLength((NetBuffer *) &frag->buffer,
+               frag->buffer.chunk[0].size + sizeof(Ipv4HoleDesc));
+         }
 
          //Failed to allocate memory?
          if(error)
@@ -0,0 +1,548 @@
+/**
+ * @file ipv4_routing.c
+ * @brief IPv4 routing
+ *
+ * @section License
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Copyright (C) 2010-2020 Oryx Embedded SARL. All rights reserved.
+ *
+ * This file is part of CycloneTCP Open.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * @author Oryx Embedded SARL (www.oryx-embedded.com)
+ * @version 1.9.7b
+ **/
+
+//Switch to the appropriate trace level
+#define TRACE_LEVEL IPV4_TRACE_LEVEL
+
+//Dependencies
+#include "core/net.h"
+#include "core/ip.h"
+#include "core/ip_trie.h"
+#include "ipv4/ipv4.h"
+#include "ipv4/ipv4_misc.h"
+#include "ipv4/ipv4_routing.h"
+#include "ipv4/icmp.h"
+#include "ipv4/arp.h"
+#include "debug.h"
+
+//Check TCP/IP stack configuration
+#if (IPV4_SUPPORT == ENABLED && IPV4_ROUTING_SUPPORT == ENABLED)
+
+//IPv4 routing table
+static Ipv4RoutingTableEntry ipv4RoutingTable[IPV4_ROUTING_TABLE_SIZE];
+//Trie used to find the longest matching route
+static IpTrie ipv4RoutingTrie;
+//Nodes of the trie
+static IpTrieNode ipv4RoutingTrieNodes[2 * IPV4_ROUTING_TABLE_SIZE];
+
+
+/**
+ * @brief Initialize IPv4 routing table
+ * @return Error code
+ **/
+
+error_t ipv4InitRouting(void)
+{
+   //Clear the routing table
+   osMemset(ipv4RoutingTable, 0, sizeof(ipv4RoutingTable));
+
+   //The trie is initially empty
+   ipTrieInit(&ipv4RoutingTrie, ipv4RoutingTrieNodes,
+      arraysize(ipv4RoutingTrieNodes));
+
+   //Successful initialization
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Enable routing for the specified interface
+ * @param[in] interface Underlying network interface
+ * @param[in] enable When the flag is set to TRUE, routing is enabled on the
+ *   interface and the router can forward packets to or from the interface
+ * @return Error code
+ **/
+
+error_t ipv4EnableRouting(NetInterface *interface, bool_t enable)
+{
+   //Check parameters
+   if(interface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+   //Enable or disable routing
+   interface->ipv4Context.isRouter = enable;
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Add a new entry in the IPv4 routing table
+ * @param[in] networkDest Network destination
+ * @param[in] networkMask Subnet mask for this route
+ * @param[in] interface Network interface where to forward the packet
+ * @param[in] nextHop IPv4 address of the next hop
+ * @param[in] metric Metric value
+ * @return Error code
+ **/
+
+error_t ipv4AddRoute(Ipv4Addr networkDest, Ipv4Addr networkMask,
+   NetInterface *interface, Ipv4Addr nextHop, uint_t metric)
+{
+   error_t error;
+   uint_t i;
+   uint_t prefixLen;
+   Ipv4RoutingTableEntry *entry;
+
+   //Check parameters
+   if(interface == NULL)
+      return ERROR_INVALID_PARAMETER;
+
+   //Calculate the length of the prefix
+   prefixLen = ipv4GetPrefixLength(networkMask);
+
+   //The subnet mask must be made of contiguous 1 bits
+   if(prefixLen < 32 && ntohl(networkMask) != ~(0xFFFFFFFFU >> prefixLen))
+      return ERROR_INVALID_PARAMETER;
+
+   //Only the network part of the destination is significant
+   networkDest &= networkMask;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Check whether the routing table already contains the specified
+   //destination
+   entry = ipTrieFind(&ipv4RoutingTrie, (uint8_t *) &networkDest, prefixLen);
+
+   //If the routing table does not contain the specified destination,
+   //then a new entry should be created
+   if(entry == NULL)
+   {
+      //Loop through routing table entries
+      for(i = 0; i < IPV4_ROUTING_TABLE_SIZE; i++)
+      {
+         //Check whether the current entry is free
+         if(!ipv4RoutingTable[i].valid)
+         {
+            entry = &ipv4RoutingTable[i];
+            break;
+         }
+      }
+   }
+
+   //Check whether the routing table runs out of space
+   if(entry != NULL)
+   {
+      //Network destination
+      entry->networkDest = networkDest;
+      entry->networkMask = networkMask;
+
+      //Interface where to forward the packet
+      entry->interface = interface;
+      //Address of the next hop
+      entry->nextHop = nextHop;
+
+      //Metric value
+      entry->metric = metric;
+
+      //Index the route by its prefix
+      error = ipTrieAdd(&ipv4RoutingTrie, (uint8_t *) &networkDest,
+         prefixLen, entry);
+
+      //Check status code
+      if(!error)
+      {
+         //The entry is now valid
+         entry->valid = TRUE;
+      }
+   }
+   else
+   {
+      //The routing table is full
+      error = ERROR_FAILURE;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Remove an entry from the IPv4 routing table
+ * @param[in] networkDest Network destination
+ * @param[in] networkMask Subnet mask for this route
+ * @return Error code
+ **/
+
+error_t ipv4DeleteRoute(Ipv4Addr networkDest, Ipv4Addr networkMask)
+{
+   error_t error;
+   uint_t prefixLen;
+   Ipv4RoutingTableEntry *entry;
+
+   //Calculate the length of the prefix
+   prefixLen = ipv4GetPrefixLength(networkMask);
+
+   //Routes are always defined by contiguous subnet masks
+   if(prefixLen < 32 && ntohl(networkMask) != ~(0xFFFFFFFFU >> prefixLen))
+      return ERROR_NOT_FOUND;
+
+   //Only the network part of the destination is significant
+   networkDest &= networkMask;
+
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Remove the route from the trie
+   entry = ipTrieDelete(&ipv4RoutingTrie, (uint8_t *) &networkDest,
+      prefixLen);
+
+   //Matching route?
+   if(entry != NULL)
+   {
+      //Delete the entry
+      entry->valid = FALSE;
+      //The route was successfully deleted from the routing table
+      error = NO_ERROR;
+   }
+   else
+   {
+      //The route was not found
+      error = ERROR_NOT_FOUND;
+   }
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Return status code
+   return error;
+}
+
+
+/**
+ * @brief Delete all routes from the IPv4 routing table
+ * @return Error code
+ **/
+
+error_t ipv4DeleteAllRoutes(void)
+{
+   //Get exclusive access
+   osAcquireMutex(&netMutex);
+
+   //Clear the routing table
+   osMemset(ipv4RoutingTable, 0, sizeof(ipv4RoutingTable));
+
+   //Flush the trie
+   ipTrieInit(&ipv4RoutingTrie, ipv4RoutingTrieNodes,
+      arraysize(ipv4RoutingTrieNodes));
+
+   //Release exclusive access
+   osReleaseMutex(&netMutex);
+
+   //Successful processing
+   return NO_ERROR;
+}
+
+
+/**
+ * @brief Forward an IPv4 packet
+ * @param[in] srcInterface Network interface on which the packet was received
+ * @param[in] ipPacket Multi-part buffer that holds the IPv4 packet to forward
+ * @param[in] ipPacketOffset Offset to the first byte of the IPv4 packet
+ * @return Error code
+ **/
+
+error_t ipv4ForwardPacket(NetInterface *srcInterface, const NetBuffer *ipPacket,
+   size_t ipPacketOffset)
+{
+   error_t error;
+   size_t length;
+   size_t headerLength;
+   size_t destOffset;
+   NetInterface *destInterface;
+   NetBuffer *destBuffer;
+   Ipv4Header *ipHeader;
+   IpTrieNode *node;
+   Ipv4RoutingTableEntry *entry;
+   Ipv4Addr destIpAddr;
+#if (ETH_SUPPORT == ENABLED)
+   NetInterface *physicalInterface;
+#endif
+
+   //If routing is not enabled on the interface, then the router cannot
+   //forward packets from the interface
+   if(!srcInterface->ipv4Context.isRouter)
+      return ERROR_FAILURE;
+
+   //Calculate the length of the IPv4 packet
+   length = netBufferGetLength(ipPacket) - ipPacketOffset;
+
+   //Ensure the packet length is greater than 20 bytes
+   if(length < sizeof(Ipv4Header))
+      return ERROR_INVALID_LENGTH;
+
+   //Point to the IPv4 header
+   ipHeader = netBufferAt(ipPacket, ipPacketOffset);
+
+   //Sanity check
+   if(ipHeader == NULL)
+      return ERROR_FAILURE;
+
+   //Retrieve the length of the IPv4 header
+   headerLength = ipHeader->headerLength * 4;
+
+   //Check the length of the header
+   if(headerLength < sizeof(Ipv4Header) || headerLength > length)
+      return ERROR_INVALID_HEADER;
+
+   //A router must verify the IP header checksum of every datagram it
+   //forwards (refer to RFC 1812, section 5.2.2)
+   if(ipCalcChecksumEx(ipPacket, ipPacketOffset, headerLength) != 0x0000)
+      return ERROR_INVALID_HEADER;
+
+   //Broadcast and multicast datagrams are not forwarded
+   if(ipv4IsMulticastAddr(ipHeader->destAddr) ||
+      ipHeader->destAddr == IPV4_BROADCAST_ADDR ||
+      ipv4IsBroadcastAddr(srcInterface, ipHeader->destAddr))
+   {
+      return ERROR_INVALID_ADDRESS;
+   }
+
+   //A router must not forward any packet that has an invalid source address
+   //or a source address on network 0 (refer to RFC 1812, section 5.3.7)
+   if(ipHeader->srcAddr == IPV4_UNSPECIFIED_ADDR ||
+      ipv4IsMulticastAddr(ipHeader->srcAddr) ||
+      ipv4IsLoopbackAddr(ipHeader->srcAddr))
+   {
+      return ERROR_INVALID_ADDRESS;
+   }
+
+   //Packets with a link-local source or destination address must not be
+   //forwarded (refer to RFC 3927, section 2.7)
+   if(ipv4IsLinkLocalAddr(ipHeader->srcAddr) ||
+      ipv4IsLinkLocalAddr(ipHeader->destAddr))
+   {
+      return ERROR_INVALID_ADDRESS;
+   }
+
+   //Packets addressed to the loopback network must never be forwarded
+   if(ipv4IsLoopbackAddr(ipHeader->destAddr))
+      return ERROR_INVALID_ADDRESS;
+
+   //Outgoing network interface
+   destInterface = NULL;
+   //Next hop
+   destIpAddr = ipHeader->destAddr;
+
+   //The longest matching route is the most specific route to the destination
+   //IPv4 address. Less specific routes are only used when the outgoing
+   //interface of the more specific ones cannot forward packets
+   node = ipTrieLookup(&ipv4RoutingTrie, (uint8_t *) &ipHeader->destAddr, 32);
+
+   //Route determination process
+   while(node != NULL)
+   {
+      //Point to the routing table entry
+      entry = (Ipv4RoutingTableEntry *) node->data;
+
+      //If routing is enabled on the interface, then the router can forward
+      //packets to the interface
+      if(entry->interface != NULL && entry->interface->ipv4Context.isRouter)
+      {
+         //Outgoing interface on which to forward the packet
+         destInterface = entry->interface;
+
+         //Next hop
+         if(entry->nextHop != IPV4_UNSPECIFIED_ADDR)
+            destIpAddr = entry->nextHop;
+
+         //We are done
+         break;
+      }
+
+      //Try the next shorter prefix
+      node = ipTrieLookupNext(node);
+   }
+
+   //No route to the destination?
+   if(destInterface == NULL)
+   {
+      //A Destination Unreachable message should be generated by a router
+      //in response to a packet that cannot be delivered
+      icmpSendErrorMessage(srcInterface, ICMP_TYPE_DEST_UNREACHABLE,
+         ICMP_CODE_NET_UNREACHABLE, 0, ipPacket, ipPacketOffset);
+
+      //Exit immediately
+      return ERROR_NO_ROUTE;
+   }
+
+   //Check whether the packet is explicitly addressed to the router itself
+   if(ipv4IsLocalHostAddr(ipHeader->destAddr))
+   {
+      //Exit immediately
+      return NO_ERROR;
+   }
+
+   //Time-To-Live exceeded in transit?
+   if(ipHeader->timeToLive <= 1)
+   {
+      //If the TTL is reduced to zero (or less), the packet must be discarded,
+      //and the router must send an ICMP Time Exceeded message to the source
+      icmpSendErrorMessage(srcInterface, ICMP_TYPE_TIME_EXCEEDED,
+         ICMP_CODE_TTL_EXCEEDED, 0, ipPacket, ipPacketOffset);
+
+      //Exit immediately
+      return ERROR_FAILURE;
+   }
+
+   //Check whether the length of the IPv4 packet is larger than the link MTU
+   if(length > destInterface->ipv4Context.linkMtu)
+   {
+      //The datagram cannot be fragmented?
+      if(ntohs(ipHeader->fragmentOffset) & IPV4_FLAG_DF)
+      {
+         //A Destination Unreachable message must be sent by a router in
+         //response to a packet that it cannot forward because the packet
+         //is larger than the MTU of the outgoing link
+         icmpSendErrorMessage(srcInterface, ICMP_TYPE_DEST_UNREACHABLE,
+            ICMP_CODE_FRAG_NEEDED_AND_DF_SET, 0, ipPacket, ipPacketOffset);
+      }
+
+      //Forwarded datagrams are not fragmented
+      return ERROR_INVALID_LENGTH;
+   }
+
+   //Allocate a buffer to hold the IPv4 packet
+   destBuffer = ethAllocBuffer(length, &destOffset);
+
+   //Successful memory allocation?
+   if(destBuffer != NULL)
+   {
+      //Copy IPv4 packet
+      error = netBufferCopy(destBuffer, destOffset, ipPacket, ipPacketOffset,
+         length);
+
+      //Check status code
+      if(!error)
+      {
+         //Point to the IPv4 header
+         ipHeader = netBufferAt(destBuffer, destOffset);
+
+         //Every time a router forwards a packet, it decrements the TTL field
+         ipHeader->timeToLive--;
+
+         //The header checksum must be recomputed since the TTL field has
+         //been modified
+         ipHeader->headerChecksum = 0;
+         ipHeader->headerChecksum = ipCalcChecksum(ipHeader, headerLength);
+
+#if (ETH_SUPPORT == ENABLED)
+         //Point to the physical interface
+         physicalInterface = nicGetPhysicalInterface(destInterface);
+
+         //Ethernet interface?
+         if(physicalInterface->nicDriver != NULL &&
+            physicalInterface->nicDriver->type == NIC_TYPE_ETHERNET)
+         {
+            MacAddr destMacAddr;
+
+            //Resolve host address using ARP
+            error = arpResolve(destInterface, destIpAddr, &destMacAddr);
+
+            //Successful address resolution?
+            if(!error)
+            {
+               //Debug message
+               TRACE_INFO("Forwarding IPv4 packet to %s (%" PRIuSIZE " bytes)...\r\n",
+                  destInterface->name, length);
+               //Dump IP header contents for debugging purpose
+               ipv4DumpHeader(ipHeader);
+
+               //Send Ethernet frame
+               error = ethSendFrame(destInterface, &destMacAddr, ETH_TYPE_IPV4,
+                  destBuffer, destOffset, &NET_DEFAULT_ANCILLARY_DATA);
+            }
+            //Address resolution is in progress?
+            else if(error == ERROR_IN_PROGRESS)
+            {
+               //Debug message
+               TRACE_INFO("Enqueuing IPv4 packet (%" PRIuSIZE " bytes)...\r\n", length);
+               //Dump IP header contents for debugging purpose
+               ipv4DumpHeader(ipHeader);
+
+               //Enqueue packets waiting for address resolution
+               error = arpEnqueuePacket(destInterface, destIpAddr, destBuffer,
+                  destOffset, &NET_DEFAULT_ANCILLARY_DATA);
+            }
+            //Address resolution failed?
+            else
+            {
+               //Debug message
+               TRACE_WARNING("Cannot map IPv4 address to Ethernet address!\r\n");
+            }
+         }
+         else
+#endif
+#if (PPP_SUPPORT == ENABLED)
+         //PPP interface?
+         if(destInterface->nicDriver != NULL &&
+            destInterface->nicDriver->type == NIC_TYPE_PPP)
+         {
+            //Debug message
+            TRACE_INFO("Forwarding IPv4 packet to %s (%" PRIuSIZE " bytes)...\r\n",
+               destInterface->name, length);
+            //Dump IP header contents for debugging purpose
+            ipv4DumpHeader(ipHeader);
+
+            //Send PPP frame
+            error = pppSendFrame(destInterface, destBuffer, destOffset, PPP_PROTOCOL_IP);
+         }
+         else
+#endif
+         //Unknown interface type?
+         {
+            //Report an error
+            error = ERROR_INVALID_INTERFACE;
+         }
+      }
+
+      //Free previously allocated memory
+      netBufferFree(destBuffer);
+   }
+   else
+   {
+      //Failed to allocate memory
+      error = ERROR_OUT_OF_MEMORY;
+   }
+
+   //Return status code
+   return error;
+}
+
+#endif
@@ -43,6 +43,7 @@
 #include "core/ip.h"
 #include "core/udp.h"
 #include "core/tcp_fsm.h"
+#include "core/tcp_gro.h"
 #include "core/raw_socket.h"
 #include "ipv6/ipv6.h"
 #include "ipv6/ipv6_frag.h"
@@ -1103,8 +1104,14 @@ void ipv6ProcessPacket(NetInterface *interface, NetBuffer *ipPacket,
          //Packets addressed to the tentative address should be silently discarded
          if(!ipv6IsTentativeAddr(interface, &ipHeader->destAddr))
          {
+#if (TCP_GRO_SUPPORT == ENABLED)
+            //Coalesce consecutive segments of the same connection
+            tcpGroProcessSegment(interface, &pseudoHeader, ipPacket, i,
+               ancillary);
+#else
             //Process incoming TCP segment
             tcpProcessSegment(interface, &pseudoHeader, ipPacket, i, ancillary);
+#endif
          }
          else
          {
@@ -1607,6 +1614,17 @@ error_t ipv6SendDatagram(NetInterface *interface, Ipv6PseudoHeader *pseudoHeader
    pathMtu = interface->ipv6Context.linkMtu;
 #endif
 
+#if (TCP_SUPPORT == ENABLED && TCP_GSO_SUPPORT == ENABLED)
+   //TCP super-segments are split by the Ethernet layer or by the hardware
+   //and must not be fragmented
+   if(ancillary->gsoSize != 0)
+   {
+      //Send data as is
+      error = ipv6SendPacket(interface, pseudoHeader, 0, 0, buffer, offset,
+         ancillary);
+   }
+   else
+#endif
    //If the payload length is smaller than the PMTU then no fragmentation is
    //needed
    if((length + sizeof(Ipv6Header)) <= pathMtu)
@@ -645,10 +645,25 @@ Ipv6FragDesc *ipv6SearchFragQueue(NetInterface *interface,
          //Number of chunks that comprise the reassembly buffer
          frag->buffer.maxChunkCount = arraysize(frag->buffer.chunk);
 
-         //Allocate sufficient memory to hold the IPv6 header and
-         //the first hole descriptor
+         //The first chunk holds the IPv6 header only and must not be
+         //extended when the buffer grows
          error = netBufferSetLength((NetBuffer *) &frag->buffer,
-            NET_MEM_POOL_BUFFER_SIZE + sizeof(Ipv6HoleDesc));
+            NET_MEM_POOL_BUFFER_SIZE);
+
+         //The block may come from a larger size class. Use it up entirely so
+         //that the first hole descriptor is placed in a separate chunk
+         if(!error)
+         {
+            error = netBufferSetLength((NetBuffer *) &frag->buffer,
+               frag->buffer.chunk[0].size);
+         }
+
+         //Allocate sufficient memory to hold the first hole descriptor
+         if(!error)
+         {
+            error = netBufferSetLength((NetBuffer *) &frag->buffer,
+               frag->buffer.chunk[0].size + sizeof(Ipv6HoleDesc));
+         }
 
          //Failed to allocate memory?
          if(error)
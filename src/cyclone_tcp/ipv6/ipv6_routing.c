@@ -32,9 +32,9 @@
 #define TRACE_LEVEL IPV6_TRACE_LEVEL
 
 //Dependencies
-#include <limits.h>
 #include "core/net.h"
 #include "core/ip.h"
+#include "core/ip_trie.h"
 #include "ipv6/ipv6.h"
 #include "ipv6/ipv6_misc.h"
 #include "ipv6/ipv6_routing.h"
@@ -47,6 +47,10 @@
 
 //IPv6 routing table
 static Ipv6RoutingTableEntry ipv6RoutingTable[IPV6_ROUTING_TABLE_SIZE];
+//Trie used to find the longest matching route
+static IpTrie ipv6RoutingTrie;
+//Nodes of the trie
+static IpTrieNode ipv6RoutingTrieNodes[2 * IPV6_ROUTING_TABLE_SIZE];
 
 
 /**
@@ -59,6 +63,10 @@ error_t ipv6InitRouting(void)
    //Clear the routing table
    osMemset(ipv6RoutingTable, 0, sizeof(ipv6RoutingTable));
 
+   //The trie is initially empty
+   ipTrieInit(&ipv6RoutingTrie, ipv6RoutingTrieNodes,
+      arraysize(ipv6RoutingTrieNodes));
+
    //Successful initialization
    return NO_ERROR;
 }
@@ -106,48 +114,34 @@ error_t ipv6AddRoute(const Ipv6Addr *prefix, uint_t prefixLen,
    error_t error;
    uint_t i;
    Ipv6RoutingTableEntry *entry;
-   Ipv6RoutingTableEntry *firstFreeEntry;
 
    //Check parameters
-   if(prefix == NULL || interface == NULL)
+   if(prefix == NULL || interface == NULL || prefixLen > 128)
       return ERROR_INVALID_PARAMETER;
 
-   //Keep track of the first free entry
-   firstFreeEntry = NULL;
-
    //Get exclusive access
    osAcquireMutex(&netMutex);
 
-   //Loop through routing table entries
-   for(i = 0; i < IPV6_ROUTING_TABLE_SIZE; i++)
-   {
-      //Point to the current entry
-      entry = &ipv6RoutingTable[i];
+   //Check whether the routing table already contains the specified
+   //destination
+   entry = ipTrieFind(&ipv6RoutingTrie, prefix->b, prefixLen);
 
-      //Valid entry?
-      if(entry->valid)
+   //If the routing table does not contain the specified destination,
+   //then a new entry should be created
+   if(entry == NULL)
+   {
+      //Loop through routing table entries
+      for(i = 0; i < IPV6_ROUTING_TABLE_SIZE; i++)
       {
-         //Check prefix length
-         if(entry->prefixLen == prefixLen)
+         //Check whether the current entry is free
+         if(!ipv6RoutingTable[i].valid)
          {
-            //Check whether the current entry matches the specified destination
-            if(ipv6CompPrefix(&entry->prefix, prefix, prefixLen))
-               break;
+            entry = &ipv6RoutingTable[i];
+            break;
          }
       }
-      else
-      {
-         //Keep track of the first free entry
-         if(firstFreeEntry == NULL)
-            firstFreeEntry = entry;
-      }
    }
 
-   //If the routing table does not contain the specified destination,
-   //then a new entry should be created
-   if(i >= IPV6_ROUTING_TABLE_SIZE)
-      entry = firstFreeEntry;
-
    //Check whether the routing table runs out of space
    if(entry != NULL)
    {
@@ -166,11 +160,16 @@ error_t ipv6AddRoute(const Ipv6Addr *prefix, uint_t prefixLen,
 
       //Metric value
       entry->metric = metric;
-      //The entry is now valid
-      entry->valid = TRUE;
 
-      //Sucessful processing
-      error = NO_ERROR;
+      //Index the route by its prefix
+      error = ipTrieAdd(&ipv6RoutingTrie, prefix->b, prefixLen, entry);
+
+      //Check status code
+      if(!error)
+      {
+         //The entry is now valid
+         entry->valid = TRUE;
+      }
    }
    else
    {
@@ -196,37 +195,30 @@ error_t ipv6AddRoute(const Ipv6Addr *prefix, uint_t prefixLen,
 error_t ipv6DeleteRoute(const Ipv6Addr *prefix, uint_t prefixLen)
 {
    error_t error;
-   uint_t i;
    Ipv6RoutingTableEntry *entry;
 
-   //Initialize status code
-   error = ERROR_NOT_FOUND;
+   //Check parameters
+   if(prefix == NULL || prefixLen > 128)
+      return ERROR_INVALID_PARAMETER;
 
    //Get exclusive access
    osAcquireMutex(&netMutex);
 
-   //Loop through routing table entries
-   for(i = 0; i < IPV6_ROUTING_TABLE_SIZE; i++)
-   {
-      //Point to the current entry
-      entry = &ipv6RoutingTable[i];
+   //Remove the route from the trie
+   entry = ipTrieDelete(&ipv6RoutingTrie, prefix->b, prefixLen);
 
-      //Valid entry?
-      if(entry->valid)
-      {
-         //Check prefix length
-         if(entry->prefixLen == prefixLen)
-         {
-            //Check whether the current entry matches the specified destination
-            if(ipv6CompPrefix(&entry->prefix, prefix, prefixLen))
-            {
-               //Delete current entry
-               entry->valid = FALSE;
-               //The route was successfully deleted from the routing table
-               error = NO_ERROR;
-            }
-         }
-      }
+   //Matching route?
+   if(entry != NULL)
+   {
+      //Delete the entry
+      entry->valid = FALSE;
+      //The route was successfully deleted from the routing table
+      error = NO_ERROR;
+   }
+   else
+   {
+      //The route was not found
+      error = ERROR_NOT_FOUND;
    }
 
    //Release exclusive access
@@ -246,8 +238,14 @@ error_t ipv6DeleteAllRoutes(void)
 {
    //Get exclusive access
    osAcquireMutex(&netMutex);
+
    //Clear the routing table
    osMemset(ipv6RoutingTable, 0, sizeof(ipv6RoutingTable));
+
+   //Flush the trie
+   ipTrieInit(&ipv6RoutingTrie, ipv6RoutingTrieNodes,
+      arraysize(ipv6RoutingTrieNodes));
+
    //Release exclusive access
    osReleaseMutex(&netMutex);
 
@@ -268,15 +266,12 @@ error_t ipv6ForwardPacket(NetInterface *srcInterface, NetBuffer *ipPacket,
    size_t ipPacketOffset)
 {
    error_t error;
-   uint_t i;
-   uint_t metric;
-   uint_t prefixLen;
-   bool_t match;
    size_t length;
    size_t destOffset;
    NetInterface *destInterface;
    NetBuffer *destBuffer;
    Ipv6Header *ipHeader;
+   IpTrieNode *node;
    Ipv6RoutingTableEntry *entry;
    Ipv6Addr destIpAddr;
 #if (ETH_SUPPORT == ENABLED)
@@ -332,64 +327,30 @@ error_t ipv6ForwardPacket(NetInterface *srcInterface, NetBuffer *ipPacket,
    }
    else
    {
-      //Lowest metric value
-      metric = UINT_MAX;
-      //Longest prefix length
-      prefixLen = 0;
       //Outgoing network interface
       destInterface = NULL;
 
+      //The longest matching route is the most specific route to the
+      //destination IPv6 address. Less specific routes are only used when
+      //the outgoing interface of the more specific ones cannot forward
+      //packets
+      node = ipTrieLookup(&ipv6RoutingTrie, ipHeader->destAddr.b, 128);
+
       //Route determination process
-      for(i = 0; i < IPV6_ROUTING_TABLE_SIZE; i++)
+      while(node != NULL)
       {
-         //Point to the current entry
-         entry = &ipv6RoutingTable[i];
+         //Point to the routing table entry
+         entry = (Ipv6RoutingTableEntry *) node->data;
 
-         //Valid entry?
-         if(entry->valid && entry->interface != NULL)
+         //Do not forward any IP packets to an interface that has not
+         //been assigned a valid link-local address...
+         if(entry->interface != NULL &&
+            ipv6GetLinkLocalAddrState(entry->interface) == IPV6_ADDR_STATE_PREFERRED)
          {
-            //Clear flag
-            match = FALSE;
-
-            //Do not forward any IP packets to an interface that has not
-            //been assigned a valid link-local address...
-            if(ipv6GetLinkLocalAddrState(entry->interface) == IPV6_ADDR_STATE_PREFERRED)
-            {
-               //If routing is enabled on the interface, then the router
-               //can forward packets to the interface
-               if(entry->interface->ipv6Context.isRouter)
-               {
-                  //Compare the destination address with the current entry for a match
-                  if(ipv6CompPrefix(&ipHeader->destAddr, &entry->prefix, entry->prefixLen))
-                  {
-                     //The longest matching route is the most specific route to the
-                     //destination IPv6 address...
-                     if(entry->prefixLen > prefixLen)
-                     {
-                        //Give the current route the higher precedence
-                        match = TRUE;
-                     }
-                     else if(entry->prefixLen == prefixLen)
-                     {
-                        //If multiple entries with the longest match are found, the
-                        //router uses the lowest metric to select the best route
-                        if(entry->metric < metric)
-                        {
-                           //Give the current route the higher precedence
-                           match = TRUE;
-                        }
-                     }
-                  }
-               }
-            }
-
-            //Matching entry?
-            if(match)
+            //If routing is enabled on the interface, then the router
+            //can forward packets to the interface
+            if(entry->interface->ipv6Context.isRouter)
             {
-               //Select the current route
-               metric = entry->metric;
-               prefixLen = entry->prefixLen;
-
                //Outgoing interface on which to forward the packet
                destInterface = entry->interface;
 
@@ -398,8 +359,14 @@ error_t ipv6ForwardPacket(NetInterface *srcInterface, NetBuffer *ipPacket,
                   destIpAddr = entry->nextHop;
                else
                   destIpAddr = ipHeader->destAddr;
+
+               //We are done
+               break;
             }
          }
+
+         //Try the next shorter prefix
+         node = ipTrieLookupNext(node);
       }
    }
 
@@ -600,11 +600,11 @@ error_t mqttClientWaitForData(MqttClientContext *context, systime_t timeout)
    if(context->settings.transportProtocol == MQTT_TRANSPORT_PROTOCOL_TCP)
    {
       //Get exclusive access
-      osAcquireMutex(&netMutex);
+      socketAcquireMutex(context->socket, FALSE);
       //Wait for some data to be available for reading
       event = tcpWaitForEvents(context->socket, SOCKET_EVENT_RX_READY, timeout);
       //Release exclusive access
-      osReleaseMutex(&netMutex);
+      socketReleaseMutex(context->socket);
    }
 #if (MQTT_CLIENT_TLS_SUPPORT == ENABLED)
    //TLS transport protocol?
@@ -623,11 +623,11 @@ error_t mqttClientWaitForData(MqttClientContext *context, systime_t timeout)
       else
       {
          //Get exclusive access
-         osAcquireMutex(&netMutex);
+         socketAcquireMutex(context->socket, FALSE);
          //Wait for some data to be available for reading
          event = tcpWaitForEvents(context->socket, SOCKET_EVENT_RX_READY, timeout);
          //Release exclusive access
-         osReleaseMutex(&netMutex);
+         socketReleaseMutex(context->socket);
       }
    }
 #endif
@@ -640,11 +640,11 @@ error_t mqttClientWaitForData(MqttClientContext *context, systime_t timeout)
          return ERROR_FAILURE;
 
       //Get exclusive access
-      osAcquireMutex(&netMutex);
+      socketAcquireMutex(context->webSocket->socket, FALSE);
       //Wait for some data to be available for reading
       event = tcpWaitForEvents(context->webSocket->socket, SOCKET_EVENT_RX_READY, timeout);
       //Release exclusive access
-      osReleaseMutex(&netMutex);
+      socketReleaseMutex(context->webSocket->socket);
    }
 #endif
 #if (MQTT_CLIENT_WS_SUPPORT == ENABLED && WEB_SOCKET_TLS_SUPPORT)
@@ -664,11 +664,11 @@ error_t mqttClientWaitForData(MqttClientContext *context, systime_t timeout)
       else
       {
          //Get exclusive access
-         osAcquireMutex(&netMutex);
+         socketAcquireMutex(context->webSocket->socket, FALSE);
          //Wait for some data to be available for reading
          event = tcpWaitForEvents(context->webSocket->socket, SOCKET_EVENT_RX_READY, timeout);
          //Release exclusive access
-         osReleaseMutex(&netMutex);
+         socketReleaseMutex(context->webSocket->socket);
       }
    }
 #endif